@@ -59,6 +59,7 @@ dec_srcs := \
 demux_srcs := \
     src/demux/anim_decode.c \
     src/demux/demux.c \
+    src/demux/tile_decode.c \
 
 dsp_dec_srcs := \
     src/dsp/alpha_processing.c \
@@ -158,6 +159,7 @@ mux_srcs := \
     src/mux/muxedit.c \
     src/mux/muxinternal.c \
     src/mux/muxread.c \
+    src/mux/tile_encode.c \
 
 utils_dec_srcs := \
     src/utils/bit_reader_utils.c \
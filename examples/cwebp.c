@@ -631,6 +631,8 @@ static void HelpLong(void) {
       "  -resize_mode <string> .. one of: up_only, down_only,"
       " always (default)\n");
   printf("  -mt .................... use multi-threading if available\n");
+  printf("  -threads <int> ......... number of threads (0..64), from 2 implies\n"
+         "                           -mt and codes lossy rows concurrently\n");
   printf("  -low_memory ............ reduce memory usage (slower encoding)\n");
   printf("  -map <int> ............. print map of extra info\n");
   printf("  -print_psnr ............ prints averaged PSNR distortion\n");
@@ -854,6 +856,8 @@ int main(int argc, const char* argv[]) {
       config.emulate_jpeg_size = 1;
     } else if (!strcmp(argv[c], "-mt")) {
       ++config.thread_level;  // increase thread level
+    } else if (!strcmp(argv[c], "-threads") && c + 1 < argc) {
+      picture.num_threads = ExUtilGetInt(argv[++c], 0, &parse_error);
     } else if (!strcmp(argv[c], "-low_memory")) {
       config.low_memory = 1;
     } else if (!strcmp(argv[c], "-strong")) {
@@ -1030,6 +1034,10 @@ int main(int argc, const char* argv[]) {
               " encoding. Ignoring this option!\n");
     }
   }
+  // Several threads imply -mt.
+  if (picture.num_threads >= 2 && config.thread_level == 0) {
+    config.thread_level = 1;
+  }
   // If a target size or PSNR was given, but somehow the -pass option was
   // omitted, force a reasonable value.
   if (config.target_size > 0 || config.target_PSNR > 0) {
@@ -10,5 +10,7 @@
 #include "sharpyuv/sharpyuv_cpu.h"
 
 // Include src/dsp/cpu.c to create SharpYuvGetCPUInfo from VP8GetCPUInfo. The
-// function pointer is renamed in sharpyuv_cpu.h.
+// function pointer is renamed in sharpyuv_cpu.h. The SIMD level API is only
+// exported by libwebp.
+#define WEBP_CPU_OMIT_SIMD_LEVEL_API
 #include "src/dsp/cpu.c"
@@ -172,12 +172,25 @@ WEBP_NODISCARD static int AllocateAlphaPlane(VP8Decoder* const dec,
   const int stride = io->width;
   const int height = io->crop_bottom;
   const uint64_t alpha_size = (uint64_t)stride * height;
-  assert(dec->alpha_plane_mem == NULL);
-  dec->alpha_plane_mem =
-      (uint8_t*)WebPSafeMalloc(alpha_size, sizeof(*dec->alpha_plane));
-  if (dec->alpha_plane_mem == NULL) {
-    return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
-                       "Alpha decoder initialization failed.");
+  if (WebPArenaIsMeasuring(dec->arena)) {  // nothing to set up
+    if (!WebPArenaReserve(dec->arena, alpha_size, sizeof(*dec->alpha_plane))) {
+      return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                         "Alpha decoder initialization failed.");
+    }
+    return 1;
+  }
+  // The memory of a previous picture is reused if large enough (see
+  // VP8Reset()).
+  if (alpha_size > dec->alpha_plane_mem_size) {
+    WebPArenaFree(dec->arena, dec->alpha_plane_mem);
+    dec->alpha_plane_mem_size = 0;
+    dec->alpha_plane_mem = (uint8_t*)WebPArenaMalloc(dec->arena, alpha_size,
+                                                     sizeof(*dec->alpha_plane));
+    if (dec->alpha_plane_mem == NULL) {
+      return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                         "Alpha decoder initialization failed.");
+    }
+    dec->alpha_plane_mem_size = (size_t)alpha_size;
   }
   dec->alpha_plane = dec->alpha_plane_mem;
   dec->alpha_prev_line = NULL;
@@ -186,13 +199,29 @@ WEBP_NODISCARD static int AllocateAlphaPlane(VP8Decoder* const dec,
 
 void WebPDeallocateAlphaMemory(VP8Decoder* const dec) {
   assert(dec != NULL);
-  WebPSafeFree(dec->alpha_plane_mem);
+  WebPArenaFree(dec->arena, dec->alpha_plane_mem);
   dec->alpha_plane_mem = NULL;
+  dec->alpha_plane_mem_size = 0;
   dec->alpha_plane = NULL;
   ALPHDelete(dec->alph_dec);
   dec->alph_dec = NULL;
 }
 
+int VP8ReserveAlphaMemory(VP8Decoder* const dec, const VP8Io* const io) {
+  assert(dec != NULL && io != NULL);
+  assert(WebPArenaIsMeasuring(dec->arena));
+  if (!AllocateAlphaPlane(dec, io)) return 0;
+  // The compression method is the only part of the header needed. Invalid
+  // headers are left to the decoding.
+  if (dec->alpha_data_size > ALPHA_HEADER_LEN &&
+      (dec->alpha_data[0] & 0x03) == ALPHA_LOSSLESS_COMPRESSION &&
+      !VP8LReserveAlphaMemory(dec->arena, io->width, io->height)) {
+    return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                       "Alpha decoder initialization failed.");
+  }
+  return 1;
+}
+
 //------------------------------------------------------------------------------
 // Main entry point.
 
@@ -216,6 +245,7 @@ WEBP_NODISCARD const uint8_t* VP8DecompressAlphaRows(VP8Decoder* const dec,
                     "Alpha decoder initialization failed.");
         return NULL;
       }
+      dec->alph_dec->arena = dec->arena;
       if (!AllocateAlphaPlane(dec, io)) goto Error;
       {
         const VP8StatusCode status =
@@ -18,6 +18,7 @@
 #include "src/dec/webpi_dec.h"
 #include "src/dsp/dsp.h"
 #include "src/utils/filters_utils.h"
+#include "src/utils/utils.h"
 #include "src/webp/types.h"
 
 WEBP_ASSUME_UNSAFE_INDEXABLE_ABI
@@ -36,6 +37,7 @@ struct ALPHDecoder {
   WEBP_FILTER_TYPE filter;
   int pre_processing;
   struct VP8LDecoder* vp8l_dec;
+  WebPArena* arena;  // if not NULL, memory of the lossless decoder buffers
   VP8Io io;
   int use_8b_decode;  // Although alpha channel requires only 1 byte per
                       // pixel, sometimes VP8LDecoder may need to allocate
@@ -43,11 +43,29 @@ int IsValidColorspace(int webp_csp_mode) {
 #define MIN_BUFFER_SIZE(WIDTH, HEIGHT, STRIDE) \
   ((uint64_t)(STRIDE) * ((HEIGHT) - 1) + (WIDTH))
 
-static VP8StatusCode CheckDecBuffer(const WebPDecBuffer* const buffer) {
+// Maximum number of source rows output at once: a macroblock row, plus the
+// rows delayed by the loop-filter, the fancy upsampler or the chroma rescaler
+// (see FinishRow() and NUM_ARGB_CACHE_ROWS).
+#define MAX_ROWS_PER_OUTPUT 40
+
+// Returns the number of rows stored at once in 'buffer', given the height of
+// the decoded area before scaling.
+static int GetNumBufferRows(const WebPDecBuffer* const buffer,
+                            int src_height) {
+  uint64_t num_rows;
+  if (buffer->row_sink == NULL) return buffer->height;
+  // The rescaler can output one more row than the scaled number of rows.
+  num_rows = ((uint64_t)MAX_ROWS_PER_OUTPUT * buffer->height + src_height - 1) /
+                 src_height + 1;
+  return (num_rows < (uint64_t)buffer->height) ? (int)num_rows
+                                               : buffer->height;
+}
+
+static VP8StatusCode CheckDecBuffer(const WebPDecBuffer* const buffer,
+                                    int height) {
   int ok = 1;
   const WEBP_CSP_MODE mode = buffer->colorspace;
   const int width = buffer->width;
-  const int height = buffer->height;
   if (!IsValidColorspace(mode)) {
     ok = 0;
   } else if (!WebPIsRGBMode(mode)) {  // YUV checks
@@ -89,9 +107,11 @@ static VP8StatusCode CheckDecBuffer(const WebPDecBuffer* const buffer) {
 }
 #undef MIN_BUFFER_SIZE
 
-static VP8StatusCode AllocateBuffer(WebPDecBuffer* const buffer) {
+// Allocates the 'h' rows held by 'buffer', if its memory is internal, from
+// 'arena' if not NULL, or only accounts for them if 'arena' is measuring.
+static VP8StatusCode AllocateBuffer(WebPDecBuffer* const buffer, int h,
+                                    WebPArena* const arena) {
   const int w = buffer->width;
-  const int h = buffer->height;
   const WEBP_CSP_MODE mode = buffer->colorspace;
 
   if (w <= 0 || h <= 0 || !IsValidColorspace(mode)) {
@@ -122,11 +142,17 @@ static VP8StatusCode AllocateBuffer(WebPDecBuffer* const buffer) {
     }
     total_size = size + 2 * uv_size + a_size;
 
-    output = (uint8_t*)WebPSafeMalloc(total_size, sizeof(*output));
+    if (WebPArenaIsMeasuring(arena)) {  // the buffer is not set up
+      return WebPArenaReserve(arena, total_size, sizeof(*output))
+                 ? VP8_STATUS_OK
+                 : VP8_STATUS_OUT_OF_MEMORY;
+    }
+    output = (uint8_t*)WebPArenaMalloc(arena, total_size, sizeof(*output));
     if (output == NULL) {
       return VP8_STATUS_OUT_OF_MEMORY;
     }
-    buffer->private_memory = output;
+    // The memory carved from an arena is not owned by the buffer.
+    buffer->private_memory = (arena == NULL) ? output : NULL;
 
     if (!WebPIsRGBMode(mode)) {  // YUVA initialization
       WebPYUVABuffer* const buf = &buffer->u.YUVA;
@@ -151,7 +177,7 @@ static VP8StatusCode AllocateBuffer(WebPDecBuffer* const buffer) {
       buf->size = (size_t)size;
     }
   }
-  return CheckDecBuffer(buffer);
+  return CheckDecBuffer(buffer, h);
 }
 
 VP8StatusCode WebPFlipBuffer(WebPDecBuffer* const buffer) {
@@ -181,11 +207,23 @@ VP8StatusCode WebPFlipBuffer(WebPDecBuffer* const buffer) {
 
 VP8StatusCode WebPAllocateDecBuffer(int width, int height,
                                     const WebPDecoderOptions* const options,
-                                    WebPDecBuffer* const buffer) {
+                                    WebPDecBuffer* const buffer,
+                                    WebPArena* const arena) {
   VP8StatusCode status;
+  int src_height = height;  // height before scaling
   if (buffer == NULL || width <= 0 || height <= 0) {
     return VP8_STATUS_INVALID_PARAM;
   }
+  if (buffer->row_sink != NULL) {
+    // The rows are only held until they are passed to the sink. The YUV
+    // rescalers output the luma and chroma rows independently.
+    if (buffer->is_external_memory > 0 ||
+        (options != NULL &&
+         (options->flip ||
+          (options->use_scaling && !WebPIsRGBMode(buffer->colorspace))))) {
+      return VP8_STATUS_INVALID_PARAM;
+    }
+  }
   if (options != NULL) {  // First, apply options if there is any.
     if (options->use_cropping) {
       const int cw = options->crop_width;
@@ -198,6 +236,7 @@ VP8StatusCode WebPAllocateDecBuffer(int width, int height,
       width = cw;
       height = ch;
     }
+    src_height = height;
 
     if (options->use_scaling) {
 #if !defined(WEBP_REDUCE_SIZE)
@@ -218,11 +257,12 @@ VP8StatusCode WebPAllocateDecBuffer(int width, int height,
   buffer->height = height;
 
   // Then, allocate buffer for real.
-  status = AllocateBuffer(buffer);
+  status =
+      AllocateBuffer(buffer, GetNumBufferRows(buffer, src_height), arena);
   if (status != VP8_STATUS_OK) return status;
 
   // Use the stride trick if vertical flip is needed.
-  if (options != NULL && options->flip) {
+  if (options != NULL && options->flip && !WebPArenaIsMeasuring(arena)) {
     status = WebPFlipBuffer(buffer);
   }
   return status;
@@ -278,7 +318,7 @@ VP8StatusCode WebPCopyDecBufferPixels(const WebPDecBuffer* const src_buf,
 
   dst_buf->width = src_buf->width;
   dst_buf->height = src_buf->height;
-  if (CheckDecBuffer(dst_buf) != VP8_STATUS_OK) {
+  if (CheckDecBuffer(dst_buf, dst_buf->height) != VP8_STATUS_OK) {
     return VP8_STATUS_INVALID_PARAM;
   }
   if (WebPIsRGBMode(src_buf->colorspace)) {
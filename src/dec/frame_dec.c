@@ -80,15 +80,12 @@ static void DoUVTransform(uint32_t bits, const int16_t* const src,
   }
 }
 
-static void ReconstructRow(const VP8Decoder* const dec,
-                           const VP8ThreadContext* ctx) {
+// Prepares the work buffer 'yuv_b' for the reconstruction of row 'mb_y'.
+static void InitLeftSamples(uint8_t* const yuv_b, int mb_y) {
   int j;
-  int mb_x;
-  const int mb_y = ctx->mb_y;
-  const int cache_id = ctx->id;
-  uint8_t* const y_dst = dec->yuv_b + Y_OFF;
-  uint8_t* const u_dst = dec->yuv_b + U_OFF;
-  uint8_t* const v_dst = dec->yuv_b + V_OFF;
+  uint8_t* const y_dst = yuv_b + Y_OFF;
+  uint8_t* const u_dst = yuv_b + U_OFF;
+  uint8_t* const v_dst = yuv_b + V_OFF;
 
   // Initialize left-most block.
   for (j = 0; j < 16; ++j) {
@@ -109,100 +106,123 @@ static void ReconstructRow(const VP8Decoder* const dec,
     WEBP_UNSAFE_MEMSET(u_dst - BPS - 1, 127, 8 + 1);
     WEBP_UNSAFE_MEMSET(v_dst - BPS - 1, 127, 8 + 1);
   }
+}
 
-  // Reconstruct one row.
-  for (mb_x = 0; mb_x < dec->mb_w; ++mb_x) {
-    const VP8MBData* const block = ctx->mb_data + mb_x;
-
-    // Rotate in the left samples from previously decoded block. We move four
-    // pixels at a time for alignment reason, and because of in-loop filter.
-    if (mb_x > 0) {
-      for (j = -1; j < 16; ++j) {
-        Copy32b(&y_dst[j * BPS - 4], &y_dst[j * BPS + 12]);
-      }
-      for (j = -1; j < 8; ++j) {
-        Copy32b(&u_dst[j * BPS - 4], &u_dst[j * BPS + 4]);
-        Copy32b(&v_dst[j * BPS - 4], &v_dst[j * BPS + 4]);
-      }
+// Reconstructs the macroblock ('mb_x', 'mb_y') in the work buffer 'yuv_b' and
+// stores it in the cache row 'cache_id'. The macroblocks of a row must be
+// reconstructed in order.
+static void ReconstructMB(const VP8Decoder* const dec, uint8_t* const yuv_b,
+                          const VP8MBData* const block, int mb_x, int mb_y,
+                          int cache_id) {
+  int j;
+  uint8_t* const y_dst = yuv_b + Y_OFF;
+  uint8_t* const u_dst = yuv_b + U_OFF;
+  uint8_t* const v_dst = yuv_b + V_OFF;
+  // Rotate in the left samples from previously decoded block. We move four
+  // pixels at a time for alignment reason, and because of in-loop filter.
+  if (mb_x > 0) {
+    for (j = -1; j < 16; ++j) {
+      Copy32b(&y_dst[j * BPS - 4], &y_dst[j * BPS + 12]);
     }
-    {
-      // bring top samples into the cache
-      VP8TopSamples* const top_yuv = dec->yuv_t + mb_x;
-      const int16_t* const coeffs = block->coeffs;
-      uint32_t bits = block->non_zero_y;
-      int n;
-
-      if (mb_y > 0) {
-        WEBP_UNSAFE_MEMCPY(y_dst - BPS, top_yuv[0].y, 16);
-        WEBP_UNSAFE_MEMCPY(u_dst - BPS, top_yuv[0].u, 8);
-        WEBP_UNSAFE_MEMCPY(v_dst - BPS, top_yuv[0].v, 8);
-      }
+    for (j = -1; j < 8; ++j) {
+      Copy32b(&u_dst[j * BPS - 4], &u_dst[j * BPS + 4]);
+      Copy32b(&v_dst[j * BPS - 4], &v_dst[j * BPS + 4]);
+    }
+  }
+  {
+    // bring top samples into the cache
+    VP8TopSamples* const top_yuv = dec->yuv_t + mb_x;
+    const int16_t* const coeffs = block->coeffs;
+    uint32_t bits = block->non_zero_y;
+    int n;
 
-      // predict and add residuals
-      if (block->is_i4x4) {  // 4x4
-        uint32_t* const top_right = (uint32_t*)(y_dst - BPS + 16);
+    if (mb_y > 0) {
+      WEBP_UNSAFE_MEMCPY(y_dst - BPS, top_yuv[0].y, 16);
+      WEBP_UNSAFE_MEMCPY(u_dst - BPS, top_yuv[0].u, 8);
+      WEBP_UNSAFE_MEMCPY(v_dst - BPS, top_yuv[0].v, 8);
+    }
 
-        if (mb_y > 0) {
-          if (mb_x >= dec->mb_w - 1) {  // on rightmost border
-            WEBP_UNSAFE_MEMSET(top_right, top_yuv[0].y[15], sizeof(*top_right));
-          } else {
-            WEBP_UNSAFE_MEMCPY(top_right, top_yuv[1].y, sizeof(*top_right));
-          }
-        }
-        // replicate the top-right pixels below
-        top_right[BPS] = top_right[2 * BPS] = top_right[3 * BPS] = top_right[0];
+    // predict and add residuals
+    if (block->is_i4x4) {  // 4x4
+      uint32_t* const top_right = (uint32_t*)(y_dst - BPS + 16);
 
-        // predict and add residuals for all 4x4 blocks in turn.
-        for (n = 0; n < 16; ++n, bits <<= 2) {
-          uint8_t* const dst = y_dst + kScan[n];
-          VP8PredLuma4[block->imodes[n]](dst);
-          DoTransform(bits, coeffs + n * 16, dst);
-        }
-      } else {  // 16x16
-        const int pred_func = CheckMode(mb_x, mb_y, block->imodes[0]);
-        VP8PredLuma16[pred_func](y_dst);
-        if (bits != 0) {
-          for (n = 0; n < 16; ++n, bits <<= 2) {
-            DoTransform(bits, coeffs + n * 16, y_dst + kScan[n]);
-          }
+      if (mb_y > 0) {
+        if (mb_x >= dec->mb_w - 1) {  // on rightmost border
+          WEBP_UNSAFE_MEMSET(top_right, top_yuv[0].y[15], sizeof(*top_right));
+        } else {
+          WEBP_UNSAFE_MEMCPY(top_right, top_yuv[1].y, sizeof(*top_right));
         }
       }
-      {
-        // Chroma
-        const uint32_t bits_uv = block->non_zero_uv;
-        const int pred_func = CheckMode(mb_x, mb_y, block->uvmode);
-        VP8PredChroma8[pred_func](u_dst);
-        VP8PredChroma8[pred_func](v_dst);
-        DoUVTransform(bits_uv >> 0, coeffs + 16 * 16, u_dst);
-        DoUVTransform(bits_uv >> 8, coeffs + 20 * 16, v_dst);
+      // replicate the top-right pixels below
+      top_right[BPS] = top_right[2 * BPS] = top_right[3 * BPS] = top_right[0];
+
+      // predict and add residuals for all 4x4 blocks in turn.
+      for (n = 0; n < 16; ++n, bits <<= 2) {
+        uint8_t* const dst = y_dst + kScan[n];
+        VP8PredLuma4[block->imodes[n]](dst);
+        DoTransform(bits, coeffs + n * 16, dst);
       }
-
-      // stash away top samples for next block
-      if (mb_y < dec->mb_h - 1) {
-        WEBP_UNSAFE_MEMCPY(top_yuv[0].y, y_dst + 15 * BPS, 16);
-        WEBP_UNSAFE_MEMCPY(top_yuv[0].u, u_dst + 7 * BPS, 8);
-        WEBP_UNSAFE_MEMCPY(top_yuv[0].v, v_dst + 7 * BPS, 8);
+    } else {  // 16x16
+      const int pred_func = CheckMode(mb_x, mb_y, block->imodes[0]);
+      VP8PredLuma16[pred_func](y_dst);
+      if (bits != 0) {
+        for (n = 0; n < 16; ++n, bits <<= 2) {
+          DoTransform(bits, coeffs + n * 16, y_dst + kScan[n]);
+        }
       }
     }
-    // Transfer reconstructed samples from yuv_b cache to final destination.
     {
-      const int y_offset = cache_id * 16 * dec->cache_y_stride;
-      const int uv_offset = cache_id * 8 * dec->cache_uv_stride;
-      uint8_t* const y_out = dec->cache_y + mb_x * 16 + y_offset;
-      uint8_t* const u_out = dec->cache_u + mb_x * 8 + uv_offset;
-      uint8_t* const v_out = dec->cache_v + mb_x * 8 + uv_offset;
-      for (j = 0; j < 16; ++j) {
-        WEBP_UNSAFE_MEMCPY(y_out + j * dec->cache_y_stride, y_dst + j * BPS,
-                           16);
-      }
-      for (j = 0; j < 8; ++j) {
-        WEBP_UNSAFE_MEMCPY(u_out + j * dec->cache_uv_stride, u_dst + j * BPS,
-                           8);
-        WEBP_UNSAFE_MEMCPY(v_out + j * dec->cache_uv_stride, v_dst + j * BPS,
-                           8);
-      }
+      // Chroma
+      const uint32_t bits_uv = block->non_zero_uv;
+      const int pred_func = CheckMode(mb_x, mb_y, block->uvmode);
+      VP8PredChroma8[pred_func](u_dst);
+      VP8PredChroma8[pred_func](v_dst);
+      DoUVTransform(bits_uv >> 0, coeffs + 16 * 16, u_dst);
+      DoUVTransform(bits_uv >> 8, coeffs + 20 * 16, v_dst);
+    }
+
+    // stash away top samples for next block
+    if (mb_y < dec->mb_h - 1) {
+      WEBP_UNSAFE_MEMCPY(top_yuv[0].y, y_dst + 15 * BPS, 16);
+      WEBP_UNSAFE_MEMCPY(top_yuv[0].u, u_dst + 7 * BPS, 8);
+      WEBP_UNSAFE_MEMCPY(top_yuv[0].v, v_dst + 7 * BPS, 8);
     }
   }
+  // Transfer reconstructed samples from yuv_b cache to final destination.
+  {
+    const int y_offset = cache_id * 16 * dec->cache_y_stride;
+    const int uv_offset = cache_id * 8 * dec->cache_uv_stride;
+    uint8_t* const y_out = dec->cache_y + mb_x * 16 + y_offset;
+    uint8_t* const u_out = dec->cache_u + mb_x * 8 + uv_offset;
+    uint8_t* const v_out = dec->cache_v + mb_x * 8 + uv_offset;
+    for (j = 0; j < 16; ++j) {
+      WEBP_UNSAFE_MEMCPY(y_out + j * dec->cache_y_stride, y_dst + j * BPS, 16);
+    }
+    for (j = 0; j < 8; ++j) {
+      WEBP_UNSAFE_MEMCPY(u_out + j * dec->cache_uv_stride, u_dst + j * BPS, 8);
+      WEBP_UNSAFE_MEMCPY(v_out + j * dec->cache_uv_stride, v_dst + j * BPS, 8);
+    }
+  }
+}
+
+// Returns the number of macroblocks to reconstruct in the row 'mb_y'. The ones
+// on the right of the cropping area are only needed for the top-right samples
+// of the intra4 predictions below, which reach one more macroblock to the right
+// per row.
+static int GetNumMBsToReconstruct(const VP8Decoder* const dec, int mb_y) {
+  const int num_mbs = dec->br_mb_x + (dec->br_mb_y - 1 - mb_y);
+  return (num_mbs < dec->mb_w) ? num_mbs : dec->mb_w;
+}
+
+static void ReconstructRow(const VP8Decoder* const dec,
+                           const VP8ThreadContext* ctx) {
+  const int num_mbs = GetNumMBsToReconstruct(dec, ctx->mb_y);
+  int mb_x;
+  InitLeftSamples(dec->yuv_b, ctx->mb_y);
+  for (mb_x = 0; mb_x < num_mbs; ++mb_x) {
+    ReconstructMB(dec, dec->yuv_b, ctx->mb_data + mb_x, mb_x, ctx->mb_y,
+                  ctx->id);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -215,11 +235,10 @@ static void ReconstructRow(const VP8Decoder* const dec,
 //                 U/V, so it's 8 samples total (because of the 2x upsampling).
 static const uint8_t kFilterExtraRows[3] = {0, 2, 8};
 
-static void DoFilter(const VP8Decoder* const dec, int mb_x, int mb_y) {
-  const VP8ThreadContext* const ctx = &dec->thread_ctx;
-  const int cache_id = ctx->id;
+static void DoFilter(const VP8Decoder* const dec,
+                     const VP8FInfo* const f_info, int cache_id, int mb_x,
+                     int mb_y) {
   const int y_bps = dec->cache_y_stride;
-  const VP8FInfo* const f_info = ctx->f_info + mb_x;
   uint8_t* const y_dst = dec->cache_y + cache_id * 16 * y_bps + mb_x * 16;
   const int ilevel = f_info->f_ilevel;
   const int limit = f_info->f_limit;
@@ -267,10 +286,10 @@ static void DoFilter(const VP8Decoder* const dec, int mb_x, int mb_y) {
 // Filter the decoded macroblock row (if needed)
 static void FilterRow(const VP8Decoder* const dec) {
   int mb_x;
-  const int mb_y = dec->thread_ctx.mb_y;
-  assert(dec->thread_ctx.filter_row);
+  const VP8ThreadContext* const ctx = &dec->thread_ctx;
+  assert(ctx->filter_row);
   for (mb_x = dec->tl_mb_x; mb_x < dec->br_mb_x; ++mb_x) {
-    DoFilter(dec, mb_x, mb_y);
+    DoFilter(dec, ctx->f_info + mb_x, ctx->id, mb_x, ctx->mb_y);
   }
 }
 
@@ -412,13 +431,34 @@ static void DitherRow(VP8Decoder* const dec) {
 
 #define MACROBLOCK_VPOS(mb_y) ((mb_y) * 16)  // vertical position of a MB
 
-// Finalize and transmit a complete row. Return false in case of user-abort.
-static int FinishRow(void* arg1, void* arg2) {
-  VP8Decoder* const dec = (VP8Decoder*)arg1;
-  VP8Io* const io = (VP8Io*)arg2;
+// The bottom pixels of the last cache row are not emitted yet: preserve them
+// above the first cache row, where the next row (and its filtering) expects
+// them. Only the macroblocks in [mb_x, mb_x + num_mbs) are copied.
+static void RotateTopSamples(const VP8Decoder* const dec, int mb_x,
+                             int num_mbs) {
+  const int extra_y_rows = kFilterExtraRows[dec->filter_type];
+  const int y_stride = dec->cache_y_stride;
+  const int uv_stride = dec->cache_uv_stride;
+  const int y_offset = 16 * dec->num_caches * y_stride;
+  const int uv_offset = 8 * dec->num_caches * uv_stride;
+  int j;
+  for (j = -extra_y_rows; j < 0; ++j) {
+    uint8_t* const dst = dec->cache_y + j * y_stride + 16 * mb_x;
+    WEBP_UNSAFE_MEMCPY(dst, dst + y_offset, 16 * num_mbs);
+  }
+  for (j = -extra_y_rows / 2; j < 0; ++j) {
+    uint8_t* const u_dst = dec->cache_u + j * uv_stride + 8 * mb_x;
+    uint8_t* const v_dst = dec->cache_v + j * uv_stride + 8 * mb_x;
+    WEBP_UNSAFE_MEMCPY(u_dst, u_dst + uv_offset, 8 * num_mbs);
+    WEBP_UNSAFE_MEMCPY(v_dst, v_dst + uv_offset, 8 * num_mbs);
+  }
+}
+
+// Transmit the complete row 'mb_y', stored in the cache row 'cache_id'.
+// Return false in case of user-abort.
+static int OutputRow(VP8Decoder* const dec, VP8Io* const io, int cache_id,
+                     int mb_y) {
   int ok = 1;
-  const VP8ThreadContext* const ctx = &dec->thread_ctx;
-  const int cache_id = ctx->id;
   const int extra_y_rows = kFilterExtraRows[dec->filter_type];
   const int ysize = extra_y_rows * dec->cache_y_stride;
   const int uvsize = (extra_y_rows / 2) * dec->cache_uv_stride;
@@ -427,22 +467,9 @@ static int FinishRow(void* arg1, void* arg2) {
   uint8_t* const ydst = dec->cache_y - ysize + y_offset;
   uint8_t* const udst = dec->cache_u - uvsize + uv_offset;
   uint8_t* const vdst = dec->cache_v - uvsize + uv_offset;
-  const int mb_y = ctx->mb_y;
   const int is_first_row = (mb_y == 0);
   const int is_last_row = (mb_y >= dec->br_mb_y - 1);
 
-  if (dec->mt_method == 2) {
-    ReconstructRow(dec, ctx);
-  }
-
-  if (ctx->filter_row) {
-    FilterRow(dec);
-  }
-
-  if (dec->dither) {
-    DitherRow(dec);
-  }
-
   if (io->put != NULL) {
     int y_start = MACROBLOCK_VPOS(mb_y);
     int y_end = MACROBLOCK_VPOS(mb_y + 1);
@@ -496,15 +523,36 @@ static int FinishRow(void* arg1, void* arg2) {
       ok = io->put(io);
     }
   }
+  return ok;
+}
+
+// Finalize and transmit a complete row. Return false in case of user-abort.
+static int FinishRow(void* arg1, void* arg2) {
+  VP8Decoder* const dec = (VP8Decoder*)arg1;
+  VP8Io* const io = (VP8Io*)arg2;
+  int ok;
+  const VP8ThreadContext* const ctx = &dec->thread_ctx;
+  const int cache_id = ctx->id;
+  const int mb_y = ctx->mb_y;
+
+  if (dec->mt_method == 2) {
+    ReconstructRow(dec, ctx);
+  }
+
+  if (ctx->filter_row) {
+    FilterRow(dec);
+  }
+
+  if (dec->dither) {
+    DitherRow(dec);
+  }
+
+  ok = OutputRow(dec, io, cache_id, mb_y);
+
   // rotate top samples if needed
   if (cache_id + 1 == dec->num_caches) {
-    if (!is_last_row) {
-      WEBP_UNSAFE_MEMCPY(dec->cache_y - ysize, ydst + 16 * dec->cache_y_stride,
-                         ysize);
-      WEBP_UNSAFE_MEMCPY(dec->cache_u - uvsize, udst + 8 * dec->cache_uv_stride,
-                         uvsize);
-      WEBP_UNSAFE_MEMCPY(dec->cache_v - uvsize, vdst + 8 * dec->cache_uv_stride,
-                         uvsize);
+    if (mb_y < dec->br_mb_y - 1) {  // not the last row
+      RotateTopSamples(dec, 0, dec->mb_w);
     }
   }
 
@@ -560,6 +608,218 @@ int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io) {
   return ok;
 }
 
+//------------------------------------------------------------------------------
+// Wavefront multi-threading (mt_method 3)
+//
+// When the tokens are spread over several partitions, consecutive macroblock
+// rows can be parsed concurrently. Each worker parses, reconstructs, filters
+// and emits whole rows. Row 'y' can process the macroblock 'x' once row 'y - 1'
+// is done with the macroblock 'x + 1': the top-right samples are needed for
+// the intra4 prediction, and filtering the macroblock 'x + 1' modifies the
+// right-most pixels of the macroblock 'x'. The intra modes (partition #0) are
+// parsed and the rows are emitted in order. Each row has its own cache row,
+// and the first cache row gets its top samples from the last one, macroblock
+// per macroblock, instead of waiting for a full rotation.
+
+// Indices of the synchronization counters, after the per-row ones (holding the
+// number of macroblocks processed in each row).
+enum {
+  WF_NEXT_ROW = 0,  // next row to decode
+  WF_PARSED_ROWS,   // number of rows with parsed intra modes
+  WF_EMITTED_ROWS,  // number of rows passed to io->put()
+  WF_NUM_COUNTERS
+};
+
+typedef struct Wavefront Wavefront;
+
+typedef struct {
+  WebPWorker worker;
+  Wavefront* wf;
+  VP8MBData* mb_data;  // data of the row being decoded
+  uint8_t* yuv_b;      // reconstruction buffer (size = YUV_SIZE)
+  int error_row;       // row in error, if status is not VP8_STATUS_OK
+  VP8StatusCode status;
+  const char* error_msg;
+} WavefrontWorker;
+
+struct Wavefront {
+  VP8Decoder* dec;
+  VP8Io* io;
+  WavefrontWorker* workers;    // workers[0] is run by the calling thread
+  WebPSyncCounters* counters;  // see above
+};
+
+static int WavefrontError(WavefrontWorker* const w, int mb_y,
+                          VP8StatusCode status, const char* const msg) {
+  w->error_row = mb_y;
+  w->status = status;
+  w->error_msg = msg;
+  return 0;
+}
+
+// Decodes and emits the row 'mb_y'. Returns false in case of error or if
+// another worker aborted.
+static int WavefrontDecodeRow(WavefrontWorker* const w, int mb_y) {
+  Wavefront* const wf = w->wf;
+  VP8Decoder* const dec = wf->dec;
+  WebPSyncCounters* const counters = wf->counters;
+  const int num_rows = dec->br_mb_y;
+  const int num_parts = (int)dec->num_parts_minus_one + 1;
+  const int cache_id = mb_y % dec->num_caches;
+  const int filter_row = (dec->filter_type > 0) &&
+                         (mb_y >= dec->tl_mb_y) && (mb_y <= dec->br_mb_y);
+  const int rotate_top = (cache_id == 0) && (mb_y > 0) &&
+                         (kFilterExtraRows[dec->filter_type] > 0);
+  const int num_mbs_to_reconstruct = GetNumMBsToReconstruct(dec, mb_y);
+  VP8BitReader* const token_br = &dec->parts[mb_y & dec->num_parts_minus_one];
+  VP8MB left;
+  int mb_x;
+
+  // The cache row and the bottom pixels of the previous cache row are needed
+  // until the row following their previous user is emitted.
+  if (!WebPSyncCountersWait(counters, num_rows + WF_EMITTED_ROWS,
+                            mb_y + 2 - dec->num_caches)) {
+    return 0;
+  }
+  // The previous row of the same partition must be fully parsed.
+  if (mb_y >= num_parts &&
+      !WebPSyncCountersWait(counters, mb_y - num_parts, dec->mb_w)) {
+    return 0;
+  }
+
+  // Parse the intra modes.
+  if (!WebPSyncCountersWait(counters, num_rows + WF_PARSED_ROWS, mb_y)) {
+    return 0;
+  }
+  dec->mb_data = w->mb_data;
+  WEBP_UNSAFE_MEMSET(dec->intra_l, B_DC_PRED, sizeof(dec->intra_l));
+  if (!VP8ParseIntraModeRow(&dec->br, dec)) {
+    return WavefrontError(w, mb_y, VP8_STATUS_NOT_ENOUGH_DATA,
+                          "Premature end-of-partition0 encountered.");
+  }
+  WebPSyncCountersSet(counters, num_rows + WF_PARSED_ROWS, mb_y + 1);
+
+  // Parse the tokens, reconstruct and filter.
+  left.nz = left.nz_dc = 0;
+  InitLeftSamples(w->yuv_b, mb_y);
+  for (mb_x = 0; mb_x < dec->mb_w; ++mb_x) {
+    VP8MBData* const block = w->mb_data + mb_x;
+    VP8FInfo f_info;
+    // wait for the top and top-right macroblocks
+    const int top_needed = (mb_x + 2 < dec->mb_w) ? mb_x + 2 : dec->mb_w;
+    if (mb_y > 0 && !WebPSyncCountersWait(counters, mb_y - 1, top_needed)) {
+      return 0;
+    }
+    if (!VP8DecodeMBInRow(dec, mb_x, &left, block, &f_info, token_br)) {
+      return WavefrontError(w, mb_y, VP8_STATUS_NOT_ENOUGH_DATA,
+                            "Premature end-of-file encountered.");
+    }
+    if (mb_x < num_mbs_to_reconstruct) {
+      ReconstructMB(dec, w->yuv_b, block, mb_x, mb_y, cache_id);
+      if (rotate_top) RotateTopSamples(dec, mb_x, 1);
+    }
+    if (filter_row && mb_x >= dec->tl_mb_x && mb_x < dec->br_mb_x) {
+      DoFilter(dec, &f_info, cache_id, mb_x, mb_y);
+    }
+    WebPSyncCountersSet(counters, mb_y, mb_x + 1);
+  }
+
+  // Emit the row.
+  if (!WebPSyncCountersWait(counters, num_rows + WF_EMITTED_ROWS, mb_y)) {
+    return 0;
+  }
+  if (!OutputRow(dec, wf->io, cache_id, mb_y)) {
+    return WavefrontError(w, mb_y, VP8_STATUS_USER_ABORT, "Output aborted.");
+  }
+  WebPSyncCountersSet(counters, num_rows + WF_EMITTED_ROWS, mb_y + 1);
+  return 1;
+}
+
+static int WavefrontHook(void* arg1, void* arg2) {
+  WavefrontWorker* const w = (WavefrontWorker*)arg1;
+  Wavefront* const wf = w->wf;
+  const int num_rows = wf->dec->br_mb_y;
+  (void)arg2;
+  while (1) {
+    const int mb_y =
+        WebPSyncCountersIncrement(wf->counters, num_rows + WF_NEXT_ROW);
+    if (mb_y >= num_rows) break;
+    if (!WavefrontDecodeRow(w, mb_y)) {
+      WebPSyncCountersAbort(wf->counters);  // release the other workers
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int VP8DecodeRowsMT(VP8Decoder* const dec, VP8Io* const io) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  const int num_workers = dec->num_row_workers;
+  WavefrontWorker* error_worker = NULL;
+  Wavefront wf;
+  int i;
+
+  assert(dec->mt_method == 3 && num_workers > 1);
+  wf.dec = dec;
+  wf.io = io;
+  wf.workers =
+      (WavefrontWorker*)WebPSafeCalloc(num_workers, sizeof(*wf.workers));
+  wf.counters = WebPSyncCountersNew(dec->br_mb_y + WF_NUM_COUNTERS);
+  if (wf.workers == NULL || wf.counters == NULL) {
+    WebPSafeFree(wf.workers);
+    WebPSyncCountersDelete(wf.counters);
+    return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                       "thread initialization failed.");
+  }
+  for (i = 0; i < num_workers; ++i) {
+    WavefrontWorker* const w = &wf.workers[i];
+    worker_interface->Init(&w->worker);
+    w->worker.pool = dec->worker.pool;
+    w->worker.data1 = w;
+    w->worker.data2 = NULL;
+    w->worker.hook = WavefrontHook;
+    w->wf = &wf;
+    w->mb_data = dec->mb_data + i * dec->mb_w;
+    w->yuv_b = dec->yuv_b + i * YUV_SIZE;
+    w->status = VP8_STATUS_OK;
+  }
+  // we don't need to call Reset() on workers[0], since we're calling
+  // Execute() on it
+  for (i = 1; i < num_workers; ++i) {
+    if (!worker_interface->Reset(&wf.workers[i].worker)) {
+      VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                  "thread initialization failed.");
+      goto End;
+    }
+  }
+  for (i = 1; i < num_workers; ++i) {
+    worker_interface->Launch(&wf.workers[i].worker);
+  }
+  worker_interface->Execute(&wf.workers[0].worker);
+  for (i = 1; i < num_workers; ++i) {
+    worker_interface->Sync(&wf.workers[i].worker);
+  }
+  // Report the error of the top-most row, like the single-threaded decoding.
+  for (i = 0; i < num_workers; ++i) {
+    WavefrontWorker* const w = &wf.workers[i];
+    if (w->status != VP8_STATUS_OK &&
+        (error_worker == NULL || w->error_row < error_worker->error_row)) {
+      error_worker = w;
+    }
+  }
+  if (error_worker != NULL) {
+    VP8SetError(dec, error_worker->status, error_worker->error_msg);
+  }
+
+End:
+  for (i = 1; i < num_workers; ++i) {
+    worker_interface->End(&wf.workers[i].worker);
+  }
+  WebPSyncCountersDelete(wf.counters);
+  WebPSafeFree(wf.workers);
+  return (dec->status == VP8_STATUS_OK);
+}
+
 //------------------------------------------------------------------------------
 // Finish setting up the decoding parameter once user's setup() is called.
 
@@ -656,12 +916,35 @@ int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io) {
 #define MT_CACHE_LINES 3
 #define ST_CACHE_LINES 1  // 1 cache row only for single-threaded case
 
+// Returns the number of rows that can be decoded concurrently (mt_method 3).
+static int GetNumRowWorkers(const VP8Decoder* const dec) {
+  // The rows sharing a partition are parsed one after the other.
+  int num_workers = (int)dec->num_parts_minus_one + 1;
+  // Incremental decoding needs to stop anywhere, and dithering must be
+  // applied to the rows in order.
+  if (dec->incremental || dec->dither) return 1;
+  if (dec->worker.pool != NULL) {
+    const int max_workers = WebPThreadPoolGetNumThreads(dec->worker.pool) + 1;
+    if (num_workers > max_workers) num_workers = max_workers;
+  }
+  if (num_workers > dec->br_mb_y) num_workers = dec->br_mb_y;
+  return num_workers;
+}
+
 // Initialize multi/single-thread worker
 static int InitThreadContext(VP8Decoder* const dec) {
   dec->cache_id = 0;
-  if (dec->mt_method > 0) {
+  dec->num_row_workers = (dec->mt_method > 0) ? GetNumRowWorkers(dec) : 1;
+  if (dec->num_row_workers > 1) {
+    // Each row being decoded needs its own cache row, and the row following
+    // the last emitted one still needs the bottom pixels of the latter.
+    dec->mt_method = 3;
+    dec->num_caches = dec->num_row_workers + 1;
+  } else if (dec->mt_method > 0) {
     WebPWorker* const worker = &dec->worker;
-    if (!WebPGetWorkerInterface()->Reset(worker)) {
+    // No thread is needed to measure the memory.
+    if (!WebPArenaIsMeasuring(dec->arena) &&
+        !WebPGetWorkerInterface()->Reset(worker)) {
       return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
                          "thread initialization failed.");
     }
@@ -692,6 +975,11 @@ int VP8GetThreadMethod(const WebPDecoderOptions* const options,
   return 0;
 }
 
+void VP8InitThreadPool(const WebPDecoderOptions* const options,
+                       VP8Decoder* const dec) {
+  dec->worker.pool = WebPGetThreadPool(options);
+}
+
 #undef MT_CACHE_LINES
 #undef ST_CACHE_LINES
 
@@ -709,9 +997,11 @@ static int AllocateMemory(VP8Decoder* const dec) {
       (dec->filter_type > 0)
           ? mb_w * (dec->mt_method > 0 ? 2 : 1) * sizeof(VP8FInfo)
           : 0;
-  const size_t yuv_size = YUV_SIZE * sizeof(*dec->yuv_b);
-  const size_t mb_data_size =
-      (dec->mt_method == 2 ? 2 : 1) * mb_w * sizeof(*dec->mb_data);
+  // with mt_method 3, each worker has its own yuv_b and mb_data
+  const size_t yuv_size =
+      dec->num_row_workers * YUV_SIZE * sizeof(*dec->yuv_b);
+  const size_t mb_data_size = (dec->mt_method == 2 ? 2 : dec->num_row_workers) *
+                              mb_w * sizeof(*dec->mb_data);
   const int cache_y_stride = 16 * mb_w;
   const size_t cache_height =
       (16 * num_caches + kFilterExtraRows[dec->filter_type]) * 3 / 2;
@@ -730,10 +1020,17 @@ static int AllocateMemory(VP8Decoder* const dec) {
     return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
                        "frame memory size overflow.");
   }
+  if (WebPArenaIsMeasuring(dec->arena)) {  // nothing to set up
+    if (!WebPArenaReserve(dec->arena, needed, sizeof(uint8_t))) {
+      return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                         "frame memory size overflow.");
+    }
+    return 1;
+  }
   if (needed > dec->mem_size) {
-    WebPSafeFree(dec->mem);
+    WebPArenaFree(dec->arena, dec->mem);
     dec->mem_size = 0;
-    dec->mem = WebPSafeMalloc(needed, sizeof(uint8_t));
+    dec->mem = WebPArenaMalloc(dec->arena, needed, sizeof(uint8_t));
     if (dec->mem == NULL) {
       return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
                          "no memory during frame initialization.");
@@ -819,6 +1116,7 @@ static void InitIo(VP8Decoder* const dec, VP8Io* io) {
 int VP8InitFrame(VP8Decoder* const dec, VP8Io* const io) {
   if (!InitThreadContext(dec)) return 0;  // call first. Sets dec->num_caches.
   if (!AllocateMemory(dec)) return 0;
+  if (WebPArenaIsMeasuring(dec->arena)) return 1;
   InitIo(dec, io);
   VP8DspInit();  // Init critical function pointers and look-up tables.
   return 1;
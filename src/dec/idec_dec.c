@@ -456,13 +456,15 @@ static VP8StatusCode DecodePartition0(WebPIDecoder* const idec) {
 
   // Allocate/Verify output buffer now
   dec->status =
-      WebPAllocateDecBuffer(io->width, io->height, params->options, output);
+      WebPAllocateDecBuffer(io->width, io->height, params->options, output,
+                            /*arena=*/NULL);
   if (dec->status != VP8_STATUS_OK) {
     return IDecError(idec, dec->status);
   }
   // This change must be done before calling VP8InitFrame()
   dec->mt_method =
       VP8GetThreadMethod(params->options, NULL, io->width, io->height);
+  VP8InitThreadPool(params->options, dec);
   VP8InitDithering(params->options, dec);
 
   dec->status = CopyParts0Data(idec);
@@ -578,7 +580,8 @@ static VP8StatusCode DecodeVP8LHeader(WebPIDecoder* const idec) {
   }
   // Allocate/verify output buffer now.
   dec->status =
-      WebPAllocateDecBuffer(io->width, io->height, params->options, output);
+      WebPAllocateDecBuffer(io->width, io->height, params->options, output,
+                            /*arena=*/NULL);
   if (dec->status != VP8_STATUS_OK) {
     return IDecError(idec, dec->status);
   }
@@ -642,7 +645,13 @@ static VP8StatusCode IDecode(WebPIDecoder* idec) {
 WEBP_NODISCARD static WebPIDecoder* NewDecoder(
     WebPDecBuffer* const output_buffer,
     const WebPBitstreamFeatures* const features) {
-  WebPIDecoder* idec = (WebPIDecoder*)WebPSafeCalloc(1ULL, sizeof(*idec));
+  WebPIDecoder* idec;
+  // The rows already output can be decoded again when resuming, and the
+  // decoded area must remain available to WebPIDecGetRGB() and the like.
+  if (output_buffer != NULL && output_buffer->row_sink != NULL) {
+    return NULL;
+  }
+  idec = (WebPIDecoder*)WebPSafeCalloc(1ULL, sizeof(*idec));
   if (idec == NULL) {
     return NULL;
   }
@@ -35,9 +35,10 @@ WEBP_ASSUME_UNSAFE_INDEXABLE_ABI
 static int EmitYUV(const VP8Io* const io, WebPDecParams* const p) {
   WebPDecBuffer* output = p->output;
   const WebPYUVABuffer* const buf = &output->u.YUVA;
-  uint8_t* const y_dst = buf->y + (ptrdiff_t)io->mb_y * buf->y_stride;
-  uint8_t* const u_dst = buf->u + (ptrdiff_t)(io->mb_y >> 1) * buf->u_stride;
-  uint8_t* const v_dst = buf->v + (ptrdiff_t)(io->mb_y >> 1) * buf->v_stride;
+  const int y = io->mb_y - p->window_y;  // row in the output planes
+  uint8_t* const y_dst = buf->y + (ptrdiff_t)y * buf->y_stride;
+  uint8_t* const u_dst = buf->u + (ptrdiff_t)(y >> 1) * buf->u_stride;
+  uint8_t* const v_dst = buf->v + (ptrdiff_t)(y >> 1) * buf->v_stride;
   const int mb_w = io->mb_w;
   const int mb_h = io->mb_h;
   const int uv_w = (mb_w + 1) / 2;
@@ -52,7 +53,8 @@ static int EmitYUV(const VP8Io* const io, WebPDecParams* const p) {
 static int EmitSampledRGB(const VP8Io* const io, WebPDecParams* const p) {
   WebPDecBuffer* const output = p->output;
   WebPRGBABuffer* const buf = &output->u.RGBA;
-  uint8_t* const dst = buf->rgba + (ptrdiff_t)io->mb_y * buf->stride;
+  uint8_t* const dst =
+      buf->rgba + (ptrdiff_t)(io->mb_y - p->window_y) * buf->stride;
   WebPSamplerProcessPlane(io->y, io->y_stride, io->u, io->v, io->uv_stride, dst,
                           buf->stride, io->mb_w, io->mb_h,
                           WebPSamplers[output->colorspace]);
@@ -66,7 +68,7 @@ static int EmitSampledRGB(const VP8Io* const io, WebPDecParams* const p) {
 static int EmitFancyRGB(const VP8Io* const io, WebPDecParams* const p) {
   int num_lines_out = io->mb_h;  // a priori guess
   const WebPRGBABuffer* const buf = &p->output->u.RGBA;
-  uint8_t* dst = buf->rgba + (ptrdiff_t)io->mb_y * buf->stride;
+  uint8_t* dst = buf->rgba + (ptrdiff_t)(io->mb_y - p->window_y) * buf->stride;
   WebPUpsampleLinePairFunc upsample = WebPUpsamplers[p->output->colorspace];
   const uint8_t* cur_y = io->y;
   const uint8_t* cur_u = io->u;
@@ -136,7 +138,7 @@ static int EmitAlphaYUV(const VP8Io* const io, WebPDecParams* const p,
   const WebPYUVABuffer* const buf = &p->output->u.YUVA;
   const int mb_w = io->mb_w;
   const int mb_h = io->mb_h;
-  uint8_t* dst = buf->a + (ptrdiff_t)io->mb_y * buf->a_stride;
+  uint8_t* dst = buf->a + (ptrdiff_t)(io->mb_y - p->window_y) * buf->a_stride;
   int j;
   (void)expected_num_lines_out;
   assert(expected_num_lines_out == mb_h);
@@ -190,7 +192,8 @@ static int EmitAlphaRGB(const VP8Io* const io, WebPDecParams* const p,
     const WebPRGBABuffer* const buf = &p->output->u.RGBA;
     int num_rows;
     const int start_y = GetAlphaSourceRow(io, &alpha, &num_rows);
-    uint8_t* const base_rgba = buf->rgba + (ptrdiff_t)start_y * buf->stride;
+    uint8_t* const base_rgba =
+        buf->rgba + (ptrdiff_t)(start_y - p->window_y) * buf->stride;
     uint8_t* const dst = base_rgba + (alpha_first ? 0 : 3);
     const int has_alpha =
         WebPDispatchAlpha(alpha, io->width, mb_w, num_rows, dst, buf->stride);
@@ -214,7 +217,8 @@ static int EmitAlphaRGBA4444(const VP8Io* const io, WebPDecParams* const p,
     const WebPRGBABuffer* const buf = &p->output->u.RGBA;
     int num_rows;
     const int start_y = GetAlphaSourceRow(io, &alpha, &num_rows);
-    uint8_t* const base_rgba = buf->rgba + (ptrdiff_t)start_y * buf->stride;
+    uint8_t* const base_rgba =
+        buf->rgba + (ptrdiff_t)(start_y - p->window_y) * buf->stride;
 #if (WEBP_SWAP_16BIT_CSP == 1)
     uint8_t* alpha_dst = base_rgba;
 #else
@@ -324,8 +328,11 @@ static int InitYUVRescaler(const VP8Io* const io, WebPDecParams* const p) {
   if (!CheckSizeOverflow(total_size)) {
     return 0;
   }
+  if (WebPArenaIsMeasuring(p->arena)) {
+    return WebPArenaReserve(p->arena, 1ULL, (size_t)total_size);
+  }
 
-  work = (rescaler_t*)WebPSafeMalloc(1ULL, (size_t)total_size);
+  work = (rescaler_t*)WebPArenaMalloc(p->arena, 1ULL, (size_t)total_size);
   if (work == NULL) {
     return 0;  // memory error
   }
@@ -369,7 +376,7 @@ static int ExportRGB(WebPDecParams* const p, int y_pos) {
   const WebPYUV444Converter convert =
       WebPYUV444Converters[p->output->colorspace];
   const WebPRGBABuffer* const buf = &p->output->u.RGBA;
-  uint8_t* dst = buf->rgba + (ptrdiff_t)y_pos * buf->stride;
+  uint8_t* dst = buf->rgba + (ptrdiff_t)(y_pos - p->window_y) * buf->stride;
   int num_lines_out = 0;
   // For RGB rescaling, because of the YUV420, current scan position
   // U/V can be +1/-1 line from the Y one.  Hence the double test.
@@ -416,7 +423,8 @@ static int EmitRescaledRGB(const VP8Io* const io, WebPDecParams* const p) {
 
 static int ExportAlpha(WebPDecParams* const p, int y_pos, int max_lines_out) {
   const WebPRGBABuffer* const buf = &p->output->u.RGBA;
-  uint8_t* const base_rgba = buf->rgba + (ptrdiff_t)y_pos * buf->stride;
+  uint8_t* const base_rgba =
+      buf->rgba + (ptrdiff_t)(y_pos - p->window_y) * buf->stride;
   const WEBP_CSP_MODE colorspace = p->output->colorspace;
   const int alpha_first = (colorspace == MODE_ARGB || colorspace == MODE_Argb);
   uint8_t* dst = base_rgba + (alpha_first ? 0 : 3);
@@ -443,7 +451,8 @@ static int ExportAlpha(WebPDecParams* const p, int y_pos, int max_lines_out) {
 static int ExportAlphaRGBA4444(WebPDecParams* const p, int y_pos,
                                int max_lines_out) {
   const WebPRGBABuffer* const buf = &p->output->u.RGBA;
-  uint8_t* const base_rgba = buf->rgba + (ptrdiff_t)y_pos * buf->stride;
+  uint8_t* const base_rgba =
+      buf->rgba + (ptrdiff_t)(y_pos - p->window_y) * buf->stride;
 #if (WEBP_SWAP_16BIT_CSP == 1)
   uint8_t* alpha_dst = base_rgba;
 #else
@@ -515,8 +524,11 @@ static int InitRGBRescaler(const VP8Io* const io, WebPDecParams* const p) {
   if (!CheckSizeOverflow(total_size)) {
     return 0;
   }
+  if (WebPArenaIsMeasuring(p->arena)) {
+    return WebPArenaReserve(p->arena, 1ULL, (size_t)total_size);
+  }
 
-  work = (rescaler_t*)WebPSafeMalloc(1ULL, (size_t)total_size);
+  work = (rescaler_t*)WebPArenaMalloc(p->arena, 1ULL, (size_t)total_size);
   if (work == NULL) {
     return 0;  // memory error
   }
@@ -601,7 +613,15 @@ static int CustomSetup(VP8Io* io) {
       if (io->fancy_upsampling) {
 #ifdef FANCY_UPSAMPLING
         const int uv_width = (io->mb_w + 1) >> 1;
-        p->memory = WebPSafeMalloc(1ULL, (size_t)(io->mb_w + 2 * uv_width));
+        const size_t tmp_size = (size_t)(io->mb_w + 2 * uv_width);
+        if (WebPArenaIsMeasuring(p->arena)) {
+          if (!WebPArenaReserve(p->arena, 1ULL, tmp_size)) {
+            p->status = VP8_STATUS_OUT_OF_MEMORY;
+            return 0;
+          }
+          return 1;  // nothing to set up
+        }
+        p->memory = WebPArenaMalloc(p->arena, 1ULL, tmp_size);
         if (p->memory == NULL) {
           p->status = VP8_STATUS_OUT_OF_MEMORY;
           return 0;  // memory error.
@@ -640,13 +660,16 @@ static int CustomPut(const VP8Io* io) {
   int num_lines_out;
   assert(!(io->mb_y & 1));
 
-  if (mb_w <= 0 || mb_h <= 0) {
+  if (mb_w <= 0 || mb_h <= 0 || p->status != VP8_STATUS_OK) {
     return 0;
   }
   num_lines_out = p->emit(io, p);
   if (p->emit_alpha != NULL) {
     p->emit_alpha(io, p, num_lines_out);
   }
+  if (!WebPSinkRows(p, p->last_y, num_lines_out)) {
+    return 0;
+  }
   p->last_y += num_lines_out;
   return 1;
 }
@@ -655,10 +678,47 @@ static int CustomPut(const VP8Io* io) {
 
 static void CustomTeardown(const VP8Io* io) {
   WebPDecParams* const p = (WebPDecParams*)io->opaque;
-  WebPSafeFree(p->memory);
+  WebPArenaFree(p->arena, p->memory);
   p->memory = NULL;
 }
 
+//------------------------------------------------------------------------------
+// Row sink
+
+int WebPSinkRows(WebPDecParams* const params, int y, int num_rows) {
+  const WebPDecBuffer* const output = params->output;
+  WebPDecBuffer rows;
+  if (output->row_sink == NULL || num_rows <= 0) return 1;
+  if (params->status != VP8_STATUS_OK) return 0;
+  assert(y == params->window_y);
+
+  // The rows are stored at the top of the planes: describe them only.
+  rows = *output;
+  rows.height = num_rows;
+  rows.is_external_memory = 1;
+  rows.private_memory = NULL;
+  if (WebPIsRGBMode(output->colorspace)) {
+    WebPRGBABuffer* const buf = &rows.u.RGBA;
+    assert((uint64_t)buf->stride * num_rows <= buf->size);
+    buf->size = (size_t)buf->stride * num_rows;
+  } else {
+    WebPYUVABuffer* const buf = &rows.u.YUVA;
+    const int uv_rows = (num_rows + 1) >> 1;
+    assert((uint64_t)buf->y_stride * num_rows <= buf->y_size);
+    buf->y_size = (size_t)buf->y_stride * num_rows;
+    buf->u_size = (size_t)buf->u_stride * uv_rows;
+    buf->v_size = (size_t)buf->v_stride * uv_rows;
+    buf->a_size = (size_t)buf->a_stride * num_rows;
+  }
+  if (!output->row_sink(&rows, y, num_rows, output->row_sink_data)) {
+    params->status = VP8_STATUS_USER_ABORT;
+    return 0;
+  }
+  // The next rows will overwrite these ones.
+  params->window_y = y + num_rows;
+  return 1;
+}
+
 //------------------------------------------------------------------------------
 // Main entry point
 
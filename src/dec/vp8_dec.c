@@ -68,18 +68,28 @@ int VP8InitIoInternal(VP8Io* const io, int version) {
   return 1;
 }
 
+// Initializes the zero-filled 'dec'.
+static void InitDecoder(VP8Decoder* const dec) {
+  SetOk(dec);
+  WebPGetWorkerInterface()->Init(&dec->worker);
+  dec->ready = 0;
+  dec->num_parts_minus_one = 0;
+  InitGetCoeffs();
+}
+
 VP8Decoder* VP8New(void) {
   VP8Decoder* const dec = (VP8Decoder*)WebPSafeCalloc(1ULL, sizeof(*dec));
   if (dec != NULL) {
-    SetOk(dec);
-    WebPGetWorkerInterface()->Init(&dec->worker);
-    dec->ready = 0;
-    dec->num_parts_minus_one = 0;
-    InitGetCoeffs();
+    InitDecoder(dec);
   }
   return dec;
 }
 
+void VP8InitDecoder(VP8Decoder* const dec) {
+  WEBP_UNSAFE_MEMSET(dec, 0, sizeof(*dec));
+  InitDecoder(dec);
+}
+
 VP8StatusCode VP8Status(VP8Decoder* const dec) {
   if (!dec) return VP8_STATUS_INVALID_PARAM;
   return dec->status;
@@ -531,13 +541,12 @@ static WEBP_INLINE uint32_t NzCodeBits(uint32_t nz_coeffs, int nz, int dc_nz) {
 }
 
 static int ParseResiduals(VP8Decoder* const dec, VP8MB* const mb,
+                          VP8MB* const left_mb, VP8MBData* const block,
                           VP8BitReader* const token_br) {
   const VP8BandProbas*(*const bands)[16 + 1] = dec->proba.bands_ptr;
   const VP8BandProbas* const* ac_proba;
-  VP8MBData* const block = dec->mb_data + dec->mb_x;
   const VP8QuantMatrix* const q = &dec->dqm[block->segment];
   int16_t* dst = block->coeffs;
-  VP8MB* const left_mb = dec->mb_info - 1;
   uint8_t tnz, lnz;
   uint32_t non_zero_y = 0;
   uint32_t non_zero_uv = 0;
@@ -625,13 +634,21 @@ static int ParseResiduals(VP8Decoder* const dec, VP8MB* const mb,
 // Main loop
 
 int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
-  VP8MB* const left = dec->mb_info - 1;
-  VP8MB* const mb = dec->mb_info + dec->mb_x;
-  VP8MBData* const block = dec->mb_data + dec->mb_x;
+  return VP8DecodeMBInRow(dec, dec->mb_x, dec->mb_info - 1,
+                          dec->mb_data + dec->mb_x,
+                          (dec->filter_type > 0) ? dec->f_info + dec->mb_x
+                                                 : NULL,
+                          token_br);
+}
+
+int VP8DecodeMBInRow(VP8Decoder* const dec, int mb_x, VP8MB* const left,
+                     VP8MBData* const block, VP8FInfo* const finfo,
+                     VP8BitReader* const token_br) {
+  VP8MB* const mb = dec->mb_info + mb_x;
   int skip = dec->use_skip_proba ? block->skip : 0;
 
   if (!skip) {
-    skip = ParseResiduals(dec, mb, token_br);
+    skip = ParseResiduals(dec, mb, left, block, token_br);
   } else {
     left->nz = mb->nz = 0;
     if (!block->is_i4x4) {
@@ -643,7 +660,6 @@ int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
   }
 
   if (dec->filter_type > 0) {  // store filter info
-    VP8FInfo* const finfo = dec->f_info + dec->mb_x;
     *finfo = dec->fstrengths[block->segment][block->is_i4x4];
     finfo->f_inner |= !skip;
   }
@@ -660,6 +676,9 @@ void VP8InitScanline(VP8Decoder* const dec) {
 }
 
 static int ParseFrame(VP8Decoder* const dec, VP8Io* io) {
+  if (dec->mt_method == 3) {
+    return VP8DecodeRowsMT(dec, io);
+  }
   for (dec->mb_y = 0; dec->mb_y < dec->br_mb_y; ++dec->mb_y) {
     // Parse bitstream for this row.
     VP8BitReader* const token_br =
@@ -737,11 +756,29 @@ void VP8Clear(VP8Decoder* const dec) {
   }
   WebPGetWorkerInterface()->End(&dec->worker);
   WebPDeallocateAlphaMemory(dec);
-  WebPSafeFree(dec->mem);
+  WebPArenaFree(dec->arena, dec->mem);
   dec->mem = NULL;
   dec->mem_size = 0;
   WEBP_UNSAFE_MEMSET(&dec->br, 0, sizeof(dec->br));
   dec->ready = 0;
 }
 
+void VP8Reset(VP8Decoder* const dec) {
+  void* const mem = dec->mem;
+  const size_t mem_size = dec->mem_size;
+  uint8_t* const alpha_plane_mem = dec->alpha_plane_mem;
+  const size_t alpha_plane_mem_size = dec->alpha_plane_mem_size;
+  // Release everything else.
+  dec->mem = NULL;
+  dec->alpha_plane_mem = NULL;
+  VP8Clear(dec);
+
+  WEBP_UNSAFE_MEMSET(dec, 0, sizeof(*dec));
+  InitDecoder(dec);
+  dec->mem = mem;
+  dec->mem_size = mem_size;
+  dec->alpha_plane_mem = alpha_plane_mem;
+  dec->alpha_plane_mem_size = alpha_plane_mem_size;
+}
+
 //------------------------------------------------------------------------------
@@ -153,6 +153,10 @@ const char* VP8StatusMessage(VP8Decoder* const dec);
 // Not a mandatory call between calls to VP8Decode().
 void VP8Clear(VP8Decoder* const dec);
 
+// Resets the decoder in its initial state, to decode a new picture. Unlike
+// VP8Clear(), the frame and alpha memory is kept for reuse.
+void VP8Reset(VP8Decoder* const dec);
+
 // Destroy the decoder object.
 void VP8Delete(VP8Decoder* const dec);
 
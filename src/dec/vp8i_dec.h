@@ -205,8 +205,11 @@ struct VP8Decoder {
   WebPWorker worker;
   int mt_method;   // multi-thread method: 0=off, 1=[parse+recon][filter]
                    // 2=[parse][recon+filter]
+                   // 3=[parse+recon+filter] of several rows at once
   int cache_id;    // current cache row
-  int num_caches;  // number of cached rows of 16 pixels (1, 2 or 3)
+  int num_caches;  // number of cached rows of 16 pixels (1, 2 or 3, or
+                   // num_row_workers + 1 for mt_method 3)
+  int num_row_workers;  // number of rows decoded concurrently (mt_method 3)
   VP8ThreadContext thread_ctx;  // Thread context
 
   // dimension, in macroblock units.
@@ -252,6 +255,7 @@ struct VP8Decoder {
   // main memory chunk for the above data. Persistent.
   void* mem;
   size_t mem_size;
+  WebPArena* arena;  // if not NULL, memory of 'mem' and 'alpha_plane_mem'
 
   // Per macroblock non-persistent infos.
   int mb_x, mb_y;      // current position, in macroblock units
@@ -268,6 +272,7 @@ struct VP8Decoder {
   size_t alpha_data_size;
   int is_alpha_decoded;      // true if alpha_data is decoded in alpha_plane
   uint8_t* alpha_plane_mem;  // memory allocated for alpha_plane
+  size_t alpha_plane_mem_size;
   uint8_t* alpha_plane;      // output. Persistent, contains the whole data.
   const uint8_t* alpha_prev_line;  // last decoded alpha row (or NULL)
   int alpha_dithering;  // derived from decoding options (0=off, 100=full)
@@ -277,6 +282,9 @@ struct VP8Decoder {
 // internal functions. Not public.
 
 // in vp8.c
+// Initializes 'dec' as VP8New() does, for a decoder not allocated by the
+// latter (e.g. on the stack). It must still be released with VP8Clear().
+void VP8InitDecoder(VP8Decoder* const dec);
 int VP8SetError(VP8Decoder* const dec, VP8StatusCode error,
                 const char* const msg);
 
@@ -304,21 +312,40 @@ WEBP_NODISCARD int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io);
 int VP8GetThreadMethod(const WebPDecoderOptions* const options,
                        const WebPHeaderStructure* const headers, int width,
                        int height);
+// Attach the thread pool from 'options' (if any) to the decoder's worker.
+// Must be called before VP8InitFrame().
+void VP8InitThreadPool(const WebPDecoderOptions* const options,
+                       VP8Decoder* const dec);
 // Initialize dithering post-process if needed.
 void VP8InitDithering(const WebPDecoderOptions* const options,
                       VP8Decoder* const dec);
 // Process the last decoded row (filtering + output).
 WEBP_NODISCARD int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io);
+// Parse, reconstruct, filter and emit all the rows, with several rows being
+// decoded concurrently (mt_method 3). Returns false in case of error.
+WEBP_NODISCARD int VP8DecodeRowsMT(VP8Decoder* const dec, VP8Io* const io);
 // To be called at the start of a new scanline, to initialize predictors.
 void VP8InitScanline(VP8Decoder* const dec);
 // Decode one macroblock. Returns false if there is not enough data.
 WEBP_NODISCARD int VP8DecodeMB(VP8Decoder* const dec,
                                VP8BitReader* const token_br);
+// Same as VP8DecodeMB() for the macroblock 'mb_x' of a row, but using the
+// given left context and storing the results in 'block' and 'finfo' (which
+// can be NULL if there's no filtering) instead of the decoder's current ones.
+WEBP_NODISCARD int VP8DecodeMBInRow(VP8Decoder* const dec, int mb_x,
+                                    VP8MB* const left, VP8MBData* const block,
+                                    VP8FInfo* const finfo,
+                                    VP8BitReader* const token_br);
 
 // in alpha.c
 const uint8_t* VP8DecompressAlphaRows(VP8Decoder* const dec,
                                       const VP8Io* const io, int row,
                                       int num_rows);
+// Accounts in the measuring 'dec->arena' for the memory the alpha decoding
+// takes from it, without allocating nor decoding anything. Lossless alpha is
+// accounted for at its largest. Returns false in case of error.
+WEBP_NODISCARD int VP8ReserveAlphaMemory(VP8Decoder* const dec,
+                                         const VP8Io* const io);
 
 //------------------------------------------------------------------------------
 
@@ -38,6 +38,10 @@
 WEBP_ASSUME_UNSAFE_INDEXABLE_ABI
 
 #define NUM_ARGB_CACHE_ROWS 16
+// minimal width under which lossless multi-threading is always disabled: a
+// batch of narrower rows is too little work to pay for handing it over to
+// another thread
+#define MIN_WIDTH_FOR_THREADS 512
 
 static const int kCodeLengthLiterals = 16;
 static const int kCodeLengthRepeatCode = 16;
@@ -582,8 +586,14 @@ static int AllocateAndInitRescaler(VP8LDecoder* const dec, VP8Io* const io) {
   const uint64_t memory_size = sizeof(*dec->rescaler) +
                                work_size * sizeof(*work) +
                                scaled_data_size * sizeof(*scaled_data);
-  uint8_t* WEBP_BIDI_INDEXABLE memory =
-      (uint8_t*)WebPSafeMalloc(memory_size, sizeof(*memory));
+  uint8_t* WEBP_BIDI_INDEXABLE memory;
+  if (WebPArenaIsMeasuring(dec->arena)) {  // nothing to set up
+    if (!WebPArenaReserve(dec->arena, memory_size, sizeof(*memory))) {
+      return VP8LSetError(dec, VP8_STATUS_OUT_OF_MEMORY);
+    }
+    return 1;
+  }
+  memory = (uint8_t*)WebPArenaMalloc(dec->arena, memory_size, sizeof(*memory));
   if (memory == NULL) {
     return VP8LSetError(dec, VP8_STATUS_OUT_OF_MEMORY);
   }
@@ -744,7 +754,9 @@ static int CheckNonOpaque(const uint8_t* alpha, int width, int height,
 static int EmitRowsYUVA(const uint8_t* const in, const VP8Io* const io,
                         int in_stride, uint16_t* tmp_rgb,
                         VP8LDecoder* const dec) {
+  const WebPDecParams* const params = (const WebPDecParams*)io->opaque;
   int y_pos = dec->last_out_row;
+  const int y_out = y_pos - params->window_y;  // row in the output planes
   const int width = io->mb_w;
   int num_rows = io->mb_h;
   const int y_pos_final = y_pos + num_rows;
@@ -752,9 +764,9 @@ static int EmitRowsYUVA(const uint8_t* const in, const VP8Io* const io,
   const int uv_stride = dec->output->u.YUVA.u_stride;
   const int a_stride = dec->output->u.YUVA.a_stride;
   uint8_t* dst_a = dec->output->u.YUVA.a;
-  uint8_t* dst_y = dec->output->u.YUVA.y + (ptrdiff_t)y_pos * y_stride;
-  uint8_t* dst_u = dec->output->u.YUVA.u + (ptrdiff_t)(y_pos >> 1) * uv_stride;
-  uint8_t* dst_v = dec->output->u.YUVA.v + (ptrdiff_t)(y_pos >> 1) * uv_stride;
+  uint8_t* dst_y = dec->output->u.YUVA.y + (ptrdiff_t)y_out * y_stride;
+  uint8_t* dst_u = dec->output->u.YUVA.u + (ptrdiff_t)(y_out >> 1) * uv_stride;
+  uint8_t* dst_v = dec->output->u.YUVA.v + (ptrdiff_t)(y_out >> 1) * uv_stride;
   const uint8_t* r_ptr = in + CHANNEL_OFFSET(1);
   const uint8_t* g_ptr = in + CHANNEL_OFFSET(2);
   const uint8_t* b_ptr = in + CHANNEL_OFFSET(3);
@@ -768,7 +780,7 @@ static int EmitRowsYUVA(const uint8_t* const in, const VP8Io* const io,
   num_rows &= ~1;
 
   if (dst_a) {
-    dst_a += (ptrdiff_t)y_pos * a_stride;
+    dst_a += (ptrdiff_t)y_out * a_stride;
     a_ptr = in + CHANNEL_OFFSET(0);
     has_alpha = CheckNonOpaque(a_ptr, width, num_rows, in_stride);
   }
@@ -855,12 +867,12 @@ typedef void (*ProcessRowsFunc)(VP8LDecoder* const dec, int row,
                                 int wait_for_biggest_batch);
 
 static void ApplyInverseTransforms(VP8LDecoder* const dec, int start_row,
-                                   int num_rows, const uint32_t* const rows) {
+                                   int num_rows, const uint32_t* const rows,
+                                   uint32_t* const rows_out) {
   int n = dec->next_transform;
   const int cache_pixs = dec->width * num_rows;
   const int end_row = start_row + num_rows;
   const uint32_t* rows_in = rows;
-  uint32_t* const rows_out = dec->argb_cache;
 
   // Inverse transforms.
   while (n-- > 0) {
@@ -874,11 +886,121 @@ static void ApplyInverseTransforms(VP8LDecoder* const dec, int start_row,
   }
 }
 
+// Scales & color-converts the already transformed rows [start_row, end_row)
+// stored in 'argb_cache'.
+static void OutputRows(VP8LDecoder* const dec, int start_row, int end_row,
+                       uint32_t* const argb_cache) {
+  VP8Io* const io = dec->io;
+  WebPDecParams* const params = (WebPDecParams*)io->opaque;
+  uint8_t* rows_data = (uint8_t*)argb_cache;
+  const int in_stride = io->width * sizeof(uint32_t);  // in unit of RGBA
+  if (params->status != VP8_STATUS_OK) {
+    // The row sink aborted the decoding: its buffer is not available anymore.
+  } else if (!SetCropWindow(io, start_row, end_row, &rows_data, in_stride)) {
+    // Nothing to output (this time).
+  } else {
+    const WebPDecBuffer* const output = dec->output;
+    const int first_out_row = dec->last_out_row;
+    if (WebPIsRGBMode(output->colorspace)) {  // convert to RGBA
+      const WebPRGBABuffer* const buf = &output->u.RGBA;
+      uint8_t* const rgba =
+          buf->rgba + (ptrdiff_t)(first_out_row - params->window_y) *
+                          buf->stride;
+      const int num_rows_out =
+#if !defined(WEBP_REDUCE_SIZE)
+          io->use_scaling ? EmitRescaledRowsRGBA(dec, rows_data, in_stride,
+                                                 io->mb_h, rgba, buf->stride)
+                          :
+#endif  // WEBP_REDUCE_SIZE
+                          EmitRows(output->colorspace, rows_data, in_stride,
+                                   io->mb_w, io->mb_h, rgba, buf->stride);
+      // Update 'last_out_row'.
+      dec->last_out_row += num_rows_out;
+    } else {  // convert to YUVA
+      dec->last_out_row =
+          io->use_scaling
+              ? EmitRescaledRowsYUVA(dec, rows_data, in_stride, io->mb_h)
+              : EmitRowsYUVA(rows_data, io, in_stride,
+                             dec->accumulated_rgb_pixels, dec);
+    }
+    assert(dec->last_out_row <= output->height);
+    // An abort is reported by VP8LDecodeImage().
+    (void)WebPSinkRows(params, first_out_row,
+                       dec->last_out_row - first_out_row);
+  }
+}
+
+static int TransformRowsHook(void* arg1, void* arg2) {
+  VP8LDecoder* const dec = (VP8LDecoder*)arg1;
+  const VP8LRowBatch* const batch = &dec->transform_batch;
+  (void)arg2;
+  ApplyInverseTransforms(dec, batch->start_row,
+                         batch->end_row - batch->start_row,
+                         dec->pixels + dec->width * batch->start_row,
+                         batch->argb_cache);
+  return 1;
+}
+
+static int OutputRowsHook(void* arg1, void* arg2) {
+  VP8LDecoder* const dec = (VP8LDecoder*)arg1;
+  const VP8LRowBatch* const batch = &dec->output_batch;
+  (void)arg2;
+  OutputRows(dec, batch->start_row, batch->end_row, batch->argb_cache);
+  return 1;
+}
+
+// With threads, the rows are decoded by a pipeline of three stages, each one
+// working on its own batch of up to NUM_ARGB_CACHE_ROWS rows: the calling
+// thread decodes the entropy-coded pixels of a batch while the transform worker
+// applies the inverse transforms of the previous batch and the output worker
+// scales and color-converts the one before. Each stage must process the
+// batches in order: the entropy decoding and the predictor transform depend on
+// the rows above, and the rescaler and the YUV conversion accumulate rows. So
+// there is nothing for more workers to run concurrently, and two of them,
+// alternating between argb_cache and argb_cache_mt, are the ceiling.
+
+// Waits for both pipeline stages, then hands the freshly transformed batch
+// over to the output stage. If 'wait' is true, the output is done before
+// returning, leaving the pipeline empty.
+static void FlushRows(VP8LDecoder* const dec, int wait) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  VP8LRowBatch* const batch = &dec->transform_batch;
+  if (!dec->use_threads) return;
+  worker_interface->Sync(&dec->transform_worker);
+  worker_interface->Sync(&dec->output_worker);
+  if (batch->end_row > batch->start_row) {
+    dec->output_batch = *batch;
+    batch->end_row = batch->start_row;  // mark as consumed
+    if (wait) {
+      worker_interface->Execute(&dec->output_worker);
+    } else {
+      worker_interface->Launch(&dec->output_worker);
+    }
+  }
+}
+
+// Queues the rows [start_row, end_row) for transformation in the cache not
+// being read by the output stage.
+static void PipelineRows(VP8LDecoder* const dec, int start_row, int end_row) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  uint32_t* const prev = dec->transform_batch.argb_cache;
+  uint32_t* const next =
+      (prev == dec->argb_cache) ? dec->argb_cache_mt : dec->argb_cache;
+  const int width = dec->io->width;
+  FlushRows(dec, /*wait=*/0);
+  // The predictor transform stores the last row of each batch just above the
+  // cache, for use as top row of the next batch.
+  WEBP_UNSAFE_MEMCPY(next - width, prev - width, width * sizeof(*next));
+  dec->transform_batch.start_row = start_row;
+  dec->transform_batch.end_row = end_row;
+  dec->transform_batch.argb_cache = next;
+  worker_interface->Launch(&dec->transform_worker);
+}
+
 // Processes (transforms, scales & color-converts) the rows decoded after the
 // last call.
 static void ProcessRows(VP8LDecoder* const dec, int row,
                         int wait_for_biggest_batch) {
-  const uint32_t* const rows = dec->pixels + dec->width * dec->last_row;
   int num_rows;
 
   // In case of YUV conversion and if we do not need to get to the last row.
@@ -904,36 +1026,18 @@ static void ProcessRows(VP8LDecoder* const dec, int row,
   // of argb_cache), but we currently don't need more than that.
   assert(num_rows <= NUM_ARGB_CACHE_ROWS);
   if (num_rows > 0) {  // Emit output.
-    VP8Io* const io = dec->io;
-    uint8_t* rows_data = (uint8_t*)dec->argb_cache;
-    const int in_stride = io->width * sizeof(uint32_t);  // in unit of RGBA
-    ApplyInverseTransforms(dec, dec->last_row, num_rows, rows);
-    if (!SetCropWindow(io, dec->last_row, row, &rows_data, in_stride)) {
-      // Nothing to output (this time).
+    if (row <= dec->io->crop_top &&
+        !(dec->transforms_seen & (1U << PREDICTOR_TRANSFORM))) {
+      // Nothing to output: without the predictor transform, the following
+      // rows don't depend on these ones and their inverse transforms can be
+      // skipped.
+    } else if (dec->use_threads) {
+      PipelineRows(dec, dec->last_row, row);
     } else {
-      const WebPDecBuffer* const output = dec->output;
-      if (WebPIsRGBMode(output->colorspace)) {  // convert to RGBA
-        const WebPRGBABuffer* const buf = &output->u.RGBA;
-        uint8_t* const rgba =
-            buf->rgba + (ptrdiff_t)dec->last_out_row * buf->stride;
-        const int num_rows_out =
-#if !defined(WEBP_REDUCE_SIZE)
-            io->use_scaling ? EmitRescaledRowsRGBA(dec, rows_data, in_stride,
-                                                   io->mb_h, rgba, buf->stride)
-                            :
-#endif  // WEBP_REDUCE_SIZE
-                            EmitRows(output->colorspace, rows_data, in_stride,
-                                     io->mb_w, io->mb_h, rgba, buf->stride);
-        // Update 'last_out_row'.
-        dec->last_out_row += num_rows_out;
-      } else {  // convert to YUVA
-        dec->last_out_row =
-            io->use_scaling
-                ? EmitRescaledRowsYUVA(dec, rows_data, in_stride, io->mb_h)
-                : EmitRowsYUVA(rows_data, io, in_stride,
-                               dec->accumulated_rgb_pixels, dec);
-      }
-      assert(dec->last_out_row <= output->height);
+      const uint32_t* const rows = dec->pixels + dec->width * dec->last_row;
+      ApplyInverseTransforms(dec, dec->last_row, num_rows, rows,
+                             dec->argb_cache);
+      OutputRows(dec, dec->last_row, row, dec->argb_cache);
     }
   }
 
@@ -974,11 +1078,11 @@ static void AlphaApplyFilter(ALPHDecoder* const alph_dec, int first_row,
 }
 
 static void ExtractPalettedAlphaRows(VP8LDecoder* const dec, int last_row) {
-  // For vertical and gradient filtering, we need to decode the part above the
-  // crop_top row, in order to have the correct spatial predictors.
+  // For all the filters, we need to decode the part above the crop_top row, in
+  // order to have the correct spatial predictors (the horizontal one predicts
+  // the first pixel of each row from the row above).
   ALPHDecoder* const alph_dec = (ALPHDecoder*)dec->io->opaque;
-  const int top_row = (alph_dec->filter == WEBP_FILTER_NONE ||
-                       alph_dec->filter == WEBP_FILTER_HORIZONTAL)
+  const int top_row = (alph_dec->filter == WEBP_FILTER_NONE)
                           ? dec->io->crop_top
                           : dec->last_row;
   const int first_row = (dec->last_row < top_row) ? top_row : dec->last_row;
@@ -1495,11 +1599,18 @@ static void ClearMetadata(VP8LMetadata* const hdr) {
 // -----------------------------------------------------------------------------
 // VP8LDecoder
 
+// Initializes the zero-filled 'dec'.
+static void InitDecoder(VP8LDecoder* const dec) {
+  dec->status = VP8_STATUS_OK;
+  dec->state = READ_DIM;
+  WebPGetWorkerInterface()->Init(&dec->transform_worker);
+  WebPGetWorkerInterface()->Init(&dec->output_worker);
+}
+
 VP8LDecoder* VP8LNew(void) {
   VP8LDecoder* const dec = (VP8LDecoder*)WebPSafeCalloc(1ULL, sizeof(*dec));
   if (dec == NULL) return NULL;
-  dec->status = VP8_STATUS_OK;
-  dec->state = READ_DIM;
+  InitDecoder(dec);
 
   VP8LDspInit();  // Init critical function pointers.
 
@@ -1509,9 +1620,11 @@ VP8LDecoder* VP8LNew(void) {
 // Frees dec->pixels along with the sub-slice pointers derived from it, to
 // prevent dangling references.
 static void ClearInternalBuffers(VP8LDecoder* const dec) {
-  WebPSafeFree(dec->pixels);
+  WebPArenaFree(dec->arena, dec->pixels);
   dec->pixels = NULL;
+  dec->pixels_size = 0;
   dec->argb_cache = NULL;
+  dec->argb_cache_mt = NULL;
   dec->accumulated_rgb_pixels = NULL;
 }
 
@@ -1520,6 +1633,10 @@ static void ClearInternalBuffers(VP8LDecoder* const dec) {
 static void VP8LClear(VP8LDecoder* const dec) {
   int i;
   if (dec == NULL) return;
+  // The workers may still be using the caches.
+  WebPGetWorkerInterface()->End(&dec->transform_worker);
+  WebPGetWorkerInterface()->End(&dec->output_worker);
+  dec->use_threads = 0;
   ClearMetadata(&dec->hdr);
 
   ClearInternalBuffers(dec);
@@ -1529,12 +1646,24 @@ static void VP8LClear(VP8LDecoder* const dec) {
   dec->next_transform = 0;
   dec->transforms_seen = 0;
 
-  WebPSafeFree(dec->rescaler_memory);
+  WebPArenaFree(dec->arena, dec->rescaler_memory);
   dec->rescaler_memory = NULL;
 
   dec->output = NULL;  // leave no trace behind
 }
 
+void VP8LReset(VP8LDecoder* const dec) {
+  uint32_t* const pixels = dec->pixels;
+  const size_t pixels_size = dec->pixels_size;
+  dec->pixels = NULL;  // Release everything else.
+  VP8LClear(dec);
+
+  WEBP_UNSAFE_MEMSET(dec, 0, sizeof(*dec));
+  InitDecoder(dec);
+  dec->pixels = pixels;
+  dec->pixels_size = pixels_size;
+}
+
 void VP8LDelete(VP8LDecoder* const dec) {
   if (dec != NULL) {
     VP8LClear(dec);
@@ -1640,6 +1769,24 @@ End:
 
 //------------------------------------------------------------------------------
 // Allocate internal buffers dec->pixels and dec->argb_cache.
+// Makes dec->pixels hold 'num_pixels' of 'size' bytes. The memory of a previous
+// image is reused if large enough (see VP8LReset()). Returns false in case of
+// memory error.
+static int AllocatePixels(VP8LDecoder* const dec, uint64_t num_pixels,
+                          size_t size) {
+  if (WebPArenaIsMeasuring(dec->arena)) {
+    return WebPArenaReserve(dec->arena, num_pixels, size);
+  }
+  if (num_pixels * size > dec->pixels_size) {
+    ClearInternalBuffers(dec);
+    dec->pixels = (uint32_t*)WebPArenaMalloc(dec->arena, num_pixels, size);
+    if (dec->pixels == NULL) return 0;
+    // down-cast is ok, thanks to WebPArenaMalloc() above.
+    dec->pixels_size = (size_t)(num_pixels * size);
+  }
+  return 1;
+}
+
 static int AllocateInternalBuffers32b(VP8LDecoder* const dec, int final_width) {
   const uint64_t num_pixels = (uint64_t)dec->width * dec->height;
   // Scratch buffer corresponding to top-prediction row for transforming the
@@ -1647,6 +1794,9 @@ static int AllocateInternalBuffers32b(VP8LDecoder* const dec, int final_width) {
   const uint64_t cache_top_pixels = (uint16_t)final_width;
   // Scratch buffer for temporary BGRA storage. Not needed for paletted alpha.
   const uint64_t cache_pixels = (uint64_t)final_width * NUM_ARGB_CACHE_ROWS;
+  // Second top row and cache, for the multi-threaded pipeline.
+  const uint64_t cache_mt_pixels =
+      dec->use_threads ? cache_top_pixels + cache_pixels : 0;
   // Scratch buffer to accumulate RGBA values (hence 4*)for YUV conversion.
   uint64_t accumulated_rgb_pixels = 0;
   uint64_t total_num_pixels;
@@ -1655,29 +1805,29 @@ static int AllocateInternalBuffers32b(VP8LDecoder* const dec, int final_width) {
     accumulated_rgb_pixels =
         4 * uv_width * sizeof(*dec->accumulated_rgb_pixels) / sizeof(uint32_t);
   }
-  total_num_pixels =
-      num_pixels + cache_top_pixels + cache_pixels + accumulated_rgb_pixels;
+  total_num_pixels = num_pixels + cache_top_pixels + cache_pixels +
+                     cache_mt_pixels + accumulated_rgb_pixels;
   assert(dec->width <= final_width);
-  dec->pixels = (uint32_t*)WebPSafeMalloc(total_num_pixels, sizeof(uint32_t));
-  if (dec->pixels == NULL) {
-    ClearInternalBuffers(dec);
+  if (!AllocatePixels(dec, total_num_pixels, sizeof(uint32_t))) {
     return VP8LSetError(dec, VP8_STATUS_OUT_OF_MEMORY);
   }
+  if (WebPArenaIsMeasuring(dec->arena)) return 1;  // nothing to set up
   dec->argb_cache = dec->pixels + num_pixels + cache_top_pixels;
+  dec->argb_cache_mt =
+      dec->use_threads ? dec->argb_cache + cache_pixels + cache_top_pixels
+                       : NULL;
   dec->accumulated_rgb_pixels =
       accumulated_rgb_pixels == 0
           ? NULL
           : (uint16_t*)(dec->pixels + num_pixels + cache_top_pixels +
-                        cache_pixels);
+                        cache_pixels + cache_mt_pixels);
 
   return 1;
 }
 
 static int AllocateInternalBuffers8b(VP8LDecoder* const dec) {
   const uint64_t total_num_pixels = (uint64_t)dec->width * dec->height;
-  ClearInternalBuffers(dec);
-  dec->pixels = (uint32_t*)WebPSafeMalloc(total_num_pixels, sizeof(uint8_t));
-  if (dec->pixels == NULL) {
+  if (!AllocatePixels(dec, total_num_pixels, sizeof(uint8_t))) {
     return VP8LSetError(dec, VP8_STATUS_OUT_OF_MEMORY);
   }
   return 1;
@@ -1706,7 +1856,8 @@ static void ExtractAlphaRows(VP8LDecoder* const dec, int last_row,
     const int cache_pixs = width * num_rows_to_process;
     uint8_t* const dst = output + width * cur_row;
     const uint32_t* const src = dec->argb_cache;
-    ApplyInverseTransforms(dec, cur_row, num_rows_to_process, in);
+    ApplyInverseTransforms(dec, cur_row, num_rows_to_process, in,
+                           dec->argb_cache);
     WebPExtractGreen(src, dst, cache_pixs);
     AlphaApplyFilter(alph_dec, cur_row, cur_row + num_rows_to_process, dst,
                      width);
@@ -1728,6 +1879,7 @@ VP8StatusCode VP8LDecodeAlphaHeader(
   if (dec == NULL) return VP8_STATUS_OUT_OF_MEMORY;
 
   assert(alph_dec != NULL);
+  dec->arena = alph_dec->arena;
 
   dec->width = alph_dec->width;
   dec->height = alph_dec->height;
@@ -1829,68 +1981,131 @@ Error:
   return 0;
 }
 
-int VP8LDecodeImage(VP8LDecoder* const dec) {
+// Sets up the transform and output workers if the image is wide and tall
+// enough for the pipeline to pay off.
+static int InitThreads(VP8LDecoder* const dec,
+                       const WebPDecoderOptions* const options) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  const VP8Io* const io = dec->io;
+  dec->use_threads = 0;
+#if defined(WEBP_USE_THREAD)
+  dec->use_threads = (options != NULL && options->use_threads &&
+                      io->width >= MIN_WIDTH_FOR_THREADS &&
+                      io->crop_bottom > NUM_ARGB_CACHE_ROWS);
+#else
+  (void)options;
+  (void)io;
+#endif
+  // No thread is needed to measure the memory.
+  if (dec->use_threads && !WebPArenaIsMeasuring(dec->arena)) {
+    dec->transform_worker.pool = WebPGetThreadPool(options);
+    dec->transform_worker.hook = TransformRowsHook;
+    dec->transform_worker.data1 = dec;
+    dec->output_worker.pool = WebPGetThreadPool(options);
+    dec->output_worker.hook = OutputRowsHook;
+    dec->output_worker.data1 = dec;
+    if (!worker_interface->Reset(&dec->transform_worker) ||
+        !worker_interface->Reset(&dec->output_worker)) {
+      return VP8LSetError(dec, VP8_STATUS_OUT_OF_MEMORY);
+    }
+  }
+  return 1;
+}
+
+// Sets up the output and allocates the memory needed to decode the image,
+// without decoding it. Returns false in case of error, with updated
+// dec->status.
+static int InitDecoding(VP8LDecoder* const dec) {
   VP8Io* io = NULL;
   WebPDecParams* params = NULL;
 
   if (dec == NULL) return 0;
 
-  assert(dec->hdr.huffman_tables.root.start != NULL);
-  assert(dec->hdr.htree_groups != NULL);
-  assert(dec->hdr.num_htree_groups > 0);
-
   io = dec->io;
   assert(io != NULL);
   params = (WebPDecParams*)io->opaque;
   assert(params != NULL);
 
-  // Initialization.
-  if (dec->state != READ_DATA) {
-    dec->output = params->output;
-    assert(dec->output != NULL);
+  dec->output = params->output;
+  assert(dec->output != NULL);
 
-    if (!WebPIoInitFromOptions(params->options, io, MODE_BGRA)) {
-      VP8LSetError(dec, VP8_STATUS_INVALID_PARAM);
-      goto Err;
-    }
+  if (!WebPIoInitFromOptions(params->options, io, MODE_BGRA)) {
+    VP8LSetError(dec, VP8_STATUS_INVALID_PARAM);
+    goto Err;
+  }
 
-    if (!AllocateInternalBuffers32b(dec, io->width)) goto Err;
+  if (!InitThreads(dec, params->options)) goto Err;
+  if (!AllocateInternalBuffers32b(dec, io->width)) goto Err;
+  dec->transform_batch.start_row = dec->transform_batch.end_row = 0;
+  dec->transform_batch.argb_cache = dec->argb_cache;
+  dec->output_batch = dec->transform_batch;
 
 #if !defined(WEBP_REDUCE_SIZE)
-    if (io->use_scaling && !AllocateAndInitRescaler(dec, io)) goto Err;
+  if (io->use_scaling && !AllocateAndInitRescaler(dec, io)) goto Err;
 #else
-    if (io->use_scaling) {
-      VP8LSetError(dec, VP8_STATUS_INVALID_PARAM);
-      goto Err;
-    }
+  if (io->use_scaling) {
+    VP8LSetError(dec, VP8_STATUS_INVALID_PARAM);
+    goto Err;
+  }
 #endif
-    if (io->use_scaling || WebPIsPremultipliedMode(dec->output->colorspace)) {
-      // need the alpha-multiply functions for premultiplied output or rescaling
-      WebPInitAlphaProcessing();
-    }
+  if (io->use_scaling || WebPIsPremultipliedMode(dec->output->colorspace)) {
+    // need the alpha-multiply functions for premultiplied output or rescaling
+    WebPInitAlphaProcessing();
+  }
 
-    if (!WebPIsRGBMode(dec->output->colorspace)) {
-      WebPInitConvertARGBToYUV();
-      if (dec->output->u.YUVA.a != NULL) WebPInitAlphaProcessing();
-    }
-    if (dec->incremental) {
-      if (dec->hdr.color_cache_size > 0 &&
-          dec->hdr.saved_color_cache.colors == NULL) {
-        if (!VP8LColorCacheInit(&dec->hdr.saved_color_cache,
-                                dec->hdr.color_cache.hash_bits)) {
-          VP8LSetError(dec, VP8_STATUS_OUT_OF_MEMORY);
-          goto Err;
-        }
+  if (!WebPIsRGBMode(dec->output->colorspace)) {
+    WebPInitConvertARGBToYUV();
+    if (dec->output->u.YUVA.a != NULL) WebPInitAlphaProcessing();
+  }
+  if (dec->incremental) {
+    if (dec->hdr.color_cache_size > 0 &&
+        dec->hdr.saved_color_cache.colors == NULL) {
+      if (!VP8LColorCacheInit(&dec->hdr.saved_color_cache,
+                              dec->hdr.color_cache.hash_bits)) {
+        VP8LSetError(dec, VP8_STATUS_OUT_OF_MEMORY);
+        goto Err;
       }
     }
-    dec->state = READ_DATA;
   }
+  dec->state = READ_DATA;
+  return 1;
+
+Err:
+  VP8LClear(dec);
+  assert(dec->status != VP8_STATUS_OK);
+  return 0;
+}
+
+int VP8LDecodeImage(VP8LDecoder* const dec) {
+  VP8Io* io = NULL;
+  WebPDecParams* params = NULL;
+
+  if (dec == NULL) return 0;
+
+  assert(dec->hdr.huffman_tables.root.start != NULL);
+  assert(dec->hdr.htree_groups != NULL);
+  assert(dec->hdr.num_htree_groups > 0);
+
+  io = dec->io;
+  assert(io != NULL);
+  params = (WebPDecParams*)io->opaque;
+  assert(params != NULL);
+
+  // Initialization.
+  if (dec->state != READ_DATA && !InitDecoding(dec)) return 0;
 
   // Decode.
   if (!DecodeImageData(dec, dec->pixels, dec->width, dec->height,
                        io->crop_bottom, ProcessRows)) {
     goto Err;
   }
+  // Make sure no row is still in flight before returning, since incremental
+  // decoding may rewind and re-decode the last rows.
+  FlushRows(dec, /*wait=*/1);
+  if (params->status != VP8_STATUS_OK) {  // aborted by the row sink
+    VP8LSetError(dec, params->status);
+    goto Err;
+  }
 
   params->last_y = dec->last_out_row;
   return 1;
@@ -1902,3 +2117,32 @@ Err:
 }
 
 //------------------------------------------------------------------------------
+// Arena measuring. The images are accounted for at their final width, which
+// the color-indexing transform can only reduce.
+
+VP8StatusCode VP8LReserveDecodingMemory(VP8Io* const io) {
+  const WebPDecParams* const params = (const WebPDecParams*)io->opaque;
+  VP8LDecoder dec;
+  WEBP_UNSAFE_MEMSET(&dec, 0, sizeof(dec));
+  InitDecoder(&dec);
+  dec.arena = params->arena;
+  assert(WebPArenaIsMeasuring(dec.arena));
+  dec.io = io;
+  dec.width = io->width;
+  dec.height = io->height;
+  if (!InitDecoding(&dec)) return dec.status;
+  VP8LClear(&dec);
+  return VP8_STATUS_OK;
+}
+
+int VP8LReserveAlphaMemory(WebPArena* const arena, int width, int height) {
+  VP8LDecoder dec;
+  assert(WebPArenaIsMeasuring(arena));
+  WEBP_UNSAFE_MEMSET(&dec, 0, sizeof(dec));
+  dec.arena = arena;
+  dec.width = width;
+  dec.height = height;
+  return AllocateInternalBuffers32b(&dec, width);
+}
+
+//------------------------------------------------------------------------------
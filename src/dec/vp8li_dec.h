@@ -23,6 +23,8 @@
 #include "src/utils/color_cache_utils.h"
 #include "src/utils/huffman_utils.h"
 #include "src/utils/rescaler_utils.h"
+#include "src/utils/thread_utils.h"
+#include "src/utils/utils.h"
 #include "src/webp/decode.h"
 #include "src/webp/format_constants.h"
 #include "src/webp/types.h"
@@ -58,6 +60,14 @@ typedef struct {
   HuffmanTables huffman_tables;
 } VP8LMetadata;
 
+// Batch of rows [start_row, end_row) handed over to a pipeline stage, along
+// with the cache holding their transformed pixels.
+typedef struct {
+  int start_row;
+  int end_row;
+  uint32_t* argb_cache;
+} VP8LRowBatch;
+
 typedef struct VP8LDecoder VP8LDecoder;
 struct VP8LDecoder {
   VP8StatusCode status;
@@ -68,6 +78,9 @@ struct VP8LDecoder {
 
   uint32_t* pixels;      // Internal data: either uint8_t* for alpha
                          // or uint32_t* for BGRA.
+  size_t pixels_size;    // Allocated size of 'pixels', in bytes.
+  WebPArena* arena;      // if not NULL, memory of 'pixels' and
+                         // 'rescaler_memory'
   uint32_t* argb_cache;  // Scratch buffer for temporary BGRA storage.
   uint16_t* accumulated_rgb_pixels;  // Scratch buffer for accumulated RGB for
                                      // YUV conversion.
@@ -94,6 +107,16 @@ struct VP8LDecoder {
 
   uint8_t* rescaler_memory;  // Working memory for rescaling work.
   WebPRescaler* rescaler;    // Common rescaler for all channels.
+
+  // Multi-threaded pipeline: while the main thread entropy-decodes a batch of
+  // rows, the previous batch is inverse-transformed into one cache and the
+  // one before is scaled & color-converted from the other cache.
+  int use_threads;
+  WebPWorker transform_worker;
+  WebPWorker output_worker;
+  VP8LRowBatch transform_batch;
+  VP8LRowBatch output_batch;
+  uint32_t* argb_cache_mt;  // Second scratch buffer, used in turn.
 };
 
 //------------------------------------------------------------------------------
@@ -126,6 +149,21 @@ WEBP_NODISCARD int VP8LDecodeHeader(VP8LDecoder* const dec, VP8Io* const io);
 // this function. Returns false in case of error, with updated dec->status.
 WEBP_NODISCARD int VP8LDecodeImage(VP8LDecoder* const dec);
 
+// Accounts in the measuring arena of the WebPDecParams behind 'io->opaque' for
+// the memory VP8LDecodeImage() takes from it, given the dimensions in 'io'.
+// Nothing is allocated nor decoded. The result is an upper bound, see
+// WebPGetDecodeArenaSize().
+WEBP_NODISCARD VP8StatusCode VP8LReserveDecodingMemory(VP8Io* const io);
+
+// Same as above for an alpha plane of 'width' x 'height' pixels, accounted for
+// in 'arena'. Returns false in case of overflow.
+WEBP_NODISCARD int VP8LReserveAlphaMemory(WebPArena* const arena, int width,
+                                          int height);
+
+// Resets the decoder in its initial state, to decode a new image. The memory
+// of the pixels is kept for reuse.
+void VP8LReset(VP8LDecoder* const dec);
+
 // Clears and deallocate a lossless decoder instance.
 void VP8LDelete(VP8LDecoder* const dec);
 
@@ -468,10 +468,109 @@ void WebPResetDecParams(WebPDecParams* const params) {
 //------------------------------------------------------------------------------
 // "Into" decoding variants
 
-// Main flow
+// Decoders kept between the calls to WebPDecodeWithContext(). They are always
+// reset, holding only the memory that can be reused.
+struct WebPDecoderContext {
+  VP8Decoder* vp8_dec;    // Lossy decoder, or NULL if not used yet.
+  VP8LDecoder* vp8l_dec;  // Lossless decoder, or NULL if not used yet.
+};
+
+// Returns the lossy decoder of 'context', or a new one if 'context' is NULL.
+static VP8Decoder* GetVP8Decoder(WebPDecoderContext* const context) {
+  if (context == NULL) return VP8New();
+  if (context->vp8_dec == NULL) context->vp8_dec = VP8New();
+  return context->vp8_dec;
+}
+
+// Deletes 'dec', or resets it for the next picture if it belongs to 'context'.
+static void ReleaseVP8Decoder(WebPDecoderContext* const context,
+                              VP8Decoder* const dec) {
+  if (context == NULL) {
+    VP8Delete(dec);
+  } else {
+    VP8Reset(dec);
+  }
+}
+
+// Same as above, for the lossless decoder.
+static VP8LDecoder* GetVP8LDecoder(WebPDecoderContext* const context) {
+  if (context == NULL) return VP8LNew();
+  if (context->vp8l_dec == NULL) context->vp8l_dec = VP8LNew();
+  return context->vp8l_dec;
+}
+
+static void ReleaseVP8LDecoder(WebPDecoderContext* const context,
+                               VP8LDecoder* const dec) {
+  if (context == NULL) {
+    VP8LDelete(dec);
+  } else {
+    VP8LReset(dec);
+  }
+}
+
+// Accounts in the measuring 'dec->arena' for the memory VP8Decode() takes from
+// it: the one of io->setup(), the frame and the alpha plane.
+WEBP_NODISCARD static int ReserveVP8Memory(VP8Decoder* const dec,
+                                           VP8Io* const io) {
+  int ok = (VP8EnterCritical(dec, io) == VP8_STATUS_OK);
+  if (ok) {
+    ok = VP8InitFrame(dec, io);
+    if (ok && dec->alpha_data != NULL) ok = VP8ReserveAlphaMemory(dec, io);
+    ok &= VP8ExitCritical(dec, io);
+  }
+  return ok;
+}
+
+// Accounts in the measuring 'params->arena' for the memory DecodeInto() takes
+// from it, from the headers only. Nothing is allocated nor decoded, and the
+// bitstream past the headers is not checked.
+WEBP_NODISCARD static VP8StatusCode MeasureInto(
+    const WebPHeaderStructure* const headers, VP8Io* const io,
+    WebPDecParams* const params) {
+  VP8StatusCode status;
+  if (!headers->is_lossless) {
+    VP8Decoder dec;
+    VP8InitDecoder(&dec);
+    dec.alpha_data = headers->alpha_data;
+    dec.alpha_data_size = headers->alpha_data_size;
+    dec.arena = params->arena;
+    if (!VP8GetHeaders(&dec, io)) {
+      status = dec.status;
+    } else {
+      status = WebPAllocateDecBuffer(io->width, io->height, params->options,
+                                     params->output, params->arena);
+      if (status == VP8_STATUS_OK) {
+        dec.mt_method =
+            VP8GetThreadMethod(params->options, headers, io->width, io->height);
+        VP8InitThreadPool(params->options, &dec);
+        VP8InitDithering(params->options, &dec);
+        if (!ReserveVP8Memory(&dec, io)) {
+          status =
+              (params->status != VP8_STATUS_OK) ? params->status : dec.status;
+        }
+      }
+    }
+    VP8Clear(&dec);
+  } else {
+    int width, height;
+    if (!VP8LGetInfo(io->data, io->data_size, &width, &height, NULL)) {
+      return VP8_STATUS_BITSTREAM_ERROR;
+    }
+    io->width = width;
+    io->height = height;
+    status = WebPAllocateDecBuffer(io->width, io->height, params->options,
+                                   params->output, params->arena);
+    if (status == VP8_STATUS_OK) status = VP8LReserveDecodingMemory(io);
+  }
+  return status;
+}
+
+// Main flow. If 'context' is not NULL, its decoders are used instead of
+// temporary ones. If 'params->arena' is only measuring, the memory is only
+// accounted for (see MeasureInto()).
 WEBP_NODISCARD static VP8StatusCode DecodeInto(
     const uint8_t* WEBP_COUNTED_BY(data_size) const data, size_t data_size,
-    WebPDecParams* const params) {
+    WebPDecParams* const params, WebPDecoderContext* const context) {
   VP8StatusCode status;
   VP8Io io;
   WebPHeaderStructure headers;
@@ -491,14 +590,18 @@ WEBP_NODISCARD static VP8StatusCode DecodeInto(
   io.data = headers.data + headers.offset;
   io.data_size = headers.data_size - headers.offset;
   WebPInitCustomIo(params, &io);  // Plug the I/O functions.
+  if (WebPArenaIsMeasuring(params->arena)) {
+    return MeasureInto(&headers, &io, params);
+  }
 
   if (!headers.is_lossless) {
-    VP8Decoder* const dec = VP8New();
+    VP8Decoder* const dec = GetVP8Decoder(context);
     if (dec == NULL) {
       return VP8_STATUS_OUT_OF_MEMORY;
     }
     dec->alpha_data = headers.alpha_data;
     dec->alpha_data_size = headers.alpha_data_size;
+    dec->arena = params->arena;
 
     // Decode bitstream header, update io->width/io->height.
     if (!VP8GetHeaders(dec, &io)) {
@@ -506,11 +609,12 @@ WEBP_NODISCARD static VP8StatusCode DecodeInto(
     } else {
       // Allocate/check output buffers.
       status = WebPAllocateDecBuffer(io.width, io.height, params->options,
-                                     params->output);
+                                     params->output, params->arena);
       if (status == VP8_STATUS_OK) {  // Decode
         // This change must be done before calling VP8Decode()
         dec->mt_method =
             VP8GetThreadMethod(params->options, &headers, io.width, io.height);
+        VP8InitThreadPool(params->options, dec);
         VP8InitDithering(params->options, dec);
         if (!VP8Decode(dec, &io)) {
           status =
@@ -518,25 +622,26 @@ WEBP_NODISCARD static VP8StatusCode DecodeInto(
         }
       }
     }
-    VP8Delete(dec);
+    ReleaseVP8Decoder(context, dec);
   } else {
-    VP8LDecoder* const dec = VP8LNew();
+    VP8LDecoder* const dec = GetVP8LDecoder(context);
     if (dec == NULL) {
       return VP8_STATUS_OUT_OF_MEMORY;
     }
+    dec->arena = params->arena;
     if (!VP8LDecodeHeader(dec, &io)) {
       status = dec->status;  // An error occurred. Grab error status.
     } else {
       // Allocate/check output buffers.
       status = WebPAllocateDecBuffer(io.width, io.height, params->options,
-                                     params->output);
+                                     params->output, params->arena);
       if (status == VP8_STATUS_OK) {  // Decode
         if (!VP8LDecodeImage(dec)) {
           status = dec->status;
         }
       }
     }
-    VP8LDelete(dec);
+    ReleaseVP8LDecoder(context, dec);
   }
 
   if (status != VP8_STATUS_OK) {
@@ -568,7 +673,7 @@ WEBP_NODISCARD static uint8_t* DecodeIntoRGBABuffer(
   buf.u.RGBA.stride = stride;
   buf.u.RGBA.size = size;
   buf.is_external_memory = 1;
-  if (DecodeInto(data, data_size, &params) != VP8_STATUS_OK) {
+  if (DecodeInto(data, data_size, &params, NULL) != VP8_STATUS_OK) {
     return NULL;
   }
   return rgba;
@@ -632,7 +737,7 @@ uint8_t* WebPDecodeYUVInto(const uint8_t* WEBP_COUNTED_BY(data_size) data,
   output.u.YUVA.v_stride = v_stride;
   output.u.YUVA.v_size = v_size;
   output.is_external_memory = 1;
-  if (DecodeInto(data, data_size, &params) != VP8_STATUS_OK) {
+  if (DecodeInto(data, data_size, &params, NULL) != VP8_STATUS_OK) {
     return NULL;
   }
   return luma;
@@ -664,7 +769,7 @@ WEBP_NODISCARD static uint8_t* Decode(WEBP_CSP_MODE mode,
   if (height != NULL) *height = output.height;
 
   // Decode
-  if (DecodeInto(data, data_size, &params) != VP8_STATUS_OK) {
+  if (DecodeInto(data, data_size, &params, NULL) != VP8_STATUS_OK) {
     return NULL;
   }
   if (keep_info != NULL) {  // keep track of the side-info
@@ -783,6 +888,23 @@ int WebPInitDecoderConfigInternal(WebPDecoderConfig* config, int version) {
   return 1;
 }
 
+// The pool is stored in the padding of the options to keep their size.
+int WebPDecoderConfigSetThreadPool(WebPDecoderConfig* config,
+                                   WebPThreadPool* pool) {
+  if (config == NULL) return 0;
+  assert(sizeof(pool) <= sizeof(config->options.pad));
+  WEBP_UNSAFE_MEMCPY(config->options.pad, &pool, sizeof(pool));
+  return 1;
+}
+
+WebPThreadPool* WebPGetThreadPool(const WebPDecoderOptions* const options) {
+  WebPThreadPool* pool = NULL;
+  if (options != NULL) {
+    WEBP_UNSAFE_MEMCPY(&pool, options->pad, sizeof(pool));
+  }
+  return pool;
+}
+
 static int WebPCheckCropDimensionsBasic(int x, int y, int w, int h) {
   return !(x < 0 || y < 0 || w <= 0 || h <= 0);
 }
@@ -852,8 +974,12 @@ VP8StatusCode WebPGetFeaturesInternal(const uint8_t* WEBP_COUNTED_BY(data_size)
   return GetFeatures(data, data_size, features);
 }
 
-VP8StatusCode WebPDecode(const uint8_t* WEBP_COUNTED_BY(data_size) data,
-                         size_t data_size, WebPDecoderConfig* config) {
+// If not NULL, 'arena' holds the memory of the output and of the largest
+// buffers. It is not combined with a 'context'.
+static VP8StatusCode DecodeWithContext(
+    const uint8_t* WEBP_COUNTED_BY(data_size) data, size_t data_size,
+    WebPDecoderConfig* const config, WebPDecoderContext* const context,
+    WebPArena* const arena) {
   WebPDecParams params;
   VP8StatusCode status;
 
@@ -872,6 +998,7 @@ VP8StatusCode WebPDecode(const uint8_t* WEBP_COUNTED_BY(data_size) data,
   WebPResetDecParams(&params);
   params.options = &config->options;
   params.output = &config->output;
+  params.arena = arena;
   if (WebPAvoidSlowMemory(params.output, &config->input)) {
     // decoding to slow memory: use a temporary in-mem buffer to decode into.
     WebPDecBuffer in_mem_buffer;
@@ -882,18 +1009,88 @@ VP8StatusCode WebPDecode(const uint8_t* WEBP_COUNTED_BY(data_size) data,
     in_mem_buffer.width = config->input.width;
     in_mem_buffer.height = config->input.height;
     params.output = &in_mem_buffer;
-    status = DecodeInto(data, data_size, &params);
-    if (status == VP8_STATUS_OK) {  // do the slow-copy
+    status = DecodeInto(data, data_size, &params, context);
+    if (status == VP8_STATUS_OK && !WebPArenaIsMeasuring(arena)) {
+      // do the slow-copy
       status = WebPCopyDecBufferPixels(&in_mem_buffer, &config->output);
     }
     WebPFreeDecBuffer(&in_mem_buffer);
   } else {
-    status = DecodeInto(data, data_size, &params);
+    status = DecodeInto(data, data_size, &params, context);
   }
 
   return status;
 }
 
+VP8StatusCode WebPDecode(const uint8_t* WEBP_COUNTED_BY(data_size) data,
+                         size_t data_size, WebPDecoderConfig* config) {
+  return DecodeWithContext(data, data_size, config, /*context=*/NULL,
+                           /*arena=*/NULL);
+}
+
+//------------------------------------------------------------------------------
+// Decoder context
+
+WebPDecoderContext* WebPDecoderContextNewInternal(int version) {
+  if (WEBP_ABI_IS_INCOMPATIBLE(version, WEBP_DECODER_ABI_VERSION)) {
+    return NULL;  // version mismatch
+  }
+  // Note: the decoders are only created when needed.
+  return (WebPDecoderContext*)WebPSafeCalloc(1ULL, sizeof(WebPDecoderContext));
+}
+
+VP8StatusCode WebPDecodeWithContext(
+    WebPDecoderContext* context, const uint8_t* WEBP_COUNTED_BY(data_size) data,
+    size_t data_size, WebPDecoderConfig* config) {
+  if (context == NULL) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  return DecodeWithContext(data, data_size, config, context, /*arena=*/NULL);
+}
+
+void WebPDecoderContextDelete(WebPDecoderContext* context) {
+  if (context != NULL) {
+    VP8Delete(context->vp8_dec);
+    VP8LDelete(context->vp8l_dec);
+    WebPSafeFree(context);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Arena decoding
+
+VP8StatusCode WebPGetDecodeArenaSize(
+    const uint8_t* WEBP_COUNTED_BY(data_size) data, size_t data_size,
+    const WebPDecoderConfig* config, size_t* arena_size) {
+  WebPDecoderConfig measure_config;
+  WebPArena arena;
+  VP8StatusCode status;
+
+  if (config == NULL || arena_size == NULL) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  *arena_size = 0;
+  // Nothing is allocated: the sizes are derived from the headers and 'config'.
+  measure_config = *config;
+  measure_config.output.private_memory = NULL;  // Owned by 'config'.
+  WebPArenaInit(&arena, /*mem=*/NULL, 0);
+  status = DecodeWithContext(data, data_size, &measure_config,
+                             /*context=*/NULL, &arena);
+  if (status == VP8_STATUS_OK) *arena_size = arena.used;
+  return status;
+}
+
+VP8StatusCode WebPDecodeInArena(const uint8_t* WEBP_COUNTED_BY(data_size) data,
+                                size_t data_size, WebPDecoderConfig* config,
+                                void* mem, size_t mem_size) {
+  WebPArena arena;
+  if (mem == NULL) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  WebPArenaInit(&arena, mem, mem_size);
+  return DecodeWithContext(data, data_size, config, /*context=*/NULL, &arena);
+}
+
 //------------------------------------------------------------------------------
 // Cropping and rescaling.
 
@@ -953,9 +1150,9 @@ int WebPIoInitFromOptions(const WebPDecoderOptions* const options,
 #endif
 
   if (io->use_scaling) {
-    // disable filter (only for large downscaling ratio).
+    // disable filter (only for large downscaling ratio of the cropped area).
     io->bypass_filtering |=
-        (io->scaled_width < W * 3 / 4) && (io->scaled_height < H * 3 / 4);
+        (io->scaled_width < w * 3 / 4) && (io->scaled_height < h * 3 / 4);
     io->fancy_upsampling = 0;
   }
   return 1;
@@ -22,6 +22,7 @@ extern "C" {
 
 #include "src/dec/vp8_dec.h"
 #include "src/utils/rescaler_utils.h"
+#include "src/utils/utils.h"
 #include "src/webp/decode.h"
 #include "src/webp/types.h"
 
@@ -43,6 +44,8 @@ struct WebPDecParams {
                                    // or used for tmp rescaling
 
   int last_y;  // coordinate of the line that was last output
+  int window_y;  // output row stored at the top of the output planes. Always
+                 // 0, unless the rows are passed to a row sink.
   const WebPDecoderOptions* options;  // if not NULL, use alt decoding features
 
   // Precise reason for a setup() failure, VP8_STATUS_OK otherwise.
@@ -50,6 +53,7 @@ struct WebPDecParams {
 
   WebPRescaler *scaler_y, *scaler_u, *scaler_v, *scaler_a;  // rescalers
   void* memory;  // overall scratch memory for the output work.
+  WebPArena* arena;  // if not NULL, memory of the output buffers.
 
   OutputFunc emit;               // output RGB or YUV samples
   OutputAlphaFunc emit_alpha;    // output alpha channel
@@ -95,12 +99,21 @@ int WebPCheckCropDimensions(int image_width, int image_height, int x, int y,
 // hooks will use the supplied 'params' as io->opaque handle.
 void WebPInitCustomIo(WebPDecParams* const params, VP8Io* const io);
 
+// Passes the 'num_rows' final rows starting at row 'y' to the row sink of the
+// output buffer, if any, and makes room for the next ones. Returns false and
+// sets params->status if the sink aborted the decoding.
+WEBP_NODISCARD int WebPSinkRows(WebPDecParams* const params, int y,
+                                int num_rows);
+
 // Setup crop_xxx fields, mb_w and mb_h in io. 'src_colorspace' refers
 // to the *compressed* format, not the output one.
 WEBP_NODISCARD int WebPIoInitFromOptions(
     const WebPDecoderOptions* const options, VP8Io* const io,
     WEBP_CSP_MODE src_colorspace);
 
+// Returns the thread pool set by WebPDecoderConfigSetThreadPool(), or NULL.
+WebPThreadPool* WebPGetThreadPool(const WebPDecoderOptions* const options);
+
 //------------------------------------------------------------------------------
 // Internal functions regarding WebPDecBuffer memory (in buffer.c).
 // Don't really need to be externally visible for now.
@@ -113,10 +126,13 @@ WEBP_NODISCARD int WebPIoInitFromOptions(
 // parameters are valid and apply them to the width/height dimensions of the
 // output buffer. This takes cropping / scaling / rotation into account.
 // Also incorporates the options->flip flag to flip the buffer parameters if
-// needed.
+// needed. If 'arena' is not NULL, the memory is taken from it and not owned by
+// 'buffer'. If 'arena' is only measuring, internal memory is only accounted for
+// and 'buffer' is left without pixels.
 VP8StatusCode WebPAllocateDecBuffer(int width, int height,
                                     const WebPDecoderOptions* const options,
-                                    WebPDecBuffer* const buffer);
+                                    WebPDecBuffer* const buffer,
+                                    WebPArena* const arena);
 
 // Flip buffer vertically by negating the various strides.
 VP8StatusCode WebPFlipBuffer(WebPDecBuffer* const buffer);
@@ -17,6 +17,7 @@
 #include <assert.h>
 #include <string.h>
 
+#include "src/utils/thread_utils.h"
 #include "src/utils/utils.h"
 #include "src/webp/decode.h"
 #include "src/webp/demux.h"
@@ -42,6 +43,17 @@ static void BlendPixelRowNonPremult(uint32_t* const src,
 static void BlendPixelRowPremult(uint32_t* const src, const uint32_t* const dst,
                                  int num_pixels);
 
+// Frame decoded ahead by a worker, in its own buffer.
+typedef struct {
+  WebPWorker worker;
+  WebPDecoderConfig config;  // Copy of the decoder's one, output to 'buf'.
+  const uint8_t* data;       // Frame bitstream.
+  size_t data_size;
+  uint8_t* buf;     // Decoded frame rectangle, kept for the next frames.
+  size_t buf_size;  // Allocated size of 'buf'.
+  int frame_num;    // Frame being decoded, or 0 if the slot is free.
+} PrefetchSlot;
+
 struct WebPAnimDecoder {
   WebPDemuxer* demux;        // Demuxer created from given WebP bitstream.
   WebPDecoderConfig config;  // Decoder config.
@@ -56,11 +68,21 @@ struct WebPAnimDecoder {
   int prev_frame_was_keyframe;   // True if previous frame was a keyframe.
   int next_frame;                // Index of the next frame to be decoded
                                  // (starting from 1).
+
+  // Frames decoded ahead (see WebPAnimDecoderOptions::prefetch_frames).
+  PrefetchSlot* slots;           // Frame 'n' is decoded by slot
+                                 // 'n % num_slots'.
+  int num_slots;                 // 0 if prefetching is off.
+  size_t prefetch_memory;        // Sum of the 'buf_size' of the slots.
+  size_t prefetch_memory_limit;  // 0 means no limit.
+  int prefetch_next;             // Index of the next frame to be prefetched.
 };
 
 static void DefaultDecoderOptions(WebPAnimDecoderOptions* const dec_options) {
   dec_options->color_mode = MODE_RGBA;
   dec_options->use_threads = 0;
+  dec_options->prefetch_frames = 0;
+  dec_options->prefetch_memory_limit = 0;
 }
 
 int WebPAnimDecoderOptionsInitInternal(WebPAnimDecoderOptions* dec_options,
@@ -98,6 +120,118 @@ WEBP_NODISCARD static int ApplyDecoderOptions(
   return 1;
 }
 
+static int PrefetchHook(void* arg1, void* arg2) {
+  PrefetchSlot* const slot = (PrefetchSlot*)arg1;
+  (void)arg2;
+  return (WebPDecode(slot->data, slot->data_size, &slot->config) ==
+          VP8_STATUS_OK);
+}
+
+// Starts the worker of each slot, run by the threads of 'pool' if not NULL.
+// The workers must be idle.
+WEBP_NODISCARD static int StartPrefetchWorkers(WebPAnimDecoder* const dec,
+                                               WebPThreadPool* const pool) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  int i;
+  for (i = 0; i < dec->num_slots; ++i) {
+    WebPWorker* const worker = &dec->slots[i].worker;
+    worker_interface->End(worker);
+    worker_interface->Init(worker);
+    worker->pool = pool;
+    worker->hook = PrefetchHook;
+    worker->data1 = &dec->slots[i];
+    worker->data2 = NULL;
+    if (!worker_interface->Reset(worker)) return 0;
+  }
+  return 1;
+}
+
+// Starts the workers decoding the frames ahead, if requested by 'dec_options'.
+WEBP_NODISCARD static int InitPrefetch(
+    const WebPAnimDecoderOptions* const dec_options,
+    WebPAnimDecoder* const dec) {
+#if defined(WEBP_USE_THREAD)
+  if (dec_options->prefetch_frames <= 0) return 1;
+  dec->slots = (PrefetchSlot*)WebPSafeCalloc(dec_options->prefetch_frames,
+                                             sizeof(*dec->slots));
+  if (dec->slots == NULL) return 0;
+  dec->num_slots = dec_options->prefetch_frames;
+  dec->prefetch_memory_limit = dec_options->prefetch_memory_limit;
+  if (!StartPrefetchWorkers(dec, NULL)) return 0;
+#else
+  (void)dec_options;
+  (void)dec;
+#endif
+  return 1;
+}
+
+// Waits for the frames decoded ahead and discards them.
+static void CancelPrefetch(WebPAnimDecoder* const dec) {
+  int i;
+  for (i = 0; i < dec->num_slots; ++i) {
+    PrefetchSlot* const slot = &dec->slots[i];
+    if (slot->frame_num != 0) {
+      (void)WebPGetWorkerInterface()->Sync(&slot->worker);
+      slot->frame_num = 0;
+    }
+  }
+}
+
+// Starts decoding the frame 'prefetch_next' on the worker of its slot. Returns
+// false if there is no such frame, if the slot still holds an earlier frame or
+// if the frame doesn't fit in the memory limit.
+static int LaunchPrefetch(WebPAnimDecoder* const dec) {
+  const int frame_num = dec->prefetch_next;
+  PrefetchSlot* const slot = &dec->slots[frame_num % dec->num_slots];
+  WebPRGBABuffer* const buf = &slot->config.output.u.RGBA;
+  WebPIterator iter;
+  uint64_t size;
+
+  if (frame_num > (int)dec->info.frame_count || slot->frame_num != 0) return 0;
+  if (!WebPDemuxGetFrame(dec->demux, frame_num, &iter)) return 0;
+  size = (uint64_t)iter.width * iter.height * NUM_CHANNELS;
+  if (size > slot->buf_size) {
+    const uint64_t memory = dec->prefetch_memory - slot->buf_size + size;
+    if ((dec->prefetch_memory_limit > 0 &&
+         memory > dec->prefetch_memory_limit) ||
+        !CheckSizeOverflow(size)) {
+      WebPDemuxReleaseIterator(&iter);
+      return 0;
+    }
+    WebPSafeFree(slot->buf);
+    dec->prefetch_memory -= slot->buf_size;
+    slot->buf_size = 0;
+    slot->buf = (uint8_t*)WebPSafeMalloc(1ULL, (size_t)size);
+    if (slot->buf == NULL) {
+      WebPDemuxReleaseIterator(&iter);
+      return 0;
+    }
+    slot->buf_size = (size_t)size;
+    dec->prefetch_memory += slot->buf_size;
+  }
+  slot->config = dec->config;
+  buf->rgba = slot->buf;
+  buf->stride = iter.width * NUM_CHANNELS;
+  buf->size = (size_t)size;
+  slot->data = iter.fragment.bytes;
+  slot->data_size = iter.fragment.size;
+  slot->frame_num = frame_num;
+  WebPDemuxReleaseIterator(&iter);
+  WebPGetWorkerInterface()->Launch(&slot->worker);
+  ++dec->prefetch_next;
+  return 1;
+}
+
+// Decodes ahead as many of the next frames as the slots and memory allow.
+static void Prefetch(WebPAnimDecoder* const dec) {
+  if (dec->num_slots == 0) return;
+  if (dec->prefetch_next < dec->next_frame) {
+    dec->prefetch_next = dec->next_frame;
+  }
+  while (LaunchPrefetch(dec)) {
+  }
+}
+
 WebPAnimDecoder* WebPAnimDecoderNewInternal(
     const WebPData* webp_data, const WebPAnimDecoderOptions* dec_options,
     int abi_version) {
@@ -126,6 +260,7 @@ WebPAnimDecoder* WebPAnimDecoderNewInternal(
     DefaultDecoderOptions(&options);
   }
   if (!ApplyDecoderOptions(&options, dec)) goto Error;
+  if (!InitPrefetch(&options, dec)) goto Error;
 
   dec->demux = WebPDemux(webp_data);
   if (dec->demux == NULL) goto Error;
@@ -376,13 +511,28 @@ int WebPAnimDecoderGetNext(WebPAnimDecoder* dec, uint8_t** buf_ptr,
     const uint64_t size = (uint64_t)iter.height * stride;  // at most 25 + 27b
     WebPDecoderConfig* const config = &dec->config;
     WebPRGBABuffer* const buf = &config->output.u.RGBA;
+    PrefetchSlot* const slot =
+        (dec->num_slots > 0) ? &dec->slots[iter.frame_num % dec->num_slots]
+                             : NULL;
     if ((size_t)size != size) goto Error;
-    buf->stride = (int)stride;
-    buf->size = (size_t)size;
-    buf->rgba = dec->curr_frame + out_offset;
+    if (slot != NULL && slot->frame_num == iter.frame_num) {
+      // The frame was decoded ahead: only copy it.
+      const size_t row_size = (size_t)iter.width * NUM_CHANNELS;
+      int y;
+      slot->frame_num = 0;
+      if (!WebPGetWorkerInterface()->Sync(&slot->worker)) goto Error;
+      for (y = 0; y < iter.height; ++y) {
+        WEBP_UNSAFE_MEMCPY(dec->curr_frame + out_offset + (size_t)y * stride,
+                           slot->buf + (size_t)y * row_size, row_size);
+      }
+    } else {
+      buf->stride = (int)stride;
+      buf->size = (size_t)size;
+      buf->rgba = dec->curr_frame + out_offset;
 
-    if (WebPDecode(in, in_size, config) != VP8_STATUS_OK) {
-      goto Error;
+      if (WebPDecode(in, in_size, config) != VP8_STATUS_OK) {
+        goto Error;
+      }
     }
   }
 
@@ -440,6 +590,7 @@ int WebPAnimDecoderGetNext(WebPAnimDecoder* dec, uint8_t** buf_ptr,
                       dec->prev_iter.width, dec->prev_iter.height);
   }
   ++dec->next_frame;
+  Prefetch(dec);
 
   // All OK, fill in the values.
   *buf_ptr = dec->curr_frame;
@@ -463,9 +614,22 @@ void WebPAnimDecoderReset(WebPAnimDecoder* dec) {
     WEBP_UNSAFE_MEMSET(&dec->prev_iter, 0, sizeof(dec->prev_iter));
     dec->prev_frame_was_keyframe = 0;
     dec->next_frame = 1;
+    CancelPrefetch(dec);
+    dec->prefetch_next = 1;
+    Prefetch(dec);
   }
 }
 
+int WebPAnimDecoderSetThreadPool(WebPAnimDecoder* dec, WebPThreadPool* pool) {
+  if (dec == NULL) return 0;
+  CancelPrefetch(dec);
+  (void)WebPDecoderConfigSetThreadPool(&dec->config, pool);
+  if (!StartPrefetchWorkers(dec, pool)) return 0;
+  dec->prefetch_next = dec->next_frame;
+  Prefetch(dec);
+  return 1;
+}
+
 const WebPDemuxer* WebPAnimDecoderGetDemuxer(const WebPAnimDecoder* dec) {
   if (dec == NULL) return NULL;
   return dec->demux;
@@ -473,6 +637,12 @@ const WebPDemuxer* WebPAnimDecoderGetDemuxer(const WebPAnimDecoder* dec) {
 
 void WebPAnimDecoderDelete(WebPAnimDecoder* dec) {
   if (dec != NULL) {
+    int i;
+    for (i = 0; i < dec->num_slots; ++i) {
+      WebPGetWorkerInterface()->End(&dec->slots[i].worker);
+      WebPSafeFree(dec->slots[i].buf);
+    }
+    WebPSafeFree(dec->slots);
     WebPDemuxReleaseIterator(&dec->prev_iter);
     WebPDemuxDelete(dec->demux);
     WebPSafeFree(dec->curr_frame);
@@ -74,6 +74,8 @@ struct WebPDemuxer {
   int num_frames;
   Frame* frames;
   Frame** frames_tail;
+  Frame** frame_index;  // 'num_frames' pointers to the frames by number, set
+                        // once the parsing is complete. May be NULL.
   Chunk* chunks;  // non-image chunks
   Chunk** chunks_tail;
 };
@@ -669,6 +671,22 @@ static void InitDemux(WebPDemuxer* const dmux, const MemBuffer* const mem) {
   dmux->mem = *mem;
 }
 
+// Indexes the frames of a fully parsed file, for a direct access to any of
+// them (e.g. the tiles of a WebPTileDecoder). Without the index, which is
+// optional, the frame list is searched.
+static void BuildFrameIndex(WebPDemuxer* const dmux) {
+  Frame* f;
+  int i = 0;
+  if (dmux->num_frames <= 1) return;
+  dmux->frame_index = (Frame**)WebPSafeMalloc(
+      (uint64_t)dmux->num_frames, sizeof(*dmux->frame_index));
+  if (dmux->frame_index == NULL) return;
+  for (f = dmux->frames; f != NULL; f = f->next) {
+    assert(i < dmux->num_frames && f->frame_num == i + 1);
+    dmux->frame_index[i++] = f;
+  }
+}
+
 static ParseStatus CreateRawImageDemuxer(MemBuffer* const mem,
                                          WebPDemuxer** demuxer) {
   WebPBitstreamFeatures features;
@@ -760,6 +778,7 @@ WebPDemuxer* WebPDemuxInternal(const WebPData* data, int allow_partial,
     WebPDemuxDelete(dmux);
     return NULL;
   }
+  if (dmux->state == WEBP_DEMUX_DONE) BuildFrameIndex(dmux);
   return dmux;
 }
 
@@ -778,6 +797,7 @@ void WebPDemuxDelete(WebPDemuxer* dmux) {
     c = c->next;
     WebPSafeFree(cur_chunk);
   }
+  WebPSafeFree(dmux->frame_index);
   WebPSafeFree(dmux);
 }
 
@@ -808,6 +828,10 @@ uint32_t WebPDemuxGetI(const WebPDemuxer* dmux, WebPFormatFeature feature) {
 
 static const Frame* GetFrame(const WebPDemuxer* const dmux, int frame_num) {
   const Frame* f;
+  if (dmux->frame_index != NULL) {
+    if (frame_num < 1 || frame_num > dmux->num_frames) return NULL;
+    return dmux->frame_index[frame_num - 1];
+  }
   for (f = dmux->frames; f != NULL; f = f->next) {
     if (frame_num == f->frame_num) break;
   }
@@ -0,0 +1,285 @@
+// Copyright 2025 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  TileDecoder implementation.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "src/webp/config.h"
+#endif
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "src/utils/utils.h"
+#include "src/webp/decode.h"
+#include "src/webp/demux.h"
+#include "src/webp/format_constants.h"
+#include "src/webp/mux_types.h"
+#include "src/webp/types.h"
+
+WEBP_ASSUME_UNSAFE_INDEXABLE_ABI
+
+struct WebPTileDecoder {
+  WebPDemuxer* demux;        // Demuxer created from given WebP bitstream.
+  WebPDecoderConfig config;  // Decoder config.
+  int bytes_per_pixel;       // Of the output colorspace.
+  WebPTileInfo info;         // Global info about the tiled image.
+  uint8_t* area;             // Partially decoded tiles.
+  size_t area_size;
+};
+
+static void DefaultDecoderOptions(WebPTileDecoderOptions* const dec_options) {
+  dec_options->color_mode = MODE_RGBA;
+  dec_options->use_threads = 0;
+}
+
+int WebPTileDecoderOptionsInitInternal(WebPTileDecoderOptions* dec_options,
+                                       int abi_version) {
+  if (dec_options == NULL ||
+      WEBP_ABI_IS_INCOMPATIBLE(abi_version, WEBP_DEMUX_ABI_VERSION)) {
+    return 0;
+  }
+  DefaultDecoderOptions(dec_options);
+  return 1;
+}
+
+// Returns the number of bytes per pixel of the RGB 'mode', 0 if not supported.
+static int GetBytesPerPixel(WEBP_CSP_MODE mode) {
+  switch (mode) {
+    case MODE_RGB:
+    case MODE_BGR:
+      return 3;
+    case MODE_RGBA_4444:
+    case MODE_RGB_565:
+    case MODE_rgbA_4444:
+      return 2;
+    case MODE_RGBA:
+    case MODE_BGRA:
+    case MODE_ARGB:
+    case MODE_rgbA:
+    case MODE_bgrA:
+    case MODE_Argb:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+WEBP_NODISCARD static int ApplyDecoderOptions(
+    const WebPTileDecoderOptions* const dec_options,
+    WebPTileDecoder* const dec) {
+  WebPDecoderConfig* const config = &dec->config;
+  assert(dec_options != NULL);
+
+  dec->bytes_per_pixel = GetBytesPerPixel(dec_options->color_mode);
+  if (dec->bytes_per_pixel == 0) return 0;
+  if (!WebPInitDecoderConfig(config)) return 0;
+  config->output.colorspace = dec_options->color_mode;
+  config->output.is_external_memory = 1;
+  config->options.use_threads = dec_options->use_threads;
+  config->options.use_cropping = 1;
+  // Note: the crop area and config->output.u.RGBA are set at the time of
+  // decoding each tile.
+  return 1;
+}
+
+// Reads the tile grid from the "TILE" chunk and checks it against the frames.
+WEBP_NODISCARD static int ReadTileInfo(WebPTileDecoder* const dec) {
+  WebPTileInfo* const info = &dec->info;
+  WebPChunkIterator chunk_iter;
+  uint64_t num_tiles;
+
+  info->canvas_width = WebPDemuxGetI(dec->demux, WEBP_FF_CANVAS_WIDTH);
+  info->canvas_height = WebPDemuxGetI(dec->demux, WEBP_FF_CANVAS_HEIGHT);
+  if (!WebPDemuxGetChunk(dec->demux, "TILE", 1, &chunk_iter)) return 0;
+  if (chunk_iter.chunk.size < TILE_CHUNK_SIZE) {
+    WebPDemuxReleaseChunkIterator(&chunk_iter);
+    return 0;
+  }
+  info->tile_width = 1 + GetLE24(chunk_iter.chunk.bytes + 0);
+  info->tile_height = 1 + GetLE24(chunk_iter.chunk.bytes + 3);
+  WebPDemuxReleaseChunkIterator(&chunk_iter);
+
+  info->tiles_x =
+      (info->canvas_width + info->tile_width - 1) / info->tile_width;
+  info->tiles_y =
+      (info->canvas_height + info->tile_height - 1) / info->tile_height;
+  num_tiles = (uint64_t)info->tiles_x * info->tiles_y;
+  return (num_tiles == WebPDemuxGetI(dec->demux, WEBP_FF_FRAME_COUNT));
+}
+
+WebPTileDecoder* WebPTileDecoderNewInternal(
+    const WebPData* webp_data, const WebPTileDecoderOptions* dec_options,
+    int abi_version) {
+  WebPTileDecoderOptions options;
+  WebPTileDecoder* dec = NULL;
+  if (webp_data == NULL ||
+      WEBP_ABI_IS_INCOMPATIBLE(abi_version, WEBP_DEMUX_ABI_VERSION)) {
+    return NULL;
+  }
+
+  // Note: calloc() so that the pointer members are initialized to NULL.
+  dec = (WebPTileDecoder*)WebPSafeCalloc(1ULL, sizeof(*dec));
+  if (dec == NULL) goto Error;
+
+  if (dec_options != NULL) {
+    options = *dec_options;
+  } else {
+    DefaultDecoderOptions(&options);
+  }
+  if (!ApplyDecoderOptions(&options, dec)) goto Error;
+
+  dec->demux = WebPDemux(webp_data);
+  if (dec->demux == NULL) goto Error;
+  if (!ReadTileInfo(dec)) goto Error;
+  return dec;
+
+Error:
+  WebPTileDecoderDelete(dec);
+  return NULL;
+}
+
+int WebPTileDecoderGetInfo(const WebPTileDecoder* dec, WebPTileInfo* info) {
+  if (dec == NULL || info == NULL) return 0;
+  *info = dec->info;
+  return 1;
+}
+
+// Decodes the area at 'crop_left', 'crop_top' of dimensions 'crop_width' x
+// 'crop_height' of the 'tile' into 'output' of stride 'stride'.
+static int DecodeTileArea(const WebPTileDecoder* const dec,
+                          const WebPData* const tile, int crop_left,
+                          int crop_top, int crop_width, int crop_height,
+                          uint8_t* const output, int stride) {
+  WebPDecoderConfig config = dec->config;
+  config.options.crop_left = crop_left;
+  config.options.crop_top = crop_top;
+  config.options.crop_width = crop_width;
+  config.options.crop_height = crop_height;
+  config.output.u.RGBA.rgba = output;
+  config.output.u.RGBA.stride = stride;
+  config.output.u.RGBA.size = (size_t)stride * (crop_height - 1) +
+                              (size_t)crop_width * dec->bytes_per_pixel;
+  return (WebPDecode(tile->bytes, tile->size, &config) == VP8_STATUS_OK);
+}
+
+// Decodes the intersection of the tile at 'tile_x', 'tile_y' with the
+// rectangle at 'left', 'top' of dimensions 'width' x 'height' to 'output',
+// which maps the rectangle.
+static int DecodeTile(WebPTileDecoder* const dec, int tile_x, int tile_y,
+                      int left, int top, int width, int height,
+                      uint8_t* const output, int stride) {
+  const WebPTileInfo* const info = &dec->info;
+  const int bpp = dec->bytes_per_pixel;
+  const int x = tile_x * (int)info->tile_width;
+  const int y = tile_y * (int)info->tile_height;
+  const int tile_width = (x + (int)info->tile_width < (int)info->canvas_width)
+                             ? (int)info->tile_width
+                             : (int)info->canvas_width - x;
+  const int tile_height =
+      (y + (int)info->tile_height < (int)info->canvas_height)
+          ? (int)info->tile_height
+          : (int)info->canvas_height - y;
+  // Intersection, in tile coordinates.
+  const int x0 = ((left > x) ? left : x) - x;
+  const int y0 = ((top > y) ? top : y) - y;
+  const int x1 = ((left + width < x + tile_width) ? left + width
+                                                  : x + tile_width) - x;
+  const int y1 = ((top + height < y + tile_height) ? top + height
+                                                   : y + tile_height) - y;
+  uint8_t* const dst =
+      output + (size_t)(y + y0 - top) * stride + (size_t)(x + x0 - left) * bpp;
+  WebPIterator iter;
+  int ok;
+
+  if (!WebPDemuxGetFrame(dec->demux, tile_y * info->tiles_x + tile_x + 1,
+                         &iter)) {
+    return 0;
+  }
+  ok = (iter.x_offset == x && iter.y_offset == y && iter.width == tile_width &&
+        iter.height == tile_height);
+  if (!ok) goto End;
+
+  if (x0 == 0 && y0 == 0 && x1 == tile_width && y1 == tile_height) {
+    ok = DecodeTileArea(dec, &iter.fragment, 0, 0, tile_width, tile_height,
+                        dst, stride);
+  } else {
+    // The lossy samples next to the edges of a crop area, or in an area
+    // starting at an odd position, differ from the ones of the full tile
+    // because of the chroma upsampling. A larger area, starting at an even
+    // position, is decoded instead and the intersection is copied from it.
+    const int ax0 = (x0 >= 2) ? (x0 - 2) & ~1 : 0;
+    const int ay0 = (y0 >= 2) ? (y0 - 2) & ~1 : 0;
+    const int ax1 = (x1 + 2 < tile_width) ? x1 + 2 : tile_width;
+    const int ay1 = (y1 + 2 < tile_height) ? y1 + 2 : tile_height;
+    const int area_stride = (ax1 - ax0) * bpp;
+    const size_t area_size = (size_t)area_stride * (ay1 - ay0);
+    int j;
+    if (area_size > dec->area_size) {
+      WebPSafeFree(dec->area);
+      dec->area = (uint8_t*)WebPSafeMalloc(1ULL, area_size);
+      dec->area_size = (dec->area != NULL) ? area_size : 0;
+      if (dec->area == NULL) {
+        ok = 0;
+        goto End;
+      }
+    }
+    ok = DecodeTileArea(dec, &iter.fragment, ax0, ay0, ax1 - ax0, ay1 - ay0,
+                        dec->area, area_stride);
+    for (j = y0; ok && j < y1; ++j) {
+      memcpy(dst + (size_t)(j - y0) * stride,
+             dec->area + (size_t)(j - ay0) * area_stride + (x0 - ax0) * bpp,
+             (size_t)(x1 - x0) * bpp);
+    }
+  }
+
+End:
+  WebPDemuxReleaseIterator(&iter);
+  return ok;
+}
+
+int WebPTileDecoderDecodeRegion(WebPTileDecoder* dec, int left, int top,
+                                int width, int height, uint8_t* output,
+                                int stride) {
+  int tile_x, tile_y;
+  if (dec == NULL || output == NULL) return 0;
+  if (left < 0 || top < 0 || width <= 0 || height <= 0 ||
+      left > (int)dec->info.canvas_width - width ||
+      top > (int)dec->info.canvas_height - height) {
+    return 0;
+  }
+  if (stride < width * dec->bytes_per_pixel) return 0;
+
+  for (tile_y = top / (int)dec->info.tile_height;
+       tile_y <= (top + height - 1) / (int)dec->info.tile_height; ++tile_y) {
+    for (tile_x = left / (int)dec->info.tile_width;
+         tile_x <= (left + width - 1) / (int)dec->info.tile_width; ++tile_x) {
+      if (!DecodeTile(dec, tile_x, tile_y, left, top, width, height, output,
+                      stride)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+const WebPDemuxer* WebPTileDecoderGetDemuxer(const WebPTileDecoder* dec) {
+  if (dec == NULL) return NULL;
+  return dec->demux;
+}
+
+void WebPTileDecoderDelete(WebPTileDecoder* dec) {
+  if (dec != NULL) {
+    WebPDemuxDelete(dec->demux);
+    WebPSafeFree(dec->area);
+    WebPSafeFree(dec);
+  }
+}
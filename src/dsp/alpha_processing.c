@@ -440,6 +440,8 @@ extern void WebPInitAlphaProcessingSSE41(void);
 extern void WebPInitAlphaProcessingNEON(void);
 
 WEBP_DSP_INIT_FUNC(WebPInitAlphaProcessing) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
   WebPMultARGBRow = WebPMultARGBRow_C;
   WebPMultRow = WebPMultRow_C;
   WebPApplyAlphaMultiply4444 = ApplyAlphaMultiply_16b_C;
@@ -465,9 +467,11 @@ WEBP_DSP_INIT_FUNC(WebPInitAlphaProcessing) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       WebPInitAlphaProcessingSSE2();
+      level = WEBP_SIMD_SSE2;
 #if defined(WEBP_HAVE_SSE41)
       if (VP8GetCPUInfo(kSSE4_1)) {
         WebPInitAlphaProcessingSSE41();
+        level = WEBP_SIMD_SSE4_1;
       }
 #endif
     }
@@ -475,6 +479,7 @@ WEBP_DSP_INIT_FUNC(WebPInitAlphaProcessing) {
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       WebPInitAlphaProcessingMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
@@ -483,6 +488,7 @@ WEBP_DSP_INIT_FUNC(WebPInitAlphaProcessing) {
   if (WEBP_NEON_OMIT_C_CODE ||
       (VP8GetCPUInfo != NULL && VP8GetCPUInfo(kNEON))) {
     WebPInitAlphaProcessingNEON();
+    level = WEBP_SIMD_SSE2;
   }
 #endif
 
@@ -501,4 +507,5 @@ WEBP_DSP_INIT_FUNC(WebPInitAlphaProcessing) {
   assert(WebPHasAlpha8b != NULL);
   assert(WebPHasAlpha32b != NULL);
   assert(WebPAlphaReplace != NULL);
+  WebPDspInitDone(kDspAlphaProcessing, level);
 }
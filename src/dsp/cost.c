@@ -297,6 +297,8 @@ extern void VP8EncDspCostInitSSE2(void);
 extern void VP8EncDspCostInitNEON(void);
 
 WEBP_DSP_INIT_FUNC(VP8EncDspCostInit) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
   VP8GetResidualCost = GetResidualCost_C;
   VP8SetResidualCoeffs = SetResidualCoeffs_C;
 
@@ -305,24 +307,29 @@ WEBP_DSP_INIT_FUNC(VP8EncDspCostInit) {
 #if defined(WEBP_USE_MIPS32)
     if (VP8GetCPUInfo(kMIPS32)) {
       VP8EncDspCostInitMIPS32();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       VP8EncDspCostInitMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       VP8EncDspCostInitSSE2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_HAVE_NEON)
     if (VP8GetCPUInfo(kNEON)) {
       VP8EncDspCostInitNEON();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
+  WebPDspInitDone(kDspEncCost, level);
 }
 
 //------------------------------------------------------------------------------
@@ -15,7 +15,6 @@
 
 #if defined(WEBP_HAVE_NEON_RTCD)
 #include <stdio.h>
-#include <string.h>
 #endif
 
 #if defined(WEBP_ANDROID_NEON)
@@ -23,6 +22,8 @@
 #endif
 
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "src/webp/types.h"
 
@@ -164,10 +165,20 @@ static int x86CPUInfo(CPUFeature feature) {
       return !!(cpu_info[1] & (1 << 5));
     }
   }
+  if (feature == kAVX512) {
+    if (x86CPUInfo(kAVX2)) {
+      // bits 16 (AVX512F), 30 (AVX512BW) & 31 (AVX512VL)
+      const uint32_t kAVX512Bits = (1u << 16) | (1u << 30) | (1u << 31);
+      GetCPUInfo(cpu_info, 7);
+      if (((uint32_t)cpu_info[1] & kAVX512Bits) == kAVX512Bits) {
+        // opmask, upper ZMM0-15 and ZMM16-31 states enabled by the OS.
+        return (xgetbv() & 0xe0) == 0xe0;
+      }
+    }
+  }
   return 0;
 }
-WEBP_EXTERN VP8CPUInfo VP8GetCPUInfo;
-VP8CPUInfo VP8GetCPUInfo = x86CPUInfo;
+#define DETECT_CPU_INFO x86CPUInfo
 #elif defined(WEBP_ANDROID_NEON)  // NB: needs to be before generic NEON test.
 static int AndroidCPUInfo(CPUFeature feature) {
   const AndroidCpuFamily cpu_family = android_getCpuFamily();
@@ -178,8 +189,7 @@ static int AndroidCPUInfo(CPUFeature feature) {
   }
   return 0;
 }
-WEBP_EXTERN VP8CPUInfo VP8GetCPUInfo;
-VP8CPUInfo VP8GetCPUInfo = AndroidCPUInfo;
+#define DETECT_CPU_INFO AndroidCPUInfo
 #elif defined(__EMSCRIPTEN__)     // also needs to be before generic NEON test
 // Use compile flags as an indicator of SIMD support instead of a runtime check.
 static int wasmCPUInfo(CPUFeature feature) {
@@ -198,6 +208,10 @@ static int wasmCPUInfo(CPUFeature feature) {
     case kAVX2:
       return 1;
 #endif
+#ifdef WEBP_HAVE_AVX512
+    case kAVX512:
+      return 1;
+#endif
 #ifdef WEBP_HAVE_NEON
     case kNEON:
       return 1;
@@ -207,8 +221,7 @@ static int wasmCPUInfo(CPUFeature feature) {
   }
   return 0;
 }
-WEBP_EXTERN VP8CPUInfo VP8GetCPUInfo;
-VP8CPUInfo VP8GetCPUInfo = wasmCPUInfo;
+#define DETECT_CPU_INFO wasmCPUInfo
 #elif defined(WEBP_HAVE_NEON)
 // In most cases this function doesn't check for NEON support (it's assumed by
 // the configuration), but enables turning off NEON at runtime, for testing
@@ -236,8 +249,7 @@ static int armCPUInfo(CPUFeature feature) {
   return 1;
 #endif
 }
-WEBP_EXTERN VP8CPUInfo VP8GetCPUInfo;
-VP8CPUInfo VP8GetCPUInfo = armCPUInfo;
+#define DETECT_CPU_INFO armCPUInfo
 #elif defined(WEBP_USE_MIPS32) || defined(WEBP_USE_MIPS_DSP_R2) || \
     defined(WEBP_USE_MSA)
 static int mipsCPUInfo(CPUFeature feature) {
@@ -247,8 +259,7 @@ static int mipsCPUInfo(CPUFeature feature) {
     return 0;
   }
 }
-WEBP_EXTERN VP8CPUInfo VP8GetCPUInfo;
-VP8CPUInfo VP8GetCPUInfo = mipsCPUInfo;
+#define DETECT_CPU_INFO mipsCPUInfo
 #elif defined(WEBP_USE_VSX)
 // VSX is the POWER8 (ISA 2.07) baseline, so compile-time presence implies
 // runtime availability.
@@ -259,9 +270,151 @@ static int ppcCPUInfo(CPUFeature feature) {
     return 0;
   }
 }
+#define DETECT_CPU_INFO ppcCPUInfo
+#endif
+
+//------------------------------------------------------------------------------
+// SIMD level limit.
+//
+// Each limit has its own VP8GetCPUInfo function, so that the dsp init functions
+// select their implementations again when it changes.
+
+#if defined(DETECT_CPU_INFO)
+
+// Returns the level of the instruction set of 'feature'.
+static WebPSimdLevel GetFeatureLevel(CPUFeature feature) {
+  switch (feature) {
+    case kSlowSSSE3:  // a performance hint, not an instruction set
+      return WEBP_SIMD_NONE;
+    case kSSE2:
+      return WEBP_SIMD_SSE2;
+    case kSSE3:
+    case kSSE4_1:
+      return WEBP_SIMD_SSE4_1;
+    case kAVX:
+    case kAVX2:
+      return WEBP_SIMD_AVX2;
+    case kAVX512:
+      return WEBP_SIMD_AVX512;
+    default:  // other architectures
+      return WEBP_SIMD_SSE2;
+  }
+}
+
+// Returns the limit set by the WEBP_MAX_SIMD environment variable, if any.
+// The variable is only read once, since this is called for each feature test.
+static WebPSimdLevel GetEnvMaxSimdLevel(void) {
+  static volatile int env_level = -1;  // not read yet
+  int level = env_level;
+  if (level < 0) {
+    const char* const env = getenv("WEBP_MAX_SIMD");
+    level = WEBP_SIMD_AVX512;
+    if (env != NULL) {
+      if (!strcmp(env, "none")) level = WEBP_SIMD_NONE;
+      if (!strcmp(env, "sse2")) level = WEBP_SIMD_SSE2;
+      if (!strcmp(env, "sse4.1")) level = WEBP_SIMD_SSE4_1;
+      if (!strcmp(env, "avx2")) level = WEBP_SIMD_AVX2;
+      if (!strcmp(env, "avx512")) level = WEBP_SIMD_AVX512;
+    }
+    env_level = level;  // concurrent callers store the same value
+  }
+  return (WebPSimdLevel)level;
+}
+
+#define LIMITED_CPU_INFO(NAME, MAX_LEVEL)               \
+  static int NAME(CPUFeature feature) {                 \
+    return (GetFeatureLevel(feature) <= (MAX_LEVEL)) && \
+           DETECT_CPU_INFO(feature);                    \
+  }
+LIMITED_CPU_INFO(EnvCPUInfo, GetEnvMaxSimdLevel())
+
 WEBP_EXTERN VP8CPUInfo VP8GetCPUInfo;
-VP8CPUInfo VP8GetCPUInfo = ppcCPUInfo;
-#else
+VP8CPUInfo VP8GetCPUInfo = EnvCPUInfo;
+
+#if !defined(WEBP_CPU_OMIT_SIMD_LEVEL_API)
+LIMITED_CPU_INFO(NoneCPUInfo, WEBP_SIMD_NONE)
+LIMITED_CPU_INFO(SSE2CPUInfo, WEBP_SIMD_SSE2)
+LIMITED_CPU_INFO(SSE41CPUInfo, WEBP_SIMD_SSE4_1)
+LIMITED_CPU_INFO(AVX2CPUInfo, WEBP_SIMD_AVX2)
+
+int WebPSetMaxSimdLevel(WebPSimdLevel max_level) {
+  switch (max_level) {
+    case WEBP_SIMD_NONE:
+      VP8GetCPUInfo = NoneCPUInfo;
+      return 1;
+    case WEBP_SIMD_SSE2:
+      VP8GetCPUInfo = SSE2CPUInfo;
+      return 1;
+    case WEBP_SIMD_SSE4_1:
+      VP8GetCPUInfo = SSE41CPUInfo;
+      return 1;
+    case WEBP_SIMD_AVX2:
+      VP8GetCPUInfo = AVX2CPUInfo;
+      return 1;
+    case WEBP_SIMD_AVX512:
+      VP8GetCPUInfo = DETECT_CPU_INFO;
+      return 1;
+    default:
+      return 0;
+  }
+}
+#endif  // !WEBP_CPU_OMIT_SIMD_LEVEL_API
+#undef LIMITED_CPU_INFO
+
+#else  // !DETECT_CPU_INFO
+
 WEBP_EXTERN VP8CPUInfo VP8GetCPUInfo;
 VP8CPUInfo VP8GetCPUInfo = NULL;
+
+#if !defined(WEBP_CPU_OMIT_SIMD_LEVEL_API)
+int WebPSetMaxSimdLevel(WebPSimdLevel max_level) {
+  return (max_level >= WEBP_SIMD_NONE && max_level <= WEBP_SIMD_AVX512);
+}
 #endif
+
+#endif  // DETECT_CPU_INFO
+
+#if !defined(WEBP_CPU_OMIT_SIMD_LEVEL_API)
+WebPSimdLevel WebPGetSimdLevel(void) {
+  const VP8CPUInfo cpu_info = VP8GetCPUInfo;
+  if (cpu_info == NULL) return WEBP_SIMD_NONE;
+  if (cpu_info(kAVX512)) return WEBP_SIMD_AVX512;
+  if (cpu_info(kAVX2)) return WEBP_SIMD_AVX2;
+  if (cpu_info(kSSE4_1)) return WEBP_SIMD_SSE4_1;
+  if (cpu_info(kSSE2) || cpu_info(kNEON) || cpu_info(kMIPS32) ||
+      cpu_info(kMIPSdspR2) || cpu_info(kMSA) || cpu_info(kVSX)) {
+    return WEBP_SIMD_SSE2;
+  }
+  return WEBP_SIMD_NONE;
+}
+#endif  // !WEBP_CPU_OMIT_SIMD_LEVEL_API
+
+//------------------------------------------------------------------------------
+// Implementations bound by each dsp init function.
+
+#if !defined(WEBP_CPU_OMIT_SIMD_LEVEL_API)
+static const char* const kDspGroupNames[kDspNumGroups] = {
+  "WebPInitAlphaProcessing", "WebPInitConvertARGBToYUV", "VP8DspInit",
+  "VP8EncDspInit", "VP8EncDspCostInit", "VP8FiltersInit", "VP8LDspInit",
+  "VP8LEncDspInit", "WebPRescalerDspInit", "WebPInitSamplers",
+  "VP8SSIMDspInit", "WebPInitUpsamplers", "WebPInitYUV444Converters"
+};
+
+// -1 until the init function has run. Written under the lock of the init
+// function, the reads are not synchronized with it.
+static volatile int dsp_group_levels[kDspNumGroups] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+void WebPDspInitDone(WebPDspGroup group, WebPSimdLevel level) {
+  dsp_group_levels[group] = (int)level;
+}
+
+const char* WebPGetDspGroupName(int index) {
+  return (index >= 0 && index < kDspNumGroups) ? kDspGroupNames[index] : NULL;
+}
+
+int WebPGetDspGroupSimdLevel(int index) {
+  return (index >= 0 && index < kDspNumGroups) ? dsp_group_levels[index] : -1;
+}
+#endif  // !WEBP_CPU_OMIT_SIMD_LEVEL_API
@@ -61,6 +61,11 @@
     (defined(_M_X64) || defined(_M_IX86))
 #define WEBP_MSC_AVX2  // Visual C++ AVX2 targets
 #endif
+
+#if defined(_MSC_VER) && _MSC_VER >= 1920 && \
+    (defined(_M_X64) || defined(_M_IX86))
+#define WEBP_MSC_AVX512  // Visual C++ AVX-512 (F, BW and VL) targets
+#endif
 #endif
 
 // WEBP_HAVE_* are used to indicate the presence of the instruction set in dsp
@@ -94,6 +99,17 @@
 #define WEBP_HAVE_AVX2
 #endif
 
+#if ((defined(__AVX512F__) && defined(__AVX512BW__) && \
+      defined(__AVX512VL__)) ||                             \
+     defined(WEBP_MSC_AVX512)) &&                           \
+    (!defined(HAVE_CONFIG_H) || defined(WEBP_HAVE_AVX512))
+#define WEBP_USE_AVX512
+#endif
+
+#if defined(WEBP_USE_AVX512) && !defined(WEBP_HAVE_AVX512)
+#define WEBP_HAVE_AVX512
+#endif
+
 #if defined(WEBP_MSC_AVX2) && _MSC_VER <= 1900
 #include <immintrin.h>
 
@@ -105,6 +121,7 @@ static WEBP_INLINE int _mm256_cvtsi256_si32(__m256i a) {
 }
 #endif
 
+#undef WEBP_MSC_AVX512
 #undef WEBP_MSC_AVX2
 #undef WEBP_MSC_SSE41
 #undef WEBP_MSC_SSE2
@@ -319,6 +336,7 @@ typedef enum {
   kSSE4_1,
   kAVX,
   kAVX2,
+  kAVX512,  // AVX-512 F, BW and VL
   kNEON,
   kMIPS32,
   kMIPSdspR2,
@@ -329,4 +347,27 @@ typedef enum {
 // returns true if the CPU supports the feature.
 typedef int (*VP8CPUInfo)(CPUFeature feature);
 
+// Groups of function pointers, each set up by one dsp init function.
+typedef enum {
+  kDspAlphaProcessing,   // WebPInitAlphaProcessing()
+  kDspConvertARGBToYUV,  // WebPInitConvertARGBToYUV()
+  kDspDec,               // VP8DspInit()
+  kDspEnc,               // VP8EncDspInit()
+  kDspEncCost,           // VP8EncDspCostInit()
+  kDspFilters,           // VP8FiltersInit()
+  kDspLossless,          // VP8LDspInit()
+  kDspLosslessEnc,       // VP8LEncDspInit()
+  kDspRescaler,          // WebPRescalerDspInit()
+  kDspSamplers,          // WebPInitSamplers()
+  kDspSSIM,              // VP8SSIMDspInit()
+  kDspUpsamplers,        // WebPInitUpsamplers()
+  kDspYUV444Converters,  // WebPInitYUV444Converters()
+  kDspNumGroups
+} WebPDspGroup;
+
+// Records the highest SIMD level of the implementations bound by the init
+// function of 'group', for WebPGetDspGroupSimdLevel(). NEON, MIPS and VSX
+// implementations are reported as WEBP_SIMD_SSE2.
+void WebPDspInitDone(WebPDspGroup group, WebPSimdLevel level);
+
 #endif  // WEBP_DSP_CPU_H_
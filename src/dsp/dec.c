@@ -746,12 +746,15 @@ void (*VP8DitherCombine8x8)(const uint8_t* WEBP_RESTRICT dither,
 extern VP8CPUInfo VP8GetCPUInfo;
 extern void VP8DspInitSSE2(void);
 extern void VP8DspInitSSE41(void);
+extern void VP8DspInitAVX2(void);
 extern void VP8DspInitNEON(void);
 extern void VP8DspInitMIPS32(void);
 extern void VP8DspInitMIPSdspR2(void);
 extern void VP8DspInitMSA(void);
 
 WEBP_DSP_INIT_FUNC(VP8DspInit) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
   VP8InitClipTables();
 
 #if !WEBP_NEON_OMIT_C_CODE
@@ -820,9 +823,17 @@ WEBP_DSP_INIT_FUNC(VP8DspInit) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       VP8DspInitSSE2();
+      level = WEBP_SIMD_SSE2;
 #if defined(WEBP_HAVE_SSE41)
       if (VP8GetCPUInfo(kSSE4_1)) {
         VP8DspInitSSE41();
+        level = WEBP_SIMD_SSE4_1;
+#if defined(WEBP_HAVE_AVX2)
+        if (VP8GetCPUInfo(kAVX2)) {
+          VP8DspInitAVX2();
+          level = WEBP_SIMD_AVX2;
+        }
+#endif
       }
 #endif
     }
@@ -830,16 +841,19 @@ WEBP_DSP_INIT_FUNC(VP8DspInit) {
 #if defined(WEBP_USE_MIPS32)
     if (VP8GetCPUInfo(kMIPS32)) {
       VP8DspInitMIPS32();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       VP8DspInitMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MSA)
     if (VP8GetCPUInfo(kMSA)) {
       VP8DspInitMSA();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
@@ -848,6 +862,7 @@ WEBP_DSP_INIT_FUNC(VP8DspInit) {
   if (WEBP_NEON_OMIT_C_CODE ||
       (VP8GetCPUInfo != NULL && VP8GetCPUInfo(kNEON))) {
     VP8DspInitNEON();
+    level = WEBP_SIMD_SSE2;
   }
 #endif
 
@@ -894,4 +909,5 @@ WEBP_DSP_INIT_FUNC(VP8DspInit) {
   assert(VP8PredChroma8[5] != NULL);
   assert(VP8PredChroma8[6] != NULL);
   assert(VP8DitherCombine8x8 != NULL);
+  WebPDspInitDone(kDspDec, level);
 }
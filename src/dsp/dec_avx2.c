@@ -0,0 +1,181 @@
+// Copyright 2025 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 version of some decoding functions.
+// The results are bit-exact with the SSE2 versions.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_AVX2)
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#include "src/dec/vp8i_dec.h"
+#include "src/dsp/cpu.h"
+#include "src/utils/utils.h"
+#include "src/webp/types.h"
+
+// Returns the 256-bit register made of 'lo' and 'hi'.
+static WEBP_INLINE __m256i Set128x2_AVX2(const __m128i lo, const __m128i hi) {
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+//------------------------------------------------------------------------------
+// Transforms (Paragraph 14.4)
+
+// One pass of the inverse transform, for one block in each lane.
+// Each lane of 'in02' holds the rows in0 | in2 of its block, 'in13' holds
+// in1 | in3. On output, 'out01' holds tmp0 | tmp1 and 'out32' tmp3 | tmp2.
+// See Transform_SSE2() for the multiplication trick with k1 and k2.
+static WEBP_INLINE void ITransformPass_AVX2(const __m256i* const in02,
+                                            const __m256i* const in13,
+                                            __m256i* const out01,
+                                            __m256i* const out32) {
+  const __m256i k1 = _mm256_set1_epi16(20091);
+  const __m256i k2 = _mm256_set1_epi16(-30068);
+  // +1 for the low half of each lane, -1 for the high half
+  const __m256i kSign = _mm256_set_epi16(-1, -1, -1, -1, 1, 1, 1, 1,
+                                         -1, -1, -1, -1, 1, 1, 1, 1);
+  // a = in0 + in2 | b = in0 - in2
+  const __m256i in20 = _mm256_shuffle_epi32(*in02, _MM_SHUFFLE(1, 0, 3, 2));
+  const __m256i ab = _mm256_add_epi16(in20, _mm256_sign_epi16(*in02, kSign));
+  // MUL(in1, K2) | MUL(in3, K2) and MUL(in1, K1) | MUL(in3, K1)
+  const __m256i m2 = _mm256_add_epi16(_mm256_mulhi_epi16(*in13, k2), *in13);
+  const __m256i m1 = _mm256_add_epi16(_mm256_mulhi_epi16(*in13, k1), *in13);
+  // c = MUL(in1, K2) - MUL(in3, K1) | d = MUL(in1, K1) + MUL(in3, K2)
+  const __m256i c0d0 = _mm256_unpacklo_epi64(m2, m1);
+  const __m256i c1d1 = _mm256_unpackhi_epi64(m1, m2);
+  const __m256i cd = _mm256_sub_epi16(c0d0, _mm256_sign_epi16(c1d1, kSign));
+  const __m256i dc = _mm256_shuffle_epi32(cd, _MM_SHUFFLE(1, 0, 3, 2));
+  *out01 = _mm256_add_epi16(ab, dc);  // a + d | b + c
+  *out32 = _mm256_sub_epi16(ab, dc);  // a - d | b - c
+}
+
+// Transposes the 4x4 block of each lane given as tmp0 | tmp1 and tmp3 | tmp2,
+// returning its rows as 0 | 2 and 1 | 3.
+static WEBP_INLINE void Transpose4x4_AVX2(const __m256i* const in01,
+                                          const __m256i* const in32,
+                                          __m256i* const out02,
+                                          __m256i* const out13) {
+  const __m256i in23 = _mm256_shuffle_epi32(*in32, _MM_SHUFFLE(1, 0, 3, 2));
+  // 00 20 01 21 02 22 03 23 and 10 30 11 31 12 32 13 33
+  const __m256i t02 = _mm256_unpacklo_epi16(*in01, in23);
+  const __m256i t13 = _mm256_unpackhi_epi16(*in01, in23);
+  // 00 10 20 30 01 11 21 31 and 02 12 22 32 03 13 23 33
+  const __m256i r01 = _mm256_unpacklo_epi16(t02, t13);
+  const __m256i r23 = _mm256_unpackhi_epi16(t02, t13);
+  *out02 = _mm256_unpacklo_epi64(r01, r23);
+  *out13 = _mm256_unpackhi_epi64(r01, r23);
+}
+
+static void Transform_AVX2(const int16_t* WEBP_RESTRICT in,
+                           uint8_t* WEBP_RESTRICT dst, int do_two) {
+  __m256i in02, in13, T02, T13;
+
+  // Load the coefficients with one block per lane. In the case of only one
+  // transform, the second lane is a copy of the first one that is not stored.
+  {
+    const __m128i A01 = _mm_loadu_si128((const __m128i*)&in[0]);
+    const __m128i A23 = _mm_loadu_si128((const __m128i*)&in[8]);
+    const __m128i B01 =
+        do_two ? _mm_loadu_si128((const __m128i*)&in[16]) : A01;
+    const __m128i B23 =
+        do_two ? _mm_loadu_si128((const __m128i*)&in[24]) : A23;
+    const __m256i in01 = Set128x2_AVX2(A01, B01);
+    const __m256i in23 = Set128x2_AVX2(A23, B23);
+    in02 = _mm256_unpacklo_epi64(in01, in23);
+    in13 = _mm256_unpackhi_epi64(in01, in23);
+  }
+
+  // Vertical pass and subsequent transpose.
+  {
+    __m256i tmp01, tmp32;
+    ITransformPass_AVX2(&in02, &in13, &tmp01, &tmp32);
+    Transpose4x4_AVX2(&tmp01, &tmp32, &T02, &T13);
+  }
+
+  // Horizontal pass and subsequent transpose.
+  {
+    // Add the rounder to T0 (first half of each lane).
+    const __m256i four = _mm256_set_epi16(0, 0, 0, 0, 4, 4, 4, 4,
+                                          0, 0, 0, 0, 4, 4, 4, 4);
+    const __m256i dc = _mm256_add_epi16(T02, four);
+    __m256i tmp01, tmp32;
+    ITransformPass_AVX2(&dc, &T13, &tmp01, &tmp32);
+    tmp01 = _mm256_srai_epi16(tmp01, 3);
+    tmp32 = _mm256_srai_epi16(tmp32, 3);
+    Transpose4x4_AVX2(&tmp01, &tmp32, &T02, &T13);
+  }
+
+  // Add inverse transform to 'dst' and store.
+  {
+    // Rows 0 | 1 and 2 | 3 of each block.
+    const __m256i T01 = _mm256_unpacklo_epi64(T02, T13);
+    const __m256i T23 = _mm256_unpackhi_epi64(T02, T13);
+    __m128i dst01, dst23;
+    __m256i res01, res23, res;
+    if (do_two) {
+      // Load eight bytes/pixels per line and regroup them per block.
+      const __m128i d0 = _mm_loadl_epi64((__m128i*)(dst + 0 * BPS));
+      const __m128i d1 = _mm_loadl_epi64((__m128i*)(dst + 1 * BPS));
+      const __m128i d2 = _mm_loadl_epi64((__m128i*)(dst + 2 * BPS));
+      const __m128i d3 = _mm_loadl_epi64((__m128i*)(dst + 3 * BPS));
+      // a0 a1 b0 b1 and a2 a3 b2 b3 (four bytes each)
+      dst01 = _mm_unpacklo_epi32(d0, d1);
+      dst23 = _mm_unpacklo_epi32(d2, d3);
+    } else {
+      // Load four bytes/pixels per line.
+      dst01 = _mm_unpacklo_epi32(
+          _mm_cvtsi32_si128(WebPMemToInt32(dst + 0 * BPS)),
+          _mm_cvtsi32_si128(WebPMemToInt32(dst + 1 * BPS)));
+      dst23 = _mm_unpacklo_epi32(
+          _mm_cvtsi32_si128(WebPMemToInt32(dst + 2 * BPS)),
+          _mm_cvtsi32_si128(WebPMemToInt32(dst + 3 * BPS)));
+    }
+    // Convert to 16b and add the inverse transform(s).
+    res01 = _mm256_add_epi16(_mm256_cvtepu8_epi16(dst01), T01);
+    res23 = _mm256_add_epi16(_mm256_cvtepu8_epi16(dst23), T23);
+    // Unsigned saturate to 8b: rows 0 1 2 3 of each block, one per lane.
+    res = _mm256_packus_epi16(res01, res23);
+    // Store the results.
+    if (do_two) {
+      // Store eight bytes/pixels per line.
+      const __m128i A = _mm256_castsi256_si128(res);
+      const __m128i B = _mm256_extracti128_si256(res, 1);
+      const __m128i AB01 = _mm_unpacklo_epi32(A, B);
+      const __m128i AB23 = _mm_unpackhi_epi32(A, B);
+      _mm_storel_epi64((__m128i*)(dst + 0 * BPS), AB01);
+      _mm_storeh_pd((double*)(dst + 1 * BPS), _mm_castsi128_pd(AB01));
+      _mm_storel_epi64((__m128i*)(dst + 2 * BPS), AB23);
+      _mm_storeh_pd((double*)(dst + 3 * BPS), _mm_castsi128_pd(AB23));
+    } else {
+      // Store four bytes/pixels per line.
+      const __m128i A = _mm256_castsi256_si128(res);
+      WebPInt32ToMem(dst + 0 * BPS, _mm_cvtsi128_si32(A));
+      WebPInt32ToMem(dst + 1 * BPS, _mm_extract_epi32(A, 1));
+      WebPInt32ToMem(dst + 2 * BPS, _mm_extract_epi32(A, 2));
+      WebPInt32ToMem(dst + 3 * BPS, _mm_extract_epi32(A, 3));
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8DspInitAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void VP8DspInitAVX2(void) {
+  VP8Transform = Transform_AVX2;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(VP8DspInitAVX2)
+
+#endif  // WEBP_USE_AVX2
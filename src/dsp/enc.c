@@ -765,12 +765,15 @@ VP8BlockCopy VP8Copy16x8;
 extern VP8CPUInfo VP8GetCPUInfo;
 extern void VP8EncDspInitSSE2(void);
 extern void VP8EncDspInitSSE41(void);
+extern void VP8EncDspInitAVX2(void);
 extern void VP8EncDspInitNEON(void);
 extern void VP8EncDspInitMIPS32(void);
 extern void VP8EncDspInitMIPSdspR2(void);
 extern void VP8EncDspInitMSA(void);
 
 WEBP_DSP_INIT_FUNC(VP8EncDspInit) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
   VP8DspInit();  // common inverse transforms
   InitTables();
 
@@ -812,9 +815,17 @@ WEBP_DSP_INIT_FUNC(VP8EncDspInit) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       VP8EncDspInitSSE2();
+      level = WEBP_SIMD_SSE2;
 #if defined(WEBP_HAVE_SSE41)
       if (VP8GetCPUInfo(kSSE4_1)) {
         VP8EncDspInitSSE41();
+        level = WEBP_SIMD_SSE4_1;
+#if defined(WEBP_HAVE_AVX2)
+        if (VP8GetCPUInfo(kAVX2)) {
+          VP8EncDspInitAVX2();
+          level = WEBP_SIMD_AVX2;
+        }
+#endif
       }
 #endif
     }
@@ -822,16 +833,19 @@ WEBP_DSP_INIT_FUNC(VP8EncDspInit) {
 #if defined(WEBP_USE_MIPS32)
     if (VP8GetCPUInfo(kMIPS32)) {
       VP8EncDspInitMIPS32();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       VP8EncDspInitMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MSA)
     if (VP8GetCPUInfo(kMSA)) {
       VP8EncDspInitMSA();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
@@ -840,6 +854,7 @@ WEBP_DSP_INIT_FUNC(VP8EncDspInit) {
   if (WEBP_NEON_OMIT_C_CODE ||
       (VP8GetCPUInfo != NULL && VP8GetCPUInfo(kNEON))) {
     VP8EncDspInitNEON();
+    level = WEBP_SIMD_SSE2;
   }
 #endif
 
@@ -863,4 +878,5 @@ WEBP_DSP_INIT_FUNC(VP8EncDspInit) {
   assert(VP8EncQuantizeBlockWHT != NULL);
   assert(VP8Copy4x4 != NULL);
   assert(VP8Copy16x8 != NULL);
+  WebPDspInitDone(kDspEnc, level);
 }
@@ -0,0 +1,551 @@
+// Copyright 2025 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 version of some encoding functions.
+// Each 128-bit lane usually holds one 4x4 block, so that two blocks are
+// processed at once with the same operations as the SSE2 / SSE4.1 versions.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_AVX2)
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <stdlib.h>  // for abs()
+
+#include "src/dsp/cpu.h"
+#include "src/enc/vp8i_enc.h"
+#include "src/webp/types.h"
+
+// Returns the 256-bit register made of 'lo' and 'hi'.
+static WEBP_INLINE __m256i Set128x2_AVX2(const __m128i lo, const __m128i hi) {
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+//------------------------------------------------------------------------------
+// Transforms
+
+// Same as FTransformPass1_SSE2(), for one block in each lane.
+static WEBP_INLINE void FTransformPass1_AVX2(const __m256i* const in01,
+                                             const __m256i* const in23,
+                                             __m256i* const out01,
+                                             __m256i* const out32) {
+  const __m256i k937 = _mm256_set1_epi32(937);
+  const __m256i k1812 = _mm256_set1_epi32(1812);
+  const __m256i k88p = _mm256_set1_epi16(8);
+  const __m256i k88m = _mm256_set1_epi32((int)(((uint32_t)-8 << 16) | 8));
+  const __m256i k5352_2217p = _mm256_set1_epi32((2217 << 16) | 5352);
+  const __m256i k5352_2217m =
+      _mm256_set1_epi32((int)(((uint32_t)-5352 << 16) | 2217));
+
+  // *in01 = 00 01 10 11 02 03 12 13
+  // *in23 = 20 21 30 31 22 23 32 33
+  const __m256i shuf01_p =
+      _mm256_shufflehi_epi16(*in01, _MM_SHUFFLE(2, 3, 0, 1));
+  const __m256i shuf23_p =
+      _mm256_shufflehi_epi16(*in23, _MM_SHUFFLE(2, 3, 0, 1));
+  // 00 01 10 11 03 02 13 12
+  // 20 21 30 31 23 22 33 32
+  const __m256i s01 = _mm256_unpacklo_epi64(shuf01_p, shuf23_p);
+  const __m256i s32 = _mm256_unpackhi_epi64(shuf01_p, shuf23_p);
+  // 00 01 10 11 20 21 30 31
+  // 03 02 13 12 23 22 33 32
+  const __m256i a01 = _mm256_add_epi16(s01, s32);
+  const __m256i a32 = _mm256_sub_epi16(s01, s32);
+  // [d0 + d3 | d1 + d2 | ...] = [a0 a1 | a0' a1' | ... ]
+  // [d0 - d3 | d1 - d2 | ...] = [a3 a2 | a3' a2' | ... ]
+
+  const __m256i tmp0 = _mm256_madd_epi16(a01, k88p);  // [ (a0 + a1) << 3, ... ]
+  const __m256i tmp2 = _mm256_madd_epi16(a01, k88m);  // [ (a0 - a1) << 3, ... ]
+  const __m256i tmp1_1 = _mm256_madd_epi16(a32, k5352_2217p);
+  const __m256i tmp3_1 = _mm256_madd_epi16(a32, k5352_2217m);
+  const __m256i tmp1_2 = _mm256_add_epi32(tmp1_1, k1812);
+  const __m256i tmp3_2 = _mm256_add_epi32(tmp3_1, k937);
+  const __m256i tmp1 = _mm256_srai_epi32(tmp1_2, 9);
+  const __m256i tmp3 = _mm256_srai_epi32(tmp3_2, 9);
+  const __m256i s03 = _mm256_packs_epi32(tmp0, tmp2);
+  const __m256i s12 = _mm256_packs_epi32(tmp1, tmp3);
+  const __m256i s_lo = _mm256_unpacklo_epi16(s03, s12);  // 0 1 0 1 0 1...
+  const __m256i s_hi = _mm256_unpackhi_epi16(s03, s12);  // 2 3 2 3 2 3
+  const __m256i v23 = _mm256_unpackhi_epi32(s_lo, s_hi);
+  *out01 = _mm256_unpacklo_epi32(s_lo, s_hi);
+  *out32 = _mm256_shuffle_epi32(v23, _MM_SHUFFLE(1, 0, 3, 2));  // 3 2 3 2 3 2..
+}
+
+// Same as FTransformPass2_SSE2(), for one block in each lane. The first 8
+// coefficients of each block are returned in 'out_lo', the last ones in
+// 'out_hi'.
+static WEBP_INLINE void FTransformPass2_AVX2(const __m256i* const v01,
+                                             const __m256i* const v32,
+                                             __m256i* const out_lo,
+                                             __m256i* const out_hi) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i seven = _mm256_set1_epi16(7);
+  const __m256i k5352_2217 = _mm256_set1_epi32((5352 << 16) | 2217);
+  const __m256i k2217_5352 =
+      _mm256_set1_epi32((int)((2217u << 16) | (uint16_t)-5352));
+  const __m256i k12000_plus_one = _mm256_set1_epi32(12000 + (1 << 16));
+  const __m256i k51000 = _mm256_set1_epi32(51000);
+
+  // Same operations are done on the (0,3) and (1,2) pairs.
+  // a3 = v0 - v3
+  // a2 = v1 - v2
+  const __m256i a32 = _mm256_sub_epi16(*v01, *v32);
+  const __m256i a22 = _mm256_unpackhi_epi64(a32, a32);
+
+  const __m256i b23 = _mm256_unpacklo_epi16(a22, a32);
+  const __m256i c1 = _mm256_madd_epi16(b23, k5352_2217);
+  const __m256i c3 = _mm256_madd_epi16(b23, k2217_5352);
+  const __m256i d1 = _mm256_add_epi32(c1, k12000_plus_one);
+  const __m256i d3 = _mm256_add_epi32(c3, k51000);
+  const __m256i e1 = _mm256_srai_epi32(d1, 16);
+  const __m256i e3 = _mm256_srai_epi32(d3, 16);
+  // f1 = ((b3 * 5352 + b2 * 2217 + 12000) >> 16)
+  // f3 = ((b3 * 2217 - b2 * 5352 + 51000) >> 16)
+  const __m256i f1 = _mm256_packs_epi32(e1, e1);
+  const __m256i f3 = _mm256_packs_epi32(e3, e3);
+  // g1 = f1 + (a3 != 0), computed as f1 + 1 - (a3 == 0).
+  const __m256i g1 = _mm256_add_epi16(f1, _mm256_cmpeq_epi16(a32, zero));
+
+  // a0 = v0 + v3
+  // a1 = v1 + v2
+  const __m256i a01 = _mm256_add_epi16(*v01, *v32);
+  const __m256i a01_plus_7 = _mm256_add_epi16(a01, seven);
+  const __m256i a11 = _mm256_unpackhi_epi64(a01, a01);
+  const __m256i c0 = _mm256_add_epi16(a01_plus_7, a11);
+  const __m256i c2 = _mm256_sub_epi16(a01_plus_7, a11);
+  // d0 = (a0 + a1 + 7) >> 4;
+  // d2 = (a0 - a1 + 7) >> 4;
+  const __m256i d0 = _mm256_srai_epi16(c0, 4);
+  const __m256i d2 = _mm256_srai_epi16(c2, 4);
+
+  *out_lo = _mm256_unpacklo_epi64(d0, g1);
+  *out_hi = _mm256_unpacklo_epi64(d2, f3);
+}
+
+// Computes the transforms of the two horizontally adjacent 4x4 blocks at
+// 'src' / 'ref'. The coefficients of the first block are returned in 'out0',
+// the ones of the second block in 'out1'.
+static WEBP_INLINE void FTransform2Regs_AVX2(const uint8_t* WEBP_RESTRICT src,
+                                             const uint8_t* WEBP_RESTRICT ref,
+                                             __m256i* const out0,
+                                             __m256i* const out1) {
+  const __m128i zero = _mm_setzero_si128();
+
+  // Load src and convert to 16b.
+  const __m128i src0 = _mm_loadl_epi64((const __m128i*)&src[0 * BPS]);
+  const __m128i src1 = _mm_loadl_epi64((const __m128i*)&src[1 * BPS]);
+  const __m128i src2 = _mm_loadl_epi64((const __m128i*)&src[2 * BPS]);
+  const __m128i src3 = _mm_loadl_epi64((const __m128i*)&src[3 * BPS]);
+  const __m128i src_0 = _mm_unpacklo_epi8(src0, zero);
+  const __m128i src_1 = _mm_unpacklo_epi8(src1, zero);
+  const __m128i src_2 = _mm_unpacklo_epi8(src2, zero);
+  const __m128i src_3 = _mm_unpacklo_epi8(src3, zero);
+  // Load ref and convert to 16b.
+  const __m128i ref0 = _mm_loadl_epi64((const __m128i*)&ref[0 * BPS]);
+  const __m128i ref1 = _mm_loadl_epi64((const __m128i*)&ref[1 * BPS]);
+  const __m128i ref2 = _mm_loadl_epi64((const __m128i*)&ref[2 * BPS]);
+  const __m128i ref3 = _mm_loadl_epi64((const __m128i*)&ref[3 * BPS]);
+  const __m128i ref_0 = _mm_unpacklo_epi8(ref0, zero);
+  const __m128i ref_1 = _mm_unpacklo_epi8(ref1, zero);
+  const __m128i ref_2 = _mm_unpacklo_epi8(ref2, zero);
+  const __m128i ref_3 = _mm_unpacklo_epi8(ref3, zero);
+  // Compute difference. -> 00 01 02 03  00' 01' 02' 03'
+  const __m128i diff0 = _mm_sub_epi16(src_0, ref_0);
+  const __m128i diff1 = _mm_sub_epi16(src_1, ref_1);
+  const __m128i diff2 = _mm_sub_epi16(src_2, ref_2);
+  const __m128i diff3 = _mm_sub_epi16(src_3, ref_3);
+
+  // Unpack and shuffle, with the first block in the low lane.
+  // 00 01 10 11 02 03 12 13 | 00' 01' 10' 11' 02' 03' 12' 13'
+  // 20 21 30 31 22 23 32 33 | 20' 21' 30' 31' 22' 23' 32' 33'
+  const __m256i shuf01 = Set128x2_AVX2(_mm_unpacklo_epi32(diff0, diff1),
+                                       _mm_unpackhi_epi32(diff0, diff1));
+  const __m256i shuf23 = Set128x2_AVX2(_mm_unpacklo_epi32(diff2, diff3),
+                                       _mm_unpackhi_epi32(diff2, diff3));
+  __m256i v01, v32, out_lo, out_hi;
+
+  FTransformPass1_AVX2(&shuf01, &shuf23, &v01, &v32);
+  FTransformPass2_AVX2(&v01, &v32, &out_lo, &out_hi);
+  *out0 = _mm256_permute2x128_si256(out_lo, out_hi, 0x20);
+  *out1 = _mm256_permute2x128_si256(out_lo, out_hi, 0x31);
+}
+
+static void FTransform2_AVX2(const uint8_t* WEBP_RESTRICT src,
+                             const uint8_t* WEBP_RESTRICT ref,
+                             int16_t* WEBP_RESTRICT out) {
+  __m256i out0, out1;
+  FTransform2Regs_AVX2(src, ref, &out0, &out1);
+  _mm256_storeu_si256((__m256i*)&out[0], out0);
+  _mm256_storeu_si256((__m256i*)&out[16], out1);
+}
+
+//------------------------------------------------------------------------------
+// Compute susceptibility based on DCT-coeff histograms.
+// The blocks are transformed two by two: consecutive blocks of VP8DspScan[]
+// starting at an even index are horizontally adjacent.
+
+static void CollectHistogram_AVX2(const uint8_t* WEBP_RESTRICT ref,
+                                  const uint8_t* WEBP_RESTRICT pred,
+                                  int start_block, int end_block,
+                                  VP8Histogram* WEBP_RESTRICT const histo) {
+  const __m256i max_coeff_thresh = _mm256_set1_epi16(MAX_COEFF_THRESH);
+  int j;
+  int distribution[MAX_COEFF_THRESH + 1] = {0};
+  for (j = start_block; j < end_block;) {
+    int16_t out[32];
+    int k;
+
+    if (j + 1 < end_block && !(j & 1)) {
+      __m256i out0, out1;
+      FTransform2Regs_AVX2(ref + VP8DspScan[j], pred + VP8DspScan[j], &out0,
+                           &out1);
+      // bin = min(abs(out) >> 3, MAX_COEFF_THRESH)
+      out0 = _mm256_srai_epi16(_mm256_abs_epi16(out0), 3);
+      out1 = _mm256_srai_epi16(_mm256_abs_epi16(out1), 3);
+      out0 = _mm256_min_epi16(out0, max_coeff_thresh);
+      out1 = _mm256_min_epi16(out1, max_coeff_thresh);
+      _mm256_storeu_si256((__m256i*)&out[0], out0);
+      _mm256_storeu_si256((__m256i*)&out[16], out1);
+      for (k = 0; k < 32; ++k) {
+        ++distribution[out[k]];
+      }
+      j += 2;
+    } else {  // single block
+      VP8FTransform(ref + VP8DspScan[j], pred + VP8DspScan[j], out);
+      for (k = 0; k < 16; ++k) {
+        const int v = abs(out[k]) >> 3;
+        const int clipped_value = (v > MAX_COEFF_THRESH) ? MAX_COEFF_THRESH : v;
+        ++distribution[clipped_value];
+      }
+      j += 1;
+    }
+  }
+  VP8SetHistogramData(distribution, histo);
+}
+
+//------------------------------------------------------------------------------
+// Metric
+
+// Adds the squared differences of the samples of 'a' and 'b' to 'sum'.
+static WEBP_INLINE void SubtractAndAccumulate_AVX2(const __m256i a,
+                                                   const __m256i b,
+                                                   __m256i* const sum) {
+  // take abs(a-b) in 8b
+  const __m256i a_b = _mm256_subs_epu8(a, b);
+  const __m256i b_a = _mm256_subs_epu8(b, a);
+  const __m256i abs_a_b = _mm256_or_si256(a_b, b_a);
+  // zero-extend to 16b
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i C0 = _mm256_unpacklo_epi8(abs_a_b, zero);
+  const __m256i C1 = _mm256_unpackhi_epi8(abs_a_b, zero);
+  // multiply with self
+  const __m256i sum1 = _mm256_madd_epi16(C0, C0);
+  const __m256i sum2 = _mm256_madd_epi16(C1, C1);
+  *sum = _mm256_add_epi32(*sum, _mm256_add_epi32(sum1, sum2));
+}
+
+#define LOAD_2x16(ptr) \
+  Set128x2_AVX2(_mm_loadu_si128((const __m128i*)&(ptr)[0 * BPS]), \
+                _mm_loadu_si128((const __m128i*)&(ptr)[1 * BPS]))
+
+static WEBP_INLINE int SSE_16xN_AVX2(const uint8_t* WEBP_RESTRICT a,
+                                     const uint8_t* WEBP_RESTRICT b,
+                                     int num_quads) {
+  __m256i sum = _mm256_setzero_si256();
+  __m128i sum128;
+  int i;
+
+  for (i = 0; i < num_quads; ++i) {
+    SubtractAndAccumulate_AVX2(LOAD_2x16(a), LOAD_2x16(b), &sum);
+    SubtractAndAccumulate_AVX2(LOAD_2x16(a + 2 * BPS), LOAD_2x16(b + 2 * BPS),
+                               &sum);
+    a += 4 * BPS;
+    b += 4 * BPS;
+  }
+  sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                         _mm256_extracti128_si256(sum, 1));
+  sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4e));
+  sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xb1));
+  return _mm_cvtsi128_si32(sum128);
+}
+
+#undef LOAD_2x16
+
+static int SSE16x16_AVX2(const uint8_t* WEBP_RESTRICT a,
+                         const uint8_t* WEBP_RESTRICT b) {
+  return SSE_16xN_AVX2(a, b, 4);
+}
+
+static int SSE16x8_AVX2(const uint8_t* WEBP_RESTRICT a,
+                        const uint8_t* WEBP_RESTRICT b) {
+  return SSE_16xN_AVX2(a, b, 2);
+}
+
+//------------------------------------------------------------------------------
+// Texture distortion
+//
+// We try to match the spectral content (weighted) between source and
+// reconstructed samples.
+
+// Same as TTransform_SSE41() for the two horizontally adjacent 4x4 blocks at
+// 'inA' / 'inB': the low lane holds the first block of 'inA' and 'inB', the
+// high lane the second one. Returns the sum of the absolute values of the two
+// weighted differences.
+static int TTransform2_AVX2(const uint8_t* inA, const uint8_t* inB,
+                            const uint16_t* const w) {
+  __m256i tmp_0, tmp_1, tmp_2, tmp_3;
+
+  // Load and combine inputs.
+  {
+    const __m128i inA_0 = _mm_loadl_epi64((const __m128i*)&inA[BPS * 0]);
+    const __m128i inA_1 = _mm_loadl_epi64((const __m128i*)&inA[BPS * 1]);
+    const __m128i inA_2 = _mm_loadl_epi64((const __m128i*)&inA[BPS * 2]);
+    const __m128i inA_3 = _mm_loadl_epi64((const __m128i*)&inA[BPS * 3]);
+    const __m128i inB_0 = _mm_loadl_epi64((const __m128i*)&inB[BPS * 0]);
+    const __m128i inB_1 = _mm_loadl_epi64((const __m128i*)&inB[BPS * 1]);
+    const __m128i inB_2 = _mm_loadl_epi64((const __m128i*)&inB[BPS * 2]);
+    const __m128i inB_3 = _mm_loadl_epi64((const __m128i*)&inB[BPS * 3]);
+
+    // Combine inA and inB (we'll do four transforms in parallel).
+    tmp_0 = _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(inA_0, inB_0));
+    tmp_1 = _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(inA_1, inB_1));
+    tmp_2 = _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(inA_2, inB_2));
+    tmp_3 = _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(inA_3, inB_3));
+    // a00 a01 a02 a03   b00 b01 b02 b03 | a04 a05 a06 a07   b04 b05 b06 b07
+    // a10 a11 a12 a13   b10 b11 b12 b13 | a14 a15 a16 a17   b14 b15 b16 b17
+    // a20 a21 a22 a23   b20 b21 b22 b23 | a24 a25 a26 a27   b24 b25 b26 b27
+    // a30 a31 a32 a33   b30 b31 b32 b33 | a34 a35 a36 a37   b34 b35 b36 b37
+  }
+
+  // Vertical pass first to avoid a transpose (vertical and horizontal passes
+  // are commutative because w/kWeightY is symmetric) and subsequent transpose.
+  {
+    const __m256i a0 = _mm256_add_epi16(tmp_0, tmp_2);
+    const __m256i a1 = _mm256_add_epi16(tmp_1, tmp_3);
+    const __m256i a2 = _mm256_sub_epi16(tmp_1, tmp_3);
+    const __m256i a3 = _mm256_sub_epi16(tmp_0, tmp_2);
+    const __m256i b0 = _mm256_add_epi16(a0, a1);
+    const __m256i b1 = _mm256_add_epi16(a3, a2);
+    const __m256i b2 = _mm256_sub_epi16(a3, a2);
+    const __m256i b3 = _mm256_sub_epi16(a0, a1);
+
+    // Transpose the 4x4 blocks of each lane (see VP8Transpose_2_4x4_16b()).
+    const __m256i transpose0_0 = _mm256_unpacklo_epi16(b0, b1);
+    const __m256i transpose0_1 = _mm256_unpacklo_epi16(b2, b3);
+    const __m256i transpose0_2 = _mm256_unpackhi_epi16(b0, b1);
+    const __m256i transpose0_3 = _mm256_unpackhi_epi16(b2, b3);
+    const __m256i transpose1_0 =
+        _mm256_unpacklo_epi32(transpose0_0, transpose0_1);
+    const __m256i transpose1_1 =
+        _mm256_unpacklo_epi32(transpose0_2, transpose0_3);
+    const __m256i transpose1_2 =
+        _mm256_unpackhi_epi32(transpose0_0, transpose0_1);
+    const __m256i transpose1_3 =
+        _mm256_unpackhi_epi32(transpose0_2, transpose0_3);
+    tmp_0 = _mm256_unpacklo_epi64(transpose1_0, transpose1_1);
+    tmp_1 = _mm256_unpackhi_epi64(transpose1_0, transpose1_1);
+    tmp_2 = _mm256_unpacklo_epi64(transpose1_2, transpose1_3);
+    tmp_3 = _mm256_unpackhi_epi64(transpose1_2, transpose1_3);
+  }
+
+  // Horizontal pass and difference of weighted sums.
+  {
+    // Load all inputs.
+    const __m256i w_0 =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)&w[0]));
+    const __m256i w_8 =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)&w[8]));
+
+    const __m256i a0 = _mm256_add_epi16(tmp_0, tmp_2);
+    const __m256i a1 = _mm256_add_epi16(tmp_1, tmp_3);
+    const __m256i a2 = _mm256_sub_epi16(tmp_1, tmp_3);
+    const __m256i a3 = _mm256_sub_epi16(tmp_0, tmp_2);
+    const __m256i b0 = _mm256_add_epi16(a0, a1);
+    const __m256i b1 = _mm256_add_epi16(a3, a2);
+    const __m256i b2 = _mm256_sub_epi16(a3, a2);
+    const __m256i b3 = _mm256_sub_epi16(a0, a1);
+
+    // Separate the transforms of inA and inB.
+    __m256i A_b0 = _mm256_unpacklo_epi64(b0, b1);
+    __m256i A_b2 = _mm256_unpacklo_epi64(b2, b3);
+    __m256i B_b0 = _mm256_unpackhi_epi64(b0, b1);
+    __m256i B_b2 = _mm256_unpackhi_epi64(b2, b3);
+    __m128i diff;
+
+    A_b0 = _mm256_abs_epi16(A_b0);
+    A_b2 = _mm256_abs_epi16(A_b2);
+    B_b0 = _mm256_abs_epi16(B_b0);
+    B_b2 = _mm256_abs_epi16(B_b2);
+
+    // weighted sums
+    A_b0 = _mm256_madd_epi16(A_b0, w_0);
+    A_b2 = _mm256_madd_epi16(A_b2, w_8);
+    B_b0 = _mm256_madd_epi16(B_b0, w_0);
+    B_b2 = _mm256_madd_epi16(B_b2, w_8);
+    A_b0 = _mm256_add_epi32(A_b0, A_b2);
+    B_b0 = _mm256_add_epi32(B_b0, B_b2);
+
+    // difference of weighted sums, one per lane
+    A_b2 = _mm256_sub_epi32(A_b0, B_b0);
+    A_b2 = _mm256_hadd_epi32(A_b2, A_b2);
+    A_b2 = _mm256_hadd_epi32(A_b2, A_b2);
+    diff = _mm_unpacklo_epi32(_mm256_castsi256_si128(A_b2),
+                              _mm256_extracti128_si256(A_b2, 1));
+    diff = _mm_abs_epi32(diff);
+    return (_mm_cvtsi128_si32(diff) >> 5) +
+           (_mm_cvtsi128_si32(_mm_srli_si128(diff, 4)) >> 5);
+  }
+}
+
+static int Disto16x16_AVX2(const uint8_t* WEBP_RESTRICT const a,
+                           const uint8_t* WEBP_RESTRICT const b,
+                           const uint16_t* WEBP_RESTRICT const w) {
+  int D = 0;
+  int x, y;
+  for (y = 0; y < 16 * BPS; y += 4 * BPS) {
+    for (x = 0; x < 16; x += 8) {
+      D += TTransform2_AVX2(a + x + y, b + x + y, w);
+    }
+  }
+  return D;
+}
+
+//------------------------------------------------------------------------------
+// Quantization
+//
+
+// Generates a pshufb constant for shuffling 16b words, in both lanes.
+#define PSHUFB_CST(A, B, C, D, E, F, G, H, I, J, K, L, M, N, O, P)    \
+  _mm256_set_epi8(2 * (P) + 1, 2 * (P) + 0, 2 * (O) + 1, 2 * (O) + 0, \
+                  2 * (N) + 1, 2 * (N) + 0, 2 * (M) + 1, 2 * (M) + 0, \
+                  2 * (L) + 1, 2 * (L) + 0, 2 * (K) + 1, 2 * (K) + 0, \
+                  2 * (J) + 1, 2 * (J) + 0, 2 * (I) + 1, 2 * (I) + 0, \
+                  2 * (H) + 1, 2 * (H) + 0, 2 * (G) + 1, 2 * (G) + 0, \
+                  2 * (F) + 1, 2 * (F) + 0, 2 * (E) + 1, 2 * (E) + 0, \
+                  2 * (D) + 1, 2 * (D) + 0, 2 * (C) + 1, 2 * (C) + 0, \
+                  2 * (B) + 1, 2 * (B) + 0, 2 * (A) + 1, 2 * (A) + 0)
+
+// Same as DoQuantizeBlock_SSE41(), with the 16 coefficients of the block in a
+// single register.
+static WEBP_INLINE int DoQuantizeBlock_AVX2(int16_t in[16], int16_t out[16],
+                                            const uint16_t* const sharpen,
+                                            const VP8Matrix* const mtx) {
+  const __m256i max_coeff_2047 = _mm256_set1_epi16(MAX_LEVEL);
+  __m256i out0;
+
+  // Load all inputs.
+  __m256i in0 = _mm256_loadu_si256((__m256i*)&in[0]);
+  const __m256i iq = _mm256_loadu_si256((const __m256i*)&mtx->iq[0]);
+  const __m256i q = _mm256_loadu_si256((const __m256i*)&mtx->q[0]);
+
+  // coeff = abs(in)
+  __m256i coeff = _mm256_abs_epi16(in0);
+
+  // coeff = abs(in) + sharpen
+  if (sharpen != NULL) {
+    coeff = _mm256_add_epi16(
+        coeff, _mm256_loadu_si256((const __m256i*)&sharpen[0]));
+  }
+
+  // out = (coeff * iQ + B) >> QFIX
+  {
+    // doing calculations with 32b precision (QFIX=17)
+    // out = (coeff * iQ), with coefficients 0-3 | 8-11 in 'out_lo' and
+    // 4-7 | 12-15 in 'out_hi'
+    const __m256i coeff_iQH = _mm256_mulhi_epu16(coeff, iq);
+    const __m256i coeff_iQL = _mm256_mullo_epi16(coeff, iq);
+    __m256i out_lo = _mm256_unpacklo_epi16(coeff_iQL, coeff_iQH);
+    __m256i out_hi = _mm256_unpackhi_epi16(coeff_iQL, coeff_iQH);
+    // out = (coeff * iQ + B)
+    const __m256i bias_0 = _mm256_loadu_si256((const __m256i*)&mtx->bias[0]);
+    const __m256i bias_8 = _mm256_loadu_si256((const __m256i*)&mtx->bias[8]);
+    out_lo = _mm256_add_epi32(out_lo,
+                              _mm256_permute2x128_si256(bias_0, bias_8, 0x20));
+    out_hi = _mm256_add_epi32(out_hi,
+                              _mm256_permute2x128_si256(bias_0, bias_8, 0x31));
+    // out = QUANTDIV(coeff, iQ, B, QFIX)
+    out_lo = _mm256_srai_epi32(out_lo, QFIX);
+    out_hi = _mm256_srai_epi32(out_hi, QFIX);
+
+    // pack result as 16b, back in order
+    out0 = _mm256_packs_epi32(out_lo, out_hi);
+
+    // if (coeff > 2047) coeff = 2047
+    out0 = _mm256_min_epi16(out0, max_coeff_2047);
+  }
+
+  // put sign back
+  out0 = _mm256_sign_epi16(out0, in0);
+
+  // in = out * Q
+  in0 = _mm256_mullo_epi16(out0, q);
+  _mm256_storeu_si256((__m256i*)&in[0], in0);
+
+  // zigzag the output before storing it. The re-ordering is:
+  //    0 1 2 3 4 5 6 7 | 8  9 10 11 12 13 14 15
+  // -> 0 1 4[8]5 2 3 6 | 9 12 13 10 [7]11 14 15
+  // There's only two misplaced entries ([8] and [7]) that are crossing the
+  // lanes' boundary: they are picked from the register with swapped lanes.
+  {
+    const __m256i kCst = PSHUFB_CST(0, 1, 4, -1, 5, 2, 3, 6,  //
+                                    1, 4, 5, 2, -1, 3, 6, 7);
+    const __m256i kCst_78 = PSHUFB_CST(-1, -1, -1, 0, -1, -1, -1, -1,  //
+                                       -1, -1, -1, -1, 7, -1, -1, -1);
+    const __m256i swapped = _mm256_permute4x64_epi64(out0, 0x4e);
+    const __m256i tmp = _mm256_shuffle_epi8(out0, kCst);
+    const __m256i tmp_78 = _mm256_shuffle_epi8(swapped, kCst_78);
+    const __m256i out_z = _mm256_or_si256(tmp, tmp_78);
+    _mm256_storeu_si256((__m256i*)&out[0], out_z);
+    // detect if all 'out' values are zeroes or not
+    return !_mm256_testz_si256(out_z, out_z);
+  }
+}
+
+#undef PSHUFB_CST
+
+static int QuantizeBlock_AVX2(int16_t in[16], int16_t out[16],
+                              const VP8Matrix* WEBP_RESTRICT const mtx) {
+  return DoQuantizeBlock_AVX2(in, out, &mtx->sharpen[0], mtx);
+}
+
+static int QuantizeBlockWHT_AVX2(int16_t in[16], int16_t out[16],
+                                 const VP8Matrix* WEBP_RESTRICT const mtx) {
+  return DoQuantizeBlock_AVX2(in, out, NULL, mtx);
+}
+
+static int Quantize2Blocks_AVX2(int16_t in[32], int16_t out[32],
+                                const VP8Matrix* WEBP_RESTRICT const mtx) {
+  int nz;
+  const uint16_t* const sharpen = &mtx->sharpen[0];
+  nz = DoQuantizeBlock_AVX2(in + 0 * 16, out + 0 * 16, sharpen, mtx) << 0;
+  nz |= DoQuantizeBlock_AVX2(in + 1 * 16, out + 1 * 16, sharpen, mtx) << 1;
+  return nz;
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8EncDspInitAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void VP8EncDspInitAVX2(void) {
+  VP8CollectHistogram = CollectHistogram_AVX2;
+  VP8FTransform2 = FTransform2_AVX2;
+  VP8SSE16x16 = SSE16x16_AVX2;
+  VP8SSE16x8 = SSE16x8_AVX2;
+  VP8TDisto16x16 = Disto16x16_AVX2;
+  VP8EncQuantizeBlock = QuantizeBlock_AVX2;
+  VP8EncQuantize2Blocks = Quantize2Blocks_AVX2;
+  VP8EncQuantizeBlockWHT = QuantizeBlockWHT_AVX2;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(VP8EncDspInitAVX2)
+
+#endif  // WEBP_USE_AVX2
@@ -218,6 +218,8 @@ extern void VP8FiltersInitNEON(void);
 extern void VP8FiltersInitSSE2(void);
 
 WEBP_DSP_INIT_FUNC(VP8FiltersInit) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
   WebPUnfilters[WEBP_FILTER_NONE] = NoneUnfilter_C;
 #if !WEBP_NEON_OMIT_C_CODE
   WebPUnfilters[WEBP_FILTER_HORIZONTAL] = HorizontalUnfilter_C;
@@ -236,16 +238,19 @@ WEBP_DSP_INIT_FUNC(VP8FiltersInit) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       VP8FiltersInitSSE2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       VP8FiltersInitMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MSA)
     if (VP8GetCPUInfo(kMSA)) {
       VP8FiltersInitMSA();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
@@ -254,6 +259,7 @@ WEBP_DSP_INIT_FUNC(VP8FiltersInit) {
   if (WEBP_NEON_OMIT_C_CODE ||
       (VP8GetCPUInfo != NULL && VP8GetCPUInfo(kNEON))) {
     VP8FiltersInitNEON();
+    level = WEBP_SIMD_SSE2;
   }
 #endif
 
@@ -264,4 +270,5 @@ WEBP_DSP_INIT_FUNC(VP8FiltersInit) {
   assert(WebPFilters[WEBP_FILTER_HORIZONTAL] != NULL);
   assert(WebPFilters[WEBP_FILTER_VERTICAL] != NULL);
   assert(WebPFilters[WEBP_FILTER_GRADIENT] != NULL);
+  WebPDspInitDone(kDspFilters, level);
 }
@@ -631,6 +631,7 @@ extern VP8CPUInfo VP8GetCPUInfo;
 extern void VP8LDspInitSSE2(void);
 extern void VP8LDspInitSSE41(void);
 extern void VP8LDspInitAVX2(void);
+extern void VP8LDspInitAVX512(void);
 extern void VP8LDspInitNEON(void);
 extern void VP8LDspInitMIPSdspR2(void);
 extern void VP8LDspInitMSA(void);
@@ -656,6 +657,8 @@ extern void VP8LDspInitMSA(void);
   } while (0);
 
 WEBP_DSP_INIT_FUNC(VP8LDspInit) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
   COPY_PREDICTOR_ARRAY(VP8LPredictor, VP8LPredictors)
   COPY_PREDICTOR_ARRAY(PredictorAdd, VP8LPredictorsAdd)
   COPY_PREDICTOR_ARRAY(PredictorAdd, VP8LPredictorsAdd_C)
@@ -681,12 +684,21 @@ WEBP_DSP_INIT_FUNC(VP8LDspInit) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       VP8LDspInitSSE2();
+      level = WEBP_SIMD_SSE2;
 #if defined(WEBP_HAVE_SSE41)
       if (VP8GetCPUInfo(kSSE4_1)) {
         VP8LDspInitSSE41();
+        level = WEBP_SIMD_SSE4_1;
 #if defined(WEBP_HAVE_AVX2)
         if (VP8GetCPUInfo(kAVX2)) {
           VP8LDspInitAVX2();
+          level = WEBP_SIMD_AVX2;
+#if defined(WEBP_HAVE_AVX512)
+          if (VP8GetCPUInfo(kAVX512)) {
+            VP8LDspInitAVX512();
+            level = WEBP_SIMD_AVX512;
+          }
+#endif
         }
 #endif
       }
@@ -696,11 +708,13 @@ WEBP_DSP_INIT_FUNC(VP8LDspInit) {
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       VP8LDspInitMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MSA)
     if (VP8GetCPUInfo(kMSA)) {
       VP8LDspInitMSA();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
@@ -709,6 +723,7 @@ WEBP_DSP_INIT_FUNC(VP8LDspInit) {
   if (WEBP_NEON_OMIT_C_CODE ||
       (VP8GetCPUInfo != NULL && VP8GetCPUInfo(kNEON))) {
     VP8LDspInitNEON();
+    level = WEBP_SIMD_SSE2;
   }
 #endif
 
@@ -721,6 +736,7 @@ WEBP_DSP_INIT_FUNC(VP8LDspInit) {
   assert(VP8LConvertBGRAToRGB565 != NULL);
   assert(VP8LMapColor32b != NULL);
   assert(VP8LMapColor8b != NULL);
+  WebPDspInitDone(kDspLossless, level);
 }
 #undef COPY_PREDICTOR_ARRAY
 
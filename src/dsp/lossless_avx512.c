@@ -0,0 +1,206 @@
+// Copyright 2025 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX-512 (F, BW and VL) variant of methods for lossless decoder.
+// Sixteen pixels are processed per register and the left-overs are handled
+// with masked loads and stores instead of falling back to narrower versions.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_AVX512)
+
+#include <immintrin.h>
+#include <stddef.h>
+
+#include "src/dsp/cpu.h"
+#include "src/dsp/lossless.h"
+#include "src/webp/format_constants.h"
+#include "src/webp/types.h"
+
+// Returns the mask of the first min(num_pixels, 16) 32-bit elements.
+static WEBP_INLINE __mmask16 GetMask16(int num_pixels) {
+  return (num_pixels >= 16) ? (__mmask16)0xffff
+                            : (__mmask16)((1u << num_pixels) - 1u);
+}
+
+//------------------------------------------------------------------------------
+// Predictor Transform
+
+static WEBP_INLINE __m512i Average2_m512i(const __m512i a0, const __m512i a1) {
+  // (a + b) >> 1 = ((a + b + 1) >> 1) - ((a ^ b) & 1)
+  const __m512i ones = _mm512_set1_epi8(1);
+  const __m512i avg1 = _mm512_avg_epu8(a0, a1);
+  const __m512i one = _mm512_and_si512(_mm512_xor_si512(a0, a1), ones);
+  return _mm512_sub_epi8(avg1, one);
+}
+
+// Predictor0: ARGB_BLACK.
+static void PredictorAdd0_AVX512(const uint32_t* in, const uint32_t* upper,
+                                 int num_pixels, uint32_t* WEBP_RESTRICT out) {
+  int i;
+  const __m512i black = _mm512_set1_epi32((int)ARGB_BLACK);
+  for (i = 0; i < num_pixels; i += 16) {
+    const __mmask16 mask = GetMask16(num_pixels - i);
+    const __m512i src = _mm512_maskz_loadu_epi32(mask, &in[i]);
+    const __m512i res = _mm512_add_epi8(src, black);
+    _mm512_mask_storeu_epi32(&out[i], mask, res);
+  }
+  (void)upper;
+}
+
+// Predictor1: left.
+static void PredictorAdd1_AVX512(const uint32_t* in, const uint32_t* upper,
+                                 int num_pixels, uint32_t* WEBP_RESTRICT out) {
+  int i;
+  // Last element of the previous lane, or zero for the first lane(s).
+  const __m512i kPrevLane1 =
+      _mm512_setr_epi32(0, 0, 0, 0, 3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11);
+  const __m512i kPrevLane2 =
+      _mm512_setr_epi32(0, 0, 0, 0, 0, 0, 0, 0, 3, 3, 3, 3, 7, 7, 7, 7);
+  const __m512i kLast = _mm512_set1_epi32(15);
+  __m512i prev = _mm512_set1_epi32((int)out[-1]);
+  for (i = 0; i < num_pixels; i += 16) {
+    const __mmask16 mask = GetMask16(num_pixels - i);
+    const __m512i src = _mm512_maskz_loadu_epi32(mask, &in[i]);
+    // Prefix sum within each 128-bit lane (see PredictorAdd1_SSE2()).
+    const __m512i sum0 = _mm512_add_epi8(src, _mm512_bslli_epi128(src, 4));
+    const __m512i sum1 = _mm512_add_epi8(sum0, _mm512_bslli_epi128(sum0, 8));
+    // Propagate the sums of the previous lanes.
+    const __m512i sum2 = _mm512_add_epi8(
+        sum1, _mm512_maskz_permutexvar_epi32(0xfff0, kPrevLane1, sum1));
+    const __m512i sum3 = _mm512_add_epi8(
+        sum2, _mm512_maskz_permutexvar_epi32(0xff00, kPrevLane2, sum2));
+    const __m512i res = _mm512_add_epi8(sum3, prev);
+    _mm512_mask_storeu_epi32(&out[i], mask, res);
+    // replicate last res output in prev.
+    prev = _mm512_permutexvar_epi32(kLast, res);
+  }
+  (void)upper;
+}
+
+// Macro that adds 32-bit integers from IN using mod 256 arithmetic
+// per 8 bit channel.
+#define GENERATE_PREDICTOR_1(X, IN)                                          \
+  static void PredictorAdd##X##_AVX512(const uint32_t* in,                   \
+                                       const uint32_t* upper, int num_pixels, \
+                                       uint32_t* WEBP_RESTRICT out) {        \
+    int i;                                                                   \
+    for (i = 0; i < num_pixels; i += 16) {                                   \
+      const __mmask16 mask = GetMask16(num_pixels - i);                      \
+      const __m512i src = _mm512_maskz_loadu_epi32(mask, &in[i]);            \
+      const __m512i other = _mm512_maskz_loadu_epi32(mask, &(IN));           \
+      const __m512i res = _mm512_add_epi8(src, other);                       \
+      _mm512_mask_storeu_epi32(&out[i], mask, res);                          \
+    }                                                                        \
+  }
+
+// Predictor2: Top.
+GENERATE_PREDICTOR_1(2, upper[i])
+// Predictor3: Top-right.
+GENERATE_PREDICTOR_1(3, upper[i + 1])
+// Predictor4: Top-left.
+GENERATE_PREDICTOR_1(4, upper[i - 1])
+#undef GENERATE_PREDICTOR_1
+
+// Due to averages with integers, values cannot be accumulated in parallel for
+// predictors 5 to 7, 10 to 13: the AVX2 versions are kept for those.
+
+#define GENERATE_PREDICTOR_2(X, IN)                                          \
+  static void PredictorAdd##X##_AVX512(const uint32_t* in,                   \
+                                       const uint32_t* upper, int num_pixels, \
+                                       uint32_t* WEBP_RESTRICT out) {        \
+    int i;                                                                   \
+    for (i = 0; i < num_pixels; i += 16) {                                   \
+      const __mmask16 mask = GetMask16(num_pixels - i);                      \
+      const __m512i Tother = _mm512_maskz_loadu_epi32(mask, &(IN));          \
+      const __m512i T = _mm512_maskz_loadu_epi32(mask, &upper[i]);           \
+      const __m512i src = _mm512_maskz_loadu_epi32(mask, &in[i]);            \
+      const __m512i res = _mm512_add_epi8(Average2_m512i(T, Tother), src);   \
+      _mm512_mask_storeu_epi32(&out[i], mask, res);                          \
+    }                                                                        \
+  }
+// Predictor8: average TL T.
+GENERATE_PREDICTOR_2(8, upper[i - 1])
+// Predictor9: average T TR.
+GENERATE_PREDICTOR_2(9, upper[i + 1])
+#undef GENERATE_PREDICTOR_2
+
+//------------------------------------------------------------------------------
+// Subtract-Green Transform
+
+static void AddGreenToBlueAndRed_AVX512(const uint32_t* const src,
+                                        int num_pixels, uint32_t* dst) {
+  int i;
+  const __m512i kCstShuffle = _mm512_broadcast_i32x4(_mm_set_epi8(
+      -1, 13, -1, 13, -1, 9, -1, 9, -1, 5, -1, 5, -1, 1, -1, 1));
+  for (i = 0; i < num_pixels; i += 16) {
+    const __mmask16 mask = GetMask16(num_pixels - i);
+    const __m512i in = _mm512_maskz_loadu_epi32(mask, &src[i]);   // argb
+    const __m512i in_0g0g = _mm512_shuffle_epi8(in, kCstShuffle);  // 0g0g
+    const __m512i out = _mm512_add_epi8(in, in_0g0g);
+    _mm512_mask_storeu_epi32(&dst[i], mask, out);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Color Transform
+
+static void TransformColorInverse_AVX512(const VP8LMultipliers* const m,
+                                         const uint32_t* const src,
+                                         int num_pixels, uint32_t* dst) {
+// sign-extended multiplying constants, pre-shifted by 5.
+#define CST(X) (((int16_t)(m->X << 8)) >> 5)  // sign-extend
+  const __m512i mults_rb = _mm512_set1_epi32(
+      (int)((uint32_t)CST(green_to_red) << 16 | (CST(green_to_blue) & 0xffff)));
+  const __m512i mults_b2 = _mm512_set1_epi32(CST(red_to_blue));
+#undef CST
+  // Bytes of the alpha and green channels.
+  const __mmask64 mask_ag = 0xaaaaaaaaaaaaaaaaull;
+  const __m512i perm1 = _mm512_broadcast_i32x4(_mm_setr_epi8(
+      -1, 1, -1, 1, -1, 5, -1, 5, -1, 9, -1, 9, -1, 13, -1, 13));
+  const __m512i perm2 = _mm512_broadcast_i32x4(_mm_setr_epi8(
+      -1, 2, -1, -1, -1, 6, -1, -1, -1, 10, -1, -1, -1, 14, -1, -1));
+  int i;
+  for (i = 0; i < num_pixels; i += 16) {
+    const __mmask16 mask = GetMask16(num_pixels - i);
+    const __m512i A = _mm512_maskz_loadu_epi32(mask, src + i);
+    const __m512i B = _mm512_shuffle_epi8(A, perm1);  // argb -> g0g0
+    const __m512i C = _mm512_mulhi_epi16(B, mults_rb);
+    const __m512i D = _mm512_add_epi8(A, C);
+    const __m512i E = _mm512_shuffle_epi8(D, perm2);
+    const __m512i F = _mm512_mulhi_epi16(E, mults_b2);
+    const __m512i G = _mm512_add_epi8(D, F);
+    const __m512i out = _mm512_mask_blend_epi8(mask_ag, G, A);
+    _mm512_mask_storeu_epi32(&dst[i], mask, out);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8LDspInitAVX512(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void VP8LDspInitAVX512(void) {
+  VP8LPredictorsAdd[0] = PredictorAdd0_AVX512;
+  VP8LPredictorsAdd[1] = PredictorAdd1_AVX512;
+  VP8LPredictorsAdd[2] = PredictorAdd2_AVX512;
+  VP8LPredictorsAdd[3] = PredictorAdd3_AVX512;
+  VP8LPredictorsAdd[4] = PredictorAdd4_AVX512;
+  VP8LPredictorsAdd[8] = PredictorAdd8_AVX512;
+  VP8LPredictorsAdd[9] = PredictorAdd9_AVX512;
+
+  VP8LAddGreenToBlueAndRed = AddGreenToBlueAndRed_AVX512;
+  VP8LTransformColorInverse = TransformColorInverse_AVX512;
+}
+
+#else  // !WEBP_USE_AVX512
+
+WEBP_DSP_INIT_STUB(VP8LDspInitAVX512)
+
+#endif  // WEBP_USE_AVX512
@@ -677,12 +677,15 @@ extern VP8CPUInfo VP8GetCPUInfo;
 extern void VP8LEncDspInitSSE2(void);
 extern void VP8LEncDspInitSSE41(void);
 extern void VP8LEncDspInitAVX2(void);
+extern void VP8LEncDspInitAVX512(void);
 extern void VP8LEncDspInitNEON(void);
 extern void VP8LEncDspInitMIPS32(void);
 extern void VP8LEncDspInitMIPSdspR2(void);
 extern void VP8LEncDspInitMSA(void);
 
 WEBP_DSP_INIT_FUNC(VP8LEncDspInit) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
   VP8LDspInit();
 
 #if !WEBP_NEON_OMIT_C_CODE
@@ -749,12 +752,21 @@ WEBP_DSP_INIT_FUNC(VP8LEncDspInit) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       VP8LEncDspInitSSE2();
+      level = WEBP_SIMD_SSE2;
 #if defined(WEBP_HAVE_SSE41)
       if (VP8GetCPUInfo(kSSE4_1)) {
         VP8LEncDspInitSSE41();
+        level = WEBP_SIMD_SSE4_1;
 #if defined(WEBP_HAVE_AVX2)
         if (VP8GetCPUInfo(kAVX2)) {
           VP8LEncDspInitAVX2();
+          level = WEBP_SIMD_AVX2;
+#if defined(WEBP_HAVE_AVX512)
+          if (VP8GetCPUInfo(kAVX512)) {
+            VP8LEncDspInitAVX512();
+            level = WEBP_SIMD_AVX512;
+          }
+#endif
         }
 #endif
       }
@@ -764,16 +776,19 @@ WEBP_DSP_INIT_FUNC(VP8LEncDspInit) {
 #if defined(WEBP_USE_MIPS32)
     if (VP8GetCPUInfo(kMIPS32)) {
       VP8LEncDspInitMIPS32();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       VP8LEncDspInitMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MSA)
     if (VP8GetCPUInfo(kMSA)) {
       VP8LEncDspInitMSA();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
@@ -782,6 +797,7 @@ WEBP_DSP_INIT_FUNC(VP8LEncDspInit) {
   if (WEBP_NEON_OMIT_C_CODE ||
       (VP8GetCPUInfo != NULL && VP8GetCPUInfo(kNEON))) {
     VP8LEncDspInitNEON();
+    level = WEBP_SIMD_SSE2;
   }
 #endif
 
@@ -832,6 +848,7 @@ WEBP_DSP_INIT_FUNC(VP8LEncDspInit) {
   assert(VP8LPredictorsSub_C[13] != NULL);
   assert(VP8LPredictorsSub_C[14] != NULL);
   assert(VP8LPredictorsSub_C[15] != NULL);
+  WebPDspInitDone(kDspLosslessEnc, level);
 }
 
 //------------------------------------------------------------------------------
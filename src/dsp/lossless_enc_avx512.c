@@ -0,0 +1,178 @@
+// Copyright 2025 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX-512 (F, BW and VL) variant of methods for lossless encoder.
+// Sixteen values are processed per register and the left-overs are handled
+// with masked loads and stores instead of falling back to narrower versions.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_AVX512)
+#include <immintrin.h>
+#include <string.h>
+
+#include "src/dsp/cpu.h"
+#include "src/dsp/lossless.h"
+#include "src/dsp/lossless_common.h"
+#include "src/utils/utils.h"
+#include "src/webp/types.h"
+
+// Returns the mask of the first min(n, 16) 32-bit elements.
+static WEBP_INLINE __mmask16 GetMask16(int n) {
+  return (n >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << n) - 1u);
+}
+
+//------------------------------------------------------------------------------
+// Histograms
+// Note: the color transform statistics are not ported as the histogram update
+// is scalar and dominates: the AVX2 versions were measured to be faster.
+
+// Note we are adding uint32_t's as *signed* int32's (using _mm512_add_epi32).
+// But that's ok since the histogram values are less than 1<<28 (max picture
+// size).
+static void AddVector_AVX512(const uint32_t* WEBP_RESTRICT a,
+                             const uint32_t* WEBP_RESTRICT b,
+                             uint32_t* WEBP_RESTRICT out, int size) {
+  int i;
+  for (i = 0; i < size; i += 16) {
+    const __mmask16 mask = GetMask16(size - i);
+    const __m512i a0 = _mm512_maskz_loadu_epi32(mask, &a[i]);
+    const __m512i b0 = _mm512_maskz_loadu_epi32(mask, &b[i]);
+    _mm512_mask_storeu_epi32(&out[i], mask, _mm512_add_epi32(a0, b0));
+  }
+}
+
+static void AddVectorEq_AVX512(const uint32_t* WEBP_RESTRICT a,
+                               uint32_t* WEBP_RESTRICT out, int size) {
+  int i;
+  for (i = 0; i < size; i += 16) {
+    const __mmask16 mask = GetMask16(size - i);
+    const __m512i a0 = _mm512_maskz_loadu_epi32(mask, &a[i]);
+    const __m512i b0 = _mm512_maskz_loadu_epi32(mask, &out[i]);
+    _mm512_mask_storeu_epi32(&out[i], mask, _mm512_add_epi32(a0, b0));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Entropy
+
+#if !defined(WEBP_HAVE_SLOW_CLZ_CTZ)
+
+// Same as in lossless_enc.c.
+static WEBP_INLINE void GetEntropyUnrefinedHelper(
+    uint32_t val, int i, uint32_t* WEBP_RESTRICT const val_prev,
+    int* WEBP_RESTRICT const i_prev,
+    VP8LBitEntropy* WEBP_RESTRICT const bit_entropy,
+    VP8LStreaks* WEBP_RESTRICT const stats) {
+  const int streak = i - *i_prev;
+
+  // Gather info for the bit entropy.
+  if (*val_prev != 0) {
+    bit_entropy->sum += (*val_prev) * streak;
+    bit_entropy->nonzeros += streak;
+    bit_entropy->nonzero_code = *i_prev;
+    bit_entropy->entropy += VP8LFastSLog2(*val_prev) * streak;
+    if (bit_entropy->max_val < *val_prev) {
+      bit_entropy->max_val = *val_prev;
+    }
+  }
+
+  // Gather info for the Huffman cost.
+  stats->counts[*val_prev != 0] += (streak > 3);
+  stats->streaks[*val_prev != 0][(streak > 3)] += streak;
+
+  *val_prev = val;
+  *i_prev = i;
+}
+
+// The streaks are found 16 values at a time by comparing each value to the
+// previous one: the scalar code is only run where the value changes.
+static void GetEntropyUnrefined_AVX512(
+    const uint32_t X[], int length,
+    VP8LBitEntropy* WEBP_RESTRICT const bit_entropy,
+    VP8LStreaks* WEBP_RESTRICT const stats) {
+  int i;
+  int i_prev = 0;
+  uint32_t x_prev = X[0];
+
+  memset(stats, 0, sizeof(*stats));
+  VP8LBitEntropyInit(bit_entropy);
+
+  for (i = 1; i < length; i += 16) {
+    const __mmask16 mask = GetMask16(length - i);
+    const __m512i x = _mm512_maskz_loadu_epi32(mask, &X[i]);
+    const __m512i x_left = _mm512_maskz_loadu_epi32(mask, &X[i - 1]);
+    uint32_t changes = _mm512_cmpneq_epi32_mask(x, x_left);
+    while (changes != 0) {
+      const int j = i + BitsCtz(changes);
+      GetEntropyUnrefinedHelper(X[j], j, &x_prev, &i_prev, bit_entropy, stats);
+      changes &= changes - 1;
+    }
+  }
+  GetEntropyUnrefinedHelper(0, length, &x_prev, &i_prev, bit_entropy, stats);
+
+  bit_entropy->entropy = VP8LFastSLog2(bit_entropy->sum) - bit_entropy->entropy;
+}
+
+static void GetCombinedEntropyUnrefined_AVX512(
+    const uint32_t X[], const uint32_t Y[], int length,
+    VP8LBitEntropy* WEBP_RESTRICT const bit_entropy,
+    VP8LStreaks* WEBP_RESTRICT const stats) {
+  int i;
+  int i_prev = 0;
+  uint32_t xy_prev = X[0] + Y[0];
+
+  memset(stats, 0, sizeof(*stats));
+  VP8LBitEntropyInit(bit_entropy);
+
+  for (i = 1; i < length; i += 16) {
+    const __mmask16 mask = GetMask16(length - i);
+    const __m512i xy = _mm512_add_epi32(_mm512_maskz_loadu_epi32(mask, &X[i]),
+                                        _mm512_maskz_loadu_epi32(mask, &Y[i]));
+    const __m512i xy_left =
+        _mm512_add_epi32(_mm512_maskz_loadu_epi32(mask, &X[i - 1]),
+                         _mm512_maskz_loadu_epi32(mask, &Y[i - 1]));
+    uint32_t changes = _mm512_cmpneq_epi32_mask(xy, xy_left);
+    while (changes != 0) {
+      const int j = i + BitsCtz(changes);
+      GetEntropyUnrefinedHelper(X[j] + Y[j], j, &xy_prev, &i_prev, bit_entropy,
+                                stats);
+      changes &= changes - 1;
+    }
+  }
+  GetEntropyUnrefinedHelper(0, length, &xy_prev, &i_prev, bit_entropy, stats);
+
+  bit_entropy->entropy = VP8LFastSLog2(bit_entropy->sum) - bit_entropy->entropy;
+}
+
+#else
+
+#define DONT_USE_ENTROPY_UNREFINED_AVX512_FUNCS  // won't be faster
+
+#endif
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8LEncDspInitAVX512(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void VP8LEncDspInitAVX512(void) {
+  VP8LAddVector = AddVector_AVX512;
+  VP8LAddVectorEq = AddVectorEq_AVX512;
+#if !defined(DONT_USE_ENTROPY_UNREFINED_AVX512_FUNCS)
+  VP8LGetEntropyUnrefined = GetEntropyUnrefined_AVX512;
+  VP8LGetCombinedEntropyUnrefined = GetCombinedEntropyUnrefined_AVX512;
+#endif
+}
+
+#else  // !WEBP_USE_AVX512
+
+WEBP_DSP_INIT_STUB(VP8LEncDspInitAVX512)
+
+#endif  // WEBP_USE_AVX512
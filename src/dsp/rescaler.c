@@ -207,6 +207,8 @@ extern void WebPRescalerDspInitMSA(void);
 extern void WebPRescalerDspInitNEON(void);
 
 WEBP_DSP_INIT_FUNC(WebPRescalerDspInit) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
 #if !defined(WEBP_REDUCE_SIZE)
 #if !WEBP_NEON_OMIT_C_CODE
   WebPRescalerExportRowExpand = WebPRescalerExportRowExpand_C;
@@ -220,21 +222,25 @@ WEBP_DSP_INIT_FUNC(WebPRescalerDspInit) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       WebPRescalerDspInitSSE2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MIPS32)
     if (VP8GetCPUInfo(kMIPS32)) {
       WebPRescalerDspInitMIPS32();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       WebPRescalerDspInitMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MSA)
     if (VP8GetCPUInfo(kMSA)) {
       WebPRescalerDspInitMSA();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
@@ -243,6 +249,7 @@ WEBP_DSP_INIT_FUNC(WebPRescalerDspInit) {
   if (WEBP_NEON_OMIT_C_CODE ||
       (VP8GetCPUInfo != NULL && VP8GetCPUInfo(kNEON))) {
     WebPRescalerDspInitNEON();
+    level = WEBP_SIMD_SSE2;
   }
 #endif
 
@@ -251,4 +258,5 @@ WEBP_DSP_INIT_FUNC(WebPRescalerDspInit) {
   assert(WebPRescalerImportRowExpand != NULL);
   assert(WebPRescalerImportRowShrink != NULL);
 #endif  // WEBP_REDUCE_SIZE
+  WebPDspInitDone(kDspRescaler, level);
 }
@@ -112,6 +112,72 @@ static void RescalerImportRowExpand_SSE2(WebPRescaler* WEBP_RESTRICT const wrk,
   assert(accum == 0);
 }
 
+// Stores the 8 16b values of 'sums' multiplied by 'x_sub' as 32b in 'frow'.
+static WEBP_INLINE void StoreEightMult_SSE2(const __m128i* const sums,
+                                            const __m128i* const mult,
+                                            rescaler_t* const frow) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i A0 = _mm_unpacklo_epi16(*sums, zero);
+  const __m128i A1 = _mm_unpackhi_epi16(*sums, zero);
+  _mm_storeu_si128((__m128i*)(frow + 0), _mm_madd_epi16(A0, *mult));
+  _mm_storeu_si128((__m128i*)(frow + 4), _mm_madd_epi16(A1, *mult));
+}
+
+// Single channel shrinking by an integer ratio of 1, 2, 4 or 8: each output
+// is exactly 'x_sub' times the sum of its 'ratio' input pixels, as there is
+// no fractional contribution to carry over.
+static void RescalerImportRowShrinkInt_SSE2(
+    WebPRescaler* WEBP_RESTRICT const wrk, const uint8_t* WEBP_RESTRICT src,
+    int ratio) {
+  const int x_sub = wrk->x_sub;
+  const int x_out_max = wrk->dst_width;
+  rescaler_t* const frow = wrk->frow;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i mult = _mm_set1_epi32(x_sub);  // x_sub in the low 16b only
+  const __m128i mask_lo = _mm_set1_epi16(0x00ff);
+  const __m128i ones = _mm_set1_epi16(1);
+  int x_out = 0;
+  // The 16b multiplication by 'x_sub' and the sums (<= 8 * 255) can't overflow.
+  assert(x_sub < (1 << 15) && ratio <= 8);
+  for (; x_out + 8 <= x_out_max; x_out += 8) {
+    const uint8_t* const s = src + x_out * ratio;
+    __m128i sums;
+    if (ratio == 1) {
+      sums = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)s), zero);
+    } else if (ratio == 2) {
+      const __m128i A = _mm_loadu_si128((const __m128i*)s);
+      sums = _mm_add_epi16(_mm_and_si128(A, mask_lo), _mm_srli_epi16(A, 8));
+    } else if (ratio == 4) {
+      const __m128i A = _mm_loadu_si128((const __m128i*)(s + 0));
+      const __m128i B = _mm_loadu_si128((const __m128i*)(s + 16));
+      const __m128i A2 =
+          _mm_add_epi16(_mm_and_si128(A, mask_lo), _mm_srli_epi16(A, 8));
+      const __m128i B2 =
+          _mm_add_epi16(_mm_and_si128(B, mask_lo), _mm_srli_epi16(B, 8));
+      sums = _mm_packs_epi32(_mm_madd_epi16(A2, ones),
+                             _mm_madd_epi16(B2, ones));
+    } else {
+      // The sums of 8 bytes are in the low 16b of each 64b lane.
+      const __m128i A = _mm_loadu_si128((const __m128i*)(s + 0));
+      const __m128i B = _mm_loadu_si128((const __m128i*)(s + 16));
+      const __m128i C = _mm_loadu_si128((const __m128i*)(s + 32));
+      const __m128i D = _mm_loadu_si128((const __m128i*)(s + 48));
+      const __m128i AB = _mm_packs_epi32(_mm_sad_epu8(A, zero),
+                                         _mm_sad_epu8(B, zero));
+      const __m128i CD = _mm_packs_epi32(_mm_sad_epu8(C, zero),
+                                         _mm_sad_epu8(D, zero));
+      sums = _mm_packs_epi32(AB, CD);
+    }
+    StoreEightMult_SSE2(&sums, &mult, frow + x_out);
+  }
+  for (; x_out < x_out_max; ++x_out) {
+    uint32_t sum = 0;
+    int i;
+    for (i = 0; i < ratio; ++i) sum += src[x_out * ratio + i];
+    frow[x_out] = sum * x_sub;
+  }
+}
+
 static void RescalerImportRowShrink_SSE2(WebPRescaler* WEBP_RESTRICT const wrk,
                                          const uint8_t* WEBP_RESTRICT src) {
   const int x_sub = wrk->x_sub;
@@ -124,6 +190,14 @@ static void RescalerImportRowShrink_SSE2(WebPRescaler* WEBP_RESTRICT const wrk,
   rescaler_t* frow = wrk->frow;
   const rescaler_t* const frow_end = wrk->frow + 4 * wrk->dst_width;
 
+  if (wrk->num_channels == 1 && wrk->x_add % x_sub == 0) {
+    const int ratio = wrk->x_add / x_sub;
+    if (ratio == 1 || ratio == 2 || ratio == 4 || ratio == 8) {
+      assert(!WebPRescalerInputDone(wrk));
+      RescalerImportRowShrinkInt_SSE2(wrk, src, ratio);
+      return;
+    }
+  }
   if (wrk->num_channels != 4 || wrk->x_add > (x_sub << 7)) {
     WebPRescalerImportRowShrink_C(wrk, src);
     return;
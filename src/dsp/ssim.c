@@ -141,6 +141,8 @@ extern VP8CPUInfo VP8GetCPUInfo;
 extern void VP8SSIMDspInitSSE2(void);
 
 WEBP_DSP_INIT_FUNC(VP8SSIMDspInit) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
 #if !defined(WEBP_REDUCE_SIZE)
   VP8SSIMGetClipped = SSIMGetClipped_C;
   VP8SSIMGet = SSIMGet_C;
@@ -154,7 +156,9 @@ WEBP_DSP_INIT_FUNC(VP8SSIMDspInit) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       VP8SSIMDspInitSSE2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
+  WebPDspInitDone(kDspSSIM, level);
 }
@@ -232,8 +232,11 @@ extern VP8CPUInfo VP8GetCPUInfo;
 extern void WebPInitYUV444ConvertersMIPSdspR2(void);
 extern void WebPInitYUV444ConvertersSSE2(void);
 extern void WebPInitYUV444ConvertersSSE41(void);
+extern void WebPInitYUV444ConvertersAVX2(void);
 
 WEBP_DSP_INIT_FUNC(WebPInitYUV444Converters) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
   WebPYUV444Converters[MODE_RGBA] = WebPYuv444ToRgba_C;
   WebPYUV444Converters[MODE_BGRA] = WebPYuv444ToBgra_C;
   WebPYUV444Converters[MODE_RGB] = WebPYuv444ToRgb_C;
@@ -250,19 +253,29 @@ WEBP_DSP_INIT_FUNC(WebPInitYUV444Converters) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       WebPInitYUV444ConvertersSSE2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_HAVE_SSE41)
     if (VP8GetCPUInfo(kSSE4_1)) {
       WebPInitYUV444ConvertersSSE41();
+      level = WEBP_SIMD_SSE4_1;
+#if defined(WEBP_HAVE_AVX2)
+      if (VP8GetCPUInfo(kAVX2)) {
+        WebPInitYUV444ConvertersAVX2();
+        level = WEBP_SIMD_AVX2;
+      }
+#endif
     }
 #endif
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       WebPInitYUV444ConvertersMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
+  WebPDspInitDone(kDspYUV444Converters, level);
 }
 
 //------------------------------------------------------------------------------
@@ -270,11 +283,14 @@ WEBP_DSP_INIT_FUNC(WebPInitYUV444Converters) {
 
 extern void WebPInitUpsamplersSSE2(void);
 extern void WebPInitUpsamplersSSE41(void);
+extern void WebPInitUpsamplersAVX2(void);
 extern void WebPInitUpsamplersNEON(void);
 extern void WebPInitUpsamplersMIPSdspR2(void);
 extern void WebPInitUpsamplersMSA(void);
 
 WEBP_DSP_INIT_FUNC(WebPInitUpsamplers) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
 #ifdef FANCY_UPSAMPLING
 #if !WEBP_NEON_OMIT_C_CODE
   WebPUpsamplers[MODE_RGBA] = UpsampleRgbaLinePair_C;
@@ -295,21 +311,31 @@ WEBP_DSP_INIT_FUNC(WebPInitUpsamplers) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       WebPInitUpsamplersSSE2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_HAVE_SSE41)
     if (VP8GetCPUInfo(kSSE4_1)) {
       WebPInitUpsamplersSSE41();
+      level = WEBP_SIMD_SSE4_1;
+#if defined(WEBP_HAVE_AVX2)
+      if (VP8GetCPUInfo(kAVX2)) {
+        WebPInitUpsamplersAVX2();
+        level = WEBP_SIMD_AVX2;
+      }
+#endif
     }
 #endif
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       WebPInitUpsamplersMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
 #if defined(WEBP_USE_MSA)
     if (VP8GetCPUInfo(kMSA)) {
       WebPInitUpsamplersMSA();
+      level = WEBP_SIMD_SSE2;
     }
 #endif
   }
@@ -318,6 +344,7 @@ WEBP_DSP_INIT_FUNC(WebPInitUpsamplers) {
   if (WEBP_NEON_OMIT_C_CODE ||
       (VP8GetCPUInfo != NULL && VP8GetCPUInfo(kNEON))) {
     WebPInitUpsamplersNEON();
+    level = WEBP_SIMD_SSE2;
   }
 #endif
 
@@ -336,6 +363,7 @@ WEBP_DSP_INIT_FUNC(WebPInitUpsamplers) {
 #endif
 
 #endif  // FANCY_UPSAMPLING
+  WebPDspInitDone(kDspUpsamplers, level);
 }
 
 //------------------------------------------------------------------------------
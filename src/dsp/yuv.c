@@ -90,10 +90,13 @@ WebPSamplerRowFunc WebPSamplers[MODE_LAST];
 extern VP8CPUInfo VP8GetCPUInfo;
 extern void WebPInitSamplersSSE2(void);
 extern void WebPInitSamplersSSE41(void);
+extern void WebPInitSamplersAVX2(void);
 extern void WebPInitSamplersMIPS32(void);
 extern void WebPInitSamplersMIPSdspR2(void);
 
 WEBP_DSP_INIT_FUNC(WebPInitSamplers) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
   WebPSamplers[MODE_RGB] = YuvToRgbRow;
   WebPSamplers[MODE_RGBA] = YuvToRgbaRow;
   WebPSamplers[MODE_BGR] = YuvToBgrRow;
@@ -111,24 +114,35 @@ WEBP_DSP_INIT_FUNC(WebPInitSamplers) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       WebPInitSamplersSSE2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif  // WEBP_HAVE_SSE2
 #if defined(WEBP_HAVE_SSE41)
     if (VP8GetCPUInfo(kSSE4_1)) {
       WebPInitSamplersSSE41();
+      level = WEBP_SIMD_SSE4_1;
+#if defined(WEBP_HAVE_AVX2)
+      if (VP8GetCPUInfo(kAVX2)) {
+        WebPInitSamplersAVX2();
+        level = WEBP_SIMD_AVX2;
+      }
+#endif  // WEBP_HAVE_AVX2
     }
 #endif  // WEBP_HAVE_SSE41
 #if defined(WEBP_USE_MIPS32)
     if (VP8GetCPUInfo(kMIPS32)) {
       WebPInitSamplersMIPS32();
+      level = WEBP_SIMD_SSE2;
     }
 #endif  // WEBP_USE_MIPS32
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       WebPInitSamplersMIPSdspR2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif  // WEBP_USE_MIPS_DSP_R2
   }
+  WebPDspInitDone(kDspSamplers, level);
 }
 
 //-----------------------------------------------------------------------------
@@ -642,6 +656,8 @@ extern void WebPInitConvertARGBToYUVSSE41(void);
 extern void WebPInitConvertARGBToYUVNEON(void);
 
 WEBP_DSP_INIT_FUNC(WebPInitConvertARGBToYUV) {
+  WebPSimdLevel level = WEBP_SIMD_NONE;
+
   WebPConvertARGBToY = ConvertARGBToY_C;
   WebPConvertARGBToUV = WebPConvertARGBToUV_C;
 
@@ -657,11 +673,13 @@ WEBP_DSP_INIT_FUNC(WebPInitConvertARGBToYUV) {
 #if defined(WEBP_HAVE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       WebPInitConvertARGBToYUVSSE2();
+      level = WEBP_SIMD_SSE2;
     }
 #endif  // WEBP_HAVE_SSE2
 #if defined(WEBP_HAVE_SSE41)
     if (VP8GetCPUInfo(kSSE4_1)) {
       WebPInitConvertARGBToYUVSSE41();
+      level = WEBP_SIMD_SSE4_1;
     }
 #endif  // WEBP_HAVE_SSE41
   }
@@ -670,6 +688,7 @@ WEBP_DSP_INIT_FUNC(WebPInitConvertARGBToYUV) {
   if (WEBP_NEON_OMIT_C_CODE ||
       (VP8GetCPUInfo != NULL && VP8GetCPUInfo(kNEON))) {
     WebPInitConvertARGBToYUVNEON();
+    level = WEBP_SIMD_SSE2;
   }
 #endif  // WEBP_HAVE_NEON
 
@@ -678,4 +697,5 @@ WEBP_DSP_INIT_FUNC(WebPInitConvertARGBToYUV) {
   assert(WebPConvertRGBToY != NULL);
   assert(WebPConvertBGRToY != NULL);
   assert(WebPConvertRGBA32ToUV != NULL);
+  WebPDspInitDone(kDspConvertARGBToYUV, level);
 }
@@ -0,0 +1,451 @@
+// Copyright 2025 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 version of the YUV->RGB conversion functions.
+// Sixteen pixels are converted per register, with the same arithmetic as the
+// SSE2 version so that the results are bit-exact.
+
+#include "src/dsp/yuv.h"
+
+#if defined(WEBP_USE_AVX2)
+#include <immintrin.h>
+
+#include "src/dsp/cpu.h"
+#include "src/dsp/dsp.h"
+#include "src/webp/decode.h"
+#include "src/webp/types.h"
+
+//-----------------------------------------------------------------------------
+// Convert spans of 32 pixels to various RGB formats for the fancy upsampler.
+
+// See ConvertYUV444ToRGB_SSE2() for the constants and the ranges.
+static void ConvertYUV444ToRGB_AVX2(const __m256i* const Y0,
+                                    const __m256i* const U0,
+                                    const __m256i* const V0, __m256i* const R,
+                                    __m256i* const G, __m256i* const B) {
+  const __m256i k19077 = _mm256_set1_epi16(19077);
+  const __m256i k26149 = _mm256_set1_epi16(26149);
+  const __m256i k14234 = _mm256_set1_epi16(14234);
+  // 33050 doesn't fit in a signed short: only use this with unsigned arithmetic
+  const __m256i k33050 = _mm256_set1_epi16((short)33050);
+  const __m256i k17685 = _mm256_set1_epi16(17685);
+  const __m256i k6419 = _mm256_set1_epi16(6419);
+  const __m256i k13320 = _mm256_set1_epi16(13320);
+  const __m256i k8708 = _mm256_set1_epi16(8708);
+
+  const __m256i Y1 = _mm256_mulhi_epu16(*Y0, k19077);
+
+  const __m256i R0 = _mm256_mulhi_epu16(*V0, k26149);
+  const __m256i R1 = _mm256_sub_epi16(Y1, k14234);
+  const __m256i R2 = _mm256_add_epi16(R1, R0);
+
+  const __m256i G0 = _mm256_mulhi_epu16(*U0, k6419);
+  const __m256i G1 = _mm256_mulhi_epu16(*V0, k13320);
+  const __m256i G2 = _mm256_add_epi16(Y1, k8708);
+  const __m256i G3 = _mm256_add_epi16(G0, G1);
+  const __m256i G4 = _mm256_sub_epi16(G2, G3);
+
+  // be careful with the saturated *unsigned* arithmetic here!
+  const __m256i B0 = _mm256_mulhi_epu16(*U0, k33050);
+  const __m256i B1 = _mm256_adds_epu16(B0, Y1);
+  const __m256i B2 = _mm256_subs_epu16(B1, k17685);
+
+  // use logical shift for B2, which can be larger than 32767
+  *R = _mm256_srai_epi16(R2, 6);  // range: [-14234, 30815]
+  *G = _mm256_srai_epi16(G4, 6);  // range: [-10953, 27710]
+  *B = _mm256_srli_epi16(B2, 6);  // range: [0, 34238]
+}
+
+// Load 16 bytes into the *upper* part of 16b words. That's "<< 8", basically.
+static WEBP_INLINE __m256i Load_HI_16_AVX2(const uint8_t* src) {
+  const __m128i tmp = _mm_loadu_si128((const __m128i*)src);
+  return _mm256_slli_epi16(_mm256_cvtepu8_epi16(tmp), 8);
+}
+
+// Load and replicate 8 U/V samples
+static WEBP_INLINE __m256i Load_UV_HI_8_AVX2(const uint8_t* src) {
+  const __m128i tmp0 = _mm_loadl_epi64((const __m128i*)src);
+  const __m128i tmp1 = _mm_unpacklo_epi8(tmp0, tmp0);  // replicate samples
+  return _mm256_slli_epi16(_mm256_cvtepu8_epi16(tmp1), 8);
+}
+
+// Convert 16 samples of YUV444 to R/G/B
+static void YUV444ToRGB_AVX2(const uint8_t* WEBP_RESTRICT const y,
+                             const uint8_t* WEBP_RESTRICT const u,
+                             const uint8_t* WEBP_RESTRICT const v,
+                             __m256i* const R, __m256i* const G,
+                             __m256i* const B) {
+  const __m256i Y0 = Load_HI_16_AVX2(y), U0 = Load_HI_16_AVX2(u),
+                V0 = Load_HI_16_AVX2(v);
+  ConvertYUV444ToRGB_AVX2(&Y0, &U0, &V0, R, G, B);
+}
+
+// Convert 16 samples of YUV420 to R/G/B
+static void YUV420ToRGB_AVX2(const uint8_t* WEBP_RESTRICT const y,
+                             const uint8_t* WEBP_RESTRICT const u,
+                             const uint8_t* WEBP_RESTRICT const v,
+                             __m256i* const R, __m256i* const G,
+                             __m256i* const B) {
+  const __m256i Y0 = Load_HI_16_AVX2(y), U0 = Load_UV_HI_8_AVX2(u),
+                V0 = Load_UV_HI_8_AVX2(v);
+  ConvertYUV444ToRGB_AVX2(&Y0, &U0, &V0, R, G, B);
+}
+
+// Pack R/G/B/A results into 32b output.
+static WEBP_INLINE void PackAndStore4_AVX2(const __m256i* const R,
+                                           const __m256i* const G,
+                                           const __m256i* const B,
+                                           const __m256i* const A,
+                                           uint8_t* WEBP_RESTRICT const dst) {
+  // The packing and unpacking instructions work within each 128-bit lane:
+  // RGBA_lo holds the pixels 0-3 and 8-11, RGBA_hi the pixels 4-7 and 12-15.
+  const __m256i rb = _mm256_packus_epi16(*R, *B);
+  const __m256i ga = _mm256_packus_epi16(*G, *A);
+  const __m256i rg = _mm256_unpacklo_epi8(rb, ga);
+  const __m256i ba = _mm256_unpackhi_epi8(rb, ga);
+  const __m256i RGBA_lo = _mm256_unpacklo_epi16(rg, ba);
+  const __m256i RGBA_hi = _mm256_unpackhi_epi16(rg, ba);
+  _mm256_storeu_si256((__m256i*)(dst + 0),
+                      _mm256_permute2x128_si256(RGBA_lo, RGBA_hi, 0x20));
+  _mm256_storeu_si256((__m256i*)(dst + 32),
+                      _mm256_permute2x128_si256(RGBA_lo, RGBA_hi, 0x31));
+}
+
+// Pack R/G/B/A results into 16b output.
+static WEBP_INLINE void PackAndStore4444_AVX2(
+    const __m256i* const R, const __m256i* const G, const __m256i* const B,
+    const __m256i* const A, uint8_t* WEBP_RESTRICT const dst) {
+#if (WEBP_SWAP_16BIT_CSP == 0)
+  const __m256i rg0 = _mm256_packus_epi16(*R, *G);
+  const __m256i ba0 = _mm256_packus_epi16(*B, *A);
+#else
+  const __m256i rg0 = _mm256_packus_epi16(*B, *A);
+  const __m256i ba0 = _mm256_packus_epi16(*R, *G);
+#endif
+  const __m256i mask_0xf0 = _mm256_set1_epi8((char)0xf0);
+  const __m256i rb1 = _mm256_unpacklo_epi8(rg0, ba0);  // rbrbrbrbrb...
+  const __m256i ga1 = _mm256_unpackhi_epi8(rg0, ba0);  // gagagagaga...
+  const __m256i rb2 = _mm256_and_si256(rb1, mask_0xf0);
+  const __m256i ga2 = _mm256_srli_epi16(_mm256_and_si256(ga1, mask_0xf0), 4);
+  const __m256i rgba4444 = _mm256_or_si256(rb2, ga2);
+  _mm256_storeu_si256((__m256i*)dst, rgba4444);
+}
+
+// Pack R/G/B results into 16b output.
+static WEBP_INLINE void PackAndStore565_AVX2(const __m256i* const R,
+                                             const __m256i* const G,
+                                             const __m256i* const B,
+                                             uint8_t* WEBP_RESTRICT const dst) {
+  const __m256i r0 = _mm256_packus_epi16(*R, *R);
+  const __m256i g0 = _mm256_packus_epi16(*G, *G);
+  const __m256i b0 = _mm256_packus_epi16(*B, *B);
+  const __m256i r1 = _mm256_and_si256(r0, _mm256_set1_epi8((char)0xf8));
+  const __m256i b1 =
+      _mm256_and_si256(_mm256_srli_epi16(b0, 3), _mm256_set1_epi8(0x1f));
+  const __m256i g1 = _mm256_srli_epi16(
+      _mm256_and_si256(g0, _mm256_set1_epi8((char)0xe0)), 5);
+  const __m256i g2 =
+      _mm256_slli_epi16(_mm256_and_si256(g0, _mm256_set1_epi8(0x1c)), 3);
+  const __m256i rg = _mm256_or_si256(r1, g1);
+  const __m256i gb = _mm256_or_si256(g2, b1);
+#if (WEBP_SWAP_16BIT_CSP == 0)
+  const __m256i rgb565 = _mm256_unpacklo_epi8(rg, gb);
+#else
+  const __m256i rgb565 = _mm256_unpacklo_epi8(gb, rg);
+#endif
+  _mm256_storeu_si256((__m256i*)dst, rgb565);
+}
+
+// Pack two registers of sixteen 16b values into 32 ordered bytes.
+static WEBP_INLINE __m256i Pack32_AVX2(const __m256i* const A,
+                                       const __m256i* const B) {
+  return _mm256_permute4x64_epi64(_mm256_packus_epi16(*A, *B),
+                                  _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// Returns the 16 bytes shuffle mask 'A', replicated in both lanes.
+#define MK_MASK(A0, A1, A2, A3, A4, A5, A6, A7, A8, A9, A10, A11, A12, A13, \
+                A14, A15)                                                   \
+  _mm256_broadcastsi128_si256(_mm_setr_epi8(A0, A1, A2, A3, A4, A5, A6, A7, \
+                                            A8, A9, A10, A11, A12, A13, A14, \
+                                            A15))
+
+// Pack the planar R/G/B results of 32 pixels as RGBRGBRGB...
+// Each lane produces the 48 bytes of its 16 pixels, as three 16 bytes chunks.
+static WEBP_INLINE void PackAndStore24b_AVX2(
+    const __m256i* const R0, const __m256i* const R1, const __m256i* const G0,
+    const __m256i* const G1, const __m256i* const B0, const __m256i* const B1,
+    uint8_t* WEBP_RESTRICT const rgb) {
+  const __m256i R = Pack32_AVX2(R0, R1);
+  const __m256i G = Pack32_AVX2(G0, G1);
+  const __m256i B = Pack32_AVX2(B0, B1);
+  __m256i out0, out1, out2;
+  {
+    const __m256i r = MK_MASK(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4,
+                              -1, -1, 5);
+    const __m256i g = MK_MASK(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1,
+                              4, -1, -1);
+    const __m256i b = MK_MASK(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1,
+                              -1, 4, -1);
+    out0 = _mm256_or_si256(
+        _mm256_or_si256(_mm256_shuffle_epi8(R, r), _mm256_shuffle_epi8(G, g)),
+        _mm256_shuffle_epi8(B, b));
+  }
+  {
+    const __m256i r = MK_MASK(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1,
+                              -1, 10, -1);
+    const __m256i g = MK_MASK(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9,
+                              -1, -1, 10);
+    const __m256i b = MK_MASK(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1,
+                              9, -1, -1);
+    out1 = _mm256_or_si256(
+        _mm256_or_si256(_mm256_shuffle_epi8(R, r), _mm256_shuffle_epi8(G, g)),
+        _mm256_shuffle_epi8(B, b));
+  }
+  {
+    const __m256i r = MK_MASK(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1,
+                              -1, 15, -1, -1);
+    const __m256i g = MK_MASK(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14,
+                              -1, -1, 15, -1);
+    const __m256i b = MK_MASK(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1,
+                              14, -1, -1, 15);
+    out2 = _mm256_or_si256(
+        _mm256_or_si256(_mm256_shuffle_epi8(R, r), _mm256_shuffle_epi8(G, g)),
+        _mm256_shuffle_epi8(B, b));
+  }
+  _mm256_storeu_si256((__m256i*)(rgb + 0),
+                      _mm256_permute2x128_si256(out0, out1, 0x20));
+  _mm256_storeu_si256((__m256i*)(rgb + 32),
+                      _mm256_permute2x128_si256(out2, out0, 0x30));
+  _mm256_storeu_si256((__m256i*)(rgb + 64),
+                      _mm256_permute2x128_si256(out1, out2, 0x31));
+}
+
+#undef MK_MASK
+
+void VP8YuvToRgba32_AVX2(const uint8_t* WEBP_RESTRICT y,
+                         const uint8_t* WEBP_RESTRICT u,
+                         const uint8_t* WEBP_RESTRICT v,
+                         uint8_t* WEBP_RESTRICT dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV444ToRGB_AVX2(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4_AVX2(&R, &G, &B, &kAlpha, dst);
+  }
+}
+
+void VP8YuvToBgra32_AVX2(const uint8_t* WEBP_RESTRICT y,
+                         const uint8_t* WEBP_RESTRICT u,
+                         const uint8_t* WEBP_RESTRICT v,
+                         uint8_t* WEBP_RESTRICT dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV444ToRGB_AVX2(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4_AVX2(&B, &G, &R, &kAlpha, dst);
+  }
+}
+
+void VP8YuvToArgb32_AVX2(const uint8_t* WEBP_RESTRICT y,
+                         const uint8_t* WEBP_RESTRICT u,
+                         const uint8_t* WEBP_RESTRICT v,
+                         uint8_t* WEBP_RESTRICT dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV444ToRGB_AVX2(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4_AVX2(&kAlpha, &R, &G, &B, dst);
+  }
+}
+
+void VP8YuvToRgba444432_AVX2(const uint8_t* WEBP_RESTRICT y,
+                             const uint8_t* WEBP_RESTRICT u,
+                             const uint8_t* WEBP_RESTRICT v,
+                             uint8_t* WEBP_RESTRICT dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 32) {
+    __m256i R, G, B;
+    YUV444ToRGB_AVX2(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4444_AVX2(&R, &G, &B, &kAlpha, dst);
+  }
+}
+
+void VP8YuvToRgb56532_AVX2(const uint8_t* WEBP_RESTRICT y,
+                           const uint8_t* WEBP_RESTRICT u,
+                           const uint8_t* WEBP_RESTRICT v,
+                           uint8_t* WEBP_RESTRICT dst) {
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 32) {
+    __m256i R, G, B;
+    YUV444ToRGB_AVX2(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore565_AVX2(&R, &G, &B, dst);
+  }
+}
+
+void VP8YuvToRgb32_AVX2(const uint8_t* WEBP_RESTRICT y,
+                        const uint8_t* WEBP_RESTRICT u,
+                        const uint8_t* WEBP_RESTRICT v,
+                        uint8_t* WEBP_RESTRICT dst) {
+  __m256i R0, R1, G0, G1, B0, B1;
+  YUV444ToRGB_AVX2(y + 0, u + 0, v + 0, &R0, &G0, &B0);
+  YUV444ToRGB_AVX2(y + 16, u + 16, v + 16, &R1, &G1, &B1);
+  PackAndStore24b_AVX2(&R0, &R1, &G0, &G1, &B0, &B1, dst);
+}
+
+void VP8YuvToBgr32_AVX2(const uint8_t* WEBP_RESTRICT y,
+                        const uint8_t* WEBP_RESTRICT u,
+                        const uint8_t* WEBP_RESTRICT v,
+                        uint8_t* WEBP_RESTRICT dst) {
+  __m256i R0, R1, G0, G1, B0, B1;
+  YUV444ToRGB_AVX2(y + 0, u + 0, v + 0, &R0, &G0, &B0);
+  YUV444ToRGB_AVX2(y + 16, u + 16, v + 16, &R1, &G1, &B1);
+  PackAndStore24b_AVX2(&B0, &B1, &G0, &G1, &R0, &R1, dst);
+}
+
+//-----------------------------------------------------------------------------
+// Arbitrary-length row conversion functions
+
+static void YuvToRgbaRow_AVX2(const uint8_t* WEBP_RESTRICT y,
+                              const uint8_t* WEBP_RESTRICT u,
+                              const uint8_t* WEBP_RESTRICT v,
+                              uint8_t* WEBP_RESTRICT dst, int len) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV420ToRGB_AVX2(y, u, v, &R, &G, &B);
+    PackAndStore4_AVX2(&R, &G, &B, &kAlpha, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+  }
+  for (; n < len; ++n) {  // Finish off
+    VP8YuvToRgba(y[0], u[0], v[0], dst);
+    dst += 4;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToBgraRow_AVX2(const uint8_t* WEBP_RESTRICT y,
+                              const uint8_t* WEBP_RESTRICT u,
+                              const uint8_t* WEBP_RESTRICT v,
+                              uint8_t* WEBP_RESTRICT dst, int len) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV420ToRGB_AVX2(y, u, v, &R, &G, &B);
+    PackAndStore4_AVX2(&B, &G, &R, &kAlpha, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+  }
+  for (; n < len; ++n) {  // Finish off
+    VP8YuvToBgra(y[0], u[0], v[0], dst);
+    dst += 4;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToArgbRow_AVX2(const uint8_t* WEBP_RESTRICT y,
+                              const uint8_t* WEBP_RESTRICT u,
+                              const uint8_t* WEBP_RESTRICT v,
+                              uint8_t* WEBP_RESTRICT dst, int len) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV420ToRGB_AVX2(y, u, v, &R, &G, &B);
+    PackAndStore4_AVX2(&kAlpha, &R, &G, &B, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+  }
+  for (; n < len; ++n) {  // Finish off
+    VP8YuvToArgb(y[0], u[0], v[0], dst);
+    dst += 4;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToRgbRow_AVX2(const uint8_t* WEBP_RESTRICT y,
+                             const uint8_t* WEBP_RESTRICT u,
+                             const uint8_t* WEBP_RESTRICT v,
+                             uint8_t* WEBP_RESTRICT dst, int len) {
+  int n;
+  for (n = 0; n + 32 <= len; n += 32, dst += 32 * 3) {
+    __m256i R0, R1, G0, G1, B0, B1;
+    YUV420ToRGB_AVX2(y + 0, u + 0, v + 0, &R0, &G0, &B0);
+    YUV420ToRGB_AVX2(y + 16, u + 8, v + 8, &R1, &G1, &B1);
+    PackAndStore24b_AVX2(&R0, &R1, &G0, &G1, &B0, &B1, dst);
+    y += 32;
+    u += 16;
+    v += 16;
+  }
+  for (; n < len; ++n) {  // Finish off
+    VP8YuvToRgb(y[0], u[0], v[0], dst);
+    dst += 3;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToBgrRow_AVX2(const uint8_t* WEBP_RESTRICT y,
+                             const uint8_t* WEBP_RESTRICT u,
+                             const uint8_t* WEBP_RESTRICT v,
+                             uint8_t* WEBP_RESTRICT dst, int len) {
+  int n;
+  for (n = 0; n + 32 <= len; n += 32, dst += 32 * 3) {
+    __m256i R0, R1, G0, G1, B0, B1;
+    YUV420ToRGB_AVX2(y + 0, u + 0, v + 0, &R0, &G0, &B0);
+    YUV420ToRGB_AVX2(y + 16, u + 8, v + 8, &R1, &G1, &B1);
+    PackAndStore24b_AVX2(&B0, &B1, &G0, &G1, &R0, &R1, dst);
+    y += 32;
+    u += 16;
+    v += 16;
+  }
+  for (; n < len; ++n) {  // Finish off
+    VP8YuvToBgr(y[0], u[0], v[0], dst);
+    dst += 3;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPInitSamplersAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPInitSamplersAVX2(void) {
+  WebPSamplers[MODE_RGB] = YuvToRgbRow_AVX2;
+  WebPSamplers[MODE_RGBA] = YuvToRgbaRow_AVX2;
+  WebPSamplers[MODE_BGR] = YuvToBgrRow_AVX2;
+  WebPSamplers[MODE_BGRA] = YuvToBgraRow_AVX2;
+  WebPSamplers[MODE_ARGB] = YuvToArgbRow_AVX2;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(WebPInitSamplersAVX2)
+
+#endif  // WEBP_USE_AVX2
@@ -87,7 +87,7 @@ static int EncodeLossless(const uint8_t* const data, int width, int height,
       (use_quality_100 && effort_level == 6) ? 100 : 8.f * effort_level;
   assert(config.quality >= 0 && config.quality <= 100.f);
 
-  ok = VP8LEncodeStream(&config, &picture, bw);
+  ok = VP8LEncodeStream(&config, &picture, bw, /*context=*/NULL);
   WebPPictureFree(&picture);
   ok = ok && !bw->error;
   if (!ok) {
@@ -401,6 +401,7 @@ void VP8EncInitAlpha(VP8Encoder* const enc) {
   if (enc->thread_level > 0) {
     WebPWorker* const worker = &enc->alpha_worker;
     WebPGetWorkerInterface()->Init(worker);
+    worker->pool = enc->pic->thread_pool;
     worker->data1 = enc;
     worker->data2 = NULL;
     worker->hook = CompressAlphaJob;
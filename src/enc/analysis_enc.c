@@ -27,18 +27,23 @@
 
 //------------------------------------------------------------------------------
 // Smooth the segment map by replacing isolated block by the majority of its
-// neighbours.
+// neighbours. Only the rows in [first_row, last_row) are considered, and the
+// ones which have no neighbour below in this range are left untouched.
 
-static void SmoothSegmentMap(VP8Encoder* const enc) {
+static void SmoothSegmentMap(VP8Encoder* const enc, int first_row,
+                             int last_row) {
   int n, x, y;
   const int w = enc->mb_w;
-  const int h = enc->mb_h;
+  const int y_start = (first_row > 1) ? first_row : 1;
+  const int y_end = last_row - 1;
   const int majority_cnt_3_x_3_grid = 5;
-  uint8_t* const tmp = (uint8_t*)WebPSafeMalloc(w * h, sizeof(*tmp));
-  assert((uint64_t)(w * h) == (uint64_t)w * h);  // no overflow, as per spec
+  uint8_t* tmp;
+  assert((uint64_t)(w * enc->mb_h) == (uint64_t)w * enc->mb_h);  // as per spec
 
+  if (y_start >= y_end) return;
+  tmp = (uint8_t*)WebPSafeMalloc(w * (y_end - y_start), sizeof(*tmp));
   if (tmp == NULL) return;
-  for (y = 1; y < h - 1; ++y) {
+  for (y = y_start; y < y_end; ++y) {
     for (x = 1; x < w - 1; ++x) {
       int cnt[NUM_MB_SEGMENTS] = {0};
       const VP8MBInfo* const mb = &enc->mb_info[x + w * y];
@@ -58,13 +63,13 @@ static void SmoothSegmentMap(VP8Encoder* const enc) {
           break;
         }
       }
-      tmp[x + y * w] = majority_seg;
+      tmp[x + (y - y_start) * w] = majority_seg;
     }
   }
-  for (y = 1; y < h - 1; ++y) {
+  for (y = y_start; y < y_end; ++y) {
     for (x = 1; x < w - 1; ++x) {
       VP8MBInfo* const mb = &enc->mb_info[x + w * y];
-      mb->segment = tmp[x + y * w];
+      mb->segment = tmp[x + (y - y_start) * w];
     }
   }
   WebPSafeFree(tmp);
@@ -130,10 +135,11 @@ static void InitHistogram(VP8Histogram* const histo) {
 }
 
 //------------------------------------------------------------------------------
-// Simplified k-Means, to assign Nb segments based on alpha-histogram
+// Simplified k-Means, to assign Nb segments based on alpha-histogram.
+// The macroblocks of the rows in [0, last_row) are assigned their segment.
 
 static void AssignSegments(VP8Encoder* const enc,
-                           const int alphas[MAX_ALPHA + 1]) {
+                           const int alphas[MAX_ALPHA + 1], int last_row) {
   // 'num_segments' is previously validated and <= NUM_MB_SEGMENTS, but an
   // explicit check is needed to avoid spurious warning about 'n + 1' exceeding
   // array bounds of 'centers' with some compilers (noticed with gcc-4.9).
@@ -206,7 +212,7 @@ static void AssignSegments(VP8Encoder* const enc,
   }
 
   // Map each original value to the closest centroid
-  for (n = 0; n < enc->mb_w * enc->mb_h; ++n) {
+  for (n = 0; n < enc->mb_w * last_row; ++n) {
     VP8MBInfo* const mb = &enc->mb_info[n];
     const int alpha = mb->alpha;
     mb->segment = map[alpha];
@@ -215,12 +221,40 @@ static void AssignSegments(VP8Encoder* const enc,
 
   if (nb > 1) {
     const int smooth = (enc->config->preprocessing & 1);
-    if (smooth) SmoothSegmentMap(enc);
+    if (smooth) SmoothSegmentMap(enc, 0, last_row);
   }
 
+  for (n = 0; n < nb; ++n) enc->segment_centers[n] = centers[n];
   SetSegmentAlphas(enc, centers, weighted_average);  // pick some alphas.
 }
 
+// Assigns the macroblocks of the rows in [first_row, last_row) to the segment
+// with the closest center, once AssignSegments() has decided the centers.
+// Without a segment map, everything goes to the first segment.
+static void AssignNearestSegments(VP8Encoder* const enc, int first_row,
+                                  int last_row) {
+  const int nb = !enc->segment_hdr.update_map ? 1
+                 : (enc->segment_hdr.num_segments < NUM_MB_SEGMENTS)
+                     ? enc->segment_hdr.num_segments
+                     : NUM_MB_SEGMENTS;
+  const int* const centers = enc->segment_centers;
+  int n, k;
+
+  for (n = first_row * enc->mb_w; n < last_row * enc->mb_w; ++n) {
+    VP8MBInfo* const mb = &enc->mb_info[n];
+    const int alpha = mb->alpha;
+    int best = 0;
+    for (k = 1; k < nb; ++k) {
+      if (abs(alpha - centers[k]) < abs(alpha - centers[best])) best = k;
+    }
+    mb->segment = best;
+    mb->alpha = centers[best];
+  }
+  if (nb > 1 && (enc->config->preprocessing & 1)) {
+    SmoothSegmentMap(enc, first_row, last_row);
+  }
+}
+
 //------------------------------------------------------------------------------
 // Macroblock analysis: collect histogram for each mode, deduce the maximal
 // susceptibility and set best modes for this macroblock.
@@ -359,9 +393,9 @@ static void DefaultMBInfo(VP8MBInfo* const mb) {
 // and decide intra4/intra16, but that's usually almost always a bad choice at
 // this stage.
 
-static void ResetAllMBInfo(VP8Encoder* const enc) {
+static void ResetMBInfo(VP8Encoder* const enc, int first_row, int last_row) {
   int n;
-  for (n = 0; n < enc->mb_w * enc->mb_h; ++n) {
+  for (n = first_row * enc->mb_w; n < last_row * enc->mb_w; ++n) {
     DefaultMBInfo(&enc->mb_info[n]);
   }
   // Default susceptibilities.
@@ -370,7 +404,9 @@ static void ResetAllMBInfo(VP8Encoder* const enc) {
   // Note: we can't compute this 'alpha' / 'uv_alpha' -> set to default value.
   enc->alpha = 0;
   enc->uv_alpha = 0;
-  WebPReportProgress(enc->pic, enc->percent + 20, &enc->percent);
+  if (first_row == 0) {
+    WebPReportProgress(enc->pic, enc->percent + 20, &enc->percent);
+  }
 }
 
 // struct used to collect job result
@@ -413,10 +449,11 @@ static void MergeJobs(const SegmentJob* const src, SegmentJob* const dst) {
 static void InitSegmentJob(VP8Encoder* const enc, SegmentJob* const job,
                            int start_row, int end_row) {
   WebPGetWorkerInterface()->Init(&job->worker);
+  job->worker.pool = enc->pic->thread_pool;
   job->worker.data1 = job;
   job->worker.data2 = &job->it;
   job->worker.hook = DoSegmentsJob;
-  VP8IteratorInit(enc, &job->it);
+  VP8IteratorInitLocal(enc, &job->it);
   VP8IteratorSetRow(&job->it, start_row);
   VP8IteratorSetCountDown(&job->it, (end_row - start_row) * enc->mb_w);
   memset(job->alphas, 0, sizeof(job->alphas));
@@ -427,61 +464,95 @@ static void InitSegmentJob(VP8Encoder* const enc, SegmentJob* const job,
   job->delta_progress = (start_row == 0) ? 20 : 0;
 }
 
-// main entry point
-int VP8EncAnalyze(VP8Encoder* const enc) {
+static int DoSegments(const VP8Encoder* const enc) {
+  return enc->config->emulate_jpeg_size ||  // We need the complexity evaluation
+         (enc->segment_hdr.num_segments > 1) ||
+         (enc->method <= 1);  // for method 0 - 1, we need preds[] to be filled.
+}
+
+// Analyzes the rows in [first_row, last_row) and collects the result in
+// 'main_job'. Returns false in case of error.
+static int AnalyzeRows(VP8Encoder* const enc, int first_row, int last_row,
+                       SegmentJob* const main_job) {
   int ok = 1;
-  const int do_segments =
-      enc->config->emulate_jpeg_size ||  // We need the complexity evaluation.
-      (enc->segment_hdr.num_segments > 1) ||
-      (enc->method <= 1);  // for method 0 - 1, we need preds[] to be filled.
-  if (do_segments) {
-    const int last_row = enc->mb_h;
-    const int total_mb = last_row * enc->mb_w;
 #ifdef WEBP_USE_THREAD
-    // We give a little more than a half work to the main thread.
-    const int split_row = (9 * last_row + 15) >> 4;
-    const int kMinSplitRow = 2;  // minimal rows needed for mt to be worth it
-    const int do_mt = (enc->thread_level > 0) && (split_row >= kMinSplitRow);
+  // We give a little more than a half work to the main thread.
+  const int split_row = first_row + ((9 * (last_row - first_row) + 15) >> 4);
+  const int kMinSplitRow = 2;  // minimal rows needed for mt to be worth it
+  const int do_mt =
+      (enc->thread_level > 0) && (split_row - first_row >= kMinSplitRow);
 #else
-    const int do_mt = 0;
+  const int do_mt = 0;
 #endif
-    const WebPWorkerInterface* const worker_interface =
-        WebPGetWorkerInterface();
-    SegmentJob main_job;
-    if (do_mt) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  if (do_mt) {
 #ifdef WEBP_USE_THREAD
-      SegmentJob side_job;
-      // Note the use of '&' instead of '&&' because we must call the functions
-      // no matter what.
-      InitSegmentJob(enc, &main_job, 0, split_row);
-      InitSegmentJob(enc, &side_job, split_row, last_row);
-      // we don't need to call Reset() on main_job.worker, since we're calling
-      // WebPWorkerExecute() on it
-      ok &= worker_interface->Reset(&side_job.worker);
-      // launch the two jobs in parallel
-      if (ok) {
-        worker_interface->Launch(&side_job.worker);
-        worker_interface->Execute(&main_job.worker);
-        ok &= worker_interface->Sync(&side_job.worker);
-        ok &= worker_interface->Sync(&main_job.worker);
-      }
-      worker_interface->End(&side_job.worker);
-      if (ok) MergeJobs(&side_job, &main_job);  // merge results together
-#endif                                          // WEBP_USE_THREAD
-    } else {
-      // Even for single-thread case, we use the generic Worker tools.
-      InitSegmentJob(enc, &main_job, 0, last_row);
-      worker_interface->Execute(&main_job.worker);
-      ok &= worker_interface->Sync(&main_job.worker);
+    SegmentJob side_job;
+    // Note the use of '&' instead of '&&' because we must call the functions
+    // no matter what.
+    InitSegmentJob(enc, main_job, first_row, split_row);
+    InitSegmentJob(enc, &side_job, split_row, last_row);
+    // we don't need to call Reset() on main_job->worker, since we're calling
+    // WebPWorkerExecute() on it
+    ok &= worker_interface->Reset(&side_job.worker);
+    // launch the two jobs in parallel
+    if (ok) {
+      worker_interface->Launch(&side_job.worker);
+      worker_interface->Execute(&main_job->worker);
+      ok &= worker_interface->Sync(&side_job.worker);
+      ok &= worker_interface->Sync(&main_job->worker);
     }
-    worker_interface->End(&main_job.worker);
+    worker_interface->End(&side_job.worker);
+    if (ok) MergeJobs(&side_job, main_job);  // merge results together
+#endif                                       // WEBP_USE_THREAD
+  } else {
+    // Even for single-thread case, we use the generic Worker tools.
+    InitSegmentJob(enc, main_job, first_row, last_row);
+    worker_interface->Execute(&main_job->worker);
+    ok &= worker_interface->Sync(&main_job->worker);
+  }
+  worker_interface->End(&main_job->worker);
+  return ok;
+}
+
+// main entry point
+int VP8EncAnalyze(VP8Encoder* const enc) {
+  int ok = 1;
+  if (DoSegments(enc)) {
+    const int total_mb = enc->mb_h * enc->mb_w;
+    SegmentJob main_job;
+    ok = AnalyzeRows(enc, 0, enc->mb_h, &main_job);
     if (ok) {
       enc->alpha = main_job.alpha / total_mb;
       enc->uv_alpha = main_job.uv_alpha / total_mb;
-      AssignSegments(enc, main_job.alphas);
+      AssignSegments(enc, main_job.alphas, enc->mb_h);
     }
   } else {  // Use only one default segment.
-    ResetAllMBInfo(enc);
+    ResetMBInfo(enc, 0, enc->mb_h);
+  }
+  if (!ok) {
+    return WebPEncodingSetError(enc->pic,
+                                VP8_ENC_ERROR_OUT_OF_MEMORY);  // imprecise
+  }
+  return ok;
+}
+
+int VP8EncAnalyzeRows(VP8Encoder* const enc, int first_row, int last_row) {
+  int ok = 1;
+  if (DoSegments(enc)) {
+    SegmentJob main_job;
+    ok = AnalyzeRows(enc, first_row, last_row, &main_job);
+    if (ok && first_row == 0) {
+      // The first rows decide the complexity and the segments.
+      const int total_mb = last_row * enc->mb_w;
+      enc->alpha = main_job.alpha / total_mb;
+      enc->uv_alpha = main_job.uv_alpha / total_mb;
+      AssignSegments(enc, main_job.alphas, last_row);
+    } else if (ok) {
+      AssignNearestSegments(enc, first_row, last_row);
+    }
+  } else {
+    ResetMBInfo(enc, first_row, last_row);
   }
   if (!ok) {
     return WebPEncodingSetError(enc->pic,
@@ -127,6 +127,28 @@ void VP8LBackwardRefsInit(VP8LBackwardRefs* const refs, int block_size) {
       (block_size < MIN_BLOCK_SIZE) ? MIN_BLOCK_SIZE : block_size;
 }
 
+void VP8LBackwardRefsReset(VP8LBackwardRefs* const refs, int block_size) {
+  assert(refs != NULL);
+  if (block_size < MIN_BLOCK_SIZE) block_size = MIN_BLOCK_SIZE;
+  if (refs->block_size == block_size) {
+    VP8LClearBackwardRefs(refs);
+    refs->error = 0;
+  } else {
+    VP8LBackwardRefsClear(refs);
+    VP8LBackwardRefsInit(refs, block_size);
+  }
+}
+
+size_t VP8LBackwardRefsMemorySize(const VP8LBackwardRefs* const refs) {
+  const size_t block_size =
+      sizeof(PixOrCopyBlock) + refs->block_size * sizeof(PixOrCopy);
+  size_t num_blocks = 0;
+  const PixOrCopyBlock* b;
+  for (b = refs->refs; b != NULL; b = b->next) ++num_blocks;
+  for (b = refs->free_blocks; b != NULL; b = b->next) ++num_blocks;
+  return num_blocks * block_size;
+}
+
 VP8LRefsCursor VP8LRefsCursorInit(const VP8LBackwardRefs* const refs) {
   VP8LRefsCursor c;
   c.cur_block = refs->refs;
@@ -252,44 +274,30 @@ static WEBP_INLINE int MaxFindCopyLength(int len) {
   return (len < MAX_LENGTH) ? len : MAX_LENGTH;
 }
 
-int VP8LHashChainFill(VP8LHashChain* const p, int quality,
-                      const uint32_t* const argb, int xsize, int ysize,
-                      int low_effort, const WebPPicture* const pic,
-                      int percent_range, int* const percent) {
-  const int size = xsize * ysize;
-  const int iter_max = GetMaxItersForQuality(quality);
-  const uint32_t window_size = GetWindowSizeForHashChain(quality, xsize);
-  int remaining_percent = percent_range;
-  int percent_start = *percent;
-  int pos;
-  int argb_comp;
-  uint32_t base_position;
-  int32_t* hash_to_first_index;
-  // Temporarily use the p->offset_length as a hash chain.
-  int32_t* chain = (int32_t*)p->offset_length;
-  assert(size > 0);
-  assert(p->size != 0);
-  assert(p->offset_length != NULL);
-
-  if (size <= 2) {
-    p->offset_length[0] = p->offset_length[size - 1] = 0;
-    return 1;
+// Returns the first position from 'pos' which is not inside a run of identical
+// pixels hashed together by LinkPixels(), i.e. the first position at which
+// LinkPixels() may start.
+static int SkipRunInterior(const uint32_t* const argb, int size, int pos) {
+  while (pos > 0 && pos + 2 < size && argb[pos - 1] == argb[pos] &&
+         argb[pos] == argb[pos + 1] && argb[pos] == argb[pos + 2]) {
+    ++pos;
   }
+  return pos;
+}
 
-  hash_to_first_index =
-      (int32_t*)WebPSafeMalloc(HASH_SIZE, sizeof(*hash_to_first_index));
-  if (hash_to_first_index == NULL) {
-    return WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
-  }
-
-  percent_range = remaining_percent / 2;
-  remaining_percent -= percent_range;
-
-  // Set the int32_t array to -1.
-  memset(hash_to_first_index, 0xff, HASH_SIZE * sizeof(*hash_to_first_index));
-  // Fill the chain linking pixels with the same hash.
-  argb_comp = (argb[0] == argb[1]);
-  for (pos = 0; pos < size - 2;) {
+// Fills the 'chain' linking the pixels from 'start' with the previous pixels
+// of same hash, as found in 'hash_to_first_index' which is updated. Stops at
+// the first position at or after 'end' where linking may start again, which
+// is stored in 'end_pos'. pic and percent are for progress.
+// Returns false in case of user abort.
+static int LinkPixels(const uint32_t* const argb, int size, int start, int end,
+                      int32_t* const chain, int32_t* const hash_to_first_index,
+                      const WebPPicture* const pic, int percent_range,
+                      int* const percent, int* const end_pos) {
+  const int percent_start = (percent != NULL) ? *percent : 0;
+  int pos;
+  int argb_comp = (argb[start] == argb[start + 1]);
+  for (pos = start; pos < end;) {
     uint32_t hash_code;
     const int argb_comp_next = (argb[pos + 1] == argb[pos + 2]);
     if (argb_comp && argb_comp_next) {
@@ -333,10 +341,358 @@ int VP8LHashChainFill(VP8LHashChain* const p, int quality,
 
     if (!WebPReportProgress(
             pic, percent_start + percent_range * pos / (size - 2), percent)) {
-      WebPSafeFree(hash_to_first_index);
       return 0;
     }
   }
+  *end_pos = pos;
+  return 1;
+}
+
+// Finds the best match interval at 'base_position', defined by an offset to
+// the pixel and a length, using the 'chain' of the pixels with the same hash.
+// The match is stored in 'offset_length' along with the ones of the pixels on
+// its left it extends to, down to 'min_position'. Returns the position of the
+// next pixel to search.
+static uint32_t FindMatches(const int32_t* const chain,
+                            const uint32_t* const argb, int xsize, int size,
+                            int iter_max, uint32_t window_size, int low_effort,
+                            uint32_t base_position, uint32_t min_position,
+                            uint32_t* const offset_length) {
+  const int max_len = MaxFindCopyLength(size - 1 - base_position);
+  const uint32_t* const argb_start = argb + base_position;
+  int iter = iter_max;
+  int best_length = 0;
+  uint32_t best_distance = 0;
+  uint32_t best_argb;
+  const int min_pos =
+      (base_position > window_size) ? base_position - window_size : 0;
+  const int length_max = (max_len < 256) ? max_len : 256;
+  uint32_t max_base_position;
+  int pos;
+
+  pos = chain[base_position];
+  if (!low_effort) {
+    int curr_length;
+    // Heuristic: use the comparison with the above line as an initialization.
+    if (base_position >= (uint32_t)xsize) {
+      curr_length =
+          FindMatchLength(argb_start - xsize, argb_start, best_length, max_len);
+      if (curr_length > best_length) {
+        best_length = curr_length;
+        best_distance = xsize;
+      }
+      --iter;
+    }
+    // Heuristic: compare to the previous pixel.
+    curr_length =
+        FindMatchLength(argb_start - 1, argb_start, best_length, max_len);
+    if (curr_length > best_length) {
+      best_length = curr_length;
+      best_distance = 1;
+    }
+    --iter;
+    // Skip the for loop if we already have the maximum.
+    if (best_length == MAX_LENGTH) pos = min_pos - 1;
+  }
+  best_argb = argb_start[best_length];
+
+  for (; pos >= min_pos && --iter; pos = chain[pos]) {
+    int curr_length;
+    assert(base_position > (uint32_t)pos);
+
+    if (argb[pos + best_length] != best_argb) continue;
+
+    curr_length = VP8LVectorMismatch(argb + pos, argb_start, max_len);
+    if (best_length < curr_length) {
+      best_length = curr_length;
+      best_distance = base_position - pos;
+      best_argb = argb_start[best_length];
+      // Stop if we have reached a good enough length.
+      if (best_length >= length_max) break;
+    }
+  }
+  // We have the best match but in case the two intervals continue matching
+  // to the left, we have the best matches for the left-extended pixels.
+  max_base_position = base_position;
+  while (1) {
+    assert(best_length <= MAX_LENGTH);
+    assert(best_distance <= WINDOW_SIZE);
+    offset_length[base_position] =
+        (best_distance << MAX_LENGTH_BITS) | (uint32_t)best_length;
+    --base_position;
+    // Stop if we don't have a match or if we are out of bounds.
+    if (best_distance == 0 || base_position == 0 ||
+        base_position < min_position) {
+      break;
+    }
+    // Stop if we cannot extend the matching intervals to the left.
+    if (base_position < best_distance ||
+        argb[base_position - best_distance] != argb[base_position]) {
+      break;
+    }
+    // Stop if we are matching at its limit because there could be a closer
+    // matching interval with the same maximum length. Then again, if the
+    // matching interval is as close as possible (best_distance == 1), we will
+    // never find anything better so let's continue.
+    if (best_length == MAX_LENGTH && best_distance != 1 &&
+        base_position + MAX_LENGTH < max_base_position) {
+      break;
+    }
+    if (best_length < MAX_LENGTH) {
+      ++best_length;
+      max_base_position = base_position;
+    }
+  }
+  return base_position;
+}
+
+// -----------------------------------------------------------------------------
+// Filling by chunks
+//
+// With a worker team, the image is split into chunks of consecutive pixels.
+// Their hash chains are first built independently, each with its own hash
+// table, and then stitched to the previous chunks. The hash tables are taken
+// from p->offset_length, which is not used before the match search, so the
+// only extra memory is the chain, kept apart as the search of a chunk reads
+// the chain of the previous ones while they write their matches. The matches are then found
+// from the top of each chunk, while the left extension of the last match of a
+// chunk is cut at its bottom. The serial search is finally resumed at each
+// cut: it meets again the search of the chunk below at one of its first
+// positions in most cases, from which the result is the same.
+// The hash chain is identical to the one of the serial fill.
+
+// In pixels. It also makes the hash tables of the chunks fit in
+// p->offset_length.
+#define HASH_CHAIN_MIN_CHUNK_SIZE HASH_SIZE
+#define HASH_CHAIN_MAX_CHUNKS 16
+#define HASH_CHAIN_NUM_SYNC_VISITS 16
+
+typedef struct {
+  int link_start, link_end;          // positions linked in the chain
+  int32_t* hash_to_last_index;       // for the positions up to link_end
+  uint32_t match_start, match_end;   // positions searched for matches
+  // First positions searched from match_end, in decreasing order.
+  uint32_t visits[HASH_CHAIN_NUM_SYNC_VISITS];
+  int num_visits;
+  uint32_t last_visit;  // last position searched, whose extension may be cut
+} HashChainChunk;
+
+typedef struct {
+  const uint32_t* argb;
+  int xsize, size;
+  int iter_max;
+  uint32_t window_size;
+  int low_effort;
+  int32_t* chain;
+  uint32_t* offset_length;
+  HashChainChunk chunks[HASH_CHAIN_MAX_CHUNKS];
+} HashChainJob;
+
+static int LinkChunksHook(void* data, int start, int end, int worker_id) {
+  HashChainJob* const job = (HashChainJob*)data;
+  int i;
+  (void)worker_id;
+  for (i = start; i < end; ++i) {
+    HashChainChunk* const chunk = &job->chunks[i];
+    // Set the int32_t array to -1.
+    memset(chunk->hash_to_last_index, 0xff,
+           HASH_SIZE * sizeof(*chunk->hash_to_last_index));
+    if (chunk->link_start >= chunk->link_end) {
+      chunk->link_end = chunk->link_start;  // only made of a run interior
+      continue;
+    }
+    (void)LinkPixels(job->argb, job->size, chunk->link_start, chunk->link_end,
+                     job->chain, chunk->hash_to_last_index, /*pic=*/NULL, 0,
+                     /*percent=*/NULL, &chunk->link_end);
+  }
+  return 1;
+}
+
+// Links the first pixel of each hash in a chunk to the last one of the
+// previous chunks. The hash tables must contain the last position of each hash
+// up to the end of their chunk.
+static int StitchChunksHook(void* data, int start, int end, int worker_id) {
+  HashChainJob* const job = (HashChainJob*)data;
+  int i;
+  uint32_t hash_code;
+  (void)worker_id;
+  for (i = (start > 0) ? start : 1; i < end; ++i) {
+    const HashChainChunk* const chunk = &job->chunks[i];
+    const int32_t* const previous = job->chunks[i - 1].hash_to_last_index;
+    for (hash_code = 0; hash_code < HASH_SIZE; ++hash_code) {
+      int32_t pos = chunk->hash_to_last_index[hash_code];
+      if (pos < chunk->link_start) continue;  // not present in the chunk
+      while (job->chain[pos] >= 0) pos = job->chain[pos];
+      job->chain[pos] = previous[hash_code];
+    }
+  }
+  return 1;
+}
+
+static int MatchChunksHook(void* data, int start, int end, int worker_id) {
+  HashChainJob* const job = (HashChainJob*)data;
+  int i;
+  (void)worker_id;
+  for (i = start; i < end; ++i) {
+    HashChainChunk* const chunk = &job->chunks[i];
+    uint32_t base_position = chunk->match_end - 1;
+    chunk->num_visits = 0;
+    while (base_position > 0 && base_position >= chunk->match_start) {
+      if (chunk->num_visits < HASH_CHAIN_NUM_SYNC_VISITS) {
+        chunk->visits[chunk->num_visits++] = base_position;
+      }
+      chunk->last_visit = base_position;
+      base_position = FindMatches(
+          job->chain, job->argb, job->xsize, job->size, job->iter_max,
+          job->window_size, job->low_effort, base_position,
+          chunk->match_start, job->offset_length);
+    }
+  }
+  return 1;
+}
+
+// Returns true if 'chunk' searched 'base_position', as far as it is known.
+static int IsChunkVisit(const HashChainChunk* const chunk,
+                        uint32_t base_position) {
+  int i;
+  for (i = 0; i < chunk->num_visits; ++i) {
+    if (chunk->visits[i] == base_position) return 1;
+  }
+  return 0;
+}
+
+static int HashChainFillByChunks(VP8LHashChain* const p, int num_chunks,
+                                 WebPWorkerTeam* const team, int iter_max,
+                                 uint32_t window_size,
+                                 const uint32_t* const argb, int xsize,
+                                 int ysize, int low_effort,
+                                 const WebPPicture* const pic,
+                                 int percent_range, int* const percent) {
+  const int size = xsize * ysize;
+  const int percent_start = *percent;
+  HashChainJob job;
+  // Unlike in the serial fill, the chain must be kept until the end.
+  int32_t* const mem = (int32_t*)WebPSafeMalloc((uint64_t)size, sizeof(*mem));
+  uint32_t base_position;
+  int i, last;
+  uint32_t hash_code;
+  if (mem == NULL) return WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  assert((uint64_t)num_chunks * HASH_SIZE <= (uint64_t)size);
+
+  job.argb = argb;
+  job.xsize = xsize;
+  job.size = size;
+  job.iter_max = iter_max;
+  job.window_size = window_size;
+  job.low_effort = low_effort;
+  job.chain = mem;
+  job.offset_length = p->offset_length;
+  for (i = 0; i < num_chunks; ++i) {
+    HashChainChunk* const chunk = &job.chunks[i];
+    chunk->link_start = SkipRunInterior(
+        argb, size, (int)((int64_t)(size - 2) * i / num_chunks));
+    chunk->link_end = (int)((int64_t)(size - 2) * (i + 1) / num_chunks);
+    chunk->hash_to_last_index =
+        (int32_t*)p->offset_length + (size_t)i * HASH_SIZE;
+    chunk->match_start = (uint32_t)((int64_t)(size - 1) * i / num_chunks);
+    chunk->match_end = (uint32_t)((int64_t)(size - 1) * (i + 1) / num_chunks);
+  }
+
+  // Fill the chain linking pixels with the same hash.
+  (void)WebPWorkerTeamRun(team, num_chunks, LinkChunksHook, &job);
+  for (i = 1; i < num_chunks; ++i) {
+    int32_t* const previous = job.chunks[i - 1].hash_to_last_index;
+    int32_t* const current = job.chunks[i].hash_to_last_index;
+    assert(job.chunks[i - 1].link_end == job.chunks[i].link_start);
+    for (hash_code = 0; hash_code < HASH_SIZE; ++hash_code) {
+      if (current[hash_code] < 0) current[hash_code] = previous[hash_code];
+    }
+  }
+  (void)WebPWorkerTeamRun(team, num_chunks, StitchChunksHook, &job);
+  // Process the penultimate pixel.
+  last = job.chunks[num_chunks - 1].link_end;
+  assert(last == size - 2);
+  job.chain[last] = job.chunks[num_chunks - 1]
+                        .hash_to_last_index[GetPixPairHash64(argb + last)];
+  if (!WebPReportProgress(pic, percent_start + percent_range / 2, percent)) {
+    WebPSafeFree(mem);
+    return 0;
+  }
+
+  // Find the best match interval at each pixel. See VP8LHashChainFill().
+  p->offset_length[0] = p->offset_length[size - 1] = 0;
+  (void)WebPWorkerTeamRun(team, num_chunks, MatchChunksHook, &job);
+  // Resume the serial search at the cut of the top chunk, down to the first
+  // position also searched by a chunk. Then all the positions searched by the
+  // latter up to its cut are the same.
+  i = num_chunks - 1;
+  base_position = job.chunks[i].last_visit;
+  while (base_position > 0) {
+    while (base_position < job.chunks[i].match_start) --i;
+    if (IsChunkVisit(&job.chunks[i], base_position)) {
+      base_position = job.chunks[i].last_visit;
+    }
+    base_position = FindMatches(job.chain, argb, xsize, size, iter_max,
+                                window_size, low_effort, base_position, 0,
+                                p->offset_length);
+  }
+  WebPSafeFree(mem);
+  return WebPReportProgress(pic, percent_start + percent_range, percent);
+}
+
+// -----------------------------------------------------------------------------
+
+int VP8LHashChainFill(VP8LHashChain* const p, int quality,
+                      const uint32_t* const argb, int xsize, int ysize,
+                      int low_effort, WebPWorkerTeam* const team,
+                      const WebPPicture* const pic, int percent_range,
+                      int* const percent) {
+  const int size = xsize * ysize;
+  const int iter_max = GetMaxItersForQuality(quality);
+  const uint32_t window_size = GetWindowSizeForHashChain(quality, xsize);
+  int num_chunks = size / HASH_CHAIN_MIN_CHUNK_SIZE;
+  int remaining_percent = percent_range;
+  int percent_start = *percent;
+  int pos;
+  uint32_t base_position;
+  int32_t* hash_to_first_index;
+  // Temporarily use the p->offset_length as a hash chain.
+  int32_t* chain = (int32_t*)p->offset_length;
+  assert(size > 0);
+  assert(p->size != 0);
+  assert(p->offset_length != NULL);
+
+  if (size <= 2) {
+    p->offset_length[0] = p->offset_length[size - 1] = 0;
+    return 1;
+  }
+  if (team == NULL || num_chunks > team->num_workers) {
+    num_chunks = (team == NULL) ? 1 : team->num_workers;
+  }
+  if (num_chunks > HASH_CHAIN_MAX_CHUNKS) num_chunks = HASH_CHAIN_MAX_CHUNKS;
+  if (num_chunks > 1) {
+    return HashChainFillByChunks(p, num_chunks, team, iter_max, window_size,
+                                 argb, xsize, ysize, low_effort, pic,
+                                 percent_range, percent);
+  }
+
+  hash_to_first_index =
+      (int32_t*)WebPSafeMalloc(HASH_SIZE, sizeof(*hash_to_first_index));
+  if (hash_to_first_index == NULL) {
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  }
+
+  percent_range = remaining_percent / 2;
+  remaining_percent -= percent_range;
+
+  // Set the int32_t array to -1.
+  memset(hash_to_first_index, 0xff, HASH_SIZE * sizeof(*hash_to_first_index));
+  // Fill the chain linking pixels with the same hash.
+  if (!LinkPixels(argb, size, 0, size - 2, chain, hash_to_first_index, pic,
+                  percent_range, percent, &pos)) {
+    WebPSafeFree(hash_to_first_index);
+    return 0;
+  }
   // Process the penultimate pixel.
   chain[pos] = hash_to_first_index[GetPixPairHash64(argb + pos)];
 
@@ -353,88 +709,9 @@ int VP8LHashChainFill(VP8LHashChain* const p, int quality,
   assert(size > 2);
   p->offset_length[0] = p->offset_length[size - 1] = 0;
   for (base_position = size - 2; base_position > 0;) {
-    const int max_len = MaxFindCopyLength(size - 1 - base_position);
-    const uint32_t* const argb_start = argb + base_position;
-    int iter = iter_max;
-    int best_length = 0;
-    uint32_t best_distance = 0;
-    uint32_t best_argb;
-    const int min_pos =
-        (base_position > window_size) ? base_position - window_size : 0;
-    const int length_max = (max_len < 256) ? max_len : 256;
-    uint32_t max_base_position;
-
-    pos = chain[base_position];
-    if (!low_effort) {
-      int curr_length;
-      // Heuristic: use the comparison with the above line as an initialization.
-      if (base_position >= (uint32_t)xsize) {
-        curr_length = FindMatchLength(argb_start - xsize, argb_start,
-                                      best_length, max_len);
-        if (curr_length > best_length) {
-          best_length = curr_length;
-          best_distance = xsize;
-        }
-        --iter;
-      }
-      // Heuristic: compare to the previous pixel.
-      curr_length =
-          FindMatchLength(argb_start - 1, argb_start, best_length, max_len);
-      if (curr_length > best_length) {
-        best_length = curr_length;
-        best_distance = 1;
-      }
-      --iter;
-      // Skip the for loop if we already have the maximum.
-      if (best_length == MAX_LENGTH) pos = min_pos - 1;
-    }
-    best_argb = argb_start[best_length];
-
-    for (; pos >= min_pos && --iter; pos = chain[pos]) {
-      int curr_length;
-      assert(base_position > (uint32_t)pos);
-
-      if (argb[pos + best_length] != best_argb) continue;
-
-      curr_length = VP8LVectorMismatch(argb + pos, argb_start, max_len);
-      if (best_length < curr_length) {
-        best_length = curr_length;
-        best_distance = base_position - pos;
-        best_argb = argb_start[best_length];
-        // Stop if we have reached a good enough length.
-        if (best_length >= length_max) break;
-      }
-    }
-    // We have the best match but in case the two intervals continue matching
-    // to the left, we have the best matches for the left-extended pixels.
-    max_base_position = base_position;
-    while (1) {
-      assert(best_length <= MAX_LENGTH);
-      assert(best_distance <= WINDOW_SIZE);
-      p->offset_length[base_position] =
-          (best_distance << MAX_LENGTH_BITS) | (uint32_t)best_length;
-      --base_position;
-      // Stop if we don't have a match or if we are out of bounds.
-      if (best_distance == 0 || base_position == 0) break;
-      // Stop if we cannot extend the matching intervals to the left.
-      if (base_position < best_distance ||
-          argb[base_position - best_distance] != argb[base_position]) {
-        break;
-      }
-      // Stop if we are matching at its limit because there could be a closer
-      // matching interval with the same maximum length. Then again, if the
-      // matching interval is as close as possible (best_distance == 1), we will
-      // never find anything better so let's continue.
-      if (best_length == MAX_LENGTH && best_distance != 1 &&
-          base_position + MAX_LENGTH < max_base_position) {
-        break;
-      }
-      if (best_length < MAX_LENGTH) {
-        ++best_length;
-        max_base_position = base_position;
-      }
-    }
-
+    base_position =
+        FindMatches(chain, argb, xsize, size, iter_max, window_size,
+                    low_effort, base_position, 0, p->offset_length);
     if (!WebPReportProgress(pic,
                             percent_start + percent_range *
                                                 (size - 2 - base_position) /
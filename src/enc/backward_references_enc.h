@@ -16,6 +16,7 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include "src/utils/thread_utils.h"
 #include "src/webp/encode.h"
 #include "src/webp/format_constants.h"
 #include "src/webp/types.h"
@@ -130,11 +131,15 @@ struct VP8LHashChain {
 
 // Must be called first, to set size.
 int VP8LHashChainInit(VP8LHashChain* const p, int size);
-// Pre-compute the best matches for argb. pic and percent are for progress.
+// Pre-compute the best matches for argb. If 'team' is not NULL, large images
+// are processed by chunks on its workers, with the same result, at the cost of
+// a temporary chain of one int32_t per pixel.
+// pic and percent are for progress.
 int VP8LHashChainFill(VP8LHashChain* const p, int quality,
                       const uint32_t* const argb, int xsize, int ysize,
-                      int low_effort, const WebPPicture* const pic,
-                      int percent_range, int* const percent);
+                      int low_effort, WebPWorkerTeam* const team,
+                      const WebPPicture* const pic, int percent_range,
+                      int* const percent);
 void VP8LHashChainClear(VP8LHashChain* const p);  // release memory
 
 static WEBP_INLINE int VP8LHashChainFindOffset(const VP8LHashChain* const p,
@@ -179,6 +184,11 @@ struct VP8LBackwardRefs {
 void VP8LBackwardRefsInit(VP8LBackwardRefs* const refs, int block_size);
 // Release memory for backward references.
 void VP8LBackwardRefsClear(VP8LBackwardRefs* const refs);
+// Same as VP8LBackwardRefsInit(), but the memory of 'refs', which must be
+// initialized or zero-filled, is kept for reuse if its block size is the same.
+void VP8LBackwardRefsReset(VP8LBackwardRefs* const refs, int block_size);
+// Returns the size in bytes of the memory held by 'refs'.
+size_t VP8LBackwardRefsMemorySize(const VP8LBackwardRefs* const refs);
 
 // Cursor for iterating on references content
 typedef struct {
@@ -20,6 +20,8 @@
 #include "src/enc/cost_enc.h"
 #include "src/enc/vp8i_enc.h"
 #include "src/utils/bit_writer_utils.h"
+#include "src/utils/thread_utils.h"
+#include "src/utils/utils.h"
 #include "src/webp/encode.h"
 #include "src/webp/format_constants.h"  // RIFF constants
 #include "src/webp/types.h"
@@ -199,11 +201,12 @@ static void ResetSegments(VP8Encoder* const enc) {
   }
 }
 
-static void SetSegmentProbas(VP8Encoder* const enc) {
+// Only the first 'num_mbs' macroblocks, already analyzed, are counted.
+static void SetSegmentProbas(VP8Encoder* const enc, int num_mbs) {
   int p[NUM_MB_SEGMENTS] = {0};
   int n;
 
-  for (n = 0; n < enc->mb_w * enc->mb_h; ++n) {
+  for (n = 0; n < num_mbs; ++n) {
     const VP8MBInfo* const mb = &enc->mb_info[n];
     ++p[mb->segment];
   }
@@ -412,21 +415,31 @@ static void RecordResiduals(VP8EncIterator* const it,
 
 #if !defined(DISABLE_TOKEN_BUFFER)
 
+// The token statistics are recorded in 'stats' (usually enc->proba.stats).
+// If 'num_tokens' is not NULL, the number of luma and chroma tokens recorded
+// are stored in num_tokens[0] and num_tokens[1].
 static int RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
-                        VP8TBuffer* const tokens) {
+                        VP8TBuffer* const tokens,
+                        StatsArray (*const stats)[NUM_BANDS],
+                        uint32_t* const num_tokens) {
   int x, y, ch;
   VP8Residual res;
   VP8Encoder* const enc = it->enc;
+  size_t pos1 = 0, pos2 = 0;
 
+  if (num_tokens != NULL) pos1 = VP8TBufferNumTokens(tokens);
   VP8IteratorNzToBytes(it);
   if (it->mb->type == 1) {  // i16x16
     const int ctx = it->top_nz[8] + it->left_nz[8];
     VP8InitResidual(0, 1, enc, &res);
+    res.stats = stats[1];
     VP8SetResidualCoeffs(rd->y_dc_levels, &res);
     it->top_nz[8] = it->left_nz[8] = VP8RecordCoeffTokens(ctx, &res, tokens);
     VP8InitResidual(1, 0, enc, &res);
+    res.stats = stats[0];
   } else {
     VP8InitResidual(0, 3, enc, &res);
+    res.stats = stats[3];
   }
 
   // luma-AC
@@ -437,9 +450,11 @@ static int RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
       it->top_nz[x] = it->left_nz[y] = VP8RecordCoeffTokens(ctx, &res, tokens);
     }
   }
+  if (num_tokens != NULL) pos2 = VP8TBufferNumTokens(tokens);
 
   // U/V
   VP8InitResidual(0, 2, enc, &res);
+  res.stats = stats[2];
   for (ch = 0; ch <= 2; ch += 2) {
     for (y = 0; y < 2; ++y) {
       for (x = 0; x < 2; ++x) {
@@ -451,6 +466,10 @@ static int RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
     }
   }
   VP8IteratorBytesToNz(it);
+  if (num_tokens != NULL) {
+    num_tokens[0] = (uint32_t)(pos2 - pos1);
+    num_tokens[1] = (uint32_t)(VP8TBufferNumTokens(tokens) - pos2);
+  }
   return !tokens->error;
 }
 
@@ -479,27 +498,31 @@ static void ResetSSE(VP8Encoder* const enc) {
   enc->sse_count = 0;
 }
 
-static void StoreSSE(const VP8EncIterator* const it) {
-  VP8Encoder* const enc = it->enc;
+static void StoreSSE(const VP8EncIterator* const it, uint64_t sse[3],
+                     uint64_t* const sse_count) {
   const uint8_t* const in = it->yuv_in;
   const uint8_t* const out = it->yuv_out;
   // Note: not totally accurate at boundary. And doesn't include in-loop filter.
-  enc->sse[0] += VP8SSE16x16(in + Y_OFF_ENC, out + Y_OFF_ENC);
-  enc->sse[1] += VP8SSE8x8(in + U_OFF_ENC, out + U_OFF_ENC);
-  enc->sse[2] += VP8SSE8x8(in + V_OFF_ENC, out + V_OFF_ENC);
-  enc->sse_count += 16 * 16;
+  sse[0] += VP8SSE16x16(in + Y_OFF_ENC, out + Y_OFF_ENC);
+  sse[1] += VP8SSE8x8(in + U_OFF_ENC, out + U_OFF_ENC);
+  sse[2] += VP8SSE8x8(in + V_OFF_ENC, out + V_OFF_ENC);
+  *sse_count += 16 * 16;
 }
 
-static void StoreSideInfo(const VP8EncIterator* const it) {
+// The distortion and block statistics are accumulated in 'sse', 'sse_count'
+// and 'block_count' (usually the enc->sse, enc->sse_count and
+// enc->block_count fields).
+static void StoreSideInfo(const VP8EncIterator* const it, uint64_t sse[3],
+                          uint64_t* const sse_count, int block_count[3]) {
   VP8Encoder* const enc = it->enc;
   const VP8MBInfo* const mb = it->mb;
   WebPPicture* const pic = enc->pic;
 
   if (pic->stats != NULL) {
-    StoreSSE(it);
-    enc->block_count[0] += (mb->type == 0);
-    enc->block_count[1] += (mb->type == 1);
-    enc->block_count[2] += (mb->skip != 0);
+    StoreSSE(it, sse, sse_count);
+    block_count[0] += (mb->type == 0);
+    block_count[1] += (mb->type == 1);
+    block_count[2] += (mb->skip != 0);
   }
 
   if (pic->extra_info != NULL) {
@@ -550,9 +573,13 @@ static void ResetSideInfo(const VP8EncIterator* const it) {
 }
 #else   // defined(WEBP_DISABLE_STATS)
 static void ResetSSE(VP8Encoder* const enc) { (void)enc; }
-static void StoreSideInfo(const VP8EncIterator* const it) {
+static void StoreSideInfo(const VP8EncIterator* const it, uint64_t sse[3],
+                          uint64_t* const sse_count, int block_count[3]) {
   VP8Encoder* const enc = it->enc;
   WebPPicture* const pic = enc->pic;
+  (void)sse;
+  (void)sse_count;
+  (void)block_count;
   if (pic->extra_info != NULL) {
     if (it->x == 0 && it->y == 0) {  // only do it once, at start
       memset(pic->extra_info, 0,
@@ -573,21 +600,22 @@ static double GetPSNR(uint64_t mse, uint64_t size) {
 //  This is used for deciding optimal probabilities. It also modifies the
 //  quantizer value if some target (size, PSNR) was specified.
 
-static void SetLoopParams(VP8Encoder* const enc, float q) {
+static void SetLoopParams(VP8Encoder* const enc, float q, int num_mbs) {
   // Make sure the quality parameter is inside valid bounds
   q = Clamp(q, 0.f, 100.f);
 
-  VP8SetSegmentParams(enc, q);  // setup segment quantizations and filters
-  SetSegmentProbas(enc);        // compute segment probabilities
+  VP8SetSegmentParams(enc, q);     // setup segment quantizations and filters
+  SetSegmentProbas(enc, num_mbs);  // compute segment probabilities
 
   ResetStats(enc);
   ResetSSE(enc);
 }
 
 // Returns false if user aborted. '*size_p0' is partition #0's estimated size,
-// legitimately 0 with RD_OPT_NONE.
+// legitimately 0 with RD_OPT_NONE. Only the first 'max_mbs' macroblocks are
+// analyzed, and the first 'nb_mbs' ones are visited.
 static int OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt, int nb_mbs,
-                       int percent_delta, PassStats* const s,
+                       int max_mbs, int percent_delta, PassStats* const s,
                        uint64_t* const size_p0) {
   VP8EncIterator it;
   uint64_t size = 0;
@@ -596,7 +624,7 @@ static int OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt, int nb_mbs,
   const uint64_t pixel_count = (uint64_t)nb_mbs * 384;
 
   VP8IteratorInit(enc, &it);
-  SetLoopParams(enc, s->q);
+  SetLoopParams(enc, s->q, max_mbs);
   do {
     VP8ModeScore info;
     VP8IteratorImport(&it, NULL);
@@ -627,7 +655,8 @@ static int OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt, int nb_mbs,
   return 1;
 }
 
-static int StatLoop(VP8Encoder* const enc) {
+// Only the first 'max_mbs' macroblocks are visited.
+static int StatLoop(VP8Encoder* const enc, int max_mbs) {
   const int method = enc->method;
   const int do_search = enc->do_search;
   const int fast_probe = ((method == 0 || method == 3) && !do_search);
@@ -638,7 +667,7 @@ static int StatLoop(VP8Encoder* const enc) {
   const int final_percent = enc->percent + task_percent;
   const VP8RDLevel rd_opt =
       (method >= 3 || do_search) ? RD_OPT_BASIC : RD_OPT_NONE;
-  int nb_mbs = enc->mb_w * enc->mb_h;
+  int nb_mbs = max_mbs;
   PassStats stats;
 
   InitPassStats(enc, &stats);
@@ -651,6 +680,7 @@ static int StatLoop(VP8Encoder* const enc) {
     } else {
       nb_mbs = (nb_mbs > 200) ? nb_mbs >> 2 : 50;
     }
+    if (nb_mbs > max_mbs) nb_mbs = max_mbs;
   }
 
   while (num_pass_left-- > 0) {
@@ -658,7 +688,8 @@ static int StatLoop(VP8Encoder* const enc) {
                              (num_pass_left == 0) ||
                              (enc->max_i4_header_bits == 0);
     uint64_t size_p0;
-    if (!OneStatPass(enc, rd_opt, nb_mbs, percent_per_pass, &stats, &size_p0)) {
+    if (!OneStatPass(enc, rd_opt, nb_mbs, max_mbs, percent_per_pass, &stats,
+                     &size_p0)) {
       return 0;
     }
 #if (DEBUG_SEARCH > 0)
@@ -754,41 +785,647 @@ static void ResetAfterSkip(VP8EncIterator* const it) {
   }
 }
 
-int VP8EncLoop(VP8Encoder* const enc) {
+//------------------------------------------------------------------------------
+// Wavefront multi-threading (WebPPicture::num_threads >= 2)
+//
+// The macroblock rows are coded concurrently by several workers. Row 'y' can
+// code the macroblock 'x' once row 'y - 1' is done with the macroblock 'x + 1'
+// (the top-right one is needed for intra4 predictions). Each row records its
+// tokens into its own buffer, and the rows are emitted in order at the end.
+
+#if !defined(DISABLE_TOKEN_BUFFER)
+
+#define MAX_WAVEFRONT_WORKERS 64
+
+typedef StatsArray RowStats[NUM_TYPES][NUM_BANDS];
+
+typedef struct Wavefront Wavefront;
+
+typedef struct {
+  WebPWorker worker;
+  Wavefront* wf;
   VP8EncIterator it;
+  RowStats stats;                 // discarded token stats (VP8EncLoop)
+  int max_edge[NUM_MB_SEGMENTS];  // local enc->dqm[].max_edge
+  uint64_t sse[3];                // local enc->sse[]
+  uint64_t sse_count;             // local enc->sse_count
+  int block_count[3];             // local enc->block_count[]
+  uint64_t size_p0;               // header bits (VP8EncTokenLoop)
+  uint64_t distortion;            // distortion (VP8EncTokenLoop)
+} WavefrontWorker;
+
+struct Wavefront {
+  VP8Encoder* enc;
+  int num_workers;             // 0 if multi-threading is off
+  WavefrontWorker* workers;    // workers[0] is run by the calling thread
+  WebPSyncCounters* counters;  // number of coded mbs per row + next row
+  VP8TBuffer* tokens;          // tokens of each row
+  RowStats* stats;             // token stats of each row (VP8EncTokenLoop)
+  LFStats* lf_stats;           // filter stats of each row, or NULL
+  uint32_t (*mb_tokens)[2];    // luma/uv token counts per mb, or NULL
+  int is_token_loop;
+  int store_side_info;  // if true, store side info, filter stats, samples
+  int dont_use_skip;
+  VP8RDLevel rd_opt;
+  int last_row;  // rows are coded up to 'last_row' (excluded)
+  int percent0;  // for progress
+  int delta_progress;
+};
+
+// 'keep_all_rows' is true if the tokens of all the rows are kept until the end
+// of the pass, instead of being emitted band by band.
+static int GetNumWavefrontWorkers(const VP8Encoder* const enc,
+                                  int keep_all_rows) {
+#ifdef WEBP_USE_THREAD
+  const WebPConfig* const config = enc->config;
+  // Consecutive rows are at least two macroblocks apart.
+  const int max_workers = (enc->mb_w + 1) >> 1;
+  int num_workers;
+  // In low-memory mode, we can't afford keeping all the tokens around.
+  if (enc->thread_level == 0 || enc->pic->num_threads < 2 ||
+      (config->low_memory && keep_all_rows)) {
+    return 1;
+  }
+  num_workers = enc->pic->num_threads;
+  if (enc->pic->thread_pool != NULL &&
+      num_workers > WebPThreadPoolGetNumThreads(enc->pic->thread_pool) + 1) {
+    num_workers = WebPThreadPoolGetNumThreads(enc->pic->thread_pool) + 1;
+  }
+  if (num_workers > max_workers) num_workers = max_workers;
+  if (num_workers > enc->mb_h) num_workers = enc->mb_h;
+  if (num_workers > MAX_WAVEFRONT_WORKERS) num_workers = MAX_WAVEFRONT_WORKERS;
+  return num_workers;
+#else
+  (void)enc;
+  (void)keep_all_rows;
+  return 1;
+#endif
+}
+
+// Codes the macroblocks of row 'y'. Returns false in case of error or if
+// another worker aborted.
+static int WavefrontCodeRow(WavefrontWorker* const w, int y) {
+  Wavefront* const wf = w->wf;
+  VP8Encoder* const enc = wf->enc;
+  VP8EncIterator* const it = &w->it;
+  VP8TBuffer* const tokens = &wf->tokens[y];
+  const int mb_w = enc->mb_w;
+  int x;
+
+  VP8IteratorSetRow(it, y);
+  if (wf->lf_stats != NULL) it->lf_stats = &wf->lf_stats[y];
+  for (x = 0; x < mb_w; ++x) {
+    VP8ModeScore info;
+    // wait for the top and top-right macroblocks
+    const int top_needed = (x + 2 < mb_w) ? x + 2 : mb_w;
+    if (y > 0 && !WebPSyncCountersWait(wf->counters, y - 1, top_needed)) {
+      return 0;
+    }
+    VP8IteratorImport(it, NULL);
+    if (wf->is_token_loop) {
+      VP8Decimate(it, &info, wf->rd_opt);
+      if (!RecordTokens(it, &info, tokens, wf->stats[y], NULL)) return 0;
+      w->size_p0 += info.H;
+      w->distortion += info.D;
+    } else if (!VP8Decimate(it, &info, wf->rd_opt) || wf->dont_use_skip) {
+      uint32_t* const num_tokens =
+          (wf->mb_tokens != NULL) ? wf->mb_tokens[x + y * mb_w] : NULL;
+      if (!RecordTokens(it, &info, tokens, w->stats, num_tokens)) return 0;
+    } else {  // reset predictors after a skip
+      ResetAfterSkip(it);
+    }
+    if (wf->store_side_info) {
+      StoreSideInfo(it, w->sse, &w->sse_count, w->block_count);
+      VP8StoreFilterStats(it);
+      VP8IteratorExport(it);
+    }
+    VP8IteratorSaveBoundary(it);
+    VP8IteratorNext(it);
+    WebPSyncCountersSet(wf->counters, y, x + 1);
+  }
+  return 1;
+}
+
+static int WavefrontHook(void* arg1, void* arg2) {
+  WavefrontWorker* const w = (WavefrontWorker*)arg1;
+  Wavefront* const wf = w->wf;
+  VP8Encoder* const enc = wf->enc;
+  // only the main worker reports the progress, since we don't expect the
+  // user's hook to be multi-thread safe
+  const int report_progress = (w == &wf->workers[0]) &&
+                              (wf->delta_progress > 0) &&
+                              (enc->pic->progress_hook != NULL);
+  (void)arg2;
+  while (1) {
+    const int y = WebPSyncCountersIncrement(wf->counters, enc->mb_h);
+    if (y >= wf->last_row) break;
+    if (!WavefrontCodeRow(w, y)) goto Abort;
+    if (report_progress) {
+      const int percent =
+          wf->percent0 + wf->delta_progress * (y + 1) / enc->mb_h;
+      if (!WebPReportProgress(enc->pic, percent, &enc->percent)) goto Abort;
+    }
+  }
+  return 1;
+
+Abort:
+  WebPSyncCountersAbort(wf->counters);  // release the other workers
+  return 0;
+}
+
+static void WavefrontClear(Wavefront* const wf) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  int i, y;
+  for (i = 1; i < wf->num_workers; ++i) {
+    worker_interface->End(&wf->workers[i].worker);
+  }
+  if (wf->tokens != NULL) {
+    for (y = 0; y < wf->enc->mb_h; ++y) VP8TBufferClear(&wf->tokens[y]);
+  }
+  WebPSyncCountersDelete(wf->counters);
+  WebPSafeFree(wf->workers);
+  WebPSafeFree(wf->tokens);
+  WebPSafeFree(wf->stats);
+  WebPSafeFree(wf->lf_stats);
+  WebPSafeFree(wf->mb_tokens);
+  memset(wf, 0, sizeof(*wf));
+}
+
+// Leaves 'wf->num_workers' to 0 if 'num_workers' is less than 2.
+static int WavefrontInit(Wavefront* const wf, VP8Encoder* const enc,
+                         int num_workers, int is_token_loop) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  const WebPPicture* const pic = enc->pic;
+  const int mb_w = enc->mb_w, mb_h = enc->mb_h;
+  int i, y;
+
+  memset(wf, 0, sizeof(*wf));
+  if (num_workers < 2) return 1;
+  wf->enc = enc;
+  wf->is_token_loop = is_token_loop;
+  wf->workers =
+      (WavefrontWorker*)WebPSafeCalloc(num_workers, sizeof(*wf->workers));
+  wf->tokens = (VP8TBuffer*)WebPSafeCalloc(mb_h, sizeof(*wf->tokens));
+  wf->counters = WebPSyncCountersNew(mb_h + 1);
+  if (wf->workers == NULL || wf->tokens == NULL || wf->counters == NULL) {
+    goto Error;
+  }
+  wf->num_workers = num_workers;
+  for (i = 0; i < num_workers; ++i) {
+    WavefrontWorker* const w = &wf->workers[i];
+    worker_interface->Init(&w->worker);
+    w->worker.pool = enc->pic->thread_pool;
+    w->worker.data1 = w;
+    w->worker.data2 = NULL;
+    w->worker.hook = WavefrontHook;
+    w->wf = wf;
+  }
+  for (y = 0; y < mb_h; ++y) {
+    VP8TBufferInit(&wf->tokens[y], enc->tokens.page_size / mb_h);
+  }
+  if (is_token_loop) {
+    wf->stats = (RowStats*)WebPSafeMalloc(mb_h, sizeof(*wf->stats));
+    if (wf->stats == NULL) goto Error;
+  } else if (pic->stats != NULL ||
+             (pic->extra_info != NULL && pic->extra_info_type == 6)) {
+    // we'll need the exact bit count of each macroblock
+    wf->mb_tokens = (uint32_t(*)[2])WebPSafeCalloc((uint64_t)mb_w * mb_h,
+                                                    sizeof(*wf->mb_tokens));
+    if (wf->mb_tokens == NULL) goto Error;
+  }
+  if (enc->lf_stats != NULL) {
+    wf->lf_stats = (LFStats*)WebPSafeMalloc(mb_h, sizeof(*wf->lf_stats));
+    if (wf->lf_stats == NULL) goto Error;
+  }
+  // we don't need to call Reset() on workers[0], since we're calling
+  // Execute() on it
+  for (i = 1; i < num_workers; ++i) {
+    if (!worker_interface->Reset(&wf->workers[i].worker)) goto Error;
+  }
+  return 1;
+
+Error:
+  WavefrontClear(wf);
+  return WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+}
+
+// Prepares a new pass over the whole picture. Must be called while no worker
+// is running, since the iterators initialization resets the shared contexts.
+static void WavefrontStartPass(Wavefront* const wf, int store_side_info,
+                               int delta_progress) {
+  VP8Encoder* const enc = wf->enc;
+  int i, y;
+  for (i = 0; i < wf->num_workers; ++i) {
+    WavefrontWorker* const w = &wf->workers[i];
+    VP8IteratorInit(enc, &w->it);
+    w->it.max_edge = w->max_edge;
+    w->it.luma_bits = w->it.uv_bits = 0;
+    memset(w->max_edge, 0, sizeof(w->max_edge));
+    memset(w->sse, 0, sizeof(w->sse));
+    memset(w->block_count, 0, sizeof(w->block_count));
+    w->sse_count = 0;
+    w->size_p0 = 0;
+    w->distortion = 0;
+  }
+  for (y = 0; y < enc->mb_h; ++y) VP8TBufferClear(&wf->tokens[y]);
+  if (wf->stats != NULL) memset(wf->stats, 0, enc->mb_h * sizeof(*wf->stats));
+  if (wf->lf_stats != NULL) {
+    memset(wf->lf_stats, 0, enc->mb_h * sizeof(*wf->lf_stats));
+  }
+  WebPSyncCountersReset(wf->counters);
+  wf->store_side_info = store_side_info;
+  wf->dont_use_skip = !enc->proba.use_skip_proba;
+  wf->rd_opt = enc->rd_opt_level;
+  wf->percent0 = enc->percent;
+  wf->delta_progress = delta_progress;
+}
+
+// Codes the rows in [first_row, last_row) using all the workers.
+static int WavefrontCodeRows(Wavefront* const wf, int first_row,
+                             int last_row) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
   int ok = 1;
+  int i;
+  wf->last_row = last_row;
+  WebPSyncCountersSet(wf->counters, wf->enc->mb_h, first_row);
+  for (i = 1; i < wf->num_workers; ++i) {
+    worker_interface->Launch(&wf->workers[i].worker);
+  }
+  worker_interface->Execute(&wf->workers[0].worker);
+  for (i = 0; i < wf->num_workers; ++i) {
+    ok &= worker_interface->Sync(&wf->workers[i].worker);
+  }
+  if (!ok) {  // a user abort has already been recorded by the main worker
+    WebPEncodingSetError(wf->enc->pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  }
+  return ok;
+}
+
+// Merges the workers' statistics into 'enc' once a pass is complete.
+static void WavefrontMergeStats(const Wavefront* const wf) {
+  VP8Encoder* const enc = wf->enc;
+  int i, s, y;
+  for (i = 0; i < wf->num_workers; ++i) {
+    const WavefrontWorker* const w = &wf->workers[i];
+    for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+      if (w->max_edge[s] > enc->dqm[s].max_edge) {
+        enc->dqm[s].max_edge = w->max_edge[s];
+      }
+    }
+    if (wf->store_side_info) {
+      enc->sse[0] += w->sse[0];
+      enc->sse[1] += w->sse[1];
+      enc->sse[2] += w->sse[2];
+      enc->sse_count += w->sse_count;
+      for (s = 0; s < 3; ++s) enc->block_count[s] += w->block_count[s];
+    }
+  }
+  if (wf->store_side_info && wf->lf_stats != NULL) {
+    // in row order, so that the result doesn't depend on the scheduling
+    for (y = 0; y < enc->mb_h; ++y) {
+      for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+        for (i = 0; i < MAX_LF_LEVELS; ++i) {
+          (*enc->lf_stats)[s][i] += wf->lf_stats[y][s][i];
+        }
+      }
+    }
+  }
+}
 
-  if (!StatLoop(enc)) return 0;  // stats-collection loop
+// Adds the token stats of 'src' to 'dst'. The counters are halved when their
+// total would overflow, like in VP8RecordStats().
+static void MergeTokenStats(proba_t* const dst, const proba_t* const src,
+                            int size) {
+  int i;
+  for (i = 0; i < size; ++i) {
+    uint32_t nb = (dst[i] & 0xffffu) + (src[i] & 0xffffu);
+    uint32_t total = (dst[i] >> 16) + (src[i] >> 16);
+    while (total >= 0xfffeu) {
+      nb = (nb + 1u) >> 1;
+      total = (total + 1u) >> 1;
+    }
+    dst[i] = (total << 16) | nb;
+  }
+}
+
+// Multi-threaded equivalent of a VP8EncTokenLoop() pass. The token
+// probabilities are refreshed between bands of rows of about 'max_count'
+// macroblocks, using the stats of all the rows above merged in order. Hence
+// the result doesn't depend on the number of workers.
+static int WavefrontTokenPass(Wavefront* const wf, int is_last_pass,
+                              int delta_progress, int max_count,
+                              uint64_t* const size_p0,
+                              uint64_t* const distortion) {
+  VP8Encoder* const enc = wf->enc;
+  VP8EncProba* const proba = &enc->proba;
+  const int band_rows = (max_count + enc->mb_w - 1) / enc->mb_w;
+  const int stats_size = (int)(sizeof(RowStats) / sizeof(proba_t));
+  int first_row, y, i;
+
+  WavefrontStartPass(wf, is_last_pass, is_last_pass ? delta_progress : 0);
+  for (first_row = 0; first_row < enc->mb_h; first_row += band_rows) {
+    const int last_row = (first_row + band_rows < enc->mb_h)
+                             ? first_row + band_rows
+                             : enc->mb_h;
+    if (first_row > 0) {
+      FinalizeTokenProbas(proba);
+      VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
+    }
+    if (!WavefrontCodeRows(wf, first_row, last_row)) return 0;
+    for (y = first_row; y < last_row; ++y) {
+      MergeTokenStats(&proba->stats[0][0][0][0], &wf->stats[y][0][0][0][0],
+                      stats_size);
+    }
+  }
+  WavefrontMergeStats(wf);
+  for (i = 0; i < wf->num_workers; ++i) {
+    *size_p0 += wf->workers[i].size_p0;
+    *distortion += wf->workers[i].distortion;
+  }
+  return 1;
+}
+
+static size_t WavefrontEstimateTokenSize(const Wavefront* const wf,
+                                         const uint8_t* const probas) {
+  size_t size = 0;
+  int y;
+  for (y = 0; y < wf->enc->mb_h; ++y) {
+    size += VP8EstimateTokenSize(&wf->tokens[y], probas);
+  }
+  return size;
+}
+
+// Emits the tokens of the rows in [first_row, last_row) in order. The bit
+// counts are recorded in 'it'.
+static int WavefrontEmitTokens(Wavefront* const wf, VP8EncIterator* const it,
+                               int first_row, int last_row) {
+  VP8Encoder* const enc = wf->enc;
+  WebPPicture* const pic = enc->pic;
+  const uint8_t* const probas = (const uint8_t*)enc->proba.coeffs;
+  int x, y;
+  for (y = first_row; y < last_row; ++y) {
+    VP8BitWriter* const bw = &enc->parts[y & (enc->num_parts - 1)];
+    VP8TBuffer* const tokens = &wf->tokens[y];
+    if (wf->mb_tokens == NULL) {
+      VP8EmitTokens(tokens, bw, probas, 1);
+    } else {
+      VP8TCursor cursor;
+      VP8TCursorInit(&cursor, tokens);
+      for (x = 0; x < enc->mb_w; ++x) {
+        const int n = x + y * enc->mb_w;
+        const VP8MBInfo* const mb = &enc->mb_info[n];
+        const uint32_t* const num_tokens = wf->mb_tokens[n];
+        if (num_tokens[0] > 0) {  // not skipped
+          const uint64_t pos1 = VP8BitWriterPos(bw);
+          uint64_t pos2;
+          VP8EmitTokensAt(&cursor, tokens, num_tokens[0], bw, probas);
+          pos2 = VP8BitWriterPos(bw);
+          VP8EmitTokensAt(&cursor, tokens, num_tokens[1], bw, probas);
+          it->luma_bits = pos2 - pos1;
+          it->uv_bits = VP8BitWriterPos(bw) - pos2;
+          it->bit_count[mb->segment][mb->type == 1] += it->luma_bits;
+          it->bit_count[mb->segment][2] += it->uv_bits;
+        }
+#if !defined(WEBP_DISABLE_STATS)
+        if (pic->extra_info != NULL && pic->extra_info_type == 6) {
+          const int b = (int)((it->luma_bits + it->uv_bits + 7) >> 3);
+          pic->extra_info[n] = (b > 255) ? 255 : b;
+        }
+#endif
+      }
+      VP8TBufferClear(tokens);
+    }
+    if (bw->error) return 0;
+  }
+  (void)pic;
+  return 1;
+}
+
+#endif  // !DISABLE_TOKEN_BUFFER
+
+// State of VP8EncLoop(), which can be run over successive bands of rows.
+struct VP8EncRowLoop {
+  VP8EncIterator it;
+#if !defined(DISABLE_TOKEN_BUFFER)
+  Wavefront wf;  // multi-threaded coding, if wf.num_workers > 0
+#endif
+  int next_row;         // first row of the next band
+  int store_side_info;  // if true, store side info, filter stats, samples
+  int delta_progress;   // progress of the whole pass, in percent
+};
+
+// Prepares a coding pass over the whole picture, using the probabilities
+// collected by StatLoop().
+static int RowLoopStart(VP8EncRowLoop* const loop, VP8Encoder* const enc,
+                        int keep_all_rows, int store_side_info,
+                        int delta_progress) {
+  loop->next_row = 0;
+  loop->store_side_info = store_side_info;
+  loop->delta_progress = delta_progress;
+#if !defined(DISABLE_TOKEN_BUFFER)
+  memset(&loop->wf, 0, sizeof(loop->wf));
+#endif
   if (!InitBitWriters(enc)) return 0;
 
-  VP8IteratorInit(enc, &it);
-  VP8InitFilter(&it);
-  do {
+  VP8IteratorInit(enc, &loop->it);
+  if (store_side_info) VP8InitFilter(&loop->it);
+#if !defined(DISABLE_TOKEN_BUFFER)
+  {
+    const int num_workers = GetNumWavefrontWorkers(enc, keep_all_rows);
+    if (num_workers > 1) {
+      loop->it.luma_bits = loop->it.uv_bits = 0;
+      if (!WavefrontInit(&loop->wf, enc, num_workers, /*is_token_loop=*/0)) {
+        VP8EncFreeBitWriters(enc);
+        return 0;
+      }
+      WavefrontStartPass(&loop->wf, store_side_info, delta_progress);
+    }
+  }
+#else
+  (void)keep_all_rows;
+#endif
+  return 1;
+}
+
+// Collects the statistics on the first 'num_rows' rows and prepares the
+// coding of the whole picture.
+static int RowLoopInit(VP8EncRowLoop* const loop, VP8Encoder* const enc,
+                       int num_rows, int keep_all_rows) {
+  if (!StatLoop(enc, num_rows * enc->mb_w)) return 0;  // stats-collection loop
+  return RowLoopStart(loop, enc, keep_all_rows, /*store_side_info=*/1,
+                      /*delta_progress=*/20);
+}
+
+// Codes the next rows, up to 'last_row' (excluded).
+static int RowLoopCode(VP8EncRowLoop* const loop, int last_row) {
+  VP8EncIterator* const it = &loop->it;
+  VP8Encoder* const enc = it->enc;
+  const int first_row = loop->next_row;
+  int ok = 1;
+
+  loop->next_row = last_row;
+#if !defined(DISABLE_TOKEN_BUFFER)
+  if (loop->wf.num_workers > 0) {
+    return WavefrontCodeRows(&loop->wf, first_row, last_row) &&
+           WavefrontEmitTokens(&loop->wf, it, first_row, last_row);
+  }
+#endif
+  assert(it->y == first_row);
+  while (ok && it->y < last_row) {
     VP8ModeScore info;
     const int dont_use_skip = !enc->proba.use_skip_proba;
     const VP8RDLevel rd_opt = enc->rd_opt_level;
 
-    VP8IteratorImport(&it, NULL);
+    VP8IteratorImport(it, NULL);
     // Warning! order is important: first call VP8Decimate() and
     // *then* decide how to code the skip decision if there's one.
-    if (!VP8Decimate(&it, &info, rd_opt) || dont_use_skip) {
-      CodeResiduals(it.bw, &it, &info);
-      if (it.bw->error) {
+    if (!VP8Decimate(it, &info, rd_opt) || dont_use_skip) {
+      CodeResiduals(it->bw, it, &info);
+      if (it->bw->error) {
         // enc->pic->error_code is set in PostLoopFinalize().
         ok = 0;
         break;
       }
     } else {  // reset predictors after a skip
-      ResetAfterSkip(&it);
+      ResetAfterSkip(it);
     }
-    StoreSideInfo(&it);
-    VP8StoreFilterStats(&it);
-    VP8IteratorExport(&it);
-    ok = VP8IteratorProgress(&it, 20);
-    VP8IteratorSaveBoundary(&it);
-  } while (ok && VP8IteratorNext(&it));
+    if (loop->store_side_info) {
+      StoreSideInfo(it, enc->sse, &enc->sse_count, enc->block_count);
+      VP8StoreFilterStats(it);
+      VP8IteratorExport(it);
+    }
+    ok = VP8IteratorProgress(it, loop->delta_progress);
+    VP8IteratorSaveBoundary(it);
+    VP8IteratorNext(it);
+  }
+  return ok;
+}
 
-  return PostLoopFinalize(&it, ok);
+// Codes all the rows, band by band. After each band, the bytes of the token
+// partitions that can't change anymore are either dropped, or passed to the
+// picture's writer for the first partition (the others are kept until the
+// end) if 'emit' is true. Their number is added to 'sizes[]'.
+static int RowLoopStream(VP8EncRowLoop* const loop, int emit,
+                         size_t sizes[MAX_NUM_PARTITIONS]) {
+  VP8Encoder* const enc = loop->it.enc;
+  WebPPicture* const pic = enc->pic;
+  int band_rows = 1;  // the rows are flushed one by one by a single thread
+  int ok = 1;
+#if !defined(DISABLE_TOKEN_BUFFER)
+  // ... but not too often by several ones, since each band ends when its
+  // last row is coded.
+  if (loop->wf.num_workers > 0) band_rows = 4 * loop->wf.num_workers;
+#endif
+  while (ok && loop->next_row < enc->mb_h) {
+    const int last_row = (loop->next_row + band_rows < enc->mb_h)
+                             ? loop->next_row + band_rows
+                             : enc->mb_h;
+    int p;
+    ok = RowLoopCode(loop, last_row);
+    for (p = 0; ok && p < (emit ? 1 : enc->num_parts); ++p) {
+      VP8BitWriter* const bw = enc->parts + p;
+      const uint8_t* const buf = VP8BitWriterBuf(bw);
+      const size_t size = VP8BitWriterNumFinalBytes(bw);
+      if (bw->error) {
+        ok = 0;  // the error code is set by the caller
+        break;
+      }
+      if (emit && size > 0 && !pic->writer(buf, size, pic)) {
+        ok = WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_WRITE);
+        break;
+      }
+      VP8BitWriterDrop(bw, size);
+      sizes[p] += size;
+    }
+  }
+  return ok;
+}
+
+static int RowLoopFinish(VP8EncRowLoop* const loop, int ok) {
+#if !defined(DISABLE_TOKEN_BUFFER)
+  if (ok && loop->wf.num_workers > 0) WavefrontMergeStats(&loop->wf);
+  WavefrontClear(&loop->wf);
+#endif
+  return PostLoopFinalize(&loop->it, ok);
+}
+
+int VP8EncLoop(VP8Encoder* const enc) {
+  VP8EncRowLoop loop;
+  int ok;
+  if (!RowLoopInit(&loop, enc, enc->mb_h, /*keep_all_rows=*/1)) return 0;
+  if (enc->stream_output) {
+    // Only the sizes of the token partitions are needed from this pass.
+    memset(enc->streamed_sizes, 0, sizeof(enc->streamed_sizes));
+    ok = RowLoopStream(&loop, /*emit=*/0, enc->streamed_sizes);
+  } else {
+    ok = RowLoopCode(&loop, enc->mb_h);
+  }
+  return RowLoopFinish(&loop, ok);
+}
+
+int VP8EncStreamPartitions(VP8Encoder* const enc,
+                           const size_t part_sizes[MAX_NUM_PARTITIONS]) {
+  WebPPicture* const pic = enc->pic;
+  size_t sizes[MAX_NUM_PARTITIONS] = {0};
+  VP8EncRowLoop loop;
+  int ok, p;
+
+  assert(enc->stream_output);
+  VP8EncFreeBitWriters(enc);  // the partitions of the first pass
+  // The same coding as in VP8EncLoop(), without storing the side info again.
+  if (!RowLoopStart(&loop, enc, /*keep_all_rows=*/1, /*store_side_info=*/0,
+                    /*delta_progress=*/19)) {
+    return 0;
+  }
+  ok = RowLoopStream(&loop, /*emit=*/1, sizes);
+#if !defined(DISABLE_TOKEN_BUFFER)
+  WavefrontClear(&loop.wf);
+#endif
+  for (p = 0; ok && p < enc->num_parts; ++p) {
+    VP8BitWriter* const bw = enc->parts + p;
+    const uint8_t* const buf = VP8BitWriterFinish(bw);
+    const size_t size = VP8BitWriterSize(bw);
+    ok = !bw->error;
+    // The coding being deterministic, the sizes are the ones of VP8EncLoop().
+    assert(!ok || sizes[p] + size == part_sizes[p]);
+    if (ok && sizes[p] + size != part_sizes[p]) {
+      ok = WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_WRITE);
+    }
+    if (ok && size > 0 && !pic->writer(buf, size, pic)) {
+      ok = WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_WRITE);
+    }
+    VP8BitWriterWipeOut(bw);  // will free the internal buffer.
+  }
+  if (!ok) {
+    VP8EncFreeBitWriters(enc);
+    // Not overriding a user abort or a write error.
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  }
+  return 1;
+}
+
+VP8EncRowLoop* VP8EncRowLoopNew(VP8Encoder* const enc, int num_rows) {
+  VP8EncRowLoop* const loop =
+      (VP8EncRowLoop*)WebPSafeMalloc(1ULL, sizeof(*loop));
+  if (loop == NULL) {
+    WebPEncodingSetError(enc->pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    return NULL;
+  }
+  if (!RowLoopInit(loop, enc, num_rows, /*keep_all_rows=*/0)) {
+    WebPSafeFree(loop);
+    return NULL;
+  }
+  return loop;
+}
+
+int VP8EncRowLoopCode(VP8EncRowLoop* const loop, int last_row) {
+  return RowLoopCode(loop, last_row);
+}
+
+int VP8EncRowLoopDelete(VP8EncRowLoop* const loop, int ok) {
+  ok = RowLoopFinish(loop, ok);
+  WebPSafeFree(loop);
+  return ok;
 }
 
 //------------------------------------------------------------------------------
@@ -809,6 +1446,7 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
   const VP8RDLevel rd_opt = enc->rd_opt_level;
   const uint64_t pixel_count = (uint64_t)enc->mb_w * enc->mb_h * 384;
   PassStats stats;
+  Wavefront wf;
   int ok = 1;
 
   InitPassStats(enc, &stats);
@@ -821,6 +1459,11 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
   assert(rd_opt >= RD_OPT_BASIC);  // otherwise, token-buffer won't be useful
   assert(num_pass_left > 0);
 
+  if (!WavefrontInit(&wf, enc, GetNumWavefrontWorkers(enc, 1),
+                     /*is_token_loop=*/1)) {
+    return 0;
+  }
+
   while (ok && num_pass_left-- > 0) {
     const int is_last_pass = (fabs(stats.dq) <= DQ_LIMIT) ||
                              (num_pass_left == 0) ||
@@ -832,42 +1475,50 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
     const int pass_progress = remaining_progress / (2 + num_pass_left);
     remaining_progress -= pass_progress;
     VP8IteratorInit(enc, &it);
-    SetLoopParams(enc, stats.q);
+    SetLoopParams(enc, stats.q, enc->mb_w * enc->mb_h);
     if (is_last_pass) {
       ResetTokenStats(enc);
       VP8InitFilter(&it);  // don't collect stats until last pass (too costly)
     }
-    VP8TBufferClear(&enc->tokens);
-    do {
-      VP8ModeScore info;
-      VP8IteratorImport(&it, NULL);
-      if (--cnt < 0) {
-        FinalizeTokenProbas(proba);
-        VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
-        cnt = max_count;
-      }
-      VP8Decimate(&it, &info, rd_opt);
-      ok = RecordTokens(&it, &info, &enc->tokens);
-      if (!ok) {
-        WebPEncodingSetError(enc->pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
-        break;
-      }
-      size_p0 += info.H;
-      distortion += info.D;
-      if (is_last_pass) {
-        StoreSideInfo(&it);
-        VP8StoreFilterStats(&it);
-        VP8IteratorExport(&it);
-        ok = VP8IteratorProgress(&it, pass_progress);
-      }
-      VP8IteratorSaveBoundary(&it);
-    } while (ok && VP8IteratorNext(&it));
-    if (!ok) break;
+    if (wf.num_workers > 0) {
+      ok = WavefrontTokenPass(&wf, is_last_pass, pass_progress, max_count,
+                              &size_p0, &distortion);
+      if (!ok) break;
+    } else {
+      VP8TBufferClear(&enc->tokens);
+      do {
+        VP8ModeScore info;
+        VP8IteratorImport(&it, NULL);
+        if (--cnt < 0) {
+          FinalizeTokenProbas(proba);
+          VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
+          cnt = max_count;
+        }
+        VP8Decimate(&it, &info, rd_opt);
+        ok = RecordTokens(&it, &info, &enc->tokens, proba->stats, NULL);
+        if (!ok) {
+          WebPEncodingSetError(enc->pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+          break;
+        }
+        size_p0 += info.H;
+        distortion += info.D;
+        if (is_last_pass) {
+          StoreSideInfo(&it, enc->sse, &enc->sse_count, enc->block_count);
+          VP8StoreFilterStats(&it);
+          VP8IteratorExport(&it);
+          ok = VP8IteratorProgress(&it, pass_progress);
+        }
+        VP8IteratorSaveBoundary(&it);
+      } while (ok && VP8IteratorNext(&it));
+      if (!ok) break;
+    }
 
     size_p0 += enc->segment_hdr.size;
     if (stats.do_size_search) {
+      const uint8_t* const probas = (const uint8_t*)proba->coeffs;
       uint64_t size = FinalizeTokenProbas(&enc->proba);
-      size += VP8EstimateTokenSize(&enc->tokens, (const uint8_t*)proba->coeffs);
+      size += (wf.num_workers > 0) ? WavefrontEstimateTokenSize(&wf, probas)
+                                   : VP8EstimateTokenSize(&enc->tokens, probas);
       size = (size + size_p0 + 1024) >> 11;  // -> size in bytes
       size += HEADER_SIZE_ESTIMATE;
       stats.value = (double)size;
@@ -902,9 +1553,13 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
       FinalizeTokenProbas(&enc->proba);
     }
     // writer only needed now, when 'base_quant' is final
-    ok = InitBitWriters(enc) && VP8EmitTokens(&enc->tokens, enc->parts + 0,
-                                              (const uint8_t*)proba->coeffs, 1);
+    ok = InitBitWriters(enc) &&
+         ((wf.num_workers > 0)
+              ? WavefrontEmitTokens(&wf, &it, 0, enc->mb_h)
+              : VP8EmitTokens(&enc->tokens, enc->parts + 0,
+                              (const uint8_t*)proba->coeffs, 1));
   }
+  WavefrontClear(&wf);
   ok = ok && WebPReportProgress(enc->pic, enc->percent + remaining_progress,
                                 &enc->percent);
   return PostLoopFinalize(&it, ok);
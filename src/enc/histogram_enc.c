@@ -22,6 +22,7 @@
 #include "src/enc/backward_references_enc.h"
 #include "src/enc/histogram_enc.h"
 #include "src/enc/vp8i_enc.h"
+#include "src/utils/thread_utils.h"
 #include "src/utils/utils.h"
 #include "src/webp/encode.h"
 #include "src/webp/format_constants.h"
@@ -34,6 +35,9 @@
 #define BIN_SIZE (NUM_PARTITIONS * NUM_PARTITIONS * NUM_PARTITIONS)
 // Maximum number of histograms allowed in greedy combining algorithm.
 #define MAX_HISTO_GREEDY 100
+// Minimum number of random pairs worth evaluating with several workers in the
+// stochastic combining algorithm.
+#define MIN_PARALLEL_TRIES 16
 
 // Enum to meaningfully access the elements of the Histogram arrays.
 typedef enum { LITERAL = 0, RED, BLUE, ALPHA, DISTANCE } HistogramIndex;
@@ -860,6 +864,69 @@ WEBP_NODISCARD static int HistoQueueUpdatePair(const VP8LHistogram* const h1,
   return 1;
 }
 
+// Inserts the already evaluated 'pair' at the end of the queue. 'pair' may
+// point to the first unused slot of the queue.
+static void HistoQueueInsert(HistoQueue* const histo_queue,
+                             const HistogramPair* const pair) {
+  assert(histo_queue->size < histo_queue->max_size);
+  histo_queue->queue[histo_queue->size++] = *pair;
+  HistoQueueUpdateHead(histo_queue, &histo_queue->queue[histo_queue->size - 1]);
+}
+
+typedef struct {
+  VP8LHistogram** histograms;
+  HistogramPair* pairs;
+  int64_t threshold;
+} PairsEvalJob;
+
+static int EvaluatePairsHook(void* data, int start, int end, int worker_id) {
+  const PairsEvalJob* const job = (const PairsEvalJob*)data;
+  int k;
+  (void)worker_id;
+  for (k = start; k < end; ++k) {
+    HistogramPair* const pair = &job->pairs[k];
+    if (!HistoQueueUpdatePair(job->histograms[pair->idx1],
+                              job->histograms[pair->idx2], job->threshold,
+                              pair)) {
+      pair->cost_diff = 0;  // not an improvement
+    }
+  }
+  return 1;
+}
+
+// Evaluates the 'num_pairs' pairs, of which only idx1 < idx2 need to be set,
+// concurrently on the 'team'. The cost_diff of the pairs whose cost is not
+// inferior to 'threshold' (a negative entropy) is set to 0.
+static void EvaluatePairs(WebPWorkerTeam* const team,
+                          VP8LHistogram** const histograms,
+                          HistogramPair* const pairs, int num_pairs,
+                          int64_t threshold) {
+  PairsEvalJob job;
+  assert(threshold <= 0);
+  job.histograms = histograms;
+  job.pairs = pairs;
+  job.threshold = threshold;
+  // The hook can't fail.
+  (void)WebPWorkerTeamRun(team, num_pairs, EvaluatePairsHook, &job);
+}
+
+// Same as calling HistoQueuePush() with a threshold of 0 for each of the
+// 'num_pairs' pairs stored (indices only) after the end of the queue, except
+// that their costs are evaluated concurrently by the 'team'.
+static void HistoQueuePushPairs(HistoQueue* const histo_queue,
+                                WebPWorkerTeam* const team,
+                                VP8LHistogram** const histograms,
+                                int num_pairs) {
+  HistogramPair* const pairs = histo_queue->queue + histo_queue->size;
+  int k;
+  assert(histo_queue->size + num_pairs <= histo_queue->max_size + 1);
+  EvaluatePairs(team, histograms, pairs, num_pairs, 0);
+  // The queue only grows up to the pair being read.
+  for (k = 0; k < num_pairs; ++k) {
+    if (pairs[k].cost_diff < 0) HistoQueueInsert(histo_queue, &pairs[k]);
+  }
+}
+
 // Create a pair from indices "idx1" and "idx2" provided its cost
 // is inferior to "threshold", a negative entropy.
 // It returns the cost of the pair, or 0 if it superior to threshold.
@@ -886,8 +953,7 @@ static int64_t HistoQueuePush(HistoQueue* const histo_queue,
   // Do not even consider the pair if it does not improve the entropy.
   if (!HistoQueueUpdatePair(h1, h2, threshold, &pair)) return 0;
 
-  histo_queue->queue[histo_queue->size++] = pair;
-  HistoQueueUpdateHead(histo_queue, &histo_queue->queue[histo_queue->size - 1]);
+  HistoQueueInsert(histo_queue, &pair);
 
   return pair.cost_diff;
 }
@@ -896,10 +962,11 @@ static int64_t HistoQueuePush(HistoQueue* const histo_queue,
 
 // Combines histograms by continuously choosing the one with the highest cost
 // reduction.
-static int HistogramCombineGreedy(VP8LHistogramSet* const image_histo) {
+static int HistogramCombineGreedy(VP8LHistogramSet* const image_histo,
+                                  WebPWorkerTeam* const team) {
   int ok = 0;
   const int image_histo_size = image_histo->size;
-  int i, j;
+  int i, j, num_pairs;
   VP8LHistogram** const histograms = image_histo->histograms;
   // Priority queue of histogram pairs.
   HistoQueue histo_queue;
@@ -917,11 +984,15 @@ static int HistogramCombineGreedy(VP8LHistogramSet* const image_histo) {
   }
 
   // Initialize the queue.
+  num_pairs = 0;
   for (i = 0; i < image_histo_size; ++i) {
     for (j = i + 1; j < image_histo_size; ++j) {
-      HistoQueuePush(&histo_queue, histograms, i, j, 0);
+      HistogramPair* const pair = &histo_queue.queue[num_pairs++];
+      pair->idx1 = i;
+      pair->idx2 = j;
     }
   }
+  HistoQueuePushPairs(&histo_queue, team, histograms, num_pairs);
 
   while (histo_queue.size > 0) {
     const int idx1 = histo_queue.queue[0].idx1;
@@ -947,10 +1018,17 @@ static int HistogramCombineGreedy(VP8LHistogramSet* const image_histo) {
     }
 
     // Push new pairs formed with combined histogram to the queue.
+    num_pairs = 0;
     for (i = 0; i < image_histo->size; ++i) {
+      HistogramPair* const pair =
+          &histo_queue.queue[histo_queue.size + num_pairs];
       if (i == idx1) continue;
-      HistoQueuePush(&histo_queue, image_histo->histograms, idx1, i, 0);
+      pair->idx1 = (i < idx1) ? i : idx1;
+      pair->idx2 = (i < idx1) ? idx1 : i;
+      ++num_pairs;
     }
+    HistoQueuePushPairs(&histo_queue, team, image_histo->histograms,
+                        num_pairs);
   }
 
   ok = 1;
@@ -965,9 +1043,14 @@ End:
 // afterwards, 0 otherwise.
 static int HistogramCombineStochastic(VP8LHistogramSet* const image_histo,
                                       int min_cluster_size,
+                                      WebPWorkerTeam* const team,
                                       int* const do_greedy) {
   int j, iter;
   uint32_t seed = 1;
+  // With several workers, the random pairs of an iteration are evaluated
+  // all at once and then pushed in order, as if evaluated one by one.
+  HistogramPair* tries = NULL;
+  uint32_t* tries_seeds = NULL;  // value of 'seed' after each try
   int tries_with_no_success = 0;
   const int outer_iters = image_histo->size;
   const int num_tries_no_success = outer_iters / 2;
@@ -985,6 +1068,12 @@ static int HistogramCombineStochastic(VP8LHistogramSet* const image_histo,
   }
 
   if (!HistoQueueInit(&histo_queue, kHistoQueueSize)) goto End;
+  if (team->num_workers > 1 && outer_iters / 2 >= MIN_PARALLEL_TRIES) {
+    const int max_tries = outer_iters / 2;
+    tries = (HistogramPair*)WebPSafeMalloc(max_tries, sizeof(*tries));
+    tries_seeds = (uint32_t*)WebPSafeMalloc(max_tries, sizeof(*tries_seeds));
+    if (tries == NULL || tries_seeds == NULL) goto End;
+  }
 
   // Collapse similar histograms in 'image_histo'.
   for (iter = 0; iter < outer_iters && image_histo->size >= min_cluster_size &&
@@ -996,7 +1085,41 @@ static int HistogramCombineStochastic(VP8LHistogramSet* const image_histo,
     const uint32_t rand_range = (image_histo->size - 1) * (image_histo->size);
     // (image_histo->size) / 2 was chosen empirically. Less means faster but
     // worse compression.
-    const int num_tries = (image_histo->size) / 2;
+    int num_tries = (image_histo->size) / 2;
+
+    if (tries != NULL && num_tries >= MIN_PARALLEL_TRIES) {
+      int num_picked;
+      uint32_t tries_seed = seed;
+      // Pick all the random samples first, ordering their indices like
+      // HistoQueuePush() does.
+      for (j = 0; image_histo->size >= 2 && j < num_tries; ++j) {
+        const uint32_t tmp = MyRand(&tries_seed) % rand_range;
+        uint32_t idx1 = tmp / (image_histo->size - 1);
+        uint32_t idx2 = tmp % (image_histo->size - 1);
+        if (idx2 >= idx1) ++idx2;
+        tries[j].idx1 = (idx1 < idx2) ? idx1 : idx2;
+        tries[j].idx2 = (idx1 < idx2) ? idx2 : idx1;
+        tries_seeds[j] = tries_seed;
+      }
+      num_picked = j;
+      // Costs inferior to the final 'best_cost' are also inferior to the
+      // current one, and are then fully computed.
+      if (histo_queue.size < histo_queue.max_size) {
+        EvaluatePairs(team, histograms, tries, num_picked, best_cost);
+      }
+      for (j = 0; j < num_picked; ++j) {
+        seed = tries_seeds[j];
+        // Stop here if the queue is full.
+        if (histo_queue.size == histo_queue.max_size) continue;
+        if (tries[j].cost_diff < best_cost) {  // found a better pair?
+          HistoQueueInsert(&histo_queue, &tries[j]);
+          best_cost = tries[j].cost_diff;
+          // Empty the queue if we reached full capacity.
+          if (histo_queue.size == histo_queue.max_size) break;
+        }
+      }
+      num_tries = 0;  // all done
+    }
 
     // Pick random samples.
     for (j = 0; image_histo->size >= 2 && j < num_tries; ++j) {
@@ -1062,44 +1185,73 @@ static int HistogramCombineStochastic(VP8LHistogramSet* const image_histo,
 
 End:
   HistoQueueClear(&histo_queue);
+  WebPSafeFree(tries);
+  WebPSafeFree(tries_seeds);
   return ok;
 }
 
 // -----------------------------------------------------------------------------
 // Histogram refinement
 
+typedef struct {
+  const VP8LHistogramSet* in;
+  const VP8LHistogramSet* out;
+  uint32_t* symbols;
+} RemapJob;
+
+// Finds the best 'out' histogram for the used 'in' histograms [start, end).
+static int FindBestOutHistograms(void* data, int start, int end,
+                                 int worker_id) {
+  const RemapJob* const job = (const RemapJob*)data;
+  VP8LHistogram** const in_histo = job->in->histograms;
+  VP8LHistogram** const out_histo = job->out->histograms;
+  const int out_size = job->out->size;
+  int i;
+  (void)worker_id;
+  for (i = start; i < end; ++i) {
+    int best_out = 0;
+    int64_t best_bits = WEBP_INT64_MAX;
+    int k;
+    if (in_histo[i] == NULL) continue;
+    for (k = 0; k < out_size; ++k) {
+      int64_t cur_bits;
+      if (HistogramAddThresh(out_histo[k], in_histo[i], best_bits,
+                             &cur_bits)) {
+        best_bits = cur_bits;
+        best_out = k;
+      }
+    }
+    job->symbols[i] = best_out;
+  }
+  return 1;
+}
+
 // Find the best 'out' histogram for each of the 'in' histograms.
 // At call-time, 'out' contains the histograms of the clusters.
 // Note: we assume that out[]->bit_cost is already up-to-date.
 static void HistogramRemap(const VP8LHistogramSet* const in,
                            VP8LHistogramSet* const out,
-                           uint32_t* const symbols) {
+                           uint32_t* const symbols,
+                           WebPWorkerTeam* const team) {
   int i;
   VP8LHistogram** const in_histo = in->histograms;
   VP8LHistogram** const out_histo = out->histograms;
   const int in_size = out->max_size;
   const int out_size = out->size;
   if (out_size > 1) {
+    RemapJob job;
+    job.in = in;
+    job.out = out;
+    job.symbols = symbols;
+    // The hook can't fail.
+    (void)WebPWorkerTeamRun(team, in_size, FindBestOutHistograms, &job);
     for (i = 0; i < in_size; ++i) {
-      int best_out = 0;
-      int64_t best_bits = WEBP_INT64_MAX;
-      int k;
       if (in_histo[i] == NULL) {
         // Arbitrarily set to the previous value if unused to help future LZ77.
         // in_histo[0] is always used, cf. HistogramCopyAndAnalyze()
         assert(i > 0);
         symbols[i] = symbols[i - 1];
-        continue;
-      }
-      for (k = 0; k < out_size; ++k) {
-        int64_t cur_bits;
-        if (HistogramAddThresh(out_histo[k], in_histo[i], best_bits,
-                               &cur_bits)) {
-          best_bits = cur_bits;
-          best_out = k;
-        }
       }
-      symbols[i] = best_out;
     }
   } else {
     assert(out_size == 1);
@@ -1137,6 +1289,7 @@ int VP8LGetHistoImageSymbols(int xsize, int ysize,
                              VP8LHistogramSet* const image_histo,
                              VP8LHistogram* const tmp_histo,
                              uint32_t* const histogram_symbols,
+                             WebPWorkerTeam* const team,
                              const WebPPicture* const pic, int percent_range,
                              int* const percent) {
   const int histo_xsize =
@@ -1180,12 +1333,13 @@ int VP8LGetHistoImageSymbols(int xsize, int ysize,
         (int)(1 + DivRound(quality * quality * quality * (MAX_HISTO_GREEDY - 1),
                            100 * 100 * 100));
     int do_greedy;
-    if (!HistogramCombineStochastic(image_histo, threshold_size, &do_greedy)) {
+    if (!HistogramCombineStochastic(image_histo, threshold_size, team,
+                                    &do_greedy)) {
       WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
       goto Error;
     }
     if (do_greedy) {
-      if (!HistogramCombineGreedy(image_histo)) {
+      if (!HistogramCombineGreedy(image_histo, team)) {
         WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
         goto Error;
       }
@@ -1193,7 +1347,7 @@ int VP8LGetHistoImageSymbols(int xsize, int ysize,
   }
 
   // Find the optimal map from original histograms to the final ones.
-  HistogramRemap(orig_histo, image_histo, histogram_symbols);
+  HistogramRemap(orig_histo, image_histo, histogram_symbols, team);
 
   if (!WebPReportProgress(pic, *percent + percent_range, percent)) {
     goto Error;
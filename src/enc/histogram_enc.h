@@ -15,6 +15,7 @@
 #define WEBP_ENC_HISTOGRAM_ENC_H_
 
 #include "src/enc/backward_references_enc.h"
+#include "src/utils/thread_utils.h"
 #include "src/webp/encode.h"
 #include "src/webp/format_constants.h"
 #include "src/webp/types.h"
@@ -102,7 +103,9 @@ static WEBP_INLINE int VP8LHistogramNumCodes(int palette_code_bits) {
          ((palette_code_bits > 0) ? (1 << palette_code_bits) : 0);
 }
 
-// Builds the histogram image. pic and percent are for progress.
+// Builds the histogram image. The pair costs of the clustering are evaluated
+// by the workers of 'team', with the same result whatever their number.
+// pic and percent are for progress.
 // Returns false in case of error (stored in pic->error_code).
 int VP8LGetHistoImageSymbols(int xsize, int ysize,
                              const VP8LBackwardRefs* const refs, int quality,
@@ -110,6 +113,7 @@ int VP8LGetHistoImageSymbols(int xsize, int ysize,
                              VP8LHistogramSet* const image_histo,
                              VP8LHistogram* const tmp_histo,
                              uint32_t* const histogram_symbols,
+                             WebPWorkerTeam* const team,
                              const WebPPicture* const pic, int percent_range,
                              int* const percent);
 
@@ -62,7 +62,6 @@ static void VP8IteratorReset(VP8EncIterator* const it) {
   VP8Encoder* const enc = it->enc;
   VP8IteratorSetRow(it, 0);
   VP8IteratorSetCountDown(it, enc->mb_w * enc->mb_h);  // default
-  InitTop(it);
   memset(it->bit_count, 0, sizeof(it->bit_count));
   it->do_trellis = 0;
 }
@@ -76,6 +75,11 @@ int VP8IteratorIsDone(const VP8EncIterator* const it) {
 }
 
 void VP8IteratorInit(VP8Encoder* const enc, VP8EncIterator* const it) {
+  VP8IteratorInitLocal(enc, it);
+  InitTop(it);
+}
+
+void VP8IteratorInitLocal(VP8Encoder* const enc, VP8EncIterator* const it) {
   it->enc = enc;
   it->yuv_in = (uint8_t*)WEBP_ALIGN(it->yuv_mem);
   it->yuv_out = it->yuv_in + YUV_SIZE_ENC;
@@ -87,6 +91,7 @@ void VP8IteratorInit(VP8Encoder* const enc, VP8EncIterator* const it) {
   it->u_left = it->y_left + 16 + 16;
   it->v_left = it->u_left + 16;
   it->top_derr = enc->top_derr;
+  it->max_edge = NULL;
   VP8IteratorReset(it);
 }
 
@@ -135,10 +140,11 @@ static void ImportLine(const uint8_t* src, int src_stride, uint8_t* dst,
 void VP8IteratorImport(VP8EncIterator* const it, uint8_t* const tmp_32) {
   const VP8Encoder* const enc = it->enc;
   const int x = it->x, y = it->y;
+  const int pic_y = y - enc->pic_mb_y;
   const WebPPicture* const pic = enc->pic;
-  const uint8_t* const ysrc = pic->y + (y * pic->y_stride + x) * 16;
-  const uint8_t* const usrc = pic->u + (y * pic->uv_stride + x) * 8;
-  const uint8_t* const vsrc = pic->v + (y * pic->uv_stride + x) * 8;
+  const uint8_t* const ysrc = pic->y + (pic_y * pic->y_stride + x) * 16;
+  const uint8_t* const usrc = pic->u + (pic_y * pic->uv_stride + x) * 8;
+  const uint8_t* const vsrc = pic->v + (pic_y * pic->uv_stride + x) * 8;
   const int w = MinSize(pic->width - x * 16, 16);
   const int h = MinSize(pic->height - y * 16, 16);
   const int uv_w = (w + 1) >> 1;
@@ -330,10 +330,12 @@ static WEBP_INLINE uint32_t* GetAccumulatedHisto(uint32_t* all_accumulated,
 }
 
 // Find and store the best predictor for a tile at subsampling
-// 'subsampling_index'.
+// 'subsampling_index'. The tiles above 'first_tile_y' are not considered as
+// neighbors.
 static void GetBestPredictorForTile(const uint32_t* const all_argb,
                                     int subsampling_index, int tile_x,
-                                    int tile_y, int tiles_per_row,
+                                    int tile_y, int first_tile_y,
+                                    int tiles_per_row,
                                     uint32_t* all_accumulated_argb,
                                     uint32_t** const all_modes,
                                     uint32_t* const all_pred_histos) {
@@ -347,8 +349,9 @@ static void GetBestPredictorForTile(const uint32_t* const all_argb,
       (tile_x > 0) ? (modes[tile_y * tiles_per_row + tile_x - 1] >> 8) & 0xff
                    : 0xff;
   const int above_mode =
-      (tile_y > 0) ? (modes[(tile_y - 1) * tiles_per_row + tile_x] >> 8) & 0xff
-                   : 0xff;
+      (tile_y > first_tile_y)
+          ? (modes[(tile_y - 1) * tiles_per_row + tile_x] >> 8) & 0xff
+          : 0xff;
   int mode;
   int64_t best_diff = WEBP_INT64_MAX;
   uint32_t best_mode = 0;
@@ -586,10 +589,39 @@ void VP8LOptimizeSampling(uint32_t* const image, int full_width,
   *best_bits_out = best_bits;
 }
 
-// Computes the best predictor image.
-// Finds the best predictors per tile. Once done, finds the best predictor image
-// sampling.
-// best_bits is set to 0 in case of error.
+//------------------------------------------------------------------------------
+// Search by bands.
+// With a worker team, the tiles are searched by horizontal bands which are
+// processed concurrently, each with its own accumulated histograms. The bands
+// only depend on the image height, so that the result does not depend on the
+// number of workers.
+
+#define MIN_BAND_HEIGHT 128  // in pixels
+#define MAX_NUM_BANDS 16
+
+// Returns the number of rows of tiles of side 2^'bits' per band.
+static int GetBandTileRows(int height, int bits,
+                           const WebPWorkerTeam* const team) {
+  const int tile_rows = VP8LSubSampleSize(height, bits);
+  const int num_bands =
+      (team == NULL) ? 1
+                     : GetMax(1, GetMin(height / MIN_BAND_HEIGHT,
+                                        MAX_NUM_BANDS));
+  return (tile_rows + num_bands - 1) / num_bands;
+}
+
+// Returns the number of scratch buffers needed to search 'num_bands' bands.
+static int GetNumBandScratches(int num_bands,
+                               const WebPWorkerTeam* const team) {
+  return (team == NULL) ? 1 : GetMax(1, GetMin(num_bands, team->num_workers));
+}
+
+//------------------------------------------------------------------------------
+
+// Finds the best predictors of the tiles in the max-tile rows
+// [max_tile_y_start, max_tile_y_end), regardless of the tiles above.
+// 'all_argb' must be zeroed, it is left zeroed.
+// Returns false in case of user abort.
 // The following requires some glossary:
 // - a tile is a square of side 2^min_bits pixels.
 // - a super-tile of a tile is a square of side 2^bits pixels with bits in
@@ -611,29 +643,23 @@ void VP8LOptimizeSampling(uint32_t* const image, int full_width,
 // When computing the residuals for a tile, the histogram of the above
 // super-tile is updated. If this super-tile is finished, its histogram is used
 // to update the histogram of the next super-tile and so on up to the max-tile.
-static void GetBestPredictorsAndSubSampling(
+static int GetBestPredictorsForBand(
     int width, int height, const int min_bits, const int max_bits,
-    uint32_t* const argb_scratch, const uint32_t* const argb,
-    int max_quantization, int exact, int used_subtract_green,
-    const WebPPicture* const pic, int percent_range, int* const percent,
-    uint32_t** const all_modes, int* best_bits, uint32_t** best_mode) {
+    int max_tile_y_start, int max_tile_y_end, uint32_t* const argb_scratch,
+    const uint32_t* const argb, int max_quantization, int exact,
+    int used_subtract_green, uint32_t* const all_argb,
+    uint32_t* const all_accumulated_argb, uint32_t* const all_pred_histos,
+    uint32_t** const all_modes, const WebPPicture* const pic,
+    int percent_range, int* const percent) {
   const uint32_t tiles_per_row = VP8LSubSampleSize(width, min_bits);
   const uint32_t tiles_per_col = VP8LSubSampleSize(height, min_bits);
-  int64_t best_cost;
   uint32_t subsampling_index;
   const uint32_t max_subsampling_index = max_bits - min_bits;
-  // Compute the needed memory size for residual histograms, accumulated
-  // residual histograms and predictor histograms.
-  const int num_argb = (max_subsampling_index + 1) * kNumPredModes * HISTO_SIZE;
-  const int num_accumulated_rgb = (max_subsampling_index + 1) * HISTO_SIZE;
-  const int num_predictors = (max_subsampling_index + 1) * kNumPredModes;
-  uint32_t* const raw_data = (uint32_t*)WebPSafeCalloc(
-      num_argb + num_accumulated_rgb + num_predictors, sizeof(uint32_t));
-  uint32_t* const all_argb = raw_data;
-  uint32_t* const all_accumulated_argb = all_argb + num_argb;
-  uint32_t* const all_pred_histos = all_accumulated_argb + num_accumulated_rgb;
   const int max_tile_size = 1 << max_subsampling_index;  // in tile size
-  int percent_start = *percent;
+  const uint32_t first_tile_y = max_tile_y_start * max_tile_size;
+  const uint32_t end_tile_y =
+      GetMin(max_tile_y_end * max_tile_size, tiles_per_col);
+  const int percent_start = (percent != NULL) ? *percent : 0;
   // When using the residuals of a tile for its super-tiles, you can either:
   // - use each residual to update the histogram of the super-tile, with a cost
   //   of 4 * (1<<n)^2 increment operations (4 for the number of channels, and
@@ -647,17 +673,10 @@ static void GetBestPredictorsAndSubSampling(
       GetMax(GetMin(4, max_bits), min_bits) - min_bits;
   // Coordinates in the max-tile in tile units.
   uint32_t local_tile_x = 0, local_tile_y = 0;
-  uint32_t max_tile_x = 0, max_tile_y = 0;
-  uint32_t tile_x = 0, tile_y = 0;
-
-  *best_bits = 0;
-  *best_mode = NULL;
-  if (raw_data == NULL) {
-    WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
-    return;
-  }
+  uint32_t max_tile_x = 0, max_tile_y = max_tile_y_start;
+  uint32_t tile_x = 0, tile_y = first_tile_y;
 
-  while (tile_y < tiles_per_col) {
+  while (tile_y < end_tile_y) {
     ComputeResidualsForTile(width, height, tile_x, tile_y, min_bits,
                             update_up_to_index, all_argb, argb_scratch, argb,
                             max_quantization, exact, used_subtract_green);
@@ -670,8 +689,9 @@ static void GetBestPredictorsAndSubSampling(
       const uint32_t super_tiles_per_row =
           VP8LSubSampleSize(width, min_bits + subsampling_index);
       GetBestPredictorForTile(all_argb, subsampling_index, super_tile_x,
-                              super_tile_y, super_tiles_per_row,
-                              all_accumulated_argb, all_modes, all_pred_histos);
+                              super_tile_y, first_tile_y >> subsampling_index,
+                              super_tiles_per_row, all_accumulated_argb,
+                              all_modes, all_pred_histos);
       if (subsampling_index == max_subsampling_index) break;
 
       // Update the following super-tile histogram if it has not been updated
@@ -736,6 +756,127 @@ static void GetBestPredictorsAndSubSampling(
         !WebPReportProgress(
             pic, percent_start + percent_range * tile_y / tiles_per_col,
             percent)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+typedef struct {
+  int width, height, min_bits, max_bits;
+  int band_max_tile_rows;  // number of max-tile rows per band
+  const uint32_t* argb;
+  int max_quantization, exact, used_subtract_green;
+  uint32_t** all_modes;
+  uint32_t* band_histos;  // accumulated and predictor histograms per band
+  int band_histos_size;
+  uint32_t* scratches;  // residual histograms and scanlines per worker
+  int scratch_size;
+  int argb_histos_size;
+} PredictorBandsJob;
+
+static int PredictorBandsHook(void* data, int start, int end, int worker_id) {
+  const PredictorBandsJob* const job = (const PredictorBandsJob*)data;
+  uint32_t* const all_argb = job->scratches + worker_id * job->scratch_size;
+  uint32_t* const argb_scratch = all_argb + job->argb_histos_size;
+  const int max_subsampling_index = job->max_bits - job->min_bits;
+  int band;
+  for (band = start; band < end; ++band) {
+    uint32_t* const all_accumulated_argb =
+        job->band_histos + band * job->band_histos_size;
+    uint32_t* const all_pred_histos =
+        all_accumulated_argb + (max_subsampling_index + 1) * HISTO_SIZE;
+    (void)GetBestPredictorsForBand(
+        job->width, job->height, job->min_bits, job->max_bits,
+        band * job->band_max_tile_rows, (band + 1) * job->band_max_tile_rows,
+        argb_scratch, job->argb, job->max_quantization, job->exact,
+        job->used_subtract_green, all_argb, all_accumulated_argb,
+        all_pred_histos, job->all_modes, /*pic=*/NULL, 0, /*percent=*/NULL);
+  }
+  return 1;
+}
+
+// Computes the best predictor image.
+// Finds the best predictors per tile, by bands on the 'team' if not NULL.
+// Once done, finds the best predictor image sampling.
+// best_bits is set to 0 in case of error.
+static void GetBestPredictorsAndSubSampling(
+    int width, int height, const int min_bits, const int max_bits,
+    uint32_t* const argb_scratch, const uint32_t* const argb,
+    int max_quantization, int exact, int used_subtract_green,
+    WebPWorkerTeam* const team, const WebPPicture* const pic,
+    int percent_range, int* const percent, uint32_t** const all_modes,
+    int* best_bits, uint32_t** best_mode) {
+  int64_t best_cost;
+  uint32_t subsampling_index;
+  const uint32_t max_subsampling_index = max_bits - min_bits;
+  // Compute the needed memory size for residual histograms, accumulated
+  // residual histograms and predictor histograms.
+  const int num_argb = (max_subsampling_index + 1) * kNumPredModes * HISTO_SIZE;
+  const int num_accumulated_rgb = (max_subsampling_index + 1) * HISTO_SIZE;
+  const int num_predictors = (max_subsampling_index + 1) * kNumPredModes;
+  const int max_tile_rows = VP8LSubSampleSize(height, max_bits);
+  const int band_max_tile_rows = GetBandTileRows(height, max_bits, team);
+  const int num_bands =
+      (max_tile_rows + band_max_tile_rows - 1) / band_max_tile_rows;
+  const int num_scratches = GetNumBandScratches(num_bands, team);
+  // Each worker also needs its own scanlines, see AllocateTransformBuffer().
+  const int num_scanlines =
+      (num_bands == 1) ? 0
+                       : (width + 1) * 2 + (width * 2 + sizeof(uint32_t) - 1) /
+                                               sizeof(uint32_t);
+  PredictorBandsJob job;
+  uint32_t* raw_data;
+  uint32_t* all_accumulated_argb;
+  uint32_t* all_pred_histos;
+  int percent_start = *percent;
+
+  *best_bits = 0;
+  *best_mode = NULL;
+  job.band_histos_size = num_accumulated_rgb + num_predictors;
+  job.scratch_size = num_argb + num_scanlines;
+  raw_data = (uint32_t*)WebPSafeCalloc(
+      (uint64_t)num_bands * job.band_histos_size +
+          (uint64_t)num_scratches * job.scratch_size,
+      sizeof(uint32_t));
+  if (raw_data == NULL) {
+    WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    return;
+  }
+  all_accumulated_argb = raw_data;
+  all_pred_histos = all_accumulated_argb + num_accumulated_rgb;
+
+  if (num_bands == 1) {
+    if (!GetBestPredictorsForBand(
+            width, height, min_bits, max_bits, 0, max_tile_rows, argb_scratch,
+            argb, max_quantization, exact, used_subtract_green,
+            raw_data + job.band_histos_size, all_accumulated_argb,
+            all_pred_histos, all_modes, pic, percent_range, percent)) {
+      WebPSafeFree(raw_data);
+      return;
+    }
+  } else {
+    int band;
+    job.width = width;
+    job.height = height;
+    job.min_bits = min_bits;
+    job.max_bits = max_bits;
+    job.band_max_tile_rows = band_max_tile_rows;
+    job.argb = argb;
+    job.max_quantization = max_quantization;
+    job.exact = exact;
+    job.used_subtract_green = used_subtract_green;
+    job.all_modes = all_modes;
+    job.band_histos = raw_data;
+    job.scratches = raw_data + num_bands * job.band_histos_size;
+    job.argb_histos_size = num_argb;
+    (void)WebPWorkerTeamRun(team, num_bands, PredictorBandsHook, &job);
+    // Merge the histograms of the bands, in order.
+    for (band = 1; band < num_bands; ++band) {
+      VP8LAddVectorEq(job.band_histos + band * job.band_histos_size,
+                      job.band_histos, job.band_histos_size);
+    }
+    if (!WebPReportProgress(pic, percent_start + percent_range, percent)) {
       WebPSafeFree(raw_data);
       return;
     }
@@ -774,9 +915,9 @@ int VP8LResidualImage(int width, int height, int min_bits, int max_bits,
                       int low_effort, uint32_t* const argb,
                       uint32_t* const argb_scratch, uint32_t* const image,
                       int near_lossless_quality, int exact,
-                      int used_subtract_green, const WebPPicture* const pic,
-                      int percent_range, int* const percent,
-                      int* const best_bits) {
+                      int used_subtract_green, WebPWorkerTeam* const team,
+                      const WebPPicture* const pic, int percent_range,
+                      int* const percent, int* const best_bits) {
   int percent_start = *percent;
   const int max_quantization = 1 << VP8LNearLosslessBits(near_lossless_quality);
   if (low_effort) {
@@ -812,7 +953,7 @@ int VP8LResidualImage(int width, int height, int min_bits, int max_bits,
     // Find the best sampling.
     GetBestPredictorsAndSubSampling(
         width, height, min_bits, max_bits, argb_scratch, argb, max_quantization,
-        exact, used_subtract_green, pic, percent_range, percent,
+        exact, used_subtract_green, team, pic, percent_range, percent,
         &modes[min_bits], best_bits, &best_mode);
     if (*best_bits == 0) {
       WebPSafeFree(modes_raw);
@@ -1040,21 +1181,30 @@ static void CopyTileWithColorTransform(int xsize, int ysize, int tile_x,
   }
 }
 
-int VP8LColorSpaceTransform(int width, int height, int bits, int quality,
-                            uint32_t* const argb, uint32_t* image,
-                            const WebPPicture* const pic, int percent_range,
-                            int* const percent, int* const best_bits) {
+// Finds and applies the best color transforms of the tile rows
+// [tile_y_start, tile_y_end), regardless of the tiles and pixels above.
+// Returns false in case of user abort.
+static int GetBestColorTransformsForBand(int width, int height, int bits,
+                                         int quality, int tile_y_start,
+                                         int tile_y_end, uint32_t* const argb,
+                                         uint32_t* const image,
+                                         const WebPPicture* const pic,
+                                         int percent_range,
+                                         int* const percent) {
   const int max_tile_size = 1 << bits;
   const int tile_xsize = VP8LSubSampleSize(width, bits);
   const int tile_ysize = VP8LSubSampleSize(height, bits);
-  int percent_start = *percent;
+  // Index of the first pixel of the band.
+  const int ix_start = tile_y_start * max_tile_size * width;
+  const int percent_start = (percent != NULL) ? *percent : 0;
   uint32_t accumulated_red_histo[256] = {0};
   uint32_t accumulated_blue_histo[256] = {0};
   int tile_x, tile_y;
   VP8LMultipliers prev_x, prev_y;
   MultipliersClear(&prev_y);
   MultipliersClear(&prev_x);
-  for (tile_y = 0; tile_y < tile_ysize; ++tile_y) {
+  tile_y_end = GetMin(tile_y_end, tile_ysize);
+  for (tile_y = tile_y_start; tile_y < tile_y_end; ++tile_y) {
     for (tile_x = 0; tile_x < tile_xsize; ++tile_x) {
       int y;
       const int tile_x_offset = tile_x * max_tile_size;
@@ -1062,7 +1212,7 @@ int VP8LColorSpaceTransform(int width, int height, int bits, int quality,
       const int all_x_max = GetMin(tile_x_offset + max_tile_size, width);
       const int all_y_max = GetMin(tile_y_offset + max_tile_size, height);
       const int offset = tile_y * tile_xsize + tile_x;
-      if (tile_y != 0) {
+      if (tile_y != tile_y_start) {
         ColorCodeToMultipliers(image[offset - tile_xsize], &prev_y);
       }
       prev_x = GetBestColorTransformForTile(
@@ -1078,10 +1228,12 @@ int VP8LColorSpaceTransform(int width, int height, int bits, int quality,
         const int ix_end = ix + all_x_max - tile_x_offset;
         for (; ix < ix_end; ++ix) {
           const uint32_t pix = argb[ix];
-          if (ix >= 2 && pix == argb[ix - 2] && pix == argb[ix - 1]) {
+          if (ix >= ix_start + 2 && pix == argb[ix - 2] &&
+              pix == argb[ix - 1]) {
             continue;  // repeated pixels are handled by backward references
           }
-          if (ix >= width + 2 && argb[ix - 2] == argb[ix - width - 2] &&
+          if (ix >= ix_start + width + 2 &&
+              argb[ix - 2] == argb[ix - width - 2] &&
               argb[ix - 1] == argb[ix - width - 1] && pix == argb[ix - width]) {
             continue;  // repeated pixels are handled by backward references
           }
@@ -1096,6 +1248,59 @@ int VP8LColorSpaceTransform(int width, int height, int bits, int quality,
       return 0;
     }
   }
+  return 1;
+}
+
+typedef struct {
+  int width, height, bits, quality;
+  int band_tile_rows;  // number of tile rows per band
+  uint32_t* argb;
+  uint32_t* image;
+} ColorTransformBandsJob;
+
+static int ColorTransformBandsHook(void* data, int start, int end,
+                                   int worker_id) {
+  const ColorTransformBandsJob* const job = (const ColorTransformBandsJob*)data;
+  int band;
+  (void)worker_id;
+  for (band = start; band < end; ++band) {
+    (void)GetBestColorTransformsForBand(
+        job->width, job->height, job->bits, job->quality,
+        band * job->band_tile_rows, (band + 1) * job->band_tile_rows,
+        job->argb, job->image, /*pic=*/NULL, 0, /*percent=*/NULL);
+  }
+  return 1;
+}
+
+int VP8LColorSpaceTransform(int width, int height, int bits, int quality,
+                            uint32_t* const argb, uint32_t* image,
+                            WebPWorkerTeam* const team,
+                            const WebPPicture* const pic, int percent_range,
+                            int* const percent, int* const best_bits) {
+  const int tile_ysize = VP8LSubSampleSize(height, bits);
+  const int band_tile_rows = GetBandTileRows(height, bits, team);
+  const int num_bands = (tile_ysize + band_tile_rows - 1) / band_tile_rows;
+  const int percent_start = *percent;
+  if (num_bands == 1) {
+    if (!GetBestColorTransformsForBand(width, height, bits, quality, 0,
+                                       tile_ysize, argb, image, pic,
+                                       percent_range, percent)) {
+      return 0;
+    }
+  } else {
+    ColorTransformBandsJob job;
+    job.width = width;
+    job.height = height;
+    job.bits = bits;
+    job.quality = quality;
+    job.band_tile_rows = band_tile_rows;
+    job.argb = argb;
+    job.image = image;
+    (void)WebPWorkerTeamRun(team, num_bands, ColorTransformBandsHook, &job);
+    if (!WebPReportProgress(pic, percent_start + percent_range, percent)) {
+      return 0;
+    }
+  }
   VP8LOptimizeSampling(image, width, height, bits, MAX_TRANSFORM_BITS,
                        best_bits);
   return 1;
@@ -243,11 +243,12 @@ static void PutQuant(VP8BitWriter* const bw, const VP8Encoder* const enc) {
 
 // Partition sizes
 static int EmitPartitionsSize(const VP8Encoder* const enc,
+                              const size_t part_sizes[MAX_NUM_PARTITIONS],
                               WebPPicture* const pic) {
   uint8_t buf[3 * (MAX_NUM_PARTITIONS - 1)];
   int p;
   for (p = 0; p < enc->num_parts - 1; ++p) {
-    const size_t part_size = VP8BitWriterSize(enc->parts + p);
+    const size_t part_size = part_sizes[p];
     if (part_size >= VP8_MAX_PARTITION_SIZE) {
       return WebPEncodingSetError(pic, VP8_ENC_ERROR_PARTITION_OVERFLOW);
     }
@@ -317,6 +318,13 @@ void VP8EncFreeBitWriters(VP8Encoder* const enc) {
   }
 }
 
+// Emits the whole bitstream, once all the partitions are complete. The token
+// partitions can't be emitted any earlier by the coding loop: the frame header
+// needs the size of partition #0, which holds the modes of all the macroblocks
+// and precedes them, and the RIFF and VP8 chunk headers need the final size.
+// Hence, with enc->stream_output, they are only sized by the first pass and
+// coded again by a second one. Each partition's memory is released as soon as
+// it is written.
 int VP8EncWrite(VP8Encoder* const enc) {
   WebPPicture* const pic = enc->pic;
   VP8BitWriter* const bw = &enc->bw;
@@ -324,6 +332,7 @@ int VP8EncWrite(VP8Encoder* const enc) {
   const int percent_per_part = task_percent / enc->num_parts;
   const int final_percent = enc->percent + task_percent;
   int ok = 0;
+  size_t part_sizes[MAX_NUM_PARTITIONS];
   size_t vp8_size, pad, riff_size;
   int p;
 
@@ -335,7 +344,9 @@ int VP8EncWrite(VP8Encoder* const enc) {
   vp8_size =
       VP8_FRAME_HEADER_SIZE + VP8BitWriterSize(bw) + 3 * (enc->num_parts - 1);
   for (p = 0; p < enc->num_parts; ++p) {
-    vp8_size += VP8BitWriterSize(enc->parts + p);
+    part_sizes[p] = VP8BitWriterSize(enc->parts + p);
+    if (enc->stream_output) part_sizes[p] += enc->streamed_sizes[p];
+    vp8_size += part_sizes[p];
   }
   pad = vp8_size & 1;
   vp8_size += pad;
@@ -361,18 +372,23 @@ int VP8EncWrite(VP8Encoder* const enc) {
     const uint8_t* const part0 = VP8BitWriterBuf(bw);
     const size_t size0 = VP8BitWriterSize(bw);
     ok = ok && PutWebPHeaders(enc, size0, vp8_size, riff_size) &&
-         pic->writer(part0, size0, pic) && EmitPartitionsSize(enc, pic);
+         pic->writer(part0, size0, pic) &&
+         EmitPartitionsSize(enc, part_sizes, pic);
     VP8BitWriterWipeOut(bw);  // will free the internal buffer.
   }
 
   // Token partitions
-  for (p = 0; p < enc->num_parts; ++p) {
-    const uint8_t* const buf = VP8BitWriterBuf(enc->parts + p);
-    const size_t size = VP8BitWriterSize(enc->parts + p);
-    if (size) ok = ok && pic->writer(buf, size, pic);
-    VP8BitWriterWipeOut(enc->parts + p);  // will free the internal buffer.
-    ok = ok && WebPReportProgress(pic, enc->percent + percent_per_part,
-                                  &enc->percent);
+  if (enc->stream_output) {
+    ok = ok && VP8EncStreamPartitions(enc, part_sizes);
+  } else {
+    for (p = 0; p < enc->num_parts; ++p) {
+      const uint8_t* const buf = VP8BitWriterBuf(enc->parts + p);
+      const size_t size = VP8BitWriterSize(enc->parts + p);
+      if (size) ok = ok && pic->writer(buf, size, pic);
+      VP8BitWriterWipeOut(enc->parts + p);  // will free the internal buffer.
+      ok = ok && WebPReportProgress(pic, enc->percent + percent_per_part,
+                                    &enc->percent);
+    }
   }
 
   // Padding byte
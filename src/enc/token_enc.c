@@ -249,6 +249,53 @@ size_t VP8EstimateTokenSize(VP8TBuffer* const b, const uint8_t* const probas) {
   return size;
 }
 
+size_t VP8TBufferNumTokens(const VP8TBuffer* const b) {
+  size_t num_tokens = 0;
+  const VP8Tokens* p = b->pages;
+  while (p != NULL) {
+    const VP8Tokens* const next = p->next;
+    num_tokens += b->page_size - ((next == NULL) ? b->left : 0);
+    p = next;
+  }
+  return num_tokens;
+}
+
+//------------------------------------------------------------------------------
+// Partial emission
+
+void VP8TCursorInit(VP8TCursor* const cursor, const VP8TBuffer* const b) {
+  cursor->page = b->pages;
+  cursor->pos = b->page_size;
+}
+
+void VP8EmitTokensAt(VP8TCursor* const cursor, const VP8TBuffer* const b,
+                     size_t num_tokens, VP8BitWriter* const bw,
+                     const uint8_t* const probas) {
+  assert(!b->error);
+  while (num_tokens > 0) {
+    const VP8Tokens* const p = cursor->page;
+    const token_t* tokens;
+    int N;
+    assert(p != NULL);
+    N = (p->next == NULL) ? b->left : 0;
+    tokens = TOKEN_DATA(p);
+    while (num_tokens > 0 && cursor->pos > N) {
+      const token_t token = tokens[--cursor->pos];
+      const int bit = (token >> 15) & 1;
+      if (token & FIXED_PROBA_BIT) {
+        VP8PutBit(bw, bit, token & 0xffu);  // constant proba
+      } else {
+        VP8PutBit(bw, bit, probas[token & 0x3fffu]);
+      }
+      --num_tokens;
+    }
+    if (cursor->pos == N && p->next != NULL) {
+      cursor->page = p->next;
+      cursor->pos = b->page_size;
+    }
+  }
+}
+
 //------------------------------------------------------------------------------
 
 #else  // DISABLE_TOKEN_BUFFER
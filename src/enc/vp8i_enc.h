@@ -254,6 +254,8 @@ typedef struct {
   int count_down;            // number of mb still to be processed
   int count_down0;           // starting counter value (for progress)
   int percent0;              // saved initial progress percent
+  int* max_edge;  // if not NULL, records the per-segment max edge deltas
+                  // instead of enc->dqm[] (for concurrent iterators)
 
   DError left_derr;  // left error diffusion (u/v)
   DError* top_derr;  // top diffusion error - NULL if disabled
@@ -274,6 +276,9 @@ typedef struct {
 // in iterator.c
 // must be called first
 void VP8IteratorInit(VP8Encoder* const enc, VP8EncIterator* const it);
+// same as VP8IteratorInit(), but leaves the encoder's shared top contexts
+// untouched. Enough for the iterators only importing the source samples.
+void VP8IteratorInitLocal(VP8Encoder* const enc, VP8EncIterator* const it);
 // reset iterator position to row 'y'
 void VP8IteratorSetRow(VP8EncIterator* const it, int y);
 // set count down (=number of iterations to go)
@@ -343,6 +348,23 @@ int VP8RecordCoeffTokens(int ctx, const struct VP8Residual* const res,
 // Estimate the final coded size given a set of 'probas'.
 size_t VP8EstimateTokenSize(VP8TBuffer* const b, const uint8_t* const probas);
 
+// Returns the number of tokens recorded so far.
+size_t VP8TBufferNumTokens(const VP8TBuffer* const b);
+
+// Reading position, for emitting the tokens of a buffer in several calls.
+typedef struct {
+  const VP8Tokens* page;  // current page
+  int pos;                // the next token is at slot 'pos - 1' of 'page'
+} VP8TCursor;
+
+// Places the cursor on the first token recorded in 'b'.
+void VP8TCursorInit(VP8TCursor* const cursor, const VP8TBuffer* const b);
+// Emits the next 'num_tokens' tokens of 'b', starting at 'cursor' which is
+// then advanced. The pages are not deallocated.
+void VP8EmitTokensAt(VP8TCursor* const cursor, const VP8TBuffer* const b,
+                     size_t num_tokens, VP8BitWriter* const bw,
+                     const uint8_t* const probas);
+
 #endif  // !DISABLE_TOKEN_BUFFER
 
 //------------------------------------------------------------------------------
@@ -369,6 +391,10 @@ struct VP8Encoder {
   VP8BitWriter bw;                         // part0
   VP8BitWriter parts[MAX_NUM_PARTITIONS];  // token partitions
   VP8TBuffer tokens;                       // token buffer
+  // if true, VP8EncLoop() only sizes the token partitions, and they are coded
+  // again by VP8EncStreamPartitions() once the headers are written.
+  int stream_output;
+  size_t streamed_sizes[MAX_NUM_PARTITIONS];  // bytes dropped from parts[]
 
   int percent;  // for progress
 
@@ -384,6 +410,7 @@ struct VP8Encoder {
                    // for relative coding of segments' quant.
   int alpha;       // global susceptibility (<=> complexity)
   int uv_alpha;    // U/V quantization susceptibility
+  int segment_centers[NUM_MB_SEGMENTS];  // segments' mean susceptibility
   // global offset of quantizers, shared by all segments
   int dq_y1_dc;
   int dq_y2_dc, dq_y2_ac;
@@ -415,8 +442,36 @@ struct VP8Encoder {
                        // U and V are packed into 16 bytes (8 U + 8 V)
   LFStats* lf_stats;   // autofilter stats (if NULL, autofilter is off)
   DError* top_derr;    // diffusion error (NULL if disabled)
+
+  // Row streaming (see WebPRowEncoder): the planes of 'pic' only hold the
+  // source samples from macroblock row 'pic_mb_y' on.
+  int pic_mb_y;
+
+  size_t mem_size;  // size of the memory block starting with this struct
 };
 
+//------------------------------------------------------------------------------
+// WebPEncoderContext
+
+struct VP8LEncoder;
+
+// Memory kept from one picture to the next by WebPEncodeWithContext().
+struct WebPEncoderContext {
+  size_t max_retained_memory;  // limit of 'retained_memory'
+  size_t retained_memory;      // total size of the memory kept below
+  void* vp8_mem;               // memory block of the last lossy encoder
+  size_t vp8_mem_size;
+  struct VP8LEncoder* vp8l_encs;  // spare lossless encoders, with their
+                                  // scratch buffers
+};
+
+// Returns true if 'context' can keep 'size' more bytes of memory.
+static WEBP_INLINE int VP8EncContextCanRetain(
+    const WebPEncoderContext* const context, size_t size) {
+  return (context != NULL &&
+          size <= context->max_retained_memory - context->retained_memory);
+}
+
 //------------------------------------------------------------------------------
 // internal functions. Not public.
 
@@ -457,6 +512,24 @@ int VP8GetCostUV(VP8EncIterator* const it, const VP8ModeScore* const rd);
 int VP8EncLoop(VP8Encoder* const enc);
 int VP8EncTokenLoop(VP8Encoder* const enc);
 
+// Second coding pass of VP8EncLoop() if enc->stream_output is true: the
+// token partitions, of sizes 'part_sizes[]', are passed to the picture's
+// writer as the rows are coded.
+int VP8EncStreamPartitions(VP8Encoder* const enc,
+                           const size_t part_sizes[MAX_NUM_PARTITIONS]);
+
+// Row streaming version of VP8EncLoop(): the rows are coded band by band, as
+// soon as their source samples are available.
+typedef struct VP8EncRowLoop VP8EncRowLoop;
+// Collects the statistics on the first 'num_rows' macroblock rows and
+// prepares the coding. Returns NULL in case of error.
+VP8EncRowLoop* VP8EncRowLoopNew(VP8Encoder* const enc, int num_rows);
+// Codes the next rows, up to 'last_row' (excluded).
+int VP8EncRowLoopCode(VP8EncRowLoop* const loop, int last_row);
+// Finalizes the partitions once all the rows are coded, if 'ok' is true, and
+// releases 'loop'. Returns false in case of error.
+int VP8EncRowLoopDelete(VP8EncRowLoop* const loop, int ok);
+
 // in webpenc.c
 // Assign an error code to a picture. Return false for convenience.
 int WebPEncodingSetError(const WebPPicture* const pic, WebPEncodingError error);
@@ -467,6 +540,10 @@ int WebPReportProgress(const WebPPicture* const pic, int percent,
 // Main analysis loop. Decides the segmentations and complexity.
 // Assigns a first guess for Intra16 and 'uvmode' prediction modes.
 int VP8EncAnalyze(VP8Encoder* const enc);
+// Row streaming version of VP8EncAnalyze(), for the rows in [first_row,
+// last_row). The first call (with 'first_row' = 0) decides the complexity and
+// the segments, and the next rows are assigned to the closest segment.
+int VP8EncAnalyzeRows(VP8Encoder* const enc, int first_row, int last_row);
 
 // in quant.c
 // Sets up segment's quantization values, 'base_quant' and filter strengths.
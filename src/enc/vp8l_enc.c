@@ -13,6 +13,7 @@
 //
 
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -287,6 +288,37 @@ typedef struct {
 // kPaletteAndSpatial.
 #define CRUNCH_CONFIGS_MAX (kNumEntropyIx + 2 * kPaletteSortingNum)
 
+// Sets 'try_sorting' for the palette sortings worth trying. The ones giving
+// the same palette as a previous one are not, as they would also give the
+// same transformed image, hence the same encoding.
+// Returns false in case of memory error.
+static int GetPaletteSortingsToTry(const VP8LEncoder* const enc,
+                                   int try_sorting[kPaletteSortingNum]) {
+  uint32_t palettes[kPaletteSortingNum][MAX_PALETTE_SIZE];
+  int i, j;
+  for (i = 0; i < kPaletteSortingNum; ++i) {
+    const PaletteSorting sorting = (PaletteSorting)i;
+    try_sorting[i] = 0;
+    // TODO(vrabaud) kSortedDefault should be tested. It is omitted
+    // for now for backward compatibility.
+    if (sorting == kUnusedPalette || sorting == kSortedDefault) continue;
+    if (!PaletteSort(sorting, enc->pic, enc->palette_sorted,
+                     enc->palette_size, palettes[i])) {
+      return 0;
+    }
+    try_sorting[i] = 1;
+    for (j = 0; j < i; ++j) {
+      if (try_sorting[j] &&
+          !memcmp(palettes[j], palettes[i],
+                  enc->palette_size * sizeof(palettes[i][0]))) {
+        try_sorting[i] = 0;
+        break;
+      }
+    }
+  }
+  return 1;
+}
+
 static int EncoderAnalyze(VP8LEncoder* const enc,
                           CrunchConfig crunch_configs[CRUNCH_CONFIGS_MAX],
                           int* const crunch_configs_size,
@@ -335,6 +367,8 @@ static int EncoderAnalyze(VP8LEncoder* const enc,
       return 0;
     }
     if (method == 6 && config->quality == 100) {
+      int try_sorting[kPaletteSortingNum];
+      if (use_palette && !GetPaletteSortingsToTry(enc, try_sorting)) return 0;
       do_no_cache = 1;
       // Go brute force on all transforms.
       *crunch_configs_size = 0;
@@ -349,12 +383,7 @@ static int EncoderAnalyze(VP8LEncoder* const enc,
                  ++sorting_method) {
               const PaletteSorting typed_sorting_method =
                   (PaletteSorting)sorting_method;
-              // TODO(vrabaud) kSortedDefault should be tested. It is omitted
-              // for now for backward compatibility.
-              if (typed_sorting_method == kUnusedPalette ||
-                  typed_sorting_method == kSortedDefault) {
-                continue;
-              }
+              if (!try_sorting[sorting_method]) continue;
               crunch_configs[(*crunch_configs_size)].entropy_idx = i;
               crunch_configs[(*crunch_configs_size)].palette_sorting_type =
                   typed_sorting_method;
@@ -410,9 +439,13 @@ static int EncoderInit(VP8LEncoder* const enc) {
   // at most MAX_REFS_BLOCK_PER_IMAGE blocks used:
   const int refs_block_size = (pix_cnt - 1) / MAX_REFS_BLOCK_PER_IMAGE + 1;
   int i;
-  if (!VP8LHashChainInit(&enc->hash_chain, pix_cnt)) return 0;
+  // The scratch buffers of a reused encoder are kept if large enough.
+  if (enc->hash_chain.size < pix_cnt) {
+    VP8LHashChainClear(&enc->hash_chain);
+    if (!VP8LHashChainInit(&enc->hash_chain, pix_cnt)) return 0;
+  }
 
-  for (i = 0; i < 4; ++i) VP8LBackwardRefsInit(&enc->refs[i], refs_block_size);
+  for (i = 0; i < 4; ++i) VP8LBackwardRefsReset(&enc->refs[i], refs_block_size);
 
   return 1;
 }
@@ -768,7 +801,7 @@ static int EncodeImageNoHuffman(VP8LBitWriter* const bw,
 
   // Calculate backward references from ARGB image.
   if (!VP8LHashChainFill(hash_chain, quality, argb, width, height, low_effort,
-                         pic, percent_range / 2, percent)) {
+                         /*team=*/NULL, pic, percent_range / 2, percent)) {
     goto Error;
   }
   if (!VP8LGetBackwardReferences(width, height, argb, quality, /*low_effort=*/0,
@@ -837,13 +870,28 @@ Error:
 }
 
 // pic and percent are for progress.
+// Counters shared by the workers trying the crunch configs.
+enum { kCrunchNextConfig = 0, kCrunchBestSize, kCrunchNumCounters };
+
+// Returns true if a stream which is already 'size' bytes long can't beat the
+// smallest one completed so far by any worker (if 'counters' is not NULL).
+static int CrunchIsAbandoned(WebPSyncCounters* const counters, size_t size) {
+  if (counters == NULL) return 0;
+  return (size > (size_t)WebPSyncCountersMin(counters, kCrunchBestSize,
+                                             INT_MAX));
+}
+
+// If every sub-config is abandoned (see CrunchIsAbandoned()), '*abandoned' is
+// set and 'bw' is left in an unspecified state.
 static int EncodeImageInternal(
     VP8LBitWriter* const bw, const uint32_t* const argb,
     VP8LHashChain* const hash_chain, VP8LBackwardRefs refs_array[4], int width,
-    int height, int quality, int low_effort, const CrunchConfig* const config,
+    int height, int quality, int low_effort, int low_memory,
+    const CrunchConfig* const config,
     int* cache_bits, int histogram_bits_in, size_t init_byte_position,
-    int* const hdr_size, int* const data_size, const WebPPicture* const pic,
-    int percent_range, int* const percent) {
+    int* const hdr_size, int* const data_size, WebPWorkerTeam* const team,
+    const WebPPicture* const pic, WebPSyncCounters* const crunch_counters,
+    int* const abandoned, int percent_range, int* const percent) {
   const uint32_t histogram_image_xysize =
       VP8LSubSampleSize(width, histogram_bits_in) *
       VP8LSubSampleSize(height, histogram_bits_in);
@@ -884,8 +932,10 @@ static int EncodeImageInternal(
   }
 
   percent_range = remaining_percent / 5;
+  // The hash chain filled by chunks needs a second chain.
   if (!VP8LHashChainFill(hash_chain, quality, argb, width, height, low_effort,
-                         pic, percent_range, percent)) {
+                         low_memory ? NULL : team, pic, percent_range,
+                         percent)) {
     goto Error;
   }
   percent_start += percent_range;
@@ -941,7 +991,7 @@ static int EncodeImageInternal(
       if (!VP8LGetHistoImageSymbols(
               width, height, &refs_array[i_cache], quality, low_effort,
               histogram_bits, cache_bits_tmp, histogram_image, tmp_histo,
-              histogram_argb, pic, i_percent_range, percent)) {
+              histogram_argb, team, pic, i_percent_range, percent)) {
         goto Error;
       }
       // Create Huffman bit lengths and codes for each histogram image.
@@ -1020,14 +1070,16 @@ static int EncodeImageInternal(
           ClearHuffmanTreeIfOnlyOneSymbol(codes);
         }
       }
-      // Store actual literals.
+      // Store actual literals, unless the headers are already too big.
       hdr_size_tmp = (int)(VP8LBitWriterNumBytes(bw) - init_byte_position);
-      if (!StoreImageToBitMask(bw, width, histogram_bits, &refs_array[i_cache],
-                               histogram_argb, huffman_codes, pic)) {
+      if (CrunchIsAbandoned(crunch_counters, VP8LBitWriterNumBytes(bw))) {
+        // Skip it.
+      } else if (!StoreImageToBitMask(bw, width, histogram_bits,
+                                      &refs_array[i_cache], histogram_argb,
+                                      huffman_codes, pic)) {
         goto Error;
-      }
-      // Keep track of the smallest image so far.
-      if (VP8LBitWriterNumBytes(bw) < bw_size_best) {
+      } else if (VP8LBitWriterNumBytes(bw) < bw_size_best) {
+        // Keep track of the smallest image so far.
         bw_size_best = VP8LBitWriterNumBytes(bw);
         *cache_bits = cache_bits_tmp;
         *hdr_size = hdr_size_tmp;
@@ -1044,7 +1096,8 @@ static int EncodeImageInternal(
       }
     }
   }
-  VP8LBitWriterSwap(bw, &bw_best);
+  *abandoned = (bw_size_best == ~(size_t)0);
+  if (!*abandoned) VP8LBitWriterSwap(bw, &bw_best);
 
   if (!WebPReportProgress(pic, percent_start + remaining_percent, percent)) {
     goto Error;
@@ -1075,6 +1128,14 @@ static void ApplySubtractGreen(VP8LEncoder* const enc, int width, int height,
   VP8LSubtractGreenFromBlueAndRed(enc->argb, width * height);
 }
 
+// Returns the team searching the transforms by bands, NULL if they should be
+// searched over the whole image (see VP8LResidualImage()).
+static WebPWorkerTeam* GetSearchTeam(VP8LEncoder* const enc) {
+  return (enc->config->thread_level > 0 && enc->pic->num_threads >= 2)
+             ? &enc->team
+             : NULL;
+}
+
 static int ApplyPredictFilter(VP8LEncoder* const enc, int width, int height,
                               int quality, int low_effort,
                               int used_subtract_green, VP8LBitWriter* const bw,
@@ -1093,8 +1154,8 @@ static int ApplyPredictFilter(VP8LEncoder* const enc, int width, int height,
   if (!VP8LResidualImage(width, height, min_bits, max_bits, low_effort,
                          enc->argb, enc->argb_scratch, enc->transform_data,
                          near_lossless_strength, enc->config->exact,
-                         used_subtract_green, enc->pic, percent_range / 2,
-                         percent, best_bits)) {
+                         used_subtract_green, GetSearchTeam(enc), enc->pic,
+                         percent_range / 2, percent, best_bits)) {
     return 0;
   }
   VP8LPutBits(bw, TRANSFORM_PRESENT, 1);
@@ -1115,8 +1176,9 @@ static int ApplyCrossColorFilter(VP8LEncoder* const enc, int width, int height,
   const int min_bits = enc->cross_color_transform_bits;
 
   if (!VP8LColorSpaceTransform(width, height, min_bits, quality, enc->argb,
-                               enc->transform_data, enc->pic, percent_range / 2,
-                               percent, best_bits)) {
+                               enc->transform_data, GetSearchTeam(enc),
+                               enc->pic, percent_range / 2, percent,
+                               best_bits)) {
     return 0;
   }
   VP8LPutBits(bw, TRANSFORM_PRESENT, 1);
@@ -1447,12 +1509,46 @@ static int EncodePalette(VP8LBitWriter* const bw, int low_effort,
 // -----------------------------------------------------------------------------
 // VP8LEncoder
 
+// Returns the size in bytes of the scratch buffers kept by 'enc' for reuse.
+static size_t GetScratchSize(const VP8LEncoder* const enc) {
+  size_t size = (size_t)enc->hash_chain.size *
+                    sizeof(*enc->hash_chain.offset_length) +
+                enc->transform_mem_size * sizeof(*enc->transform_mem);
+  int i;
+  for (i = 0; i < 4; ++i) size += VP8LBackwardRefsMemorySize(&enc->refs[i]);
+  return size;
+}
+
+// If 'context' has a spare encoder, it is reused with its scratch buffers.
 static VP8LEncoder* VP8LEncoderNew(const WebPConfig* const config,
-                                   const WebPPicture* const picture) {
-  VP8LEncoder* const enc = (VP8LEncoder*)WebPSafeCalloc(1ULL, sizeof(*enc));
-  if (enc == NULL) {
-    WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
-    return NULL;
+                                   const WebPPicture* const picture,
+                                   WebPEncoderContext* const context) {
+  VP8LEncoder* enc;
+  if (context != NULL && context->vp8l_encs != NULL) {
+    // Keep the scratch buffers only and reset everything else. The
+    // references point to themselves and must stay at the same address.
+    VP8LHashChain hash_chain;
+    VP8LBackwardRefs refs[4];
+    uint32_t* transform_mem;
+    size_t transform_mem_size;
+    enc = context->vp8l_encs;
+    context->vp8l_encs = enc->next;
+    context->retained_memory -= GetScratchSize(enc);
+    hash_chain = enc->hash_chain;
+    memcpy(refs, enc->refs, sizeof(refs));
+    transform_mem = enc->transform_mem;
+    transform_mem_size = enc->transform_mem_size;
+    memset(enc, 0, sizeof(*enc));
+    enc->hash_chain = hash_chain;
+    memcpy(enc->refs, refs, sizeof(refs));
+    enc->transform_mem = transform_mem;
+    enc->transform_mem_size = transform_mem_size;
+  } else {
+    enc = (VP8LEncoder*)WebPSafeCalloc(1ULL, sizeof(*enc));
+    if (enc == NULL) {
+      WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+      return NULL;
+    }
   }
   enc->config = config;
   enc->pic = picture;
@@ -1469,10 +1565,37 @@ static void VP8LEncoderDelete(VP8LEncoder* enc) {
     VP8LHashChainClear(&enc->hash_chain);
     for (i = 0; i < 4; ++i) VP8LBackwardRefsClear(&enc->refs[i]);
     ClearTransformBuffer(enc);
+    WebPWorkerTeamEnd(&enc->team);
     WebPSafeFree(enc);
   }
 }
 
+// Keeps 'enc' as a spare encoder of 'context' if not NULL and if the memory
+// limit allows, deletes it otherwise.
+static void VP8LEncoderRelease(VP8LEncoder* enc,
+                               WebPEncoderContext* const context) {
+  if (enc != NULL && context != NULL) {
+    const size_t size = GetScratchSize(enc);
+    if (VP8EncContextCanRetain(context, size)) {
+      WebPWorkerTeamEnd(&enc->team);
+      enc->next = context->vp8l_encs;
+      context->vp8l_encs = enc;
+      context->retained_memory += size;
+      return;
+    }
+  }
+  VP8LEncoderDelete(enc);
+}
+
+void VP8LDeleteSpareEncoders(WebPEncoderContext* const context) {
+  while (context->vp8l_encs != NULL) {
+    VP8LEncoder* const enc = context->vp8l_encs;
+    context->vp8l_encs = enc->next;
+    context->retained_memory -= GetScratchSize(enc);
+    VP8LEncoderDelete(enc);
+  }
+}
+
 // -----------------------------------------------------------------------------
 // Main call
 
@@ -1481,10 +1604,13 @@ typedef struct {
   const WebPPicture* picture;
   VP8LBitWriter* bw;
   VP8LEncoder* enc;
-  CrunchConfig crunch_configs[CRUNCH_CONFIGS_MAX];
+  const CrunchConfig* crunch_configs;  // shared by all the workers
   int num_crunch_configs;
   int red_and_blue_always_zero;
   WebPAuxStats* stats;
+  // Hands the crunch configs out to the workers and tracks the best size.
+  WebPSyncCounters* counters;
+  int best_idx;  // index of the config kept in 'bw', -1 if none
 } StreamEncodeContext;
 
 static int EncodeStreamHook(void* input, void* data2) {
@@ -1496,6 +1622,7 @@ static int EncodeStreamHook(void* input, void* data2) {
   const CrunchConfig* const crunch_configs = params->crunch_configs;
   const int num_crunch_configs = params->num_crunch_configs;
   const int red_and_blue_always_zero = params->red_and_blue_always_zero;
+  WebPSyncCounters* const counters = params->counters;
 #if !defined(WEBP_DISABLE_STATS)
   WebPAuxStats* const stats = params->stats;
 #endif
@@ -1512,21 +1639,27 @@ static int EncodeStreamHook(void* input, void* data2) {
 #endif
   int hdr_size = 0;
   int data_size = 0;
-  int idx;
   size_t best_size = ~(size_t)0;
   VP8LBitWriter bw_init = *bw, bw_best;
   (void)data2;
 
+  params->best_idx = -1;
+
   if (!VP8LBitWriterInit(&bw_best, 0) ||
       (num_crunch_configs > 1 && !VP8LBitWriterClone(bw, &bw_best))) {
     WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
     goto Error;
   }
 
-  for (idx = 0; idx < num_crunch_configs; ++idx) {
-    const int entropy_idx = crunch_configs[idx].entropy_idx;
+  // Try the configs in order, as long as some are not taken by other workers.
+  while (1) {
+    const int idx = WebPSyncCountersIncrement(counters, kCrunchNextConfig);
+    int entropy_idx;
     int remaining_percent = 97 / num_crunch_configs, percent_range;
     int predictor_transform_bits = 0, cross_color_transform_bits = 0;
+    int abandoned;
+    if (idx >= num_crunch_configs) break;
+    entropy_idx = crunch_configs[idx].entropy_idx;
     enc->use_palette =
         (entropy_idx == kPalette) || (entropy_idx == kPaletteAndSpatial);
     enc->use_subtract_green =
@@ -1542,8 +1675,8 @@ static int EncodeStreamHook(void* input, void* data2) {
     }
     // Reset any parameter in the encoder that is set in the previous iteration.
     enc->cache_bits = 0;
-    VP8LBackwardRefsClear(&enc->refs[0]);
-    VP8LBackwardRefsClear(&enc->refs[1]);
+    VP8LBackwardRefsReset(&enc->refs[0], enc->refs[0].block_size);
+    VP8LBackwardRefsReset(&enc->refs[1], enc->refs[1].block_size);
 
 #if (WEBP_NEAR_LOSSLESS == 1)
     // Apply near-lossless preprocessing.
@@ -1620,18 +1753,26 @@ static int EncodeStreamHook(void* input, void* data2) {
     VP8LPutBits(bw, !TRANSFORM_PRESENT, 1);  // No more transforms.
 
     // -------------------------------------------------------------------------
-    // Encode and write the transformed image.
-    if (!EncodeImageInternal(
-            bw, enc->argb, &enc->hash_chain, enc->refs, enc->current_width,
-            height, quality, low_effort, &crunch_configs[idx], &enc->cache_bits,
-            enc->histo_bits, byte_position, &hdr_size, &data_size, picture,
-            remaining_percent, &percent)) {
+    // Encode and write the transformed image, if the transforms alone don't
+    // already make it bigger than the best one so far.
+    abandoned = CrunchIsAbandoned(counters, VP8LBitWriterNumBytes(bw));
+    if (!abandoned &&
+        !EncodeImageInternal(bw, enc->argb, &enc->hash_chain, enc->refs,
+                             enc->current_width, height, quality, low_effort,
+                             config->low_memory, &crunch_configs[idx],
+                             &enc->cache_bits, enc->histo_bits, byte_position,
+                             &hdr_size, &data_size, &enc->team, picture,
+                             counters, &abandoned, remaining_percent,
+                             &percent)) {
       goto Error;
     }
 
     // If we are better than what we already have.
-    if (VP8LBitWriterNumBytes(bw) < best_size) {
+    if (!abandoned && VP8LBitWriterNumBytes(bw) < best_size) {
       best_size = VP8LBitWriterNumBytes(bw);
+      params->best_idx = idx;
+      WebPSyncCountersMin(counters, kCrunchBestSize,
+                          (best_size > INT_MAX) ? INT_MAX : (int)best_size);
       // Store the BitWriter.
       VP8LBitWriterSwap(bw, &bw_best);
 #if !defined(WEBP_DISABLE_STATS)
@@ -1660,161 +1801,209 @@ static int EncodeStreamHook(void* input, void* data2) {
 
 Error:
   VP8LBitWriterWipeOut(&bw_best);
+  if (params->picture->error_code != VP8_ENC_OK) {
+    // Make the other workers give up as soon as possible.
+    WebPSyncCountersMin(counters, kCrunchBestSize, 0);
+  }
   // The hook should return false in case of error.
   return (params->picture->error_code == VP8_ENC_OK);
 }
 
+// Returns the number of threads the encoding may use, including the calling
+// one.
+static int GetMaxNumWorkers(const WebPConfig* const config,
+                            const WebPPicture* const picture) {
+  int num_workers;
+  if (config->thread_level <= 0) return 1;
+  if (picture->num_threads < 2) {
+    return (picture->thread_pool != NULL)
+               ? WebPThreadPoolGetNumThreads(picture->thread_pool) + 1
+               : 2;
+  }
+  num_workers = picture->num_threads;
+  if (picture->thread_pool != NULL &&
+      num_workers > WebPThreadPoolGetNumThreads(picture->thread_pool) + 1) {
+    num_workers = WebPThreadPoolGetNumThreads(picture->thread_pool) + 1;
+  }
+  return num_workers;
+}
+
 int VP8LEncodeStream(const WebPConfig* const config,
                      const WebPPicture* const picture,
-                     VP8LBitWriter* const bw_main) {
-  VP8LEncoder* const enc_main = VP8LEncoderNew(config, picture);
-  VP8LEncoder* enc_side = NULL;
+                     VP8LBitWriter* const bw_main,
+                     WebPEncoderContext* const context) {
+  VP8LEncoder* const enc_main = VP8LEncoderNew(config, picture, context);
   CrunchConfig crunch_configs[CRUNCH_CONFIGS_MAX];
-  int num_crunch_configs_main, num_crunch_configs_side = 0;
-  int idx;
+  int num_crunch_configs;
+  int num_workers, team_size;
+  int idx, best;
   int red_and_blue_always_zero = 0;
-  WebPWorker worker_main, worker_side;
-  StreamEncodeContext params_main, params_side;
-  // The main thread uses picture->stats, the side thread uses stats_side.
-  WebPAuxStats stats_side;
-  VP8LBitWriter bw_side;
-  WebPPicture picture_side;
+  WebPSyncCounters* counters = NULL;
+  WebPWorker workers[CRUNCH_CONFIGS_MAX];
+  StreamEncodeContext params[CRUNCH_CONFIGS_MAX];
+  // The main thread uses picture->stats, the side threads use stats_side[].
+  WebPAuxStats stats_side[CRUNCH_CONFIGS_MAX];
+  VP8LBitWriter bw_side[CRUNCH_CONFIGS_MAX];
+  WebPPicture picture_side[CRUNCH_CONFIGS_MAX];
   const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
-  int ok_main;
+  int ok = 1;
 
-  if (enc_main == NULL || !VP8LBitWriterInit(&bw_side, 0)) {
-    VP8LEncoderDelete(enc_main);
+  if (enc_main == NULL) {
     return WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
   }
-
-  // Avoid "garbage value" error from Clang's static analysis tool.
-  if (!WebPPictureInit(&picture_side)) {
-    goto Error;
-  }
+  // Make the side resources safe to release at any time.
+  memset(bw_side, 0, sizeof(bw_side));
+  for (idx = 0; idx < CRUNCH_CONFIGS_MAX; ++idx) params[idx].enc = NULL;
 
   // Analyze image (entropy, num_palettes etc)
-  if (!EncoderAnalyze(enc_main, crunch_configs, &num_crunch_configs_main,
+  if (!EncoderAnalyze(enc_main, crunch_configs, &num_crunch_configs,
                       &red_and_blue_always_zero) ||
       !EncoderInit(enc_main)) {
     WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
     goto Error;
   }
-
-  // Split the configs between the main and side threads (if any).
-  if (config->thread_level > 0) {
-    num_crunch_configs_side = num_crunch_configs_main / 2;
-    for (idx = 0; idx < num_crunch_configs_side; ++idx) {
-      params_side.crunch_configs[idx] =
-          crunch_configs[num_crunch_configs_main - num_crunch_configs_side +
-                         idx];
-    }
-    params_side.num_crunch_configs = num_crunch_configs_side;
-  }
-  num_crunch_configs_main -= num_crunch_configs_side;
-  for (idx = 0; idx < num_crunch_configs_main; ++idx) {
-    params_main.crunch_configs[idx] = crunch_configs[idx];
+  counters = WebPSyncCountersNew(kCrunchNumCounters);
+  if (counters == NULL) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    goto Error;
   }
-  params_main.num_crunch_configs = num_crunch_configs_main;
-
-  // Fill in the parameters for the thread workers.
-  {
-    const int params_size = (num_crunch_configs_side > 0) ? 2 : 1;
-    for (idx = 0; idx < params_size; ++idx) {
-      // Create the parameters for each worker.
-      WebPWorker* const worker = (idx == 0) ? &worker_main : &worker_side;
-      StreamEncodeContext* const param =
-          (idx == 0) ? &params_main : &params_side;
-      param->config = config;
-      param->red_and_blue_always_zero = red_and_blue_always_zero;
-      if (idx == 0) {
-        param->picture = picture;
-        param->stats = picture->stats;
-        param->bw = bw_main;
-        param->enc = enc_main;
-      } else {
-        // Create a side picture (error_code is not thread-safe).
-        if (!WebPPictureView(picture, /*left=*/0, /*top=*/0, picture->width,
-                             picture->height, &picture_side)) {
-          assert(0);
-        }
-        picture_side.progress_hook = NULL;  // Progress hook is not thread-safe.
-        param->picture = &picture_side;  // No need to free a view afterwards.
-        param->stats = (picture->stats == NULL) ? NULL : &stats_side;
-        // Create a side bit writer.
-        if (!VP8LBitWriterClone(bw_main, &bw_side)) {
-          WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
-          goto Error;
-        }
-        param->bw = &bw_side;
-        // Create a side encoder.
-        enc_side = VP8LEncoderNew(config, &picture_side);
-        if (enc_side == NULL || !EncoderInit(enc_side)) {
-          WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
-          goto Error;
-        }
-        // Copy the values that were computed for the main encoder.
-        enc_side->histo_bits = enc_main->histo_bits;
-        enc_side->predictor_transform_bits = enc_main->predictor_transform_bits;
-        enc_side->cross_color_transform_bits =
-            enc_main->cross_color_transform_bits;
-        enc_side->palette_size = enc_main->palette_size;
-        memcpy(enc_side->palette, enc_main->palette, sizeof(enc_main->palette));
-        memcpy(enc_side->palette_sorted, enc_main->palette_sorted,
-               sizeof(enc_main->palette_sorted));
-        param->enc = enc_side;
+  WebPSyncCountersSet(counters, kCrunchBestSize, INT_MAX);
+
+  // Fill in the parameters for the thread workers. They take the configs one
+  // after the other until there's none left.
+  // The threads left are shared by the teams of the encoders.
+  num_workers = GetMaxNumWorkers(config, picture);
+  if (num_workers > num_crunch_configs) num_workers = num_crunch_configs;
+  team_size = GetMaxNumWorkers(config, picture) / num_workers;
+  for (idx = 0; idx < num_workers; ++idx) {
+    // Create the parameters for each worker.
+    WebPWorker* const worker = &workers[idx];
+    StreamEncodeContext* const param = &params[idx];
+    param->config = config;
+    param->crunch_configs = crunch_configs;
+    param->num_crunch_configs = num_crunch_configs;
+    param->red_and_blue_always_zero = red_and_blue_always_zero;
+    param->counters = counters;
+    param->best_idx = -1;
+    if (idx == 0) {
+      param->picture = picture;
+      param->stats = picture->stats;
+      param->bw = bw_main;
+      param->enc = enc_main;
+    } else {
+      VP8LEncoder* enc_side;
+      // Create a side picture (error_code is not thread-safe).
+      if (!WebPPictureView(picture, /*left=*/0, /*top=*/0, picture->width,
+                           picture->height, &picture_side[idx])) {
+        assert(0);
       }
-      // Create the workers.
-      worker_interface->Init(worker);
-      worker->data1 = param;
-      worker->data2 = NULL;
-      worker->hook = EncodeStreamHook;
+      // Progress hook is not thread-safe.
+      picture_side[idx].progress_hook = NULL;
+      // No need to free a view afterwards.
+      param->picture = &picture_side[idx];
+      param->stats = (picture->stats == NULL) ? NULL : &stats_side[idx];
+#if !defined(WEBP_DISABLE_STATS)
+      if (picture->stats != NULL) {
+        memcpy(&stats_side[idx], picture->stats, sizeof(stats_side[idx]));
+      }
+#endif
+      // Create a side bit writer.
+      param->bw = &bw_side[idx];
+      if (!VP8LBitWriterInit(&bw_side[idx], 0) ||
+          !VP8LBitWriterClone(bw_main, &bw_side[idx])) {
+        WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+        goto Error;
+      }
+      // Create a side encoder.
+      enc_side = VP8LEncoderNew(config, &picture_side[idx], context);
+      param->enc = enc_side;
+      if (enc_side == NULL || !EncoderInit(enc_side)) {
+        WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+        goto Error;
+      }
+      // Copy the values that were computed for the main encoder.
+      enc_side->histo_bits = enc_main->histo_bits;
+      enc_side->predictor_transform_bits = enc_main->predictor_transform_bits;
+      enc_side->cross_color_transform_bits =
+          enc_main->cross_color_transform_bits;
+      enc_side->palette_size = enc_main->palette_size;
+      memcpy(enc_side->palette, enc_main->palette, sizeof(enc_main->palette));
+      memcpy(enc_side->palette_sorted, enc_main->palette_sorted,
+             sizeof(enc_main->palette_sorted));
     }
-  }
-
-  // Start the second thread if needed.
-  if (num_crunch_configs_side != 0) {
-    if (!worker_interface->Reset(&worker_side)) {
+    if (!WebPWorkerTeamInit(&param->enc->team, team_size,
+                            picture->thread_pool)) {
       WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
       goto Error;
     }
-#if !defined(WEBP_DISABLE_STATS)
-    // This line is here and not in the param initialization above to remove a
-    // Clang static analyzer warning.
-    if (picture->stats != NULL) {
-      memcpy(&stats_side, picture->stats, sizeof(stats_side));
+    // Create the workers.
+    worker_interface->Init(worker);
+    worker->pool = picture->thread_pool;
+    worker->data1 = param;
+    worker->data2 = NULL;
+    worker->hook = EncodeStreamHook;
+  }
+
+  // Start the side threads if needed.
+  for (idx = 1; idx < num_workers; ++idx) {
+    if (!worker_interface->Reset(&workers[idx])) {
+      WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+      // Stop the already launched workers right away.
+      WebPSyncCountersMin(counters, kCrunchBestSize, 0);
+      WebPSyncCountersSet(counters, kCrunchNextConfig, num_crunch_configs);
+      break;
     }
-#endif
-    worker_interface->Launch(&worker_side);
+    worker_interface->Launch(&workers[idx]);
   }
   // Execute the main thread.
-  worker_interface->Execute(&worker_main);
-  ok_main = worker_interface->Sync(&worker_main);
-  worker_interface->End(&worker_main);
-  if (num_crunch_configs_side != 0) {
-    // Wait for the second thread.
-    const int ok_side = worker_interface->Sync(&worker_side);
-    worker_interface->End(&worker_side);
-    if (!ok_main || !ok_side) {
-      if (picture->error_code == VP8_ENC_OK) {
-        assert(picture_side.error_code != VP8_ENC_OK);
-        WebPEncodingSetError(picture, picture_side.error_code);
+  if (picture->error_code == VP8_ENC_OK) {
+    worker_interface->Execute(&workers[0]);
+  }
+  // Wait for all the threads.
+  best = 0;
+  for (idx = 0; idx < num_workers; ++idx) {
+    ok &= worker_interface->Sync(&workers[idx]);
+    worker_interface->End(&workers[idx]);
+    if (!ok || params[idx].best_idx < 0) continue;
+    // Keep the smallest stream, or the one of the first config if equal.
+    if (params[best].best_idx < 0 ||
+        VP8LBitWriterNumBytes(params[idx].bw) <
+            VP8LBitWriterNumBytes(params[best].bw) ||
+        (VP8LBitWriterNumBytes(params[idx].bw) ==
+             VP8LBitWriterNumBytes(params[best].bw) &&
+         params[idx].best_idx < params[best].best_idx)) {
+      best = idx;
+    }
+  }
+  if (!ok || picture->error_code != VP8_ENC_OK) {
+    if (picture->error_code == VP8_ENC_OK) {
+      for (idx = 1; idx < num_workers; ++idx) {
+        if (picture_side[idx].error_code != VP8_ENC_OK) {
+          WebPEncodingSetError(picture, picture_side[idx].error_code);
+          break;
+        }
       }
-      goto Error;
     }
-    if (VP8LBitWriterNumBytes(&bw_side) < VP8LBitWriterNumBytes(bw_main)) {
-      VP8LBitWriterSwap(bw_main, &bw_side);
+    assert(picture->error_code != VP8_ENC_OK);
+    goto Error;
+  }
+  assert(params[best].best_idx >= 0);
+  if (best != 0) {
+    VP8LBitWriterSwap(bw_main, params[best].bw);
 #if !defined(WEBP_DISABLE_STATS)
-      if (picture->stats != NULL) {
-        memcpy(picture->stats, &stats_side, sizeof(*picture->stats));
-      }
-#endif
+    if (picture->stats != NULL) {
+      memcpy(picture->stats, &stats_side[best], sizeof(*picture->stats));
     }
+#endif
   }
 
 Error:
-  VP8LBitWriterWipeOut(&bw_side);
-  VP8LEncoderDelete(enc_main);
-  VP8LEncoderDelete(enc_side);
+  for (idx = 1; idx < CRUNCH_CONFIGS_MAX; ++idx) {
+    VP8LBitWriterWipeOut(&bw_side[idx]);
+    VP8LEncoderRelease(params[idx].enc, context);
+  }
+  WebPSyncCountersDelete(counters);
+  VP8LEncoderRelease(enc_main, context);
   return (picture->error_code == VP8_ENC_OK);
 }
 
@@ -1822,7 +2011,8 @@ Error:
 #undef CRUNCH_SUBCONFIGS_MAX
 
 int VP8LEncodeImage(const WebPConfig* const config,
-                    const WebPPicture* const picture) {
+                    const WebPPicture* const picture,
+                    WebPEncoderContext* const context) {
   int width, height;
   int has_alpha;
   size_t coded_size;
@@ -1879,7 +2069,7 @@ int VP8LEncodeImage(const WebPConfig* const config,
   if (!WebPReportProgress(picture, 2, &percent)) goto UserAbort;
 
   // Encode main image stream.
-  if (!VP8LEncodeStream(config, picture, &bw)) goto Error;
+  if (!VP8LEncodeStream(config, picture, &bw, context)) goto Error;
 
   if (!WebPReportProgress(picture, 99, &percent)) goto UserAbort;
 
@@ -29,6 +29,7 @@
 #include "src/enc/backward_references_enc.h"
 #include "src/enc/histogram_enc.h"
 #include "src/utils/bit_writer_utils.h"
+#include "src/utils/thread_utils.h"
 #include "src/webp/encode.h"
 #include "src/webp/format_constants.h"
 #include "src/webp/types.h"
@@ -47,7 +48,8 @@ typedef enum {
   kEncoderPalette
 } VP8LEncoderARGBContent;
 
-typedef struct {
+typedef struct VP8LEncoder VP8LEncoder;
+struct VP8LEncoder {
   const WebPConfig* config;  // user configuration and parameters
   const WebPPicture* pic;    // input picture.
 
@@ -81,7 +83,11 @@ typedef struct {
   struct VP8LBackwardRefs refs[4];  // Backward Refs array for temporaries.
   VP8LHashChain hash_chain;         // HashChain data for constructing
                                     // backward references.
-} VP8LEncoder;
+
+  WebPWorkerTeam team;  // Workers sharing the heavy loops of the encoding.
+
+  VP8LEncoder* next;  // Next spare encoder of a WebPEncoderContext.
+};
 
 //------------------------------------------------------------------------------
 // internal functions. Not public.
@@ -89,13 +95,20 @@ typedef struct {
 // Encodes the picture.
 // Returns 0 if config or picture is NULL or picture doesn't have valid argb
 // input.
+// If 'context' is not NULL, the scratch buffers of its spare encoders are
+// reused, and the ones of the encoders used are kept in it afterwards.
 int VP8LEncodeImage(const WebPConfig* const config,
-                    const WebPPicture* const picture);
+                    const WebPPicture* const picture,
+                    WebPEncoderContext* const context);
 
 // Encodes the main image stream using the supplied bit writer.
 // Returns false in case of error (stored in picture->error_code).
 int VP8LEncodeStream(const WebPConfig* const config,
-                     const WebPPicture* const picture, VP8LBitWriter* const bw);
+                     const WebPPicture* const picture, VP8LBitWriter* const bw,
+                     WebPEncoderContext* const context);
+
+// Releases the spare encoders of 'context'.
+void VP8LDeleteSpareEncoders(WebPEncoderContext* const context);
 
 #if (WEBP_NEAR_LOSSLESS == 1)
 // in near_lossless.c
@@ -107,17 +120,22 @@ int VP8ApplyNearLossless(const WebPPicture* const picture, int quality,
 //------------------------------------------------------------------------------
 // Image transforms in predictor.c.
 
+// If 'team' is not NULL, the tiles are searched by bands of rows on its
+// workers. The result then differs slightly, but not with the number of
+// workers.
 // pic and percent are for progress.
 // Returns false in case of error (stored in pic->error_code).
 int VP8LResidualImage(int width, int height, int min_bits, int max_bits,
                       int low_effort, uint32_t* const argb,
                       uint32_t* const argb_scratch, uint32_t* const image,
                       int near_lossless, int exact, int used_subtract_green,
-                      const WebPPicture* const pic, int percent_range,
-                      int* const percent, int* const best_bits);
+                      WebPWorkerTeam* const team, const WebPPicture* const pic,
+                      int percent_range, int* const percent,
+                      int* const best_bits);
 
 int VP8LColorSpaceTransform(int width, int height, int bits, int quality,
                             uint32_t* const argb, uint32_t* image,
+                            WebPWorkerTeam* const team,
                             const WebPPicture* const pic, int percent_range,
                             int* const percent, int* const best_bits);
 
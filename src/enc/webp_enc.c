@@ -18,6 +18,7 @@
 
 #include "src/dec/common_dec.h"
 #include "src/dsp/dsp.h"
+#include "src/dsp/yuv.h"
 #include "src/enc/cost_enc.h"
 #include "src/enc/vp8i_enc.h"
 #include "src/enc/vp8li_enc.h"
@@ -124,6 +125,9 @@ static void MapConfigToTools(VP8Encoder* const enc) {
       enc->num_parts = 1;  // doesn't work with multi-partition
     }
   }
+  // The token buffer codes the partitions once the probabilities are final,
+  // from all the tokens, so there's nothing to stream.
+  enc->stream_output = enc->pic->stream_output && !enc->use_tokens;
 }
 
 // Memory scaling with dimensions:
@@ -145,8 +149,10 @@ static void MapConfigToTools(VP8Encoder* const enc) {
 //              LFStats: 2048
 // Picture size (yuv): 419328
 
+// If 'context' is not NULL, its memory is reused when large enough.
 static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
-                                  WebPPicture* const picture) {
+                                  WebPPicture* const picture,
+                                  WebPEncoderContext* const context) {
   VP8Encoder* enc;
   const int use_filter =
       (config->filter_strength > 0) || (config->autofilter > 0);
@@ -168,14 +174,14 @@ static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
           ? mb_w * sizeof(*enc->top_derr)
           : 0;
   uint8_t* mem;
-  const uint64_t size = (uint64_t)sizeof(*enc)  // main struct
-                        + WEBP_ALIGN_CST        // cache alignment
-                        + info_size             // modes info
-                        + preds_size            // prediction modes
-                        + samples_size          // top/left samples
-                        + top_derr_size         // top diffusion error
-                        + nz_size               // coeff context bits
-                        + lf_stats_size;        // autofilter stats
+  uint64_t size = (uint64_t)sizeof(*enc)  // main struct
+                  + WEBP_ALIGN_CST        // cache alignment
+                  + info_size             // modes info
+                  + preds_size            // prediction modes
+                  + samples_size          // top/left samples
+                  + top_derr_size         // top diffusion error
+                  + nz_size               // coeff context bits
+                  + lf_stats_size;        // autofilter stats
 
 #ifdef PRINT_MEMORY_INFO
   printf("===================================\n");
@@ -203,14 +209,29 @@ static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
   printf("Picture size (yuv): %ld\n", mb_w * mb_h * 384 * sizeof(uint8_t));
   printf("===================================\n");
 #endif
-  mem = (uint8_t*)WebPSafeMalloc(size, sizeof(*mem));
+  mem = NULL;
+  if (context != NULL && context->vp8_mem != NULL) {
+    if (size <= context->vp8_mem_size) {
+      mem = (uint8_t*)context->vp8_mem;
+      size = context->vp8_mem_size;
+    } else {
+      WebPSafeFree(context->vp8_mem);
+    }
+    context->retained_memory -= context->vp8_mem_size;
+    context->vp8_mem = NULL;
+    context->vp8_mem_size = 0;
+  }
   if (mem == NULL) {
-    WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
-    return NULL;
+    mem = (uint8_t*)WebPSafeMalloc(size, sizeof(*mem));
+    if (mem == NULL) {
+      WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+      return NULL;
+    }
   }
   enc = (VP8Encoder*)mem;
   mem = (uint8_t*)WEBP_ALIGN(mem + sizeof(*enc));
   memset(enc, 0, sizeof(*enc));
+  enc->mem_size = (size_t)size;
   enc->num_parts = 1 << config->partitions;
   enc->mb_w = mb_w;
   enc->mb_h = mb_h;
@@ -256,12 +277,21 @@ static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
   return enc;
 }
 
-static int DeleteVP8Encoder(VP8Encoder* enc) {
+// The memory of 'enc' is kept in 'context' if not NULL and if the limit allows.
+static int DeleteVP8Encoder(VP8Encoder* enc,
+                            WebPEncoderContext* const context) {
   int ok = 1;
   if (enc != NULL) {
     ok = VP8EncDeleteAlpha(enc);
     VP8TBufferClear(&enc->tokens);
-    WebPSafeFree(enc);
+    if (VP8EncContextCanRetain(context, enc->mem_size)) {
+      assert(context->vp8_mem == NULL);
+      context->vp8_mem = enc;
+      context->vp8_mem_size = enc->mem_size;
+      context->retained_memory += enc->mem_size;
+    } else {
+      WebPSafeFree(enc);
+    }
   }
   return ok;
 }
@@ -331,7 +361,9 @@ int WebPReportProgress(const WebPPicture* const pic, int percent,
 }
 //------------------------------------------------------------------------------
 
-int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
+static int EncodeWithContext(const WebPConfig* const config,
+                             WebPPicture* const pic,
+                             WebPEncoderContext* const context) {
   int ok = 0;
   if (pic == NULL) return 0;
 
@@ -343,6 +375,9 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
     return WebPEncodingSetError(pic, VP8_ENC_ERROR_INVALID_CONFIGURATION);
   }
   if (!WebPValidatePicture(pic)) return 0;
+  if (pic->num_threads < 0 || pic->num_threads > 64) {
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_INVALID_CONFIGURATION);
+  }
   if (pic->width > WEBP_MAX_DIMENSION || pic->height > WEBP_MAX_DIMENSION) {
     return WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_DIMENSION);
   }
@@ -377,7 +412,7 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
       WebPCleanupTransparentArea(pic);
     }
 
-    enc = InitVP8Encoder(config, pic);
+    enc = InitVP8Encoder(config, pic, context);
     if (enc == NULL) return 0;  // pic->error is already set.
     // Note: each of the tasks below account for 20% in the progress report.
     ok = VP8EncAnalyze(enc);
@@ -396,7 +431,8 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
     if (!ok) {
       VP8EncFreeBitWriters(enc);
     }
-    ok &= DeleteVP8Encoder(enc);  // must always be called, even if !ok
+    // must always be called, even if !ok
+    ok &= DeleteVP8Encoder(enc, context);
   } else {
     // Make sure we have ARGB samples.
     if (pic->argb == NULL && !WebPPictureYUVAToARGB(pic)) {
@@ -407,8 +443,337 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
       WebPReplaceTransparentPixels(pic, 0x000000);
     }
 
-    ok = VP8LEncodeImage(config, pic);  // Sets pic->error in case of problem.
+    // Sets pic->error in case of problem.
+    ok = VP8LEncodeImage(config, pic, context);
   }
 
   return ok;
 }
+
+int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
+  return EncodeWithContext(config, pic, NULL);
+}
+
+//------------------------------------------------------------------------------
+// WebPEncoderContext
+
+WebPEncoderContext* WebPEncoderContextNewInternal(size_t max_retained_memory,
+                                                  int version) {
+  WebPEncoderContext* context;
+  if (WEBP_ABI_IS_INCOMPATIBLE(version, WEBP_ENCODER_ABI_VERSION)) {
+    return NULL;  // version mismatch
+  }
+  context = (WebPEncoderContext*)WebPSafeCalloc(1ULL, sizeof(*context));
+  if (context != NULL) context->max_retained_memory = max_retained_memory;
+  return context;
+}
+
+int WebPEncodeWithContext(WebPEncoderContext* context, const WebPConfig* config,
+                          WebPPicture* picture) {
+  if (picture == NULL) return 0;
+  if (context == NULL) {
+    return WebPEncodingSetError(picture, VP8_ENC_ERROR_NULL_PARAMETER);
+  }
+  return EncodeWithContext(config, picture, context);
+}
+
+void WebPEncoderContextDelete(WebPEncoderContext* context) {
+  if (context != NULL) {
+    VP8LDeleteSpareEncoders(context);
+    WebPSafeFree(context->vp8_mem);
+    WebPSafeFree(context);
+  }
+}
+
+//------------------------------------------------------------------------------
+// WebPRowEncoder
+
+// Number of macroblocks in a band of rows. The first band also provides the
+// statistics used for coding the whole picture.
+#define ROW_ENCODER_BAND_MBS 4096
+
+struct WebPRowEncoder {
+  WebPConfig config;      // user's configuration, adjusted for streaming
+  WebPPicture* picture;   // user's picture, receiving the error code
+  WebPPicture pic;        // band of samples, from macroblock row enc->pic_mb_y
+  VP8Encoder* enc;
+  VP8EncRowLoop* loop;    // coding loop, NULL until the first band is coded
+  uint8_t* mem;           // planes of 'pic', with one more row above each
+  uint16_t* tmp_rgb;      // accumulated R/G/B values for U/V conversion
+  uint8_t* pending_rgb;   // two rows of packed RGB, to pair an odd row
+  int has_pending;        // true if the first row of pending_rgb[] is set
+  int band_rows;          // band height, in macroblock rows
+  int num_rows;           // number of rows appended so far
+};
+
+// Returns the number of rows of samples converted into the current band.
+static int GetNumBandRows(const WebPRowEncoder* const re) {
+  return re->num_rows - re->has_pending - 16 * re->enc->pic_mb_y;
+}
+
+// Returns 'ok', after reporting the error of the internal picture if any.
+static int RowEncoderStatus(const WebPRowEncoder* const re, int ok) {
+  if (!ok && re->pic.error_code != VP8_ENC_OK) {
+    WebPEncodingSetError(re->picture, re->pic.error_code);
+  }
+  return ok;
+}
+
+// Converts 'num_rows' (even) rows to YUV at the end of the band.
+static void ConvertRows(WebPRowEncoder* const re, const uint8_t* const r_ptr,
+                        const uint8_t* const g_ptr, const uint8_t* const b_ptr,
+                        int step, int stride, int num_rows) {
+  WebPPicture* const pic = &re->pic;
+  const int y = GetNumBandRows(re);
+  assert(!(y & 1) && !(num_rows & 1));
+  WebPImportYUVAFromRGBA(r_ptr, g_ptr, b_ptr, /*a_ptr=*/NULL, step, stride,
+                         /*has_alpha=*/0, pic->width, num_rows, re->tmp_rgb,
+                         pic->y_stride, pic->uv_stride, /*a_stride=*/0,
+                         pic->y + y * pic->y_stride,
+                         pic->u + (y >> 1) * pic->uv_stride,
+                         pic->v + (y >> 1) * pic->uv_stride, /*dst_a=*/NULL);
+}
+
+static void PackRGBRow(const uint8_t* r_ptr, const uint8_t* g_ptr,
+                       const uint8_t* b_ptr, int step, int width,
+                       uint8_t* dst) {
+  int x;
+  for (x = 0; x < width; ++x, dst += 3) {
+    dst[0] = r_ptr[x * step];
+    dst[1] = g_ptr[x * step];
+    dst[2] = b_ptr[x * step];
+  }
+}
+
+// Analyzes and codes the macroblock rows of the band, up to 'last_row'.
+static int CodeBand(WebPRowEncoder* const re, int last_row) {
+  VP8Encoder* const enc = re->enc;
+  WebPPicture* const pic = &re->pic;
+  const int num_rows = last_row - enc->pic_mb_y;
+
+  if (!VP8EncAnalyzeRows(enc, enc->pic_mb_y, last_row)) return 0;
+  if (re->loop == NULL) {  // first band
+    re->loop = VP8EncRowLoopNew(enc, last_row);
+    if (re->loop == NULL) return 0;
+  }
+  if (!VP8EncRowLoopCode(re->loop, last_row)) return 0;
+  if (last_row < enc->mb_h) {
+    // The analysis of the next band needs the last samples above it.
+    const int uv_width = (pic->width + 1) >> 1;
+    memcpy(pic->y - pic->y_stride, pic->y + (16 * num_rows - 1) * pic->y_stride,
+           pic->width);
+    memcpy(pic->u - pic->uv_stride,
+           pic->u + (8 * num_rows - 1) * pic->uv_stride, uv_width);
+    memcpy(pic->v - pic->uv_stride,
+           pic->v + (8 * num_rows - 1) * pic->uv_stride, uv_width);
+  }
+  enc->pic_mb_y = last_row;
+  return 1;
+}
+
+WebPRowEncoder* WebPRowEncoderNew(const WebPConfig* config,
+                                  WebPPicture* picture) {
+  WebPRowEncoder* re;
+  WebPPicture* pic;
+  int width, mb_w, mb_h, uv_width, y_size, uv_size;
+
+  if (picture == NULL) return NULL;
+  picture->error_code = VP8_ENC_OK;
+  if (config == NULL) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_NULL_PARAMETER);
+    return NULL;
+  }
+  if (!WebPValidateConfig(config) || config->lossless ||
+      picture->num_threads < 0 || picture->num_threads > 64) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_INVALID_CONFIGURATION);
+    return NULL;
+  }
+  if (picture->width <= 0 || picture->width > WEBP_MAX_DIMENSION ||
+      picture->height <= 0 || picture->height > WEBP_MAX_DIMENSION) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_BAD_DIMENSION);
+    return NULL;
+  }
+  re = (WebPRowEncoder*)WebPSafeCalloc(1ULL, sizeof(*re));
+  if (re == NULL) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    return NULL;
+  }
+  if (picture->stats != NULL) {
+    memset(picture->stats, 0, sizeof(*picture->stats));
+  }
+
+  // A single coding pass is possible, with the statistics of the first band.
+  re->config = *config;
+  re->config.low_memory = 1;
+  re->config.target_size = 0;
+  re->config.target_PSNR = 0.f;
+  re->config.show_compressed = 0;
+  re->picture = picture;
+
+  width = picture->width;
+  mb_w = (width + 15) >> 4;
+  mb_h = (picture->height + 15) >> 4;
+  uv_width = (width + 1) >> 1;
+  re->band_rows = (ROW_ENCODER_BAND_MBS + mb_w - 1) / mb_w;
+  if (re->band_rows > mb_h) re->band_rows = mb_h;
+  y_size = (16 * re->band_rows + 1) * width;
+  uv_size = (8 * re->band_rows + 1) * uv_width;
+
+  pic = &re->pic;
+  *pic = *picture;
+  pic->use_argb = 0;
+  pic->colorspace = WEBP_YUV420;
+  pic->argb = NULL;
+  pic->argb_stride = 0;
+  pic->memory_argb_ = NULL;
+  pic->a = NULL;
+  pic->a_stride = 0;
+  pic->stream_output = 0;  // a single coding pass is possible
+  re->mem = (uint8_t*)WebPSafeMalloc((uint64_t)y_size + 2 * uv_size,
+                                     sizeof(*re->mem));
+  re->tmp_rgb =
+      (uint16_t*)WebPSafeMalloc(4ULL * uv_width, sizeof(*re->tmp_rgb));
+  re->pending_rgb = (uint8_t*)WebPSafeMalloc(2ULL * 3 * width,
+                                             sizeof(*re->pending_rgb));
+  if (re->mem == NULL || re->tmp_rgb == NULL || re->pending_rgb == NULL) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    goto Error;
+  }
+  pic->y_stride = width;
+  pic->uv_stride = uv_width;
+  pic->y = re->mem + width;  // leave one row above
+  pic->u = re->mem + y_size + uv_width;
+  pic->v = re->mem + y_size + uv_size + uv_width;
+  pic->memory_ = NULL;  // 'mem' is released by WebPRowEncoderDelete()
+
+  re->enc = InitVP8Encoder(&re->config, pic, /*context=*/NULL);
+  if (re->enc == NULL) {
+    RowEncoderStatus(re, 0);
+    goto Error;
+  }
+  WebPInitConvertARGBToYUV();
+  return re;
+
+Error:
+  WebPRowEncoderDelete(re);
+  return NULL;
+}
+
+static int AppendRows(WebPRowEncoder* const re, const uint8_t* rgb, int stride,
+                      int step, int swap_rb, int num_rows) {
+  WebPPicture* const pic = &re->pic;
+  const int width = pic->width;
+
+  if (pic->error_code != VP8_ENC_OK) return RowEncoderStatus(re, 0);
+  if (rgb == NULL) {
+    WebPEncodingSetError(pic, VP8_ENC_ERROR_NULL_PARAMETER);
+    return RowEncoderStatus(re, 0);
+  }
+  if (num_rows < 0 || num_rows > pic->height - re->num_rows ||
+      abs(stride) < step * width) {
+    WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_DIMENSION);
+    return RowEncoderStatus(re, 0);
+  }
+  while (num_rows > 0) {
+    // swap_rb -> b,g,r , !swap_rb -> r,g,b
+    const uint8_t* const r_ptr = rgb + (swap_rb ? 2 : 0);
+    const uint8_t* const g_ptr = rgb + 1;
+    const uint8_t* const b_ptr = rgb + (swap_rb ? 0 : 2);
+    int n;
+    if (re->has_pending) {  // pair the pending row with the first new one
+      uint8_t* const pending = re->pending_rgb;
+      PackRGBRow(r_ptr, g_ptr, b_ptr, step, width, pending + 3 * width);
+      ConvertRows(re, pending + 0, pending + 1, pending + 2, 3, 3 * width, 2);
+      re->has_pending = 0;
+      n = 1;
+    } else if (num_rows == 1) {  // wait for the next row
+      PackRGBRow(r_ptr, g_ptr, b_ptr, step, width, re->pending_rgb);
+      re->has_pending = 1;
+      n = 1;
+    } else {
+      const int band_left = 16 * re->band_rows - GetNumBandRows(re);
+      n = (num_rows < band_left) ? (num_rows & ~1) : band_left;
+      ConvertRows(re, r_ptr, g_ptr, b_ptr, step, stride, n);
+    }
+    rgb += (ptrdiff_t)n * stride;
+    num_rows -= n;
+    re->num_rows += n;
+    if (GetNumBandRows(re) == 16 * re->band_rows &&
+        !CodeBand(re, re->enc->pic_mb_y + re->band_rows)) {
+      return RowEncoderStatus(re, 0);
+    }
+  }
+  return 1;
+}
+
+#if !defined(WEBP_REDUCE_CSP)
+
+int WebPRowEncoderAppendBGR(WebPRowEncoder* enc, const uint8_t* bgr,
+                            int stride, int num_rows) {
+  return (enc != NULL) ? AppendRows(enc, bgr, stride, 3, 1, num_rows) : 0;
+}
+
+int WebPRowEncoderAppendBGRX(WebPRowEncoder* enc, const uint8_t* bgrx,
+                             int stride, int num_rows) {
+  return (enc != NULL) ? AppendRows(enc, bgrx, stride, 4, 1, num_rows) : 0;
+}
+
+#endif  // WEBP_REDUCE_CSP
+
+int WebPRowEncoderAppendRGB(WebPRowEncoder* enc, const uint8_t* rgb,
+                            int stride, int num_rows) {
+  return (enc != NULL) ? AppendRows(enc, rgb, stride, 3, 0, num_rows) : 0;
+}
+
+int WebPRowEncoderAppendRGBX(WebPRowEncoder* enc, const uint8_t* rgbx,
+                             int stride, int num_rows) {
+  return (enc != NULL) ? AppendRows(enc, rgbx, stride, 4, 0, num_rows) : 0;
+}
+
+int WebPRowEncoderFinish(WebPRowEncoder* enc) {
+  WebPRowEncoder* const re = enc;
+  VP8Encoder* vp8_enc;
+  WebPPicture* pic;
+  int ok;
+
+  if (re == NULL) return 0;
+  vp8_enc = re->enc;
+  pic = &re->pic;
+  if (pic->error_code != VP8_ENC_OK) return RowEncoderStatus(re, 0);
+  if (re->num_rows != pic->height || vp8_enc == NULL) {
+    WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_DIMENSION);
+    return RowEncoderStatus(re, 0);
+  }
+  if (re->has_pending) {  // last row of an odd height
+    const uint8_t* const pending = re->pending_rgb;
+    const int y = GetNumBandRows(re);
+    WebPImportYUVAFromRGBALastLine(
+        pending + 0, pending + 1, pending + 2, /*a_ptr=*/NULL, 3,
+        /*has_alpha=*/0, pic->width, re->tmp_rgb, pic->y + y * pic->y_stride,
+        pic->u + (y >> 1) * pic->uv_stride, pic->v + (y >> 1) * pic->uv_stride,
+        /*dst_a=*/NULL);
+    re->has_pending = 0;
+  }
+  ok = (vp8_enc->pic_mb_y == vp8_enc->mb_h) || CodeBand(re, vp8_enc->mb_h);
+  ok = (re->loop != NULL) && VP8EncRowLoopDelete(re->loop, ok);
+  re->loop = NULL;
+  ok = ok && VP8EncWrite(vp8_enc);
+  StoreStats(vp8_enc);
+  if (!ok) VP8EncFreeBitWriters(vp8_enc);
+  ok &= DeleteVP8Encoder(vp8_enc, /*context=*/NULL);
+  re->enc = NULL;
+  return RowEncoderStatus(re, ok);
+}
+
+void WebPRowEncoderDelete(WebPRowEncoder* enc) {
+  if (enc == NULL) return;
+  if (enc->loop != NULL) (void)VP8EncRowLoopDelete(enc->loop, 0);
+  if (enc->enc != NULL) {
+    VP8EncFreeBitWriters(enc->enc);
+    (void)DeleteVP8Encoder(enc->enc, /*context=*/NULL);
+  }
+  WebPSafeFree(enc->mem);
+  WebPSafeFree(enc->tmp_rgb);
+  WebPSafeFree(enc->pending_rgb);
+  WebPSafeFree(enc);
+}
@@ -18,6 +18,7 @@
 #include <string.h>
 
 #include "src/mux/animi.h"
+#include "src/utils/thread_utils.h"
 #include "src/utils/utils.h"
 #include "src/webp/decode.h"
 #include "src/webp/encode.h"
@@ -46,8 +47,12 @@ typedef struct {
   WebPMuxFrameInfo sub_frame;  // Encoded frame rectangle.
   WebPMuxFrameInfo key_frame;  // Encoded frame if it is a keyframe.
   int is_key_frame;            // True if 'key_frame' has been chosen.
+  int is_pending;              // True while its bitstream is not encoded yet
+                               // (see EncodeOrDeferCandidateJobs()).
 } EncodedFrame;
 
+typedef struct CandidateJob CandidateJob;  // Defined below.
+
 struct WebPAnimEncoder {
   const int canvas_width;                // Canvas width.
   const int canvas_height;               // Canvas height.
@@ -86,6 +91,12 @@ struct WebPAnimEncoder {
   // Same as candidate_carryover_mask but for the best candidate subframe.
   uint8_t* best_candidate_carryover_mask;
 
+  // Concurrent encoding of the candidates of a frame (see CacheFrame()).
+  int use_candidate_jobs;  // True if the candidates are queued as jobs.
+  CandidateJob* jobs;      // Allocated on first use.
+  int num_jobs;            // Number of queued jobs.
+  int num_deferred;        // Number of leading jobs of previous frames.
+
   // Encoded data.
   EncodedFrame* encoded_frames;  // Array of encoded frames.
   size_t size;                   // Number of allocated frames.
@@ -128,6 +139,10 @@ struct WebPAnimEncoder {
 #define DELTA_INFINITY (1ULL << 32)
 #define KEYFRAME_NONE (-1)
 
+// Maximum number of frames whose encoding is deferred to be run concurrently
+// with the one of the next frames (see EncodeOrDeferCandidateJobs()).
+#define MAX_DEFERRED_FRAMES 8
+
 // Reset the counters in the WebPAnimEncoder.
 static void ResetCounters(WebPAnimEncoder* const enc) {
   enc->start = 0;
@@ -315,6 +330,8 @@ WebPAnimEncoder* WebPAnimEncoderNewInternal(
   // We need space for at least 2 frames. But when kmin, kmax are both zero,
   // enc->size will be 1. So we handle that special case below.
   if (enc->size < 2) enc->size = 2;
+  // Deferred frames are kept until they are encoded.
+  enc->size += MAX_DEFERRED_FRAMES;
   enc->encoded_frames =
       (EncodedFrame*)WebPSafeCalloc(enc->size, sizeof(*enc->encoded_frames));
   if (enc->encoded_frames == NULL) goto Err;
@@ -336,6 +353,8 @@ Err:
   return NULL;
 }
 
+static void DeleteCandidateJobs(WebPAnimEncoder* const enc);
+
 // Release the data contained by 'encoded_frame'.
 static void FrameRelease(EncodedFrame* const encoded_frame) {
   if (encoded_frame != NULL) {
@@ -352,6 +371,7 @@ void WebPAnimEncoderDelete(WebPAnimEncoder* enc) {
     WebPPictureFree(&enc->canvas_carryover);
     WebPSafeFree(enc->candidate_carryover_mask);
     WebPSafeFree(enc->best_candidate_carryover_mask);
+    DeleteCandidateJobs(enc);
     if (enc->encoded_frames != NULL) {
       size_t i;
       for (i = 0; i < enc->size; ++i) {
@@ -741,6 +761,20 @@ static int IncreaseTransparency(const WebPPicture* const src,
   return modified;
 }
 
+// Replaces the fully transparent pixels of 'pic' in 'rect' by
+// TRANSPARENT_COLOR, like the lossless encoder does in place unless
+// WebPConfig::exact is set.
+static void ReplaceTransparentPixels(WebPPicture* const pic,
+                                     const FrameRectangle* const rect) {
+  int i, j;
+  for (j = rect->y_offset; j < rect->y_offset + rect->height; ++j) {
+    uint32_t* const row = pic->argb + j * pic->argb_stride;
+    for (i = rect->x_offset; i < rect->x_offset + rect->width; ++i) {
+      if ((row[i] >> 24) == 0) row[i] = TRANSPARENT_COLOR;
+    }
+  }
+}
+
 #undef TRANSPARENT_COLOR
 
 // Replace similar blocks of pixels by a 'see-through' transparent block
@@ -834,14 +868,9 @@ typedef struct {
   int evaluate;      // True if this candidate should be evaluated.
 } Candidate;
 
-// Generates a candidate encoded frame given a picture and metadata.
-static WebPEncodingError EncodeCandidate(WebPPicture* const sub_frame,
-                                         const FrameRectangle* const rect,
-                                         const WebPConfig* const encoder_config,
-                                         int use_blending,
-                                         Candidate* const candidate) {
-  WebPConfig config = *encoder_config;
-  WebPEncodingError error_code = VP8_ENC_OK;
+// Sets the metadata of a candidate encoded frame, not encoded yet.
+static void InitCandidate(const FrameRectangle* const rect, int use_blending,
+                          Candidate* const candidate) {
   assert(candidate != NULL);
   memset(candidate, 0, sizeof(*candidate));
 
@@ -854,10 +883,19 @@ static WebPEncodingError EncodeCandidate(WebPPicture* const sub_frame,
   candidate->info.blend_method =
       use_blending ? WEBP_MUX_BLEND : WEBP_MUX_NO_BLEND;
   candidate->info.duration = 0;  // Set in next call to WebPAnimEncoderAdd().
-
-  // Encode picture.
   WebPMemoryWriterInit(&candidate->mem);
+}
+
+// Generates a candidate encoded frame given a picture and the candidate
+// initialized by InitCandidate().
+static WebPEncodingError EncodeCandidate(WebPPicture* const sub_frame,
+                                         const WebPConfig* const encoder_config,
+                                         Candidate* const candidate) {
+  WebPConfig config = *encoder_config;
+  const int use_blending = (candidate->info.blend_method == WEBP_MUX_BLEND);
+  WebPEncodingError error_code = VP8_ENC_OK;
 
+  // Encode picture.
   if (!config.lossless && use_blending) {
     // Disable filtering to avoid blockiness in reconstructed frames at the
     // time of decoding.
@@ -882,6 +920,8 @@ static void CopyCurrentCanvas(WebPAnimEncoder* const enc) {
     WebPCopyPixels(enc->curr_canvas, &enc->curr_canvas_copy);
     enc->curr_canvas_copy.progress_hook = enc->curr_canvas->progress_hook;
     enc->curr_canvas_copy.user_data = enc->curr_canvas->user_data;
+    enc->curr_canvas_copy.thread_pool = enc->curr_canvas->thread_pool;
+    enc->curr_canvas_copy.num_threads = enc->curr_canvas->num_threads;
     enc->curr_canvas_copy_modified = 0;
   }
 }
@@ -894,6 +934,97 @@ enum {
   CANDIDATE_COUNT
 };
 
+// Candidates of a frame for a given keyframe choice, see SetFrame().
+typedef struct {
+  Candidate candidates[CANDIDATE_COUNT];
+  Candidate* best_candidate;  // NULL until one is picked.
+} FrameCandidates;
+
+// Candidate queued to be encoded concurrently with the other ones of the
+// frame, and picked afterwards in the same order as when encoded serially.
+// As the preparation of the next candidates modifies 'curr_canvas_copy', the
+// job encodes its own copy of the pixels of the candidate rectangle.
+struct CandidateJob {
+  Candidate* candidate;
+  FrameCandidates* frame_candidates;  // Where to pick 'candidate'.
+  int is_key_frame;
+  WebPMuxAnimDispose dispose_method;
+  WebPConfig config;
+  int carries_over;
+  WebPPicture canvas;       // Canvas-sized, for any candidate rectangle.
+  WebPPicture sub_frame;    // View of 'canvas' in the candidate rectangle.
+  uint8_t* carryover_mask;  // Swapped with 'candidate_carryover_mask'.
+  WebPEncodingError error_code;
+  // Only used by the jobs of deferred frames, which outlive their
+  // FrameCandidates.
+  Candidate deferred_candidate;
+  size_t frame_index;  // Frame count since the start of the animation.
+};
+
+// A subframe and a keyframe can be tried for each frame, after the jobs of the
+// frames deferred so far.
+#define MAX_CANDIDATE_JOBS (2 * CANDIDATE_COUNT + MAX_DEFERRED_FRAMES - 1)
+
+static void DeleteCandidateJobs(WebPAnimEncoder* const enc) {
+  if (enc->jobs != NULL) {
+    int i;
+    for (i = 0; i < MAX_CANDIDATE_JOBS; ++i) {
+      WebPPictureFree(&enc->jobs[i].canvas);
+      WebPSafeFree(enc->jobs[i].carryover_mask);
+    }
+    WebPSafeFree(enc->jobs);
+    enc->jobs = NULL;
+  }
+}
+
+// Queues the 'candidate' of 'rect' in 'curr_canvas_copy' as the next job, after
+// copying the pixels. The carryover mask that was just prepared is handed over
+// to the job too.
+static WebPEncodingError QueueCandidate(
+    WebPAnimEncoder* const enc, const FrameRectangle* const rect,
+    const WebPConfig* const config, WebPMuxAnimDispose dispose_method,
+    int is_key_frame, Candidate* const candidate,
+    FrameCandidates* const frame_candidates) {
+  CandidateJob* const job = &enc->jobs[enc->num_jobs];
+  WebPPicture curr_canvas_view;
+  uint8_t* const tmp_carryover_mask = enc->candidate_carryover_mask;
+  assert(enc->num_jobs < MAX_CANDIDATE_JOBS);
+
+  if (job->canvas.argb == NULL) {
+    job->canvas.width = enc->canvas_width;
+    job->canvas.height = enc->canvas_height;
+    job->canvas.use_argb = 1;
+    if (!WebPPictureAlloc(&job->canvas)) return VP8_ENC_ERROR_OUT_OF_MEMORY;
+  }
+  if (job->carryover_mask == NULL) {
+    job->carryover_mask = (uint8_t*)WebPSafeMalloc(
+        enc->canvas_width * (uint64_t)enc->canvas_height,
+        sizeof(*job->carryover_mask));
+    if (job->carryover_mask == NULL) return VP8_ENC_ERROR_OUT_OF_MEMORY;
+  }
+  if (!WebPPictureView(&enc->curr_canvas_copy, rect->x_offset, rect->y_offset,
+                       rect->width, rect->height, &curr_canvas_view) ||
+      !WebPPictureView(&job->canvas, rect->x_offset, rect->y_offset,
+                       rect->width, rect->height, &job->sub_frame)) {
+    return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+  }
+  WebPCopyPixels(&curr_canvas_view, &job->sub_frame);
+  job->sub_frame.thread_pool = curr_canvas_view.thread_pool;
+  job->sub_frame.num_threads = curr_canvas_view.num_threads;
+
+  enc->candidate_carryover_mask = job->carryover_mask;
+  job->carryover_mask = tmp_carryover_mask;
+  job->candidate = candidate;
+  job->frame_candidates = frame_candidates;
+  job->is_key_frame = is_key_frame;
+  job->dispose_method = dispose_method;
+  job->config = *config;
+  job->carries_over = enc->curr_canvas_copy_modified;
+  job->error_code = VP8_ENC_OK;
+  ++enc->num_jobs;
+  return VP8_ENC_OK;
+}
+
 #define MIN_COLORS_LOSSY 31      // Don't try lossy below this threshold.
 #define MAX_COLORS_LOSSLESS 194  // Don't try lossless above this threshold.
 
@@ -995,16 +1126,152 @@ static void PickBestCandidate(WebPAnimEncoder* const enc,
   }
 }
 
+static int EncodeCandidateJobsHook(void* data, int start, int end,
+                                   int worker_id) {
+  CandidateJob* const jobs = (CandidateJob*)data;
+  int i;
+  (void)worker_id;
+  for (i = start; i < end; ++i) {
+    CandidateJob* const job = &jobs[i];
+    job->error_code =
+        EncodeCandidate(&job->sub_frame, &job->config, job->candidate);
+  }
+  return 1;
+}
+
+// Encodes the queued candidates concurrently, then hands the deferred ones over
+// to their frames and picks the best other ones in the order they were queued.
+// In case of error, none is picked and the deferred frames are left empty.
+static WebPEncodingError EncodeCandidateJobs(
+    WebPAnimEncoder* const enc, EncodedFrame* const encoded_frame) {
+  WebPEncodingError error_code = VP8_ENC_OK;
+  WebPWorkerTeam team;
+  int i;
+
+  if (enc->num_jobs == 0) return VP8_ENC_OK;
+  // If the threads can't be started, the team is reduced to the calling
+  // thread, which is fine.
+  (void)WebPWorkerTeamInit(&team, enc->num_jobs,
+                           enc->jobs[0].sub_frame.thread_pool);
+  (void)WebPWorkerTeamRun(&team, enc->num_jobs, EncodeCandidateJobsHook,
+                          enc->jobs);
+  WebPWorkerTeamEnd(&team);
+
+  for (i = 0; i < enc->num_jobs; ++i) {
+    WebPPictureFree(&enc->jobs[i].sub_frame);  // Only releases the YUV planes.
+    if (error_code == VP8_ENC_OK) error_code = enc->jobs[i].error_code;
+  }
+  for (i = 0; i < enc->num_jobs; ++i) {
+    CandidateJob* const job = &enc->jobs[i];
+    if (error_code != VP8_ENC_OK) {
+      if (job->candidate->evaluate) {
+        WebPMemoryWriterClear(&job->candidate->mem);
+        job->candidate->evaluate = 0;
+      }
+    }
+    if (i < enc->num_deferred) {
+      // The candidate was already picked by EncodeOrDeferCandidateJobs().
+      EncodedFrame* const frame =
+          GetFrame(enc, job->frame_index - enc->out_frame_count);
+      WebPMuxFrameInfo* const dst =
+          job->is_key_frame ? &frame->key_frame : &frame->sub_frame;
+      assert(frame->is_pending);
+      frame->is_pending = 0;
+      GetEncodedData(&job->candidate->mem, &dst->bitstream);
+    } else if (error_code == VP8_ENC_OK) {
+      // Get the carryover mask of the candidate back for PickBestCandidate().
+      uint8_t* const tmp_carryover_mask = enc->candidate_carryover_mask;
+      enc->candidate_carryover_mask = job->carryover_mask;
+      job->carryover_mask = tmp_carryover_mask;
+      job->candidate->carries_over = job->carries_over;
+      PickBestCandidate(enc, job->candidate, job->dispose_method,
+                        job->is_key_frame,
+                        &job->frame_candidates->best_candidate, encoded_frame);
+    }
+  }
+  enc->num_jobs = 0;
+  enc->num_deferred = 0;
+  return error_code;
+}
+
+// Encodes the frames deferred by EncodeOrDeferCandidateJobs() so far, if any.
+static int EncodeDeferredFrames(WebPAnimEncoder* const enc) {
+  WebPEncodingError error_code;
+  assert(enc->num_jobs == enc->num_deferred);
+  error_code = EncodeCandidateJobs(enc, /*encoded_frame=*/NULL);
+  if (error_code != VP8_ENC_OK) {
+    MarkError2(enc, "ERROR adding frame. WebPEncodingError", error_code);
+    return 0;
+  }
+  return 1;
+}
+
+// If the single candidate of the current frame at 'position' is queued, it is
+// the best one whatever its size. It is then picked right away, and its
+// encoding is deferred to be run with the candidates of the next frames. This
+// lets the candidates of consecutive frames be encoded concurrently, while the
+// frame waits in 'encoded_frames' for its bitstream to be flushed. Otherwise,
+// the queued candidates are encoded, along with the deferred ones.
+static WebPEncodingError EncodeOrDeferCandidateJobs(
+    WebPAnimEncoder* const enc, size_t position,
+    EncodedFrame* const encoded_frame) {
+  CandidateJob* job;
+  uint8_t* tmp_carryover_mask;
+
+  if (!enc->use_candidate_jobs || enc->num_jobs != enc->num_deferred + 1) {
+    return EncodeCandidateJobs(enc, encoded_frame);
+  }
+  job = &enc->jobs[enc->num_deferred];
+  tmp_carryover_mask = enc->candidate_carryover_mask;
+  enc->candidate_carryover_mask = job->carryover_mask;
+  job->carryover_mask = tmp_carryover_mask;
+  job->candidate->carries_over = job->carries_over;
+  PickBestCandidate(enc, job->candidate, job->dispose_method,
+                    job->is_key_frame, &job->frame_candidates->best_candidate,
+                    encoded_frame);
+  job->deferred_candidate = *job->candidate;
+  job->candidate = &job->deferred_candidate;
+  job->frame_candidates = NULL;
+  job->frame_index = enc->out_frame_count + position;
+  encoded_frame->is_pending = 1;
+  ++enc->num_deferred;
+  if (enc->num_deferred < MAX_DEFERRED_FRAMES) return VP8_ENC_OK;
+  return EncodeCandidateJobs(enc, encoded_frame);
+}
+
+// Encodes the candidate and picks it if it is the best one so far, or queues
+// it if the candidates are encoded concurrently.
+static WebPEncodingError AddCandidate(
+    WebPAnimEncoder* const enc, WebPPicture* const sub_frame,
+    const FrameRectangle* const rect, const WebPConfig* const config,
+    int use_blending, WebPMuxAnimDispose dispose_method, int is_key_frame,
+    Candidate* const candidate, FrameCandidates* const frame_candidates,
+    EncodedFrame* const encoded_frame) {
+  WebPEncodingError error_code;
+  InitCandidate(rect, use_blending, candidate);
+  if (enc->use_candidate_jobs) {
+    return QueueCandidate(enc, rect, config, dispose_method, is_key_frame,
+                          candidate, frame_candidates);
+  }
+  error_code = EncodeCandidate(sub_frame, config, candidate);
+  if (error_code != VP8_ENC_OK) return error_code;
+  candidate->carries_over = enc->curr_canvas_copy_modified;
+  PickBestCandidate(enc, candidate, dispose_method, is_key_frame,
+                    &frame_candidates->best_candidate, encoded_frame);
+  return VP8_ENC_OK;
+}
+
 // Generates candidates for a given dispose method given pre-filled subframe
 // 'params'.
 static WebPEncodingError GenerateCandidates(
-    WebPAnimEncoder* const enc, Candidate candidates[CANDIDATE_COUNT],
+    WebPAnimEncoder* const enc, FrameCandidates* const frame_candidates,
     WebPMuxAnimDispose dispose_method,
     const WebPPicture* const canvas_carryover_disposed, int is_lossless,
     int is_key_frame, SubFrameParams* const params,
     const WebPConfig* const config_ll, const WebPConfig* const config_lossy,
-    Candidate** const best_candidate, EncodedFrame* const encoded_frame) {
+    EncodedFrame* const encoded_frame) {
   WebPEncodingError error_code = VP8_ENC_OK;
+  Candidate* const candidates = frame_candidates->candidates;
   const int is_dispose_none = (dispose_method == WEBP_MUX_DISPOSE_NONE);
   Candidate* const candidate_ll =
       is_dispose_none ? &candidates[LL_DISP_NONE] : &candidates[LL_DISP_BG];
@@ -1051,12 +1318,15 @@ static WebPEncodingError GenerateCandidates(
           IncreaseTransparency(canvas_carryover, &params->rect_ll, curr_canvas,
                                enc->candidate_carryover_mask);
     }
-    error_code = EncodeCandidate(&params->sub_frame_ll, &params->rect_ll,
-                                 config_ll, use_blending_ll, candidate_ll);
+    error_code = AddCandidate(enc, &params->sub_frame_ll, &params->rect_ll,
+                              config_ll, use_blending_ll, dispose_method,
+                              is_key_frame, candidate_ll, frame_candidates,
+                              encoded_frame);
     if (error_code != VP8_ENC_OK) return error_code;
-    candidate_ll->carries_over = enc->curr_canvas_copy_modified;
-    PickBestCandidate(enc, candidate_ll, dispose_method, is_key_frame,
-                      best_candidate, encoded_frame);
+    if (enc->use_candidate_jobs && !config_ll->exact) {
+      // The next candidates see the pixels as left by the lossless encoder.
+      ReplaceTransparentPixels(curr_canvas, &params->rect_ll);
+    }
   }
   if (evaluate_lossy) {
     CopyCurrentCanvas(enc);
@@ -1069,14 +1339,12 @@ static WebPEncodingError GenerateCandidates(
           canvas_carryover, &params->rect_lossy, curr_canvas,
           config_lossy->quality, enc->candidate_carryover_mask);
     }
-    error_code =
-        EncodeCandidate(&params->sub_frame_lossy, &params->rect_lossy,
-                        config_lossy, use_blending_lossy, candidate_lossy);
+    error_code = AddCandidate(
+        enc, &params->sub_frame_lossy, &params->rect_lossy, config_lossy,
+        use_blending_lossy, dispose_method, is_key_frame, candidate_lossy,
+        frame_candidates, encoded_frame);
     if (error_code != VP8_ENC_OK) return error_code;
-    candidate_lossy->carries_over = enc->curr_canvas_copy_modified;
     enc->curr_canvas_copy_modified = 1;
-    PickBestCandidate(enc, candidate_lossy, dispose_method, is_key_frame,
-                      best_candidate, encoded_frame);
   }
   return error_code;
 }
@@ -1192,12 +1460,14 @@ static void CopyMaskedPixels(const WebPPicture* const src,
 
 // Depending on the configuration, tries different compressions
 // (lossy/lossless), dispose methods, blending methods etc to encode the current
-// frame and outputs the best one in 'encoded_frame'.
+// frame and outputs the best one in 'encoded_frame' and
+// 'frame_candidates->best_candidate'. If the candidates are encoded
+// concurrently, they are only queued and EncodeCandidateJobs() completes this.
 // 'frame_skipped' will be set to true if this frame should actually be skipped.
 static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
                                   const WebPConfig* const config,
                                   int is_key_frame,
-                                  FrameRectangle* const best_candidate_rect,
+                                  FrameCandidates* const frame_candidates,
                                   EncodedFrame* const encoded_frame,
                                   int* const frame_skipped) {
   int i;
@@ -1207,8 +1477,7 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
   // canvas_carryover with the area corresponding to the previous frame disposed
   // to background color.
   WebPPicture* canvas_carryover_disposed = NULL;
-  Candidate candidates[CANDIDATE_COUNT];
-  Candidate* best_candidate = NULL;
+  Candidate* const candidates = frame_candidates->candidates;
   const int is_lossless = config->lossless;
   const int consider_lossless = is_lossless || enc->options.allow_mixed;
   const int consider_lossy = !is_lossless || enc->options.allow_mixed;
@@ -1249,7 +1518,7 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
     return VP8_ENC_ERROR_INVALID_CONFIGURATION;
   }
 
-  memset(candidates, 0, sizeof(candidates));
+  memset(frame_candidates, 0, sizeof(*frame_candidates));
 
   // Change-rectangle assuming previous frame was DISPOSE_NONE.
   if (!GetSubRects(canvas_carryover, curr_canvas, is_key_frame, is_first_frame,
@@ -1301,10 +1570,10 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
 
   if (dispose_none_params.should_try) {
     error_code =
-        GenerateCandidates(enc, candidates, WEBP_MUX_DISPOSE_NONE,
+        GenerateCandidates(enc, frame_candidates, WEBP_MUX_DISPOSE_NONE,
                            /*canvas_carryover_disposed=*/NULL, is_lossless,
                            is_key_frame, &dispose_none_params, &config_ll,
-                           &config_lossy, &best_candidate, encoded_frame);
+                           &config_lossy, encoded_frame);
     if (error_code != VP8_ENC_OK) goto Err;
   }
 
@@ -1312,14 +1581,13 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
     assert(!enc->is_first_frame);
     assert(dispose_bg_possible);
     error_code = GenerateCandidates(
-        enc, candidates, WEBP_MUX_DISPOSE_BACKGROUND, canvas_carryover_disposed,
-        is_lossless, is_key_frame, &dispose_bg_params, &config_ll,
-        &config_lossy, &best_candidate, encoded_frame);
+        enc, frame_candidates, WEBP_MUX_DISPOSE_BACKGROUND,
+        canvas_carryover_disposed, is_lossless, is_key_frame,
+        &dispose_bg_params, &config_ll, &config_lossy, encoded_frame);
     if (error_code != VP8_ENC_OK) goto Err;
   }
 
-  assert(best_candidate != NULL);
-  *best_candidate_rect = best_candidate->rect;
+  assert(frame_candidates->best_candidate != NULL || enc->num_jobs > 0);
   goto End;
 
 Err:
@@ -1342,6 +1610,28 @@ static int64_t KeyFramePenalty(const EncodedFrame* const encoded_frame) {
           (int64_t)encoded_frame->sub_frame.bitstream.size);
 }
 
+// Decides whether the candidates of the current frame are encoded
+// concurrently, which is the case if 'config' enables multi-threading. They are
+// not if the progress is reported, as the hook might not be thread-safe.
+static void InitCandidateJobs(WebPAnimEncoder* const enc,
+                              const WebPConfig* const config) {
+  enc->use_candidate_jobs = 0;
+  assert(enc->num_jobs == enc->num_deferred);
+#if defined(WEBP_USE_THREAD)
+  if (config->thread_level > 0 && enc->curr_canvas->progress_hook == NULL) {
+    if (enc->jobs == NULL) {
+      // Note: calloc() so that the canvases and masks are allocated on use.
+      enc->jobs = (CandidateJob*)WebPSafeCalloc(MAX_CANDIDATE_JOBS,
+                                                sizeof(*enc->jobs));
+      if (enc->jobs == NULL) return;  // Fall back to serial encoding.
+    }
+    enc->use_candidate_jobs = 1;
+  }
+#else
+  (void)config;
+#endif
+}
+
 static int CacheFrame(WebPAnimEncoder* const enc,
                       const WebPConfig* const config) {
   int ok = 0;
@@ -1349,14 +1639,17 @@ static int CacheFrame(WebPAnimEncoder* const enc,
   WebPEncodingError error_code = VP8_ENC_OK;
   const size_t position = enc->count;
   EncodedFrame* const encoded_frame = GetFrame(enc, position);
-  FrameRectangle best_key_candidate_rect, best_sub_candidate_rect;
+  FrameCandidates key_candidates, sub_candidates;
   int candidate_undecided;
 
   ++enc->count;
+  InitCandidateJobs(enc, config);
 
   if (enc->is_first_frame) {  // Add this as a keyframe.
-    error_code = SetFrame(enc, config, 1, &best_key_candidate_rect,
-                          encoded_frame, &frame_skipped);
+    error_code = SetFrame(enc, config, 1, &key_candidates, encoded_frame,
+                          &frame_skipped);
+    if (error_code != VP8_ENC_OK) goto End;
+    error_code = EncodeOrDeferCandidateJobs(enc, position, encoded_frame);
     if (error_code != VP8_ENC_OK) goto End;
     assert(frame_skipped == 0);  // First frame can't be skipped, even if empty.
     assert(position == 0 && enc->count == 1);
@@ -1380,10 +1673,12 @@ static int CacheFrame(WebPAnimEncoder* const enc,
 
     if (enc->count_since_key_frame <= enc->options.kmin) {
       // Add this as a frame rectangle.
-      error_code = SetFrame(enc, config, 0, &best_sub_candidate_rect,
-                            encoded_frame, &frame_skipped);
+      error_code = SetFrame(enc, config, 0, &sub_candidates, encoded_frame,
+                            &frame_skipped);
       if (error_code != VP8_ENC_OK) goto End;
       if (frame_skipped) goto Skip;
+      error_code = EncodeOrDeferCandidateJobs(enc, position, encoded_frame);
+      if (error_code != VP8_ENC_OK) goto End;
       encoded_frame->is_key_frame = 0;
       enc->flush_count = enc->count - 1;
       candidate_undecided = 0;
@@ -1395,16 +1690,19 @@ static int CacheFrame(WebPAnimEncoder* const enc,
       //       only when enc->count_since_key_frame < enc->options.kmax ||
       //       enc->best_delta < DELTA_INFINITY).
       //       frame_skipped should still be tested to keep exact same behavior.
-      error_code = SetFrame(enc, config, 0, &best_sub_candidate_rect,
-                            encoded_frame, &frame_skipped);
+      error_code = SetFrame(enc, config, 0, &sub_candidates, encoded_frame,
+                            &frame_skipped);
       if (error_code != VP8_ENC_OK) goto End;
       if (frame_skipped) goto Skip;
 
       // Add this as a keyframe to enc, too.
-      error_code = SetFrame(enc, config, 1, &best_key_candidate_rect,
-                            encoded_frame, &frame_skipped);
+      error_code = SetFrame(enc, config, 1, &key_candidates, encoded_frame,
+                            &frame_skipped);
       if (error_code != VP8_ENC_OK) goto End;
       assert(frame_skipped == 0);  // keyframe cannot be an empty rectangle.
+      // The candidates of both variants are encoded together.
+      error_code = EncodeCandidateJobs(enc, encoded_frame);
+      if (error_code != VP8_ENC_OK) goto End;
 
       // Analyze size difference of the two variants.
       curr_delta = KeyFramePenalty(encoded_frame);
@@ -1444,7 +1742,8 @@ static int CacheFrame(WebPAnimEncoder* const enc,
     // A keyframe does not carry any pixels over from previous frames.
     WebPCopyPixels(enc->curr_canvas, &enc->canvas_carryover);
   } else {
-    const FrameRectangle* const curr_rect = &best_sub_candidate_rect;
+    const FrameRectangle* const curr_rect =
+        &sub_candidates.best_candidate->rect;
     WebPPicture curr_canvas_in_curr_rect;
     WebPPicture canvas_carryover_in_curr_rect;
 
@@ -1493,8 +1792,9 @@ static int CacheFrame(WebPAnimEncoder* const enc,
   if (candidate_undecided) {
     // The previous frame rectangle is not known for sure. Do not save it.
   } else {
-    enc->prev_rect = encoded_frame->is_key_frame ? best_key_candidate_rect
-                                                 : best_sub_candidate_rect;
+    enc->prev_rect = encoded_frame->is_key_frame
+                         ? key_candidates.best_candidate->rect
+                         : sub_candidates.best_candidate->rect;
   }
 
   enc->is_first_frame = 0;
@@ -1504,6 +1804,8 @@ Skip:
   ++enc->in_frame_count;
 
 End:
+  // Drop the jobs of the current frame left if any, not encoded yet.
+  enc->num_jobs = enc->num_deferred;
   if (!ok || frame_skipped) {
     FrameRelease(encoded_frame);
     // We reset some counters, as the frame addition failed/was skipped.
@@ -1525,6 +1827,7 @@ static int FlushFrames(WebPAnimEncoder* const enc) {
     const WebPMuxFrameInfo* const info =
         curr->is_key_frame ? &curr->key_frame : &curr->sub_frame;
     assert(enc->mux != NULL);
+    if (curr->is_pending) break;  // Flushed once encoded.
     err = WebPMuxPushFrame(enc->mux, info, 1);
     if (err != WEBP_MUX_OK) {
       MarkError2(enc, "ERROR adding frame. WebPMuxError", err);
@@ -1585,7 +1888,12 @@ int WebPAnimEncoderAdd(WebPAnimEncoder* enc, WebPPicture* frame, int timestamp,
     // IncreasePreviousDuration() may add a frame to avoid exceeding
     // MAX_DURATION which could cause CacheFrame() to over read 'encoded_frames'
     // before the next flush.
-    if (enc->count == enc->size && !FlushFrames(enc)) {
+    if (enc->count >= enc->size - MAX_DEFERRED_FRAMES && !FlushFrames(enc)) {
+      return 0;
+    }
+    // The frames behind deferred ones can't be flushed until they are encoded.
+    if (enc->count == enc->size &&
+        (!EncodeDeferredFrames(enc) || !FlushFrames(enc))) {
       return 0;
     }
   } else {
@@ -1781,6 +2089,9 @@ int WebPAnimEncoderAssemble(WebPAnimEncoder* enc, WebPData* webp_data) {
   }
 
   // Flush any remaining frames.
+  if (!EncodeDeferredFrames(enc)) {
+    return 0;
+  }
   enc->flush_count = enc->count;
   if (!FlushFrames(enc)) {
     return 0;
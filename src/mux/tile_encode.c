@@ -0,0 +1,188 @@
+// Copyright 2025 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  TileEncoder implementation.
+//
+
+#include <string.h>
+
+#include "src/utils/utils.h"
+#include "src/webp/encode.h"
+#include "src/webp/format_constants.h"
+#include "src/webp/mux.h"
+#include "src/webp/mux_types.h"
+#include "src/webp/types.h"
+
+struct WebPTileEncoder {
+  int canvas_width, canvas_height;
+  int tile_width, tile_height;
+  int tiles_x, tiles_y;  // Number of columns and rows of the grid.
+  WebPData* tiles;       // Encoded tiles, in raster order.
+};
+
+WebPTileEncoder* WebPTileEncoderNewInternal(int width, int height,
+                                            int tile_width, int tile_height,
+                                            int abi_version) {
+  WebPTileEncoder* enc;
+
+  if (WEBP_ABI_IS_INCOMPATIBLE(abi_version, WEBP_MUX_ABI_VERSION)) {
+    return NULL;
+  }
+  if (width <= 0 || height <= 0 || width > MAX_CANVAS_SIZE ||
+      height > MAX_CANVAS_SIZE ||
+      (width * (uint64_t)height) >= MAX_IMAGE_AREA) {
+    return NULL;
+  }
+  // The frame offsets are stored divided by 2.
+  if (tile_width <= 0 || tile_height <= 0 || (tile_width & 1) ||
+      (tile_height & 1)) {
+    return NULL;
+  }
+  if (tile_width > width) tile_width = (width + 1) & ~1;
+  if (tile_height > height) tile_height = (height + 1) & ~1;
+
+  enc = (WebPTileEncoder*)WebPSafeCalloc(1, sizeof(*enc));
+  if (enc == NULL) return NULL;
+  enc->canvas_width = width;
+  enc->canvas_height = height;
+  enc->tile_width = tile_width;
+  enc->tile_height = tile_height;
+  enc->tiles_x = (width + tile_width - 1) / tile_width;
+  enc->tiles_y = (height + tile_height - 1) / tile_height;
+  enc->tiles = (WebPData*)WebPSafeCalloc(
+      (uint64_t)enc->tiles_x * enc->tiles_y, sizeof(*enc->tiles));
+  if (enc->tiles == NULL) {
+    WebPSafeFree(enc);
+    return NULL;
+  }
+  return enc;
+}
+
+void WebPTileEncoderDelete(WebPTileEncoder* enc) {
+  if (enc != NULL) {
+    int i;
+    for (i = 0; i < enc->tiles_x * enc->tiles_y; ++i) {
+      WebPDataClear(&enc->tiles[i]);
+    }
+    WebPSafeFree(enc->tiles);
+    WebPSafeFree(enc);
+  }
+}
+
+// Returns the dimension of a tile starting 'remaining' pixels before the edge.
+static int GetTileSize(int tile_size, int remaining) {
+  return (tile_size < remaining) ? tile_size : remaining;
+}
+
+int WebPTileEncoderAdd(WebPTileEncoder* enc, int tile_x, int tile_y,
+                       WebPPicture* tile, const WebPConfig* config) {
+  WebPConfig default_config;
+  WebPMemoryWriter memory;
+  WebPData* encoded;
+  int x, y, ok;
+
+  if (tile == NULL) return 0;
+  if (enc == NULL) {
+    tile->error_code = VP8_ENC_ERROR_NULL_PARAMETER;
+    return 0;
+  }
+  if (tile_x < 0 || tile_x >= enc->tiles_x || tile_y < 0 ||
+      tile_y >= enc->tiles_y) {
+    tile->error_code = VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    return 0;
+  }
+  x = tile_x * enc->tile_width;
+  y = tile_y * enc->tile_height;
+  if (tile->width != GetTileSize(enc->tile_width, enc->canvas_width - x) ||
+      tile->height != GetTileSize(enc->tile_height, enc->canvas_height - y)) {
+    tile->error_code = VP8_ENC_ERROR_BAD_DIMENSION;
+    return 0;
+  }
+  if (config == NULL) {
+    if (!WebPConfigInit(&default_config)) {
+      tile->error_code = VP8_ENC_ERROR_INVALID_CONFIGURATION;
+      return 0;
+    }
+    config = &default_config;
+  }
+
+  WebPMemoryWriterInit(&memory);
+  tile->writer = WebPMemoryWrite;
+  tile->custom_ptr = &memory;
+  ok = WebPEncode(config, tile);
+  tile->writer = NULL;
+  tile->custom_ptr = NULL;
+  if (!ok) {
+    WebPMemoryWriterClear(&memory);
+    return 0;
+  }
+  encoded = &enc->tiles[tile_y * enc->tiles_x + tile_x];
+  WebPDataClear(encoded);
+  encoded->bytes = memory.mem;
+  encoded->size = memory.size;
+  return 1;
+}
+
+WebPMuxError WebPTileEncoderAssemble(WebPTileEncoder* enc,
+                                     WebPData* webp_data) {
+  WebPMux* mux;
+  WebPMuxError err;
+  WebPMuxAnimParams anim_params;
+  uint8_t tile_chunk[TILE_CHUNK_SIZE];
+  WebPData tile_chunk_data;
+  int tile_x, tile_y;
+
+  if (enc == NULL || webp_data == NULL) return WEBP_MUX_INVALID_ARGUMENT;
+  WebPDataInit(webp_data);
+
+  mux = WebPMuxNew();
+  if (mux == NULL) return WEBP_MUX_MEMORY_ERROR;
+
+  // The tiles are not blended nor disposed, so that decoders unaware of the
+  // grid still render the full image once all of them are displayed.
+  for (tile_y = 0; tile_y < enc->tiles_y; ++tile_y) {
+    for (tile_x = 0; tile_x < enc->tiles_x; ++tile_x) {
+      WebPMuxFrameInfo info;
+      memset(&info, 0, sizeof(info));
+      info.bitstream = enc->tiles[tile_y * enc->tiles_x + tile_x];
+      if (info.bitstream.bytes == NULL) {
+        err = WEBP_MUX_INVALID_ARGUMENT;
+        goto End;
+      }
+      info.x_offset = tile_x * enc->tile_width;
+      info.y_offset = tile_y * enc->tile_height;
+      info.duration = 0;
+      info.id = WEBP_CHUNK_ANMF;
+      info.dispose_method = WEBP_MUX_DISPOSE_NONE;
+      info.blend_method = WEBP_MUX_NO_BLEND;
+      err = WebPMuxPushFrame(mux, &info, 0);
+      if (err != WEBP_MUX_OK) goto End;
+    }
+  }
+
+  err = WebPMuxSetCanvasSize(mux, enc->canvas_width, enc->canvas_height);
+  if (err != WEBP_MUX_OK) goto End;
+  anim_params.bgcolor = 0x00000000;  // Transparent black.
+  anim_params.loop_count = 1;
+  err = WebPMuxSetAnimationParams(mux, &anim_params);
+  if (err != WEBP_MUX_OK) goto End;
+
+  PutLE24(tile_chunk + 0, enc->tile_width - 1);
+  PutLE24(tile_chunk + 3, enc->tile_height - 1);
+  tile_chunk_data.bytes = tile_chunk;
+  tile_chunk_data.size = sizeof(tile_chunk);
+  err = WebPMuxSetChunk(mux, "TILE", &tile_chunk_data, 1);
+  if (err != WEBP_MUX_OK) goto End;
+
+  err = WebPMuxAssemble(mux, webp_data);
+
+End:
+  WebPMuxDelete(mux);
+  return err;
+}
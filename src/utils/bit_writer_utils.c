@@ -16,7 +16,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
-#include <string.h>  // for memcpy()
+#include <string.h>  // for memcpy(), memmove()
 
 #include "src/utils/bounds_safety.h"
 #include "src/utils/endian_inl_utils.h"
@@ -188,6 +188,14 @@ int VP8BitWriterAppend(VP8BitWriter* const bw, const uint8_t* data,
   return 1;
 }
 
+void VP8BitWriterDrop(VP8BitWriter* const bw, size_t size) {
+  assert(size <= VP8BitWriterNumFinalBytes(bw));
+  if (size > 0) {
+    WEBP_UNSAFE_MEMMOVE(bw->buf, bw->buf + size, bw->pos - size);
+    bw->pos -= size;
+  }
+}
+
 void VP8BitWriterWipeOut(VP8BitWriter* const bw) {
   if (bw != NULL) {
     WebPSafeFree(bw->buf);
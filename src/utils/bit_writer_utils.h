@@ -73,6 +73,15 @@ static WEBP_INLINE uint8_t* VP8BitWriterBuf(const VP8BitWriter* const bw) {
 static WEBP_INLINE size_t VP8BitWriterSize(const VP8BitWriter* const bw) {
   return bw->pos;
 }
+// Returns the number of leading bytes of the internal buffer that can't change
+// anymore: all but the last one, which may still receive a carry.
+static WEBP_INLINE size_t VP8BitWriterNumFinalBytes(
+    const VP8BitWriter* const bw) {
+  return (bw->pos > 0) ? bw->pos - 1 : 0;
+}
+// Removes the first 'size' bytes of the internal buffer, once they have been
+// used. 'size' must not exceed VP8BitWriterNumFinalBytes().
+void VP8BitWriterDrop(VP8BitWriter* const bw, size_t size);
 
 //------------------------------------------------------------------------------
 // VP8LBitWriter
@@ -149,10 +149,13 @@ int WebPRescalerImport(WebPRescaler* const rescaler, int num_lines,
     }
     WebPRescalerImportRow(rescaler, src);
     if (!rescaler->y_expand) {  // Accumulate the contribution of the new row.
+      // Local copies, as the stores to 'irow' could otherwise alias 'rescaler'
+      // and prevent the vectorization of the loop.
+      rescaler_t* WEBP_RESTRICT const irow = rescaler->irow;
+      const rescaler_t* WEBP_RESTRICT const frow = rescaler->frow;
+      const int x_max = rescaler->num_channels * rescaler->dst_width;
       int x;
-      for (x = 0; x < rescaler->num_channels * rescaler->dst_width; ++x) {
-        rescaler->irow[x] += rescaler->frow[x];
-      }
+      for (x = 0; x < x_max; ++x) irow[x] += frow[x];
     }
     ++rescaler->src_y;
     src += src_stride;
@@ -46,6 +46,7 @@ typedef CONDITION_VARIABLE pthread_cond_t;
 #else  // !_WIN32
 
 #include <pthread.h>
+#include <unistd.h>  // for sysconf()
 
 #endif  // _WIN32
 
@@ -129,6 +130,11 @@ static int pthread_cond_signal(pthread_cond_t* const condition) {
   return 0;
 }
 
+static int pthread_cond_broadcast(pthread_cond_t* const condition) {
+  WakeAllConditionVariable(condition);
+  return 0;
+}
+
 static int pthread_cond_wait(pthread_cond_t* const condition,
                              pthread_mutex_t* const mutex) {
   const int ok = SleepConditionVariableSRW(condition, mutex, INFINITE, 0);
@@ -142,6 +148,8 @@ static int pthread_cond_wait(pthread_cond_t* const condition,
 
 //------------------------------------------------------------------------------
 
+static void Execute(WebPWorker* const worker);  // forward decl.
+
 static THREADFN ThreadLoop(void* ptr) {
   WebPWorker* const worker = (WebPWorker*)ptr;
   WebPWorkerImpl* const impl = (WebPWorkerImpl*)worker->impl;
@@ -197,6 +205,198 @@ static void ChangeState(WebPWorker* const worker, WebPWorkerStatus new_status) {
   pthread_mutex_unlock(&impl->mutex);
 }
 
+//------------------------------------------------------------------------------
+// Thread pool
+
+#define MAX_POOL_THREADS 256
+
+// Per-worker state when its jobs are dispatched to a WebPThreadPool.
+typedef struct WebPPoolJob WebPPoolJob;
+struct WebPPoolJob {
+  WebPWorker* worker;
+  WebPPoolJob* next;  // next job in the pool's queue
+  int queued;         // true while waiting in the queue for a thread
+};
+
+struct WebPThreadPool {
+  pthread_mutex_t mutex;         // protects the queue and the jobs' status
+  pthread_cond_t job_available;  // signaled when a job is queued or on exit
+  pthread_cond_t job_done;       // broadcast when a job is finished
+  WebPPoolJob* first;            // FIFO of the jobs waiting for a thread
+  WebPPoolJob* last;
+  int shutdown;  // true when the threads must exit
+  int num_threads;
+  pthread_t* threads;
+};
+
+static void PushJob(WebPThreadPool* const pool, WebPPoolJob* const job) {
+  job->next = NULL;
+  job->queued = 1;
+  if (pool->last == NULL) {
+    pool->first = job;
+  } else {
+    pool->last->next = job;
+  }
+  pool->last = job;
+}
+
+static void RemoveJob(WebPThreadPool* const pool, WebPPoolJob* const job) {
+  WebPPoolJob* prev = NULL;
+  WebPPoolJob* cur = pool->first;
+  while (cur != job) {
+    assert(cur != NULL);
+    prev = cur;
+    cur = cur->next;
+  }
+  if (prev == NULL) {
+    pool->first = job->next;
+  } else {
+    prev->next = job->next;
+  }
+  if (pool->last == job) pool->last = prev;
+  job->next = NULL;
+  job->queued = 0;
+}
+
+static THREADFN PoolLoop(void* ptr) {
+  WebPThreadPool* const pool = (WebPThreadPool*)ptr;
+  pthread_mutex_lock(&pool->mutex);
+  while (1) {
+    WebPPoolJob* job;
+    while (pool->first == NULL && !pool->shutdown) {
+      pthread_cond_wait(&pool->job_available, &pool->mutex);
+    }
+    job = pool->first;
+    if (job == NULL) break;  // shutdown, with nothing left to do
+    RemoveJob(pool, job);
+    pthread_mutex_unlock(&pool->mutex);
+    Execute(job->worker);
+    pthread_mutex_lock(&pool->mutex);
+    job->worker->status = OK;
+    pthread_cond_broadcast(&pool->job_done);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return THREAD_RETURN(NULL);
+}
+
+// Waits for the current job of 'worker' to finish. A job that no thread has
+// picked up yet is run by the calling thread, so that Sync() can never wait on
+// a job stuck behind others in the queue (e.g. when pool users nest).
+static void PoolSync(WebPWorker* const worker) {
+  WebPThreadPool* const pool = worker->pool;
+  WebPPoolJob* const job = (WebPPoolJob*)worker->impl;
+  if (job == NULL) return;
+  pthread_mutex_lock(&pool->mutex);
+  if (worker->status == WORK && job->queued) {
+    RemoveJob(pool, job);
+    pthread_mutex_unlock(&pool->mutex);
+    Execute(worker);
+    pthread_mutex_lock(&pool->mutex);
+    worker->status = OK;
+  }
+  while (worker->status == WORK) {
+    pthread_cond_wait(&pool->job_done, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+static void PoolLaunch(WebPWorker* const worker) {
+  WebPThreadPool* const pool = worker->pool;
+  WebPPoolJob* const job = (WebPPoolJob*)worker->impl;
+  if (job == NULL) return;
+  PoolSync(worker);  // finish the previous job, if any
+  pthread_mutex_lock(&pool->mutex);
+  worker->status = WORK;
+  PushJob(pool, job);
+  pthread_mutex_unlock(&pool->mutex);
+  pthread_cond_signal(&pool->job_available);
+}
+
+static int GetNumCPUs(void) {
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return (num_cpus > 0) ? (int)num_cpus : 1;
+#else
+  return 1;
+#endif
+}
+
+// Atomic accesses, all sequentially consistent. With them, the counters are
+// updated and checked without taking the mutex, which is only used by the
+// threads that have to sleep until a counter is reached.
+#if defined(_WIN32)
+#define SYNC_COUNTERS_ATOMICS
+static WEBP_INLINE int AtomicLoad(int* const ptr) {
+  return (int)InterlockedCompareExchange((volatile LONG*)ptr, 0, 0);
+}
+static WEBP_INLINE void AtomicStore(int* const ptr, int value) {
+  (void)InterlockedExchange((volatile LONG*)ptr, value);
+}
+// Returns the previous value.
+static WEBP_INLINE int AtomicAdd(int* const ptr, int value) {
+  return (int)InterlockedExchangeAdd((volatile LONG*)ptr, value);
+}
+// Returns the previous value, which is 'expected' if 'value' was stored.
+static WEBP_INLINE int AtomicCompareExchange(int* const ptr, int expected,
+                                             int value) {
+  return (int)InterlockedCompareExchange((volatile LONG*)ptr, value, expected);
+}
+static WEBP_INLINE void CpuRelax(void) { YieldProcessor(); }
+#elif defined(__GNUC__) || defined(__clang__)
+#define SYNC_COUNTERS_ATOMICS
+static WEBP_INLINE int AtomicLoad(int* const ptr) {
+  return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+static WEBP_INLINE void AtomicStore(int* const ptr, int value) {
+  __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+static WEBP_INLINE int AtomicAdd(int* const ptr, int value) {
+  return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+static WEBP_INLINE int AtomicCompareExchange(int* const ptr, int expected,
+                                             int value) {
+  (void)__atomic_compare_exchange_n(ptr, &expected, value, /*weak=*/0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  return expected;
+}
+static WEBP_INLINE void CpuRelax(void) {
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#endif
+}
+#endif
+
+// Number of checks of a counter before sleeping, if there are several CPUs.
+// The rows of a wavefront are usually a few macroblocks apart, so the wait is
+// often short.
+#define SYNC_COUNTERS_SPIN_COUNT 256
+
+struct WebPSyncCounters {
+  pthread_mutex_t mutex;
+  pthread_cond_t condition;  // broadcast when a counter is updated
+  int num_waiters;           // number of threads waiting on 'condition'
+  int spin_count;            // number of checks before waiting on 'condition'
+  int aborted;
+  int num_counters;
+  int* values;
+};
+
+#else  // !WEBP_USE_THREAD
+
+struct WebPThreadPool {
+  int num_threads;  // always 0: the jobs are run by the calling thread
+};
+
+struct WebPSyncCounters {
+  int aborted;
+  int num_counters;
+  int* values;
+};
+
 #endif  // WEBP_USE_THREAD
 
 //------------------------------------------------------------------------------
@@ -208,7 +408,11 @@ static void Init(WebPWorker* const worker) {
 
 static int Sync(WebPWorker* const worker) {
 #ifdef WEBP_USE_THREAD
-  ChangeState(worker, OK);
+  if (worker->pool != NULL) {
+    PoolSync(worker);
+  } else {
+    ChangeState(worker, OK);
+  }
 #endif
   assert(worker->status <= OK);
   return !worker->had_error;
@@ -219,7 +423,18 @@ static int Reset(WebPWorker* const worker) {
   worker->had_error = 0;
   if (worker->status < OK) {
 #ifdef WEBP_USE_THREAD
-    WebPWorkerImpl* const impl =
+    WebPWorkerImpl* impl;
+    if (worker->pool != NULL) {
+      // No thread to create: the pool's threads will pick the jobs up.
+      WebPPoolJob* const job =
+          (WebPPoolJob*)WebPSafeCalloc(1, sizeof(WebPPoolJob));
+      if (job == NULL) return 0;
+      job->worker = worker;
+      worker->impl = (void*)job;
+      worker->status = OK;
+      return 1;
+    }
+    impl =
         (WebPWorkerImpl*)WebPSafeCalloc(1, sizeof(WebPWorkerImpl));
     worker->impl = (void*)impl;
     if (worker->impl == NULL) {
@@ -262,7 +477,11 @@ static void Execute(WebPWorker* const worker) {
 
 static void Launch(WebPWorker* const worker) {
 #ifdef WEBP_USE_THREAD
-  ChangeState(worker, WORK);
+  if (worker->pool != NULL) {
+    PoolLaunch(worker);
+  } else {
+    ChangeState(worker, WORK);
+  }
 #else
   Execute(worker);
 #endif
@@ -270,7 +489,12 @@ static void Launch(WebPWorker* const worker) {
 
 static void End(WebPWorker* const worker) {
 #ifdef WEBP_USE_THREAD
-  if (worker->impl != NULL) {
+  if (worker->pool != NULL) {
+    PoolSync(worker);
+    WebPSafeFree(worker->impl);
+    worker->impl = NULL;
+    worker->status = NOT_OK;
+  } else if (worker->impl != NULL) {
     WebPWorkerImpl* const impl = (WebPWorkerImpl*)worker->impl;
     ChangeState(worker, NOT_OK);
     pthread_join(impl->thread, NULL);
@@ -307,3 +531,356 @@ const WebPWorkerInterface* WebPGetWorkerInterface(void) {
 }
 
 //------------------------------------------------------------------------------
+
+WebPThreadPool* WebPThreadPoolNew(int num_threads) {
+  WebPThreadPool* const pool =
+      (WebPThreadPool*)WebPSafeCalloc(1, sizeof(*pool));
+  if (pool == NULL) return NULL;
+#ifdef WEBP_USE_THREAD
+  if (num_threads <= 0) num_threads = GetNumCPUs();
+  if (num_threads > MAX_POOL_THREADS) num_threads = MAX_POOL_THREADS;
+  pool->threads =
+      (pthread_t*)WebPSafeCalloc((uint64_t)num_threads, sizeof(*pool->threads));
+  if (pool->threads == NULL) goto Error;
+  if (pthread_mutex_init(&pool->mutex, NULL)) goto Error;
+  if (pthread_cond_init(&pool->job_available, NULL)) {
+    pthread_mutex_destroy(&pool->mutex);
+    goto Error;
+  }
+  if (pthread_cond_init(&pool->job_done, NULL)) {
+    pthread_cond_destroy(&pool->job_available);
+    pthread_mutex_destroy(&pool->mutex);
+    goto Error;
+  }
+  for (; pool->num_threads < num_threads; ++pool->num_threads) {
+    if (pthread_create(&pool->threads[pool->num_threads], NULL, PoolLoop,
+                       pool)) {
+      WebPThreadPoolDelete(pool);
+      return NULL;
+    }
+  }
+  return pool;
+
+Error:
+  WebPSafeFree(pool->threads);
+  WebPSafeFree(pool);
+  return NULL;
+#else
+  (void)num_threads;
+  return pool;
+#endif
+}
+
+int WebPThreadPoolGetNumThreads(const WebPThreadPool* pool) {
+  return (pool != NULL) ? pool->num_threads : 0;
+}
+
+void WebPThreadPoolDelete(WebPThreadPool* pool) {
+  if (pool == NULL) return;
+#ifdef WEBP_USE_THREAD
+  {
+    int i;
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_cond_broadcast(&pool->job_available);
+    for (i = 0; i < pool->num_threads; ++i) {
+      pthread_join(pool->threads[i], NULL);
+    }
+    assert(pool->first == NULL);
+    pthread_cond_destroy(&pool->job_done);
+    pthread_cond_destroy(&pool->job_available);
+    pthread_mutex_destroy(&pool->mutex);
+    WebPSafeFree(pool->threads);
+  }
+#endif
+  WebPSafeFree(pool);
+}
+
+//------------------------------------------------------------------------------
+
+WebPSyncCounters* WebPSyncCountersNew(int num_counters) {
+  WebPSyncCounters* const counters =
+      (WebPSyncCounters*)WebPSafeCalloc(1, sizeof(*counters));
+  if (counters == NULL) return NULL;
+  counters->values =
+      (int*)WebPSafeCalloc((uint64_t)num_counters, sizeof(*counters->values));
+  if (counters->values == NULL) goto Error;
+  counters->num_counters = num_counters;
+#ifdef WEBP_USE_THREAD
+  if (pthread_mutex_init(&counters->mutex, NULL)) goto Error;
+  if (pthread_cond_init(&counters->condition, NULL)) {
+    pthread_mutex_destroy(&counters->mutex);
+    goto Error;
+  }
+  // Spinning only delays the thread that would update the counter if it has
+  // to share the only CPU.
+  counters->spin_count = (GetNumCPUs() > 1) ? SYNC_COUNTERS_SPIN_COUNT : 0;
+#endif
+  return counters;
+
+Error:
+  WebPSafeFree(counters->values);
+  WebPSafeFree(counters);
+  return NULL;
+}
+
+void WebPSyncCountersDelete(WebPSyncCounters* const counters) {
+  if (counters == NULL) return;
+#ifdef WEBP_USE_THREAD
+  assert(counters->num_waiters == 0);
+  pthread_cond_destroy(&counters->condition);
+  pthread_mutex_destroy(&counters->mutex);
+#endif
+  WebPSafeFree(counters->values);
+  WebPSafeFree(counters);
+}
+
+void WebPSyncCountersReset(WebPSyncCounters* const counters) {
+  memset(counters->values, 0,
+         counters->num_counters * sizeof(*counters->values));
+  counters->aborted = 0;
+}
+
+#if defined(SYNC_COUNTERS_ATOMICS)
+// Wakes up the threads waiting on the counters, if any. A waiter registers
+// itself before checking the counter (see WebPSyncCountersWait()), so either
+// it sees the updated counter or it is seen here. Taking the mutex makes sure
+// it sleeps on 'condition' before the broadcast.
+static void WakeUpWaiters(WebPSyncCounters* const counters) {
+  if (AtomicLoad(&counters->num_waiters) > 0) {
+    pthread_mutex_lock(&counters->mutex);
+    pthread_mutex_unlock(&counters->mutex);
+    pthread_cond_broadcast(&counters->condition);
+  }
+}
+
+void WebPSyncCountersSet(WebPSyncCounters* const counters, int idx,
+                         int value) {
+  assert(idx >= 0 && idx < counters->num_counters);
+  AtomicStore(&counters->values[idx], value);
+  WakeUpWaiters(counters);
+}
+
+int WebPSyncCountersIncrement(WebPSyncCounters* const counters, int idx) {
+  int value;
+  assert(idx >= 0 && idx < counters->num_counters);
+  value = AtomicAdd(&counters->values[idx], 1);
+  WakeUpWaiters(counters);
+  return value;
+}
+
+int WebPSyncCountersMin(WebPSyncCounters* const counters, int idx,
+                        int value) {
+  int current;
+  assert(idx >= 0 && idx < counters->num_counters);
+  current = AtomicLoad(&counters->values[idx]);
+  while (current > value) {
+    const int previous =
+        AtomicCompareExchange(&counters->values[idx], current, value);
+    if (previous == current) return value;
+    current = previous;
+  }
+  return current;
+}
+
+int WebPSyncCountersWait(WebPSyncCounters* const counters, int idx,
+                         int value) {
+  int* const counter = &counters->values[idx];
+  int i, ok;
+  assert(idx >= 0 && idx < counters->num_counters);
+  for (i = 0; i < counters->spin_count; ++i) {
+    if (AtomicLoad(&counters->aborted)) return 0;
+    if (AtomicLoad(counter) >= value) return 1;
+    CpuRelax();
+  }
+  pthread_mutex_lock(&counters->mutex);
+  (void)AtomicAdd(&counters->num_waiters, 1);
+  while (!AtomicLoad(&counters->aborted) && AtomicLoad(counter) < value) {
+    pthread_cond_wait(&counters->condition, &counters->mutex);
+  }
+  (void)AtomicAdd(&counters->num_waiters, -1);
+  ok = !AtomicLoad(&counters->aborted);
+  pthread_mutex_unlock(&counters->mutex);
+  return ok;
+}
+
+void WebPSyncCountersAbort(WebPSyncCounters* const counters) {
+  AtomicStore(&counters->aborted, 1);
+  pthread_mutex_lock(&counters->mutex);
+  pthread_mutex_unlock(&counters->mutex);
+  pthread_cond_broadcast(&counters->condition);
+}
+
+#else  // !SYNC_COUNTERS_ATOMICS
+
+void WebPSyncCountersSet(WebPSyncCounters* const counters, int idx,
+                         int value) {
+  assert(idx >= 0 && idx < counters->num_counters);
+#ifdef WEBP_USE_THREAD
+  {
+    int has_waiters;
+    pthread_mutex_lock(&counters->mutex);
+    counters->values[idx] = value;
+    has_waiters = (counters->num_waiters > 0);
+    pthread_mutex_unlock(&counters->mutex);
+    if (has_waiters) pthread_cond_broadcast(&counters->condition);
+  }
+#else
+  counters->values[idx] = value;
+#endif
+}
+
+int WebPSyncCountersIncrement(WebPSyncCounters* const counters, int idx) {
+  int value;
+  assert(idx >= 0 && idx < counters->num_counters);
+#ifdef WEBP_USE_THREAD
+  {
+    int has_waiters;
+    pthread_mutex_lock(&counters->mutex);
+    value = counters->values[idx]++;
+    has_waiters = (counters->num_waiters > 0);
+    pthread_mutex_unlock(&counters->mutex);
+    if (has_waiters) pthread_cond_broadcast(&counters->condition);
+  }
+#else
+  value = counters->values[idx]++;
+#endif
+  return value;
+}
+
+int WebPSyncCountersMin(WebPSyncCounters* const counters, int idx,
+                        int value) {
+  assert(idx >= 0 && idx < counters->num_counters);
+#ifdef WEBP_USE_THREAD
+  pthread_mutex_lock(&counters->mutex);
+#endif
+  if (counters->values[idx] > value) counters->values[idx] = value;
+  value = counters->values[idx];
+#ifdef WEBP_USE_THREAD
+  pthread_mutex_unlock(&counters->mutex);
+#endif
+  return value;
+}
+
+int WebPSyncCountersWait(WebPSyncCounters* const counters, int idx,
+                         int value) {
+  int ok;
+  assert(idx >= 0 && idx < counters->num_counters);
+#ifdef WEBP_USE_THREAD
+  pthread_mutex_lock(&counters->mutex);
+  while (!counters->aborted && counters->values[idx] < value) {
+    ++counters->num_waiters;
+    pthread_cond_wait(&counters->condition, &counters->mutex);
+    --counters->num_waiters;
+  }
+  ok = !counters->aborted;
+  pthread_mutex_unlock(&counters->mutex);
+#else
+  // Nobody else could ever update the counter.
+  assert(counters->aborted || counters->values[idx] >= value);
+  ok = !counters->aborted && (counters->values[idx] >= value);
+#endif
+  return ok;
+}
+
+void WebPSyncCountersAbort(WebPSyncCounters* const counters) {
+#ifdef WEBP_USE_THREAD
+  pthread_mutex_lock(&counters->mutex);
+  counters->aborted = 1;
+  pthread_mutex_unlock(&counters->mutex);
+  pthread_cond_broadcast(&counters->condition);
+#else
+  counters->aborted = 1;
+#endif
+}
+
+#endif  // SYNC_COUNTERS_ATOMICS
+
+//------------------------------------------------------------------------------
+
+struct WebPTeamJob {
+  WebPTeamHook hook;
+  void* data;
+  int start, end;
+  int worker_id;
+};
+
+static int TeamJobHook(void* arg1, void* arg2) {
+  const WebPTeamJob* const job = (const WebPTeamJob*)arg1;
+  (void)arg2;
+  return job->hook(job->data, job->start, job->end, job->worker_id);
+}
+
+int WebPWorkerTeamInit(WebPWorkerTeam* const team, int num_workers,
+                       WebPThreadPool* const pool) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  int i;
+  memset(team, 0, sizeof(*team));
+  team->num_workers = 1;
+#ifndef WEBP_USE_THREAD
+  num_workers = 1;
+#endif
+  if (num_workers <= 1) return 1;
+  team->workers = (WebPWorker*)WebPSafeCalloc((uint64_t)num_workers,
+                                              sizeof(*team->workers));
+  team->jobs =
+      (WebPTeamJob*)WebPSafeCalloc((uint64_t)num_workers, sizeof(*team->jobs));
+  if (team->workers == NULL || team->jobs == NULL) goto Error;
+  for (i = 0; i < num_workers; ++i) {
+    WebPWorker* const worker = &team->workers[i];
+    worker_interface->Init(worker);
+    worker->pool = pool;
+    worker->hook = TeamJobHook;
+    worker->data1 = &team->jobs[i];
+    // The first worker is run by the calling thread, see WebPWorkerTeamRun().
+    if (i > 0 && !worker_interface->Reset(worker)) goto Error;
+    team->num_workers = i + 1;
+  }
+  return 1;
+
+Error:
+  WebPWorkerTeamEnd(team);
+  return 0;
+}
+
+int WebPWorkerTeamRun(WebPWorkerTeam* const team, int num_items,
+                      WebPTeamHook hook, void* data) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  const int num_jobs =
+      (num_items < team->num_workers) ? num_items : team->num_workers;
+  int i, ok = 1;
+  if (num_jobs <= 1) return (num_items <= 0) || hook(data, 0, num_items, 0);
+  for (i = num_jobs - 1; i >= 0; --i) {
+    WebPTeamJob* const job = &team->jobs[i];
+    job->hook = hook;
+    job->data = data;
+    job->start = (int)((int64_t)num_items * i / num_jobs);
+    job->end = (int)((int64_t)num_items * (i + 1) / num_jobs);
+    job->worker_id = i;
+    if (i > 0) {
+      worker_interface->Launch(&team->workers[i]);
+    } else {
+      worker_interface->Execute(&team->workers[0]);
+    }
+  }
+  for (i = 0; i < num_jobs; ++i) {
+    ok &= worker_interface->Sync(&team->workers[i]);
+  }
+  return ok;
+}
+
+void WebPWorkerTeamEnd(WebPWorkerTeam* const team) {
+  int i;
+  if (team->workers != NULL) {
+    for (i = 0; i < team->num_workers; ++i) {
+      WebPGetWorkerInterface()->End(&team->workers[i]);
+    }
+  }
+  WebPSafeFree(team->workers);
+  WebPSafeFree(team->jobs);
+  memset(team, 0, sizeof(*team));
+  team->num_workers = 1;
+}
+
+//------------------------------------------------------------------------------
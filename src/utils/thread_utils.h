@@ -46,6 +46,10 @@ typedef struct {
   void* data1;          // first argument passed to 'hook'
   void* data2;          // second argument passed to 'hook'
   int had_error;        // return value of the last call to 'hook'
+  // If not NULL, the hook is run by one of the pool's threads instead of a
+  // thread owned by the worker. Must be set after Init() and before Reset(),
+  // and left unchanged until End(). Only used by the default interface.
+  WebPThreadPool* pool;
 } WebPWorker;
 
 // The interface for all thread-worker related functions. All these functions
@@ -84,6 +88,68 @@ WEBP_EXTERN int WebPSetWorkerInterface(
 // Retrieve the currently set thread worker interface.
 WEBP_EXTERN const WebPWorkerInterface* WebPGetWorkerInterface(void);
 
+//------------------------------------------------------------------------------
+// Synchronization counters
+
+// Set of integer counters that workers can wait on, e.g. to track the progress
+// of each row during a wavefront processing. Without threading support, the
+// callers are expected to never wait on a counter that isn't reached yet.
+typedef struct WebPSyncCounters WebPSyncCounters;
+
+// Allocates 'num_counters' counters, all set to 0. Returns NULL upon error.
+WEBP_EXTERN WebPSyncCounters* WebPSyncCountersNew(int num_counters);
+WEBP_EXTERN void WebPSyncCountersDelete(WebPSyncCounters* const counters);
+// Sets all the counters to 0 and clears the abort state. Must not be called
+// while a thread is using the counters.
+WEBP_EXTERN void WebPSyncCountersReset(WebPSyncCounters* const counters);
+// Sets counter 'idx' to 'value' and wakes up the threads waiting on it.
+WEBP_EXTERN void WebPSyncCountersSet(WebPSyncCounters* const counters, int idx,
+                                     int value);
+// Increments counter 'idx' and returns its previous value.
+WEBP_EXTERN int WebPSyncCountersIncrement(WebPSyncCounters* const counters,
+                                          int idx);
+// Lowers counter 'idx' to 'value' if it is greater, and returns the resulting
+// value. Lowering a counter doesn't wake up any waiting thread.
+WEBP_EXTERN int WebPSyncCountersMin(WebPSyncCounters* const counters, int idx,
+                                    int value);
+// Waits until counter 'idx' is at least 'value'. Returns false if the wait
+// was interrupted (or prevented) by WebPSyncCountersAbort().
+WEBP_EXTERN int WebPSyncCountersWait(WebPSyncCounters* const counters, int idx,
+                                     int value);
+// Releases all the waiting threads. Subsequent waits will fail immediately.
+WEBP_EXTERN void WebPSyncCountersAbort(WebPSyncCounters* const counters);
+
+//------------------------------------------------------------------------------
+// Worker teams
+
+// Function processing the items [start, end) of a loop split by a team.
+// 'worker_id' identifies the calling worker, e.g. to pick its scratch memory.
+// Returns false in case of error.
+typedef int (*WebPTeamHook)(void* data, int start, int end, int worker_id);
+
+typedef struct WebPTeamJob WebPTeamJob;
+
+// Set of workers running loops in parallel. Worker 0 is the calling thread.
+typedef struct {
+  int num_workers;
+  WebPWorker* workers;
+  WebPTeamJob* jobs;
+} WebPWorkerTeam;
+
+// Prepares a team of 'num_workers' workers, run by the threads of 'pool' if
+// not NULL. A zero-initialized team behaves like a single worker. Without
+// threading support, or in case of error, the team is reduced to a single
+// worker and false is returned in the latter case.
+WEBP_EXTERN int WebPWorkerTeamInit(WebPWorkerTeam* const team, int num_workers,
+                                   WebPThreadPool* const pool);
+// Calls 'hook' on the items [0, num_items) split into contiguous ranges of
+// similar sizes, the k-th range being processed by worker k. Returns once all
+// the ranges are processed, false if any call to 'hook' failed.
+WEBP_EXTERN int WebPWorkerTeamRun(WebPWorkerTeam* const team, int num_items,
+                                  WebPTeamHook hook, void* data);
+// Stops the workers and releases the team, which is left single-worker.
+WEBP_EXTERN void WebPWorkerTeamEnd(WebPWorkerTeam* const team);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
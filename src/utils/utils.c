@@ -178,6 +178,66 @@ static void SubMem(void* ptr) {
   } while (0)
 #endif
 
+// Custom allocator set by WebPSetAllocator(), or NULL to use malloc() and
+// free().
+static WebPAllocFunc custom_alloc = NULL;
+static WebPFreeFunc custom_free = NULL;
+static void* custom_opaque = NULL;
+
+// Set by the first allocation. The allocator can't be changed afterward, as the
+// memory might still be held and must be released by the allocator it comes
+// from. It is only read once set, so that concurrent allocations don't contend
+// on it.
+static volatile int has_allocated = 0;
+
+static int HasAllocated(void) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __atomic_load_n(&has_allocated, __ATOMIC_RELAXED);
+#else
+  return has_allocated;
+#endif
+}
+
+static void SetHasAllocated(void) {
+  if (HasAllocated()) return;
+#if defined(__GNUC__) || defined(__clang__)
+  __atomic_store_n(&has_allocated, 1, __ATOMIC_RELAXED);
+#else
+  has_allocated = 1;
+#endif
+}
+
+int WebPSetAllocator(WebPAllocFunc alloc_func, WebPFreeFunc free_func,
+                     void* opaque) {
+  if ((alloc_func == NULL) != (free_func == NULL)) return 0;
+  if (HasAllocated()) return 0;
+  custom_alloc = alloc_func;
+  custom_free = free_func;
+  custom_opaque = (alloc_func != NULL) ? opaque : NULL;
+  return 1;
+}
+
+static void* Malloc(size_t size) {
+  return (custom_alloc != NULL) ? custom_alloc(size, custom_opaque)
+                                : malloc(size);
+}
+
+static void* Calloc(size_t nmemb, size_t size) {
+  void* ptr;
+  if (custom_alloc == NULL) return calloc(nmemb, size);
+  ptr = custom_alloc(nmemb * size, custom_opaque);
+  if (ptr != NULL) memset(ptr, 0, nmemb * size);
+  return ptr;
+}
+
+static void Free(void* const ptr) {
+  if (custom_free == NULL) {
+    free(ptr);
+  } else if (ptr != NULL) {
+    custom_free(ptr, custom_opaque);
+  }
+}
+
 // Returns 0 in case of overflow of nmemb * size.
 static int CheckSizeArgumentsOverflow(uint64_t nmemb, size_t size) {
   const uint64_t total_size = nmemb * size;
@@ -207,7 +267,8 @@ void* WEBP_SIZED_BY_OR_NULL(nmemb* size)
   Increment(&num_malloc_calls);
   if (!CheckSizeArgumentsOverflow(nmemb, size)) return NULL;
   assert(nmemb * size > 0);
-  ptr = malloc((size_t)(nmemb * size));
+  ptr = Malloc((size_t)(nmemb * size));
+  if (ptr != NULL) SetHasAllocated();
   AddMem(ptr, (size_t)(nmemb * size));
   return WEBP_UNSAFE_FORGE_BIDI_INDEXABLE(void*, ptr, (size_t)(nmemb * size));
 }
@@ -218,7 +279,8 @@ void* WEBP_SIZED_BY_OR_NULL(nmemb* size)
   Increment(&num_calloc_calls);
   if (!CheckSizeArgumentsOverflow(nmemb, size)) return NULL;
   assert(nmemb * size > 0);
-  ptr = calloc((size_t)nmemb, size);
+  ptr = Calloc((size_t)nmemb, size);
+  if (ptr != NULL) SetHasAllocated();
   AddMem(ptr, (size_t)(nmemb * size));
   return WEBP_UNSAFE_FORGE_BIDI_INDEXABLE(void*, ptr, (size_t)(nmemb * size));
 }
@@ -228,9 +290,59 @@ void WebPSafeFree(void* const ptr) {
     Increment(&num_free_calls);
     SubMem(ptr);
   }
-  free(ptr);
+  Free(ptr);
 }
 
+//------------------------------------------------------------------------------
+// Arena
+
+void WebPArenaInit(WebPArena* const arena, void* mem, size_t size) {
+  arena->mem = (uint8_t*)mem;
+  arena->size = (mem != NULL) ? size : 0;
+  // The worst-case alignment of the start is accounted for when measuring.
+  arena->used = (mem != NULL) ? (size_t)(WEBP_ALIGN(mem) - (uintptr_t)mem)
+                               : WEBP_ALIGN_CST;
+}
+
+// Returns the number of bytes taken from an arena by 'nmemb' x 'size' bytes,
+// keeping the next buffer aligned. The arguments must be checked beforehand.
+static uint64_t GetArenaSize(uint64_t nmemb, size_t size) {
+  return (nmemb * size + WEBP_ALIGN_CST) & ~(uint64_t)WEBP_ALIGN_CST;
+}
+
+void* WEBP_SIZED_BY_OR_NULL(nmemb* size)
+    WebPArenaMalloc(WebPArena* const arena, uint64_t nmemb, size_t size) {
+  uint64_t total_size;
+  void* ptr;
+  if (arena == NULL) return WebPSafeMalloc(nmemb, size);
+  // Nothing is allocated when measuring, see WebPArenaReserve().
+  assert(!WebPArenaIsMeasuring(arena));
+  if (WebPArenaIsMeasuring(arena)) return NULL;
+  if (!CheckSizeArgumentsOverflow(nmemb, size)) return NULL;
+  total_size = GetArenaSize(nmemb, size);
+  if (arena->used > arena->size || total_size > arena->size - arena->used) {
+    return NULL;
+  }
+  ptr = arena->mem + arena->used;
+  arena->used += (size_t)total_size;
+  return WEBP_UNSAFE_FORGE_BIDI_INDEXABLE(void*, ptr, (size_t)(nmemb * size));
+}
+
+int WebPArenaReserve(WebPArena* const arena, uint64_t nmemb, size_t size) {
+  uint64_t total_size;
+  assert(WebPArenaIsMeasuring(arena));
+  if (!CheckSizeArgumentsOverflow(nmemb, size)) return 0;
+  total_size = GetArenaSize(nmemb, size);
+  if (total_size > (uint64_t)(~(size_t)0 - arena->used)) return 0;
+  arena->used += (size_t)total_size;
+  return 1;
+}
+
+void WebPArenaFree(const WebPArena* const arena, void* const ptr) {
+  if (arena == NULL) WebPSafeFree(ptr);
+}
+
+//------------------------------------------------------------------------------
 // Public API functions.
 
 void* WEBP_SINGLE WebPMalloc(size_t size) {
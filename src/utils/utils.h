@@ -71,6 +71,36 @@ WEBP_EXTERN void WebPSafeFree(void* const ptr);
 #define WEBP_ALIGN(PTR) \
   (((uintptr_t)(PTR) + WEBP_ALIGN_CST) & ~(uintptr_t)WEBP_ALIGN_CST)
 
+//------------------------------------------------------------------------------
+// Arena
+
+// Memory supplied by the caller, out of which the buffers are carved one after
+// the other, each aligned with WEBP_ALIGN(). They are never released
+// individually. If 'mem' is NULL, nothing is allocated: the buffers are only
+// accounted for with WebPArenaReserve() and 'used' measures the size needed.
+typedef struct {
+  uint8_t* mem;
+  size_t size;
+  size_t used;  // Bytes carved so far, including the alignment of 'mem'.
+} WebPArena;
+
+// Initializes 'arena' with the 'size' bytes at 'mem', or for measuring only if
+// 'mem' is NULL.
+void WebPArenaInit(WebPArena* const arena, void* mem, size_t size);
+// Same as WebPSafeMalloc(), taking the memory from 'arena' if not NULL.
+void* WEBP_SIZED_BY_OR_NULL(nmemb* size)
+    WebPArenaMalloc(WebPArena* const arena, uint64_t nmemb, size_t size);
+// Accounts for 'nmemb' x 'size' bytes in the measuring 'arena', as if they were
+// taken by WebPArenaMalloc(). Returns false in case of overflow.
+WEBP_NODISCARD int WebPArenaReserve(WebPArena* const arena, uint64_t nmemb,
+                                    size_t size);
+// Releases 'ptr', returned by WebPArenaMalloc() with the same 'arena'.
+void WebPArenaFree(const WebPArena* const arena, void* const ptr);
+// Returns true if 'arena' is only measuring the memory needed.
+static WEBP_INLINE int WebPArenaIsMeasuring(const WebPArena* const arena) {
+  return (arena != NULL && arena->mem == NULL);
+}
+
 #include <string.h>
 // memcpy() is the safe way of moving potentially unaligned 32b memory.
 static WEBP_INLINE uint32_t WebPMemToUint32(const uint8_t* const ptr) {
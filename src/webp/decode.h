@@ -24,7 +24,7 @@ WEBP_ASSUME_UNSAFE_INDEXABLE_ABI
 extern "C" {
 #endif
 
-#define WEBP_DECODER_ABI_VERSION 0x0210  // MAJOR(8b) + MINOR(8b)
+#define WEBP_DECODER_ABI_VERSION 0x0214  // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -37,6 +37,7 @@ typedef struct WebPIDecoder WebPIDecoder;
 typedef struct WebPBitstreamFeatures WebPBitstreamFeatures;
 typedef struct WebPDecoderOptions WebPDecoderOptions;
 typedef struct WebPDecoderConfig WebPDecoderConfig;
+typedef struct WebPDecoderContext WebPDecoderContext;
 
 // Return the decoder's version number, packed in hexadecimal using 8bits for
 // each of major/minor/revision. E.g: v2.5.7 is 0x020507.
@@ -223,6 +224,18 @@ struct WebPYUVABuffer {    // view as YUVA
   size_t a_size;           // alpha-plane size
 };
 
+// Row sink, receiving the output rows as soon as they are final, instead of
+// storing them into a full-size buffer (see WebPDecBuffer::row_sink).
+// 'rows' describes the 'num_rows' rows starting at row 'y' of the output: its
+// 'height' is 'num_rows' and the pointers of its buffer union point to the
+// row 'y' (row 'y / 2' for the U/V planes). The rows are passed by increasing
+// 'y', without overlap, and 'y' is even for the YUV modes. The samples are
+// only valid during the call. This function can be called from a worker
+// thread if 'use_threads' is set, but never concurrently.
+// Must return false to abort the decoding (with VP8_STATUS_USER_ABORT).
+typedef int (*WebPDecRowSink)(const WebPDecBuffer* rows, int y, int num_rows,
+                              void* user_data);
+
 // Output buffer
 struct WebPDecBuffer {
   WEBP_CSP_MODE colorspace;  // Colorspace.
@@ -234,8 +247,18 @@ struct WebPDecBuffer {
   union {
     WebPRGBABuffer RGBA;
     WebPYUVABuffer YUVA;
-  } u;              // Nameless union of buffer parameters.
-  uint32_t pad[4];  // padding for later use
+  } u;                      // Nameless union of buffer parameters.
+  WebPDecRowSink row_sink;  // If not NULL, the output rows are passed to
+                            // 'row_sink' and the buffer only holds a few
+                            // of them at a time. The memory must be internal
+                            // and flip, incremental decoding and scaling of
+                            // the YUV modes are not supported.
+  void* row_sink_data;      // user data passed to 'row_sink'
+#if (defined(_MSC_VER) && !defined(_WIN64)) || \
+    (defined(UINTPTR_MAX) && (UINTPTR_MAX <= 0xffffffffu))
+  uint32_t pad[2];  // padding for later use (the two pointers above took the
+                    // place of 'uint32_t pad[4]', whatever their size)
+#endif
 
   uint8_t* private_memory;  // Internally allocated memory (only when
                             // is_external_memory is 0). Should not be used
@@ -307,7 +330,7 @@ typedef enum WEBP_NODISCARD VP8StatusCode {
 // stride of output_buffer.u.RGBA or output_buffer.u.YUVA, provided they remain
 // within valid bounds.
 // All other fields of WebPDecBuffer MUST remain constant between calls.
-// Returns NULL if the allocation failed.
+// Returns NULL if the allocation failed, or if 'output_buffer' has a row_sink.
 WEBP_NODISCARD WEBP_EXTERN WebPIDecoder* WebPINewDecoder(
     WebPDecBuffer* output_buffer);
 
@@ -489,13 +512,16 @@ struct WebPDecoderOptions {
   int use_scaling;                  // if true, scaling is applied _afterward_
   int scaled_width, scaled_height;  // final resolution. if one is 0, it is
                                     // guessed from the other one to keep the
-                                    // original ratio.
+                                    // original ratio. The lossy in-loop
+                                    // filtering is skipped when shrinking
+                                    // both dimensions below 3/4.
   int use_threads;                  // if true, use multi-threaded decoding
   int dithering_strength;           // dithering strength (0=Off, 100=full)
   int flip;                         // if true, flip output vertically
   int alpha_dithering_strength;     // alpha dithering strength in [0..100]
 
-  uint32_t pad[5];  // padding for later use
+  uint32_t pad[5];  // padding for later use. Also holds the thread pool set
+                    // by WebPDecoderConfigSetThreadPool().
 };
 
 // Main object storing the configuration for advanced decoding.
@@ -517,6 +543,14 @@ WEBP_NODISCARD static WEBP_INLINE int WebPInitDecoderConfig(
   return WebPInitDecoderConfigInternal(config, WEBP_DECODER_ABI_VERSION);
 }
 
+// Makes the decodings using 'config' run on the threads of 'pool' (see
+// WebPThreadPoolNew()) instead of new ones, if 'config->options.use_threads'
+// is set. 'pool' can be NULL to stop using a pool, and otherwise must outlive
+// these decodings. WebPInitDecoderConfig() resets it to NULL.
+// Returns false if 'config' is NULL.
+WEBP_EXTERN int WebPDecoderConfigSetThreadPool(WebPDecoderConfig* config,
+                                               WebPThreadPool* pool);
+
 // Returns true if 'config' is non-NULL and all configuration parameters are
 // within their valid ranges.
 WEBP_NODISCARD WEBP_EXTERN int WebPValidateDecoderConfig(
@@ -545,6 +579,86 @@ WEBP_EXTERN VP8StatusCode WebPDecode(const uint8_t* WEBP_COUNTED_BY(data_size)
                                      size_t data_size,
                                      WebPDecoderConfig* config);
 
+//------------------------------------------------------------------------------
+// Decoder context
+//
+// A WebPDecoderContext keeps the decoders and their working memory from one
+// call to WebPDecodeWithContext() to the next, instead of allocating and
+// releasing them for each picture. The memory grows to fit the largest picture
+// decoded so far and is only released by WebPDecoderContextDelete(). This is
+// useful to decode many pictures of similar dimensions. A context can only be
+// used by one thread at a time.
+/*
+     WebPDecoderContext* const context = WebPDecoderContextNew();
+     CHECK(context != NULL);
+     while (...) {  // for each picture
+       CHECK(WebPInitDecoderConfig(&config));
+       ...
+       CHECK(WebPDecodeWithContext(context, data, data_size, &config)
+             == VP8_STATUS_OK);
+       ...
+       WebPFreeDecBuffer(&config.output);
+     }
+     WebPDecoderContextDelete(context);
+*/
+
+// Internal, version-checked, entry point
+WEBP_NODISCARD WEBP_EXTERN WebPDecoderContext* WebPDecoderContextNewInternal(
+    int);
+
+// Creates a new, empty, decoder context. Returns NULL in case of memory error
+// or version mismatch.
+WEBP_NODISCARD static WEBP_INLINE WebPDecoderContext* WebPDecoderContextNew(
+    void) {
+  return WebPDecoderContextNewInternal(WEBP_DECODER_ABI_VERSION);
+}
+
+// Same as WebPDecode(), reusing the decoders and memory of 'context'.
+WEBP_EXTERN VP8StatusCode WebPDecodeWithContext(
+    WebPDecoderContext* context,
+    const uint8_t* WEBP_COUNTED_BY(data_size) data, size_t data_size,
+    WebPDecoderConfig* config);
+
+// Releases the memory of 'context'.
+WEBP_EXTERN void WebPDecoderContextDelete(WebPDecoderContext* context);
+
+//------------------------------------------------------------------------------
+// Arena decoding
+//
+// The output buffer and the largest working buffers of the decoder can be
+// carved out of a single memory block supplied by the caller (the "arena"),
+// for instance one reserved per request, instead of being allocated one by
+// one. The remaining small allocations (headers, entropy tables...) still use
+// the heap. The arena size needed depends on the bitstream header and on
+// 'config', and is computed by WebPGetDecodeArenaSize() without allocating
+// memory nor decoding the picture.
+/*
+     size_t arena_size;
+     CHECK(WebPGetDecodeArenaSize(data, data_size, &config, &arena_size)
+           == VP8_STATUS_OK);
+     CHECK(arena_size <= sizeof(request_memory));
+     CHECK(WebPDecodeInArena(data, data_size, &config, request_memory,
+                             arena_size) == VP8_STATUS_OK);
+     ...  // use config.output, valid as long as 'request_memory' is.
+*/
+
+// Stores in '*arena_size' the number of bytes needed by WebPDecodeInArena() to
+// decode 'data' with 'config'. 'config' is not modified. Only the headers are
+// read: the size is exact for lossy pictures without alpha, and an upper bound
+// for lossless pictures and alpha, whose packed pixels are counted unpacked.
+// Errors in the rest of the bitstream are reported by WebPDecodeInArena().
+WEBP_NODISCARD WEBP_EXTERN VP8StatusCode WebPGetDecodeArenaSize(
+    const uint8_t* WEBP_COUNTED_BY(data_size) data, size_t data_size,
+    const WebPDecoderConfig* config, size_t* arena_size);
+
+// Same as WebPDecode(), taking the memory of the output buffer (unless
+// external) and of the largest working buffers from the 'mem_size' bytes at
+// 'mem'. Returns VP8_STATUS_OUT_OF_MEMORY if they do not fit. The output buffer
+// is not owned by 'config->output': calling WebPFreeDecBuffer() is harmless.
+WEBP_EXTERN VP8StatusCode WebPDecodeInArena(
+    const uint8_t* WEBP_COUNTED_BY(data_size) data, size_t data_size,
+    WebPDecoderConfig* config, void* mem, size_t mem_size);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
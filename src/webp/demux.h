@@ -58,7 +58,7 @@
 extern "C" {
 #endif
 
-#define WEBP_DEMUX_ABI_VERSION 0x0107  // MAJOR(8b) + MINOR(8b)
+#define WEBP_DEMUX_ABI_VERSION 0x0109  // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -69,6 +69,8 @@ typedef struct WebPIterator WebPIterator;
 typedef struct WebPChunkIterator WebPChunkIterator;
 typedef struct WebPAnimInfo WebPAnimInfo;
 typedef struct WebPAnimDecoderOptions WebPAnimDecoderOptions;
+typedef struct WebPTileInfo WebPTileInfo;
+typedef struct WebPTileDecoderOptions WebPTileDecoderOptions;
 
 //------------------------------------------------------------------------------
 
@@ -257,8 +259,17 @@ struct WebPAnimDecoderOptions {
   // Output colorspace. Only the following modes are supported:
   // MODE_RGBA, MODE_BGRA, MODE_rgbA and MODE_bgrA.
   WEBP_CSP_MODE color_mode;
-  int use_threads;      // If true, use multi-threaded decoding.
-  uint32_t padding[7];  // Padding for later use.
+  int use_threads;  // If true, use multi-threaded decoding.
+  // If > 0, up to this number of the next frames are decoded ahead on worker
+  // threads, while the current one is being consumed. Only their blending onto
+  // the canvas is left to WebPAnimDecoderGetNext(). Has no effect without
+  // threading support.
+  int prefetch_frames;
+  // Maximum number of bytes allocated for the pixels of the frames decoded
+  // ahead (frame rectangles in 'color_mode'). A frame not fitting in it is
+  // decoded by WebPAnimDecoderGetNext(). 0 means no limit.
+  uint32_t prefetch_memory_limit;
+  uint32_t padding[5];  // Padding for later use.
 };
 
 // Internal, version-checked, entry point.
@@ -347,6 +358,20 @@ WEBP_NODISCARD WEBP_EXTERN int WebPAnimDecoderHasMoreFrames(
 //   dec - (in/out) decoder instance to be reset
 WEBP_EXTERN void WebPAnimDecoderReset(WebPAnimDecoder* dec);
 
+// Runs the decoding of 'dec' on the threads of 'pool' (see WebPThreadPoolNew())
+// instead of new ones, both to decode the frames ahead and, if 'use_threads'
+// is set, within each frame. The frames being decoded ahead are discarded and
+// decoded again. 'pool' can be NULL to stop using a pool, and otherwise must
+// outlive 'dec' or the next call to this function.
+// Parameters:
+//   dec - (in/out) decoder instance
+//   pool - (in) thread pool, or NULL
+// Returns:
+//   False if 'dec' is NULL or in case of thread creation error, after which
+//   'dec' can only be deleted.
+WEBP_EXTERN int WebPAnimDecoderSetThreadPool(WebPAnimDecoder* dec,
+                                             WebPThreadPool* pool);
+
 // Grab the internal demuxer object.
 // Getting the demuxer object can be useful if one wants to use operations only
 // available through demuxer; e.g. to get XMP/EXIF/ICC metadata. The returned
@@ -363,6 +388,126 @@ WEBP_NODISCARD WEBP_EXTERN const WebPDemuxer* WebPAnimDecoderGetDemuxer(
 //   dec - (in/out) decoder instance to be deleted
 WEBP_EXTERN void WebPAnimDecoderDelete(WebPAnimDecoder* dec);
 
+//------------------------------------------------------------------------------
+// WebPTileDecoder API
+//
+// This API allows decoding any rectangle of a tiled WebP image (see
+// WebPTileEncoder in mux.h) by decoding only the tiles it intersects, so that
+// the decoding time depends on the size of the rectangle and not on the size
+// of the image.
+//
+// Code Example:
+/*
+  WebPTileDecoderOptions dec_options;
+  WebPTileDecoderOptionsInit(&dec_options);
+  // Tune 'dec_options' as needed.
+  WebPTileDecoder* dec = WebPTileDecoderNew(webp_data, &dec_options);
+  WebPTileInfo tile_info;
+  WebPTileDecoderGetInfo(dec, &tile_info);
+  // ... (Allocate 'buf' with 'height' rows of 'stride' bytes).
+  WebPTileDecoderDecodeRegion(dec, left, top, width, height, buf, stride);
+  // ... (Render 'buf').
+  WebPTileDecoderDelete(dec);
+*/
+
+typedef struct WebPTileDecoder WebPTileDecoder;  // Main opaque object.
+
+// Global options.
+struct WebPTileDecoderOptions {
+  // Output colorspace. Any RGB(A) mode is supported (MODE_RGB, MODE_RGBA,
+  // MODE_BGR, MODE_BGRA, MODE_ARGB, MODE_RGBA_4444, MODE_RGB_565 and their
+  // premultiplied variants).
+  WEBP_CSP_MODE color_mode;
+  int use_threads;      // If true, use multi-threaded decoding.
+  uint32_t padding[7];  // Padding for later use.
+};
+
+// Internal, version-checked, entry point.
+WEBP_NODISCARD WEBP_EXTERN int WebPTileDecoderOptionsInitInternal(
+    WebPTileDecoderOptions*, int);
+
+// Should always be called, to initialize a fresh WebPTileDecoderOptions
+// structure before modification. Returns false in case of version mismatch.
+// WebPTileDecoderOptionsInit() must have succeeded before using the
+// 'dec_options' object.
+WEBP_NODISCARD static WEBP_INLINE int WebPTileDecoderOptionsInit(
+    WebPTileDecoderOptions* dec_options) {
+  return WebPTileDecoderOptionsInitInternal(dec_options,
+                                            WEBP_DEMUX_ABI_VERSION);
+}
+
+// Internal, version-checked, entry point.
+WEBP_NODISCARD WEBP_EXTERN WebPTileDecoder* WebPTileDecoderNewInternal(
+    const WebPData*, const WebPTileDecoderOptions*, int);
+
+// Creates and initializes a WebPTileDecoder object. Only the chunk headers are
+// parsed: no tile is decoded.
+// Parameters:
+//   webp_data - (in) tiled WebP bitstream. This should remain unchanged during
+//                    the lifetime of the output WebPTileDecoder object.
+//   dec_options - (in) decoding options. Can be passed NULL to choose
+//                      reasonable defaults (in particular, color mode MODE_RGBA
+//                      will be picked).
+// Returns:
+//   A pointer to the newly created WebPTileDecoder object, or NULL in case of
+//   parsing error, bitstream without a tile grid, invalid option or memory
+//   error.
+WEBP_NODISCARD static WEBP_INLINE WebPTileDecoder* WebPTileDecoderNew(
+    const WebPData* webp_data, const WebPTileDecoderOptions* dec_options) {
+  return WebPTileDecoderNewInternal(webp_data, dec_options,
+                                    WEBP_DEMUX_ABI_VERSION);
+}
+
+// Global information about the tiled image.
+struct WebPTileInfo {
+  uint32_t canvas_width;
+  uint32_t canvas_height;
+  uint32_t tile_width;   // Dimensions of the tiles, except for the last column
+  uint32_t tile_height;  // and row which are cropped to the canvas.
+  uint32_t tiles_x;      // Number of columns of the grid.
+  uint32_t tiles_y;      // Number of rows of the grid.
+  uint32_t pad[4];       // padding for later use
+};
+
+// Get global information about the tiled image.
+// Parameters:
+//   dec - (in) decoder instance to get information from.
+//   info - (out) global information fetched from the image.
+// Returns:
+//   True on success.
+WEBP_NODISCARD WEBP_EXTERN int WebPTileDecoderGetInfo(
+    const WebPTileDecoder* dec, WebPTileInfo* info);
+
+// Decodes the rectangle of the canvas at 'left', 'top' of dimensions 'width' x
+// 'height' into 'output', in the color mode of the options supplied to
+// WebPTileDecoderNew(). Only the tiles intersecting the rectangle are decoded,
+// each one directly into 'output'.
+// Parameters:
+//   dec - (in/out) decoder instance.
+//   left/top/width/height - (in) rectangle to decode, which must be within the
+//                                canvas.
+//   output - (out) buffer of 'height' rows of 'stride' bytes.
+//   stride - (in) distance in bytes between the rows of 'output'.
+// Returns:
+//   False if any of the arguments are invalid, or if there is a parsing or
+//   decoding error. Otherwise, returns true.
+WEBP_NODISCARD WEBP_EXTERN int WebPTileDecoderDecodeRegion(
+    WebPTileDecoder* dec, int left, int top, int width, int height,
+    uint8_t* output, int stride);
+
+// Grab the internal demuxer object, e.g. to get XMP/EXIF/ICC metadata. The
+// returned demuxer object is owned by 'dec' and is valid only until the next
+// call to WebPTileDecoderDelete().
+// Parameters:
+//   dec - (in) decoder instance from which the demuxer object is to be fetched.
+WEBP_NODISCARD WEBP_EXTERN const WebPDemuxer* WebPTileDecoderGetDemuxer(
+    const WebPTileDecoder* dec);
+
+// Deletes the WebPTileDecoder object.
+// Parameters:
+//   dec - (in/out) decoder instance to be deleted
+WEBP_EXTERN void WebPTileDecoderDelete(WebPTileDecoder* dec);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -22,7 +22,7 @@
 extern "C" {
 #endif
 
-#define WEBP_ENCODER_ABI_VERSION 0x0210  // MAJOR(8b) + MINOR(8b)
+#define WEBP_ENCODER_ABI_VERSION 0x0214  // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -34,6 +34,7 @@ typedef struct WebPConfig WebPConfig;
 typedef struct WebPPicture WebPPicture;  // main structure for I/O
 typedef struct WebPAuxStats WebPAuxStats;
 typedef struct WebPMemoryWriter WebPMemoryWriter;
+typedef struct WebPEncoderContext WebPEncoderContext;
 
 // Return the encoder's version number, packed in hexadecimal using 8bits for
 // each of major/minor/revision. E.g: v2.5.7 is 0x020507.
@@ -130,7 +131,9 @@ struct WebPConfig {
   int preprocessing;      // preprocessing filter:
                           // 0=none, 1=segment-smooth, 2=pseudo-random dithering
   int partitions;         // log2(number of token partitions) in [0..3]. Default
-                          // is set to 0 for easier progressive decoding.
+                          // is set to 0 for easier progressive decoding. More
+                          // partitions allow more rows to be decoded
+                          // concurrently with multi-threading.
   int partition_limit;    // quality degradation allowed to fit the 512k limit
                           // on prediction modes coding (0: no degradation,
                           // 100: maximum possible degradation).
@@ -139,6 +142,7 @@ struct WebPConfig {
                           // JPEG compression. Generally, the output size will
                           // be similar but the degradation will be lower.
   int thread_level;       // If non-zero, try and use multi-threaded encoding.
+                          // See also WebPPicture::num_threads.
   int low_memory;         // If set, reduce memory usage (but increase CPU use).
 
   int near_lossless;  // Near lossless encoding [0 = max loss .. 100 = off
@@ -241,6 +245,10 @@ struct WebPAuxStats {
 // Signature for output function. Should return true if writing was successful.
 // data/data_size is the segment of data to write, and 'picture' is for
 // reference (and so one can make use of picture->custom_ptr).
+// Note: the lossy bitstream is only emitted once all the macroblocks are coded,
+// since the chunk sizes, the partition sizes and the partition holding the
+// modes of all the macroblocks come first. WebPPicture::stream_output only
+// changes how it is emitted afterward.
 typedef int (*WebPWriterFunction)(const uint8_t* data, size_t data_size,
                                   const WebPPicture* picture);
 
@@ -360,9 +368,34 @@ struct WebPPicture {
 
   uint32_t pad3[3];  // padding for later use
 
+  // If not NULL and config->thread_level is non-zero, the multi-threaded work
+  // is done by this pool's threads (see WebPThreadPoolNew()).
+  WebPThreadPool* thread_pool;
+
   // Unused for now
-  uint8_t *pad4, *pad5;
-  uint32_t pad6[8];  // padding for later use
+  uint8_t* pad5;
+
+  // If true, the lossy pictures coded without the token buffer (that is, with
+  // config->method < 3 or config->low_memory) are coded twice: once to size
+  // the partitions, then again to pass the first token partition to 'writer'
+  // as the macroblock rows are coded, right after the headers. This lowers the
+  // peak memory, as the first token partition is never held whole (the only
+  // one with config->partitions = 0), at the cost of coding the picture twice.
+  // It doesn't lower the latency: nothing is written before the first pass
+  // is over. The output is the same. The other token partitions are still
+  // kept until the end. Ignored by lossless encoding, WebPRowEncoder and the
+  // token buffer path.
+  int stream_output;
+
+  // Number of threads, including the calling one, the encoding may use if
+  // config->thread_level is non-zero, in [0..64]. Values >= 2 also code the
+  // macroblock rows of lossy pictures, and search the transforms of lossless
+  // ones by bands, concurrently. The output may then differ slightly from the
+  // one of 0 or 1 but doesn't depend on the value. With 'thread_pool', at most
+  // its threads plus the calling one are used. 0 and 1 use a single extra
+  // thread per task, or the threads of 'thread_pool'.
+  int num_threads;
+  uint32_t pad6[6];  // padding for later use
 
   // PRIVATE FIELDS
   ////////////////////
@@ -559,6 +592,101 @@ WEBP_EXTERN void WebPBlendAlpha(WebPPicture* picture, uint32_t background_rgb);
 WEBP_NODISCARD WEBP_EXTERN int WebPEncode(const WebPConfig* config,
                                           WebPPicture* picture);
 
+//------------------------------------------------------------------------------
+// Encoder context
+//
+// A WebPEncoderContext keeps the largest scratch buffers of the encoder from
+// one call to WebPEncodeWithContext() to the next, instead of allocating and
+// releasing them for each picture: the lossy encoder's main memory block and,
+// for lossless, the hash chains, the backward references and the transform
+// buffers. This is useful to encode many pictures of similar dimensions with
+// the same configuration. At most 'max_retained_memory' bytes are kept between
+// two calls; the memory used during an encoding is not limited. A context can
+// only be used by one thread at a time.
+
+// Internal, version-checked, entry point
+WEBP_NODISCARD WEBP_EXTERN WebPEncoderContext* WebPEncoderContextNewInternal(
+    size_t, int);
+
+// Creates a new, empty, encoder context. Returns NULL in case of memory error
+// or version mismatch.
+WEBP_NODISCARD static WEBP_INLINE WebPEncoderContext* WebPEncoderContextNew(
+    size_t max_retained_memory) {
+  return WebPEncoderContextNewInternal(max_retained_memory,
+                                       WEBP_ENCODER_ABI_VERSION);
+}
+
+// Same as WebPEncode(), reusing the memory kept by 'context'.
+WEBP_NODISCARD WEBP_EXTERN int WebPEncodeWithContext(
+    WebPEncoderContext* context, const WebPConfig* config,
+    WebPPicture* picture);
+
+// Releases the memory of 'context'.
+WEBP_EXTERN void WebPEncoderContextDelete(WebPEncoderContext* context);
+
+//------------------------------------------------------------------------------
+// Row-by-row lossy encoding
+//
+// WebPRowEncoder encodes a lossy picture whose rows are supplied in order, a
+// few at a time, so that the whole picture never needs to be held in memory:
+// only a band of about one megapixel of samples is kept before being coded.
+// The segmentation and the entropy statistics are decided on the first band,
+// and the rows are coded with a single pass, as in 'low_memory' mode. The
+// compressed bitstream is kept in memory and passed to picture->writer by
+// WebPRowEncoderFinish().
+// 'config->lossless', 'config->target_size', 'config->target_PSNR' and
+// 'config->show_compressed' are not supported, and the RGB to YUV conversion
+// doesn't use sharp-YUV nor dithering. The output is always opaque.
+//
+// Typical usage:
+//
+//   WebPRowEncoder* enc = WebPRowEncoderNew(&config, &picture);
+//   if (enc == NULL) goto Error;   // picture.error_code tells why
+//   while (/* rows are available */) {
+//     if (!WebPRowEncoderAppendRGB(enc, rows, stride, num_rows)) goto Error;
+//   }
+//   if (!WebPRowEncoderFinish(enc)) goto Error;
+//   WebPRowEncoderDelete(enc);
+
+typedef struct WebPRowEncoder WebPRowEncoder;
+
+// Creates a row encoder for a picture of 'picture->width' x 'picture->height'.
+// The pixel buffers of 'picture' are not used: only its dimensions and its
+// writer, progress hook, 'thread_pool', 'num_threads', 'stats' and 'extra_info'
+// fields.
+// 'config' and 'picture' must stay valid until WebPRowEncoderDelete() is
+// called.
+// Returns NULL in case of error, with picture->error_code set accordingly.
+WEBP_NODISCARD WEBP_EXTERN WebPRowEncoder* WebPRowEncoderNew(
+    const WebPConfig* config, WebPPicture* picture);
+
+// Appends the next 'num_rows' rows of the picture, 'stride' bytes apart.
+// The 'X' byte of RGBX / BGRX samples is ignored. Returns false in case of
+// error, for instance if more rows than the picture's height are appended.
+WEBP_NODISCARD WEBP_EXTERN int WebPRowEncoderAppendRGB(WebPRowEncoder* enc,
+                                                       const uint8_t* rgb,
+                                                       int stride,
+                                                       int num_rows);
+WEBP_NODISCARD WEBP_EXTERN int WebPRowEncoderAppendRGBX(WebPRowEncoder* enc,
+                                                        const uint8_t* rgbx,
+                                                        int stride,
+                                                        int num_rows);
+WEBP_NODISCARD WEBP_EXTERN int WebPRowEncoderAppendBGR(WebPRowEncoder* enc,
+                                                       const uint8_t* bgr,
+                                                       int stride,
+                                                       int num_rows);
+WEBP_NODISCARD WEBP_EXTERN int WebPRowEncoderAppendBGRX(WebPRowEncoder* enc,
+                                                        const uint8_t* bgrx,
+                                                        int stride,
+                                                        int num_rows);
+
+// Codes the last rows and outputs the bitstream through picture->writer, once
+// all the rows have been appended. Returns false in case of error.
+WEBP_NODISCARD WEBP_EXTERN int WebPRowEncoderFinish(WebPRowEncoder* enc);
+
+// Releases the encoder, whether WebPRowEncoderFinish() was called or not.
+WEBP_EXTERN void WebPRowEncoderDelete(WebPRowEncoder* enc);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
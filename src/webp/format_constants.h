@@ -77,6 +77,7 @@ typedef enum {
 #define ANMF_CHUNK_SIZE 16   // Size of an ANMF chunk.
 #define ANIM_CHUNK_SIZE 6    // Size of an ANIM chunk.
 #define VP8X_CHUNK_SIZE 10   // Size of a VP8X chunk.
+#define TILE_CHUNK_SIZE 6    // Size of a TILE chunk.
 
 #define MAX_CANVAS_SIZE (1 << 24)      // 24-bit max for VP8X width/height.
 #define MAX_IMAGE_AREA (1ULL << 32)    // 32-bit max for width x height.
@@ -22,7 +22,7 @@
 extern "C" {
 #endif
 
-#define WEBP_MUX_ABI_VERSION 0x0109  // MAJOR(8b) + MINOR(8b)
+#define WEBP_MUX_ABI_VERSION 0x010a  // MAJOR(8b) + MINOR(8b)
 
 //------------------------------------------------------------------------------
 // Mux API
@@ -503,10 +503,16 @@ static WEBP_INLINE WebPAnimEncoder* WebPAnimEncoderNew(
 //                       "timestamp of next frame - timestamp of this frame".
 //                       Hence, timestamps should be in non-decreasing order.
 //   config - (in) encoding options; can be passed NULL to pick
-//            reasonable defaults.
+//            reasonable defaults. If config->thread_level is non-zero, the
+//            candidate encodings of the frame (lossy/lossless, dispose
+//            methods, keyframe or not) are run concurrently, unless
+//            frame->progress_hook is set. When a single candidate is tried,
+//            its encoding may also be deferred to be run along with the ones
+//            of the next frames. The output is the same.
 // Returns:
 //   On error, returns false and frame->error_code is set appropriately.
-//   Otherwise, returns true.
+//   Otherwise, returns true. The error of a deferred encoding is reported by
+//   a later call to this function or by WebPAnimEncoderAssemble().
 WEBP_NODISCARD WEBP_EXTERN int WebPAnimEncoderAdd(
     WebPAnimEncoder* enc, struct WebPPicture* frame, int timestamp_ms,
     const struct WebPConfig* config);
@@ -596,6 +602,89 @@ WEBP_EXTERN WebPMuxError WebPAnimEncoderGetChunk(const WebPAnimEncoder* enc,
 WEBP_EXTERN WebPMuxError WebPAnimEncoderDeleteChunk(WebPAnimEncoder* enc,
                                                     const char fourcc[4]);
 
+//------------------------------------------------------------------------------
+// WebPTileEncoder API
+//
+// This API allows encoding large images as a grid of independently coded
+// tiles, so that any rectangle can later be decoded without decoding the whole
+// image (see WebPTileDecoder in demux.h). The tiles are stored in raster order
+// as the frames of a non-looping animation, one ANMF chunk each, followed by a
+// "TILE" chunk holding the tile dimensions. Decoders unaware of the "TILE"
+// chunk display the tiles as an animation building up the full image.
+//
+// Code Example:
+/*
+  WebPTileEncoder* enc = WebPTileEncoderNew(width, height, 512, 512);
+  for (int y = 0; y < height; y += 512) {
+    for (int x = 0; x < width; x += 512) {
+      WebPPicture tile;
+      // ... (Fill 'tile' with the (at most) 512x512 pixels at 'x', 'y';
+      // ... e.g. with WebPPictureView() of a full picture).
+      WebPTileEncoderAdd(enc, x / 512, y / 512, &tile, &config);
+    }
+  }
+  WebPTileEncoderAssemble(enc, webp_data);
+  WebPTileEncoderDelete(enc);
+*/
+
+typedef struct WebPTileEncoder WebPTileEncoder;  // Main opaque object.
+
+// Internal, version-checked, entry point.
+WEBP_EXTERN WebPTileEncoder* WebPTileEncoderNewInternal(int, int, int, int,
+                                                        int);
+
+// Creates and initializes a WebPTileEncoder object.
+// Parameters:
+//   width/height - (in) canvas width and height of the image.
+//   tile_width/tile_height - (in) dimensions of the tiles, which must be even.
+//                                 The tiles of the last column and row are
+//                                 cropped to the canvas.
+// Returns:
+//   A pointer to the newly created WebPTileEncoder object.
+//   Or NULL in case of invalid dimensions or memory error.
+static WEBP_INLINE WebPTileEncoder* WebPTileEncoderNew(int width, int height,
+                                                       int tile_width,
+                                                       int tile_height) {
+  return WebPTileEncoderNewInternal(width, height, tile_width, tile_height,
+                                    WEBP_MUX_ABI_VERSION);
+}
+
+// Encodes the tile at column 'tile_x' and row 'tile_y' of the grid and adds it
+// to the WebPTileEncoder object, replacing any previous one. Only the encoded
+// data is kept, so the tiles can be read and added one by one.
+// Parameters:
+//   enc - (in/out) object to which the tile is to be added.
+//   tile_x/tile_y - (in) position of the tile in the grid.
+//   tile - (in/out) tile data in ARGB or YUV(A) format. Its dimensions must be
+//          the ones of the tile, cropped to the canvas.
+//   config - (in) encoding options; can be passed NULL to pick
+//            reasonable defaults.
+// Returns:
+//   On error, returns false and tile->error_code is set appropriately.
+//   Otherwise, returns true.
+WEBP_NODISCARD WEBP_EXTERN int WebPTileEncoderAdd(
+    WebPTileEncoder* enc, int tile_x, int tile_y, struct WebPPicture* tile,
+    const struct WebPConfig* config);
+
+// Assembles all the tiles into a WebP bitstream. All the tiles must have been
+// added.
+// Parameters:
+//   enc - (in/out) object from which the tiles are to be assembled.
+//   webp_data - (out) generated WebP bitstream, to be released with
+//               WebPDataClear().
+// Returns:
+//   WEBP_MUX_INVALID_ARGUMENT - if enc or webp_data is NULL, or if a tile is
+//                               missing.
+//   WEBP_MUX_MEMORY_ERROR - on memory allocation error.
+//   WEBP_MUX_OK - on success.
+WEBP_EXTERN WebPMuxError WebPTileEncoderAssemble(WebPTileEncoder* enc,
+                                                 WebPData* webp_data);
+
+// Deletes the WebPTileEncoder object.
+// Parameters:
+//   enc - (in/out) object to be deleted
+WEBP_EXTERN void WebPTileEncoderDelete(WebPTileEncoder* enc);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -95,6 +95,92 @@ WEBP_NODISCARD WEBP_EXTERN void* WebPMalloc(size_t size);
 // Releases memory returned by the WebPDecode*() functions (from decode.h).
 WEBP_EXTERN void WebPFree(void* ptr);
 
+// Custom memory allocation functions. 'opaque' is the pointer given to
+// WebPSetAllocator(). The allocation function must return memory aligned for
+// any type, or NULL upon error. The release function is never called with a
+// NULL 'ptr'.
+typedef void* (*WebPAllocFunc)(size_t size, void* opaque);
+typedef void (*WebPFreeFunc)(void* ptr, void* opaque);
+
+// Routes all the memory allocations of the library, including WebPMalloc()
+// and WebPFree(), through 'alloc_func' and 'free_func' instead of malloc()
+// and free(). Passing NULL for both restores the default.
+// The allocator is process-wide and unsynchronized: it is shared by all the
+// encoders, decoders and worker threads (WebPThreadPool's included), so the
+// functions must be thread-safe if the library is used by several threads, and
+// they can't give concurrent requests separate arenas or memory limits.
+// The allocator must be set before any other call to the library allocates
+// memory, and not concurrently with any other call to the library. Returns
+// false if the library has already allocated memory, or if only one of the
+// functions is NULL. This function is made available by the core 'libwebp'
+// library.
+WEBP_EXTERN int WebPSetAllocator(WebPAllocFunc alloc_func,
+                                 WebPFreeFunc free_func, void* opaque);
+
+// Opaque pool of persistent threads, which can be shared by any number of
+// encoders and decoders (see WebPPicture::thread_pool and
+// WebPDecoderConfigSetThreadPool()). Threads are created once by
+// WebPThreadPoolNew() and reused by every encode/decode the pool is attached
+// to, instead of being spawned and joined for each call.
+typedef struct WebPThreadPool WebPThreadPool;
+
+// Creates a pool of 'num_threads' threads. If 'num_threads' is less than or
+// equal to 0, the number of available CPU cores is used. Returns NULL upon
+// error. Without threading support, a valid pool with 0 threads is returned
+// and the work is done by the calling thread. This function is made available
+// by the core 'libwebp' library.
+WEBP_NODISCARD WEBP_EXTERN WebPThreadPool* WebPThreadPoolNew(int num_threads);
+
+// Returns the number of threads in the pool (0 if 'pool' is NULL).
+WEBP_EXTERN int WebPThreadPoolGetNumThreads(const WebPThreadPool* pool);
+
+// Stops the threads and releases the pool. No encoder or decoder may be
+// using the pool when this function is called.
+WEBP_EXTERN void WebPThreadPoolDelete(WebPThreadPool* pool);
+
+// SIMD levels of the optimized (dsp) functions, by increasing order. On
+// architectures other than x86, any level above WEBP_SIMD_NONE enables their
+// own SIMD code (NEON, MSA, ...), except where it is required by the build.
+typedef enum WebPSimdLevel {
+  WEBP_SIMD_NONE = 0,  // plain C
+  WEBP_SIMD_SSE2,
+  WEBP_SIMD_SSE4_1,
+  WEBP_SIMD_AVX2,
+  WEBP_SIMD_AVX512
+} WebPSimdLevel;
+
+// Restricts the optimized functions used by the encoders and decoders to
+// 'max_level' or below, which is useful to compare implementations or to
+// avoid the frequency throttling of wide instructions on some hosts. The
+// functions are re-selected the next time an encoder or decoder is set up, so
+// this must not be called while encoding or decoding. The initial limit can
+// also be set with the WEBP_MAX_SIMD environment variable, to one of "none",
+// "sse2", "sse4.1", "avx2" or "avx512". Returns false if 'max_level' is
+// invalid. This function is made available by the core 'libwebp' library.
+WEBP_EXTERN int WebPSetMaxSimdLevel(WebPSimdLevel max_level);
+
+// Returns the highest SIMD level the optimized functions may use, taking into
+// account the CPU, the build and the limit set by WebPSetMaxSimdLevel() or
+// WEBP_MAX_SIMD. This is a limit for all the functions, see
+// WebPGetDspGroupSimdLevel() for the implementations actually bound. This
+// function is made available by the core 'libwebp' library.
+WEBP_EXTERN WebPSimdLevel WebPGetSimdLevel(void);
+
+// The optimized functions are set up by groups, each by its own init function.
+// Returns the name of the init function of the group 'index' (for instance
+// "VP8DspInit" for the lossy decoding functions), or NULL if 'index' is not
+// lower than the number of groups. This function is made available by the core
+// 'libwebp' library.
+WEBP_EXTERN const char* WebPGetDspGroupName(int index);
+
+// Returns the highest SIMD level (a WebPSimdLevel) of the implementations bound
+// to the functions of the group 'index' the last time it was set up, or -1 if
+// it has not been set up yet or 'index' is invalid. The functions of the group
+// that have no version at that level use the best one at a lower level. On
+// other architectures than x86, WEBP_SIMD_SSE2 means that their own SIMD code
+// is used. This function is made available by the core 'libwebp' library.
+WEBP_EXTERN int WebPGetDspGroupSimdLevel(int index);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
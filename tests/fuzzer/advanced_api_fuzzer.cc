@@ -17,9 +17,12 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <iostream>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "./fuzz_utils.h"
 #include "gtest/gtest.h"
@@ -29,6 +32,204 @@
 
 namespace {
 
+int GetBytesPerPixel(WEBP_CSP_MODE mode) {
+  switch (mode) {
+    case MODE_RGB:
+    case MODE_BGR:
+      return 3;
+    case MODE_RGBA_4444:
+    case MODE_RGB_565:
+    case MODE_rgbA_4444:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+// Samples of a decoded picture, plane by plane, without the stride padding.
+struct Samples {
+  std::vector<uint8_t> planes[4];  // RGBA, or Y, U, V and A
+
+  void AppendRows(int plane, const uint8_t* rows, int stride, int width,
+                  int num_rows) {
+    for (int y = 0; y < num_rows; ++y) {
+      const uint8_t* const row = rows + (ptrdiff_t)y * stride;
+      planes[plane].insert(planes[plane].end(), row, row + width);
+    }
+  }
+
+  // Appends the 'num_rows' rows described by 'buffer', starting at row 'y'.
+  void Append(const WebPDecBuffer& buffer, int y, int num_rows) {
+    const int width = buffer.width;
+    if (WebPIsRGBMode(buffer.colorspace)) {
+      const WebPRGBABuffer& rgba = buffer.u.RGBA;
+      AppendRows(0, rgba.rgba, rgba.stride,
+                 width * GetBytesPerPixel(buffer.colorspace), num_rows);
+    } else {
+      const WebPYUVABuffer& yuva = buffer.u.YUVA;
+      // The chroma rows of the luma rows [y, y + num_rows), 'y' being even.
+      const int uv_rows = (y + num_rows + 1) / 2 - y / 2;
+      AppendRows(0, yuva.y, yuva.y_stride, width, num_rows);
+      AppendRows(1, yuva.u, yuva.u_stride, (width + 1) / 2, uv_rows);
+      AppendRows(2, yuva.v, yuva.v_stride, (width + 1) / 2, uv_rows);
+      if (yuva.a != nullptr) AppendRows(3, yuva.a, yuva.a_stride, width, num_rows);
+    }
+  }
+
+  bool operator==(const Samples& other) const {
+    return std::equal(planes, planes + 4, other.planes);
+  }
+};
+
+Samples GetSamples(const WebPDecBuffer& buffer) {
+  Samples samples;
+  samples.Append(buffer, 0, buffer.height);
+  return samples;
+}
+
+struct RowSinkOutput {
+  Samples samples;
+  int next_y = 0;
+  int num_calls_left = -1;  // number of calls before aborting, if positive
+};
+
+int RowSink(const WebPDecBuffer* rows, int y, int num_rows, void* user_data) {
+  RowSinkOutput* const output = static_cast<RowSinkOutput*>(user_data);
+  if (y != output->next_y || num_rows <= 0 || rows->height != num_rows ||
+      (!WebPIsRGBMode(rows->colorspace) && (y & 1))) {
+    std::cerr << "Unexpected rows " << y << " + " << num_rows << "\n";
+    std::abort();
+  }
+  if (output->num_calls_left == 0) return 0;
+  if (output->num_calls_left > 0) --output->num_calls_left;
+  output->samples.Append(*rows, y, num_rows);
+  output->next_y = y + num_rows;
+  return 1;
+}
+
+// Returns a copy of 'config' with an empty output buffer.
+WebPDecoderConfig GetVariantConfig(const WebPDecoderConfig& config) {
+  WebPDecoderConfig variant = config;
+  if (!WebPInitDecBuffer(&variant.output)) std::abort();
+  variant.output.colorspace = config.output.colorspace;
+  return variant;
+}
+
+void CheckSameOutput(const char* const variant, VP8StatusCode status,
+                     const Samples& samples, const Samples& expected) {
+  if (status != VP8_STATUS_OK || !(samples == expected)) {
+    std::cerr << variant << " differs from WebPDecode(). Status: " << status
+              << "\n";
+    std::abort();
+  }
+}
+
+// Decodes with 'mem_size' bytes of arena, starting at the worst alignment and
+// followed by some bytes that must not be modified.
+VP8StatusCode DecodeInArena(const uint8_t* const data, size_t size,
+                            const WebPDecoderConfig& config, size_t mem_size,
+                            Samples* const samples) {
+  constexpr size_t kAlign = 32;  // the alignment of the arena's buffers
+  constexpr uint8_t kGuard = 0xa5;
+  std::vector<uint8_t> memory(mem_size + 2 * kAlign, kGuard);
+  const size_t offset =
+      (kAlign + 1 - reinterpret_cast<uintptr_t>(memory.data()) % kAlign) %
+      kAlign;
+  WebPDecoderConfig variant = GetVariantConfig(config);
+  const VP8StatusCode status =
+      WebPDecodeInArena(data, size, &variant, memory.data() + offset, mem_size);
+  if (status == VP8_STATUS_OK) *samples = GetSamples(variant.output);
+  WebPFreeDecBuffer(&variant.output);
+  if (std::any_of(memory.begin(), memory.begin() + offset,
+                  [](uint8_t v) { return v != kGuard; }) ||
+      std::any_of(memory.begin() + offset + mem_size, memory.end(),
+                  [](uint8_t v) { return v != kGuard; })) {
+    std::cerr << "WebPDecodeInArena() wrote out of its arena.\n";
+    std::abort();
+  }
+  return status;
+}
+
+// Checks that the other decoding functions match WebPDecode() with 'config',
+// whose output is 'expected'.
+void CheckDecodeVariants(const uint8_t* const data, size_t size,
+                         const WebPDecoderConfig& config,
+                         const Samples& expected) {
+  // Decoder context, used twice.
+  WebPDecoderContext* const context = WebPDecoderContextNew();
+  if (context == nullptr) return;
+  for (int i = 0; i < 2; ++i) {
+    WebPDecoderConfig variant = GetVariantConfig(config);
+    const VP8StatusCode status =
+        WebPDecodeWithContext(context, data, size, &variant);
+    if (status != VP8_STATUS_OUT_OF_MEMORY) {
+      CheckSameOutput("WebPDecodeWithContext()", status,
+                      GetSamples(variant.output), expected);
+    }
+    WebPFreeDecBuffer(&variant.output);
+  }
+  WebPDecoderContextDelete(context);
+
+  // Arena, of the measured size and, if exact, one byte too small.
+  size_t arena_size;
+  if (WebPGetDecodeArenaSize(data, size, &config, &arena_size) ==
+      VP8_STATUS_OK) {
+    Samples samples;
+    const VP8StatusCode status =
+        DecodeInArena(data, size, config, arena_size, &samples);
+    if (status != VP8_STATUS_OUT_OF_MEMORY) {
+      CheckSameOutput("WebPDecodeInArena()", status, samples, expected);
+    }
+    // Only lossy pictures without alpha are measured exactly.
+    const bool is_exact = (config.input.format == 1 && !config.input.has_alpha);
+    if (is_exact && arena_size > 0 &&
+        DecodeInArena(data, size, config, arena_size - 1, &samples) !=
+            VP8_STATUS_OUT_OF_MEMORY) {
+      std::cerr << "WebPDecodeInArena() fit in a smaller arena.\n";
+      std::abort();
+    }
+  }
+
+  // Row sink, which is not supported for all the options.
+  if (config.options.flip ||
+      (config.options.use_scaling && !WebPIsRGBMode(config.output.colorspace))) {
+    return;
+  }
+  RowSinkOutput sink_output;
+  WebPDecoderConfig variant = GetVariantConfig(config);
+  variant.output.row_sink = RowSink;
+  variant.output.row_sink_data = &sink_output;
+  VP8StatusCode status = WebPDecode(data, size, &variant);
+  WebPFreeDecBuffer(&variant.output);
+  if (status == VP8_STATUS_OUT_OF_MEMORY) return;
+  CheckSameOutput("WebPDecBuffer::row_sink", status, sink_output.samples,
+                  expected);
+  if (sink_output.next_y != config.output.height) {
+    std::cerr << "The row sink didn't get all the rows.\n";
+    std::abort();
+  }
+
+  // Row sink aborting after some calls.
+  RowSinkOutput aborting_output;
+  aborting_output.num_calls_left = (int)(size % 3);
+  variant = GetVariantConfig(config);
+  variant.output.row_sink = RowSink;
+  variant.output.row_sink_data = &aborting_output;
+  status = WebPDecode(data, size, &variant);
+  WebPFreeDecBuffer(&variant.output);
+  if (status != VP8_STATUS_USER_ABORT && status != VP8_STATUS_OK &&
+      status != VP8_STATUS_OUT_OF_MEMORY) {
+    std::cerr << "Unexpected status with an aborting sink: " << status
+              << "\n";
+    std::abort();
+  }
+  if (status == VP8_STATUS_OK &&
+      aborting_output.next_y != config.output.height) {
+    std::cerr << "The aborting row sink was ignored.\n";
+    std::abort();
+  }
+}
+
 void AdvancedApiTest(std::string_view blob, uint8_t factor_u8, int colorspace,
                      bool incremental,
                      const fuzz_utils::WebPDecoderOptionsCpp& decoder_options) {
@@ -70,6 +271,8 @@ void AdvancedApiTest(std::string_view blob, uint8_t factor_u8, int colorspace,
       const int data_offset = 50;
       if (data_offset + sizeof(config.options) >= size) break;
       memcpy(&config.options, data + data_offset, sizeof(config.options));
+      // The padding holds the thread pool.
+      (void)WebPDecoderConfigSetThreadPool(&config, NULL);
 
       // Skip easily avoidable out-of-memory fuzzing errors.
       if (config.options.use_scaling) {
@@ -140,8 +343,8 @@ void AdvancedApiTest(std::string_view blob, uint8_t factor_u8, int colorspace,
         }
       }
       WebPIDelete(idec);
-    } else {
-      (void)WebPDecode(data, size, &config);
+    } else if (WebPDecode(data, size, &config) == VP8_STATUS_OK) {
+      CheckDecodeVariants(data, size, config, GetSamples(config.output));
     }
 
     WebPFreeDecBuffer(&config.output);
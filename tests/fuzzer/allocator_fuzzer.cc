@@ -0,0 +1,115 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// WebPSetAllocator() can only be called before the first allocation of the
+// library, so it gets its own binary and is set before any test runs.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#include "./fuzz_utils.h"
+#include "gtest/gtest.h"
+#include "webp/decode.h"
+#include "webp/encode.h"
+#include "webp/types.h"
+
+namespace {
+
+int opaque_tag;
+std::atomic<size_t> num_allocs{0};
+std::atomic<size_t> num_frees{0};
+
+void* CountingAlloc(size_t size, void* opaque) {
+  if (opaque != &opaque_tag) abort();
+  void* const ptr = malloc(size);
+  if (ptr != NULL) ++num_allocs;
+  return ptr;
+}
+
+void CountingFree(void* ptr, void* opaque) {
+  if (opaque != &opaque_tag || ptr == NULL) abort();
+  ++num_frees;
+  free(ptr);
+}
+
+// Set before main(), hence before the library allocates anything.
+const bool kAllocatorIsSet =
+    WebPSetAllocator(CountingAlloc, CountingFree, &opaque_tag) != 0;
+
+size_t NumLiveBlocks() { return num_allocs - num_frees; }
+
+void AllocatorTest(std::string_view data_in) {
+  ASSERT_TRUE(kAllocatorIsSet);
+  const uint8_t* const data = reinterpret_cast<const uint8_t*>(data_in.data());
+  const size_t size = data_in.size();
+  int w, h;
+  if (!WebPGetInfo(data, size, &w, &h)) return;
+  if ((size_t)w * h > fuzz_utils::kFuzzPxLimit) return;
+
+  const size_t num_live_blocks = NumLiveBlocks();
+  const size_t num_allocs_before = num_allocs;
+  uint8_t* const rgba = WebPDecodeRGBA(data, size, &w, &h);
+  // Whether the decoding succeeds or not, all its memory went through the
+  // custom functions and was released, except for the returned buffer.
+  if (rgba != NULL) EXPECT_GT(num_allocs, num_allocs_before);
+  EXPECT_EQ(NumLiveBlocks(), num_live_blocks + (rgba != NULL ? 1 : 0));
+  // The allocator can't be swapped while blocks are live.
+  EXPECT_FALSE(WebPSetAllocator(NULL, NULL, NULL));
+  WebPFree(rgba);
+  EXPECT_EQ(NumLiveBlocks(), num_live_blocks);
+}
+
+}  // namespace
+
+FUZZ_TEST(Allocator, AllocatorTest)
+    .WithDomains(fuzztest::String().WithMaxSize(fuzz_utils::kMaxWebPFileSize +
+                                                1));
+
+TEST(Allocator, SwapIsRefused) {
+  ASSERT_TRUE(kAllocatorIsSet);
+  const int width = 16, height = 8;
+  uint8_t rgba[width * height * 4];
+  for (int i = 0; i < width * height * 4; ++i) rgba[i] = (uint8_t)(i * 7);
+
+  const size_t num_live_blocks = NumLiveBlocks();
+  const size_t num_allocs_before = num_allocs;
+  uint8_t* output = NULL;
+  const size_t output_size =
+      WebPEncodeLosslessRGBA(rgba, width, height, width * 4, &output);
+  ASSERT_GT(output_size, 0u);
+  EXPECT_GT(num_allocs, num_allocs_before);
+  // Only the encoded output is still live.
+  EXPECT_EQ(NumLiveBlocks(), num_live_blocks + 1);
+
+  // Swapping the allocator with a live block, be it to the default or to
+  // another custom one, is refused.
+  EXPECT_FALSE(WebPSetAllocator(NULL, NULL, NULL));
+  EXPECT_FALSE(WebPSetAllocator(CountingAlloc, CountingFree, &opaque_tag));
+  // The live block is released by the function that allocated it.
+  const size_t num_frees_before = num_frees;
+  WebPFree(output);
+  EXPECT_EQ(num_frees, num_frees_before + 1);
+  EXPECT_EQ(NumLiveBlocks(), num_live_blocks);
+
+  // Once the library allocated memory, the allocator stays fixed.
+  EXPECT_FALSE(WebPSetAllocator(NULL, NULL, NULL));
+  // Only one NULL function is always refused.
+  EXPECT_FALSE(WebPSetAllocator(CountingAlloc, NULL, NULL));
+  EXPECT_FALSE(WebPSetAllocator(NULL, CountingFree, NULL));
+}
@@ -16,8 +16,12 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 #include "./fuzz_utils.h"
 #include "gtest/gtest.h"
@@ -27,8 +31,38 @@
 
 namespace {
 
+// Decodes the frames of 'webp_data' with 'dec_options' and stores their canvas
+// and timestamp in 'frames'. The decoder switches to 'thread_pool' after the
+// first frame if it is not NULL. Returns false if the decoder can't be created.
+bool DecodeFrames(const WebPData& webp_data,
+                  const WebPAnimDecoderOptions& dec_options,
+                  WebPThreadPool* const thread_pool,
+                  std::vector<std::pair<std::vector<uint8_t>, int>>* frames) {
+  WebPAnimDecoder* dec = WebPAnimDecoderNew(&webp_data, &dec_options);
+  if (!dec) return false;
+  WebPAnimInfo info;
+  if (!WebPAnimDecoderGetInfo(dec, &info)) std::abort();
+  const size_t canvas_size = (size_t)info.canvas_width * info.canvas_height * 4;
+
+  for (int i = 0; i < fuzz_utils::kFuzzFrameLimit; i++) {
+    uint8_t* buf;
+    int timestamp;
+    if (i == 1 && thread_pool != nullptr &&
+        !WebPAnimDecoderSetThreadPool(dec, thread_pool)) {
+      break;
+    }
+    if (!WebPAnimDecoderGetNext(dec, &buf, &timestamp)) break;
+    frames->emplace_back(std::vector<uint8_t>(buf, buf + canvas_size),
+                         timestamp);
+  }
+
+  WebPAnimDecoderDelete(dec);
+  return true;
+}
+
 void AnimationApiTest(std::string_view blob, bool use_threads,
-                      WEBP_CSP_MODE color_mode) {
+                      WEBP_CSP_MODE color_mode, int prefetch_frames,
+                      uint32_t prefetch_memory_limit, int num_pool_threads) {
   const size_t size = blob.size();
   WebPData webp_data;
   WebPDataInit(&webp_data);
@@ -69,16 +103,29 @@ void AnimationApiTest(std::string_view blob, bool use_threads,
   dec_options.use_threads = use_threads;
   dec_options.color_mode = color_mode;
 
-  WebPAnimDecoder* dec = WebPAnimDecoderNew(&webp_data, &dec_options);
-  if (!dec) return;
-
-  for (int i = 0; i < fuzz_utils::kFuzzFrameLimit; i++) {
-    uint8_t* buf;
-    int timestamp;
-    if (!WebPAnimDecoderGetNext(dec, &buf, &timestamp)) break;
+  std::vector<std::pair<std::vector<uint8_t>, int>> frames;
+  if (!DecodeFrames(webp_data, dec_options, /*thread_pool=*/nullptr,
+                    &frames)) {
+    return;
   }
 
-  WebPAnimDecoderDelete(dec);
+  // The frames decoded ahead must be the ones decoded in turn.
+  if (prefetch_frames == 0) return;
+  dec_options.prefetch_frames = prefetch_frames;
+  dec_options.prefetch_memory_limit = prefetch_memory_limit;
+  WebPThreadPool* const thread_pool =
+      (num_pool_threads > 0) ? WebPThreadPoolNew(num_pool_threads) : nullptr;
+  std::vector<std::pair<std::vector<uint8_t>, int>> prefetched_frames;
+  const bool ok =
+      DecodeFrames(webp_data, dec_options, thread_pool, &prefetched_frames);
+  WebPThreadPoolDelete(thread_pool);
+  // Tolerate failures when running under the nallocfuzz engine as the frames
+  // decoded ahead need more memory.
+  if (ok && prefetched_frames != frames &&
+      getenv("NALLOC_FUZZ_VERSION") == nullptr) {
+    fprintf(stderr, "The prefetched frames differ.\n");
+    std::abort();
+  }
 }
 
 }  // namespace
@@ -89,7 +136,11 @@ FUZZ_TEST(AnimationApi, AnimationApiTest)
                  /*use_threads=*/fuzztest::Arbitrary<bool>(),
                  // Animations only support 4 (out of 12) modes.
                  fuzztest::ElementOf<WEBP_CSP_MODE>({MODE_RGBA, MODE_BGRA,
-                                                     MODE_rgbA, MODE_bgrA}));
+                                                     MODE_rgbA, MODE_bgrA}),
+                 /*prefetch_frames=*/fuzztest::InRange<int>(0, 4),
+                 /*prefetch_memory_limit=*/
+                 fuzztest::ElementOf<uint32_t>({0, 1, 1 << 12, 1 << 20}),
+                 /*num_pool_threads=*/fuzztest::InRange<int>(0, 2));
 
 TEST(AnimationApi, Buganizer498965803) {
   AnimationApiTest(
@@ -100,5 +151,6 @@ TEST(AnimationApi, Buganizer498965803) {
                   "\311\311\311\311\311\311\311\311\311\311\311\311\311\311\211"
                   "\311\311\311\311\311\030\030\030\030\030\030\311\311",
                   98),
-      false, static_cast<WEBP_CSP_MODE>(1));
+      false, static_cast<WEBP_CSP_MODE>(1), /*prefetch_frames=*/0,
+      /*prefetch_memory_limit=*/0, /*num_pool_threads=*/0);
 }
@@ -17,6 +17,7 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <utility>
 #include <vector>
 
@@ -50,9 +51,17 @@ auto ArbitraryKMinKMax() {
       fuzztest::InRange(0, 15));
 }
 
+// Reports the progress, which keeps the frame candidates encoded serially.
+int ProgressHook(int percent, const WebPPicture* picture) {
+  (void)percent;
+  (void)picture;
+  return 1;
+}
+
 int AddFrame(WebPAnimEncoder** const enc,
              const WebPAnimEncoderOptions& anim_config, int* const width,
-             int* const height, int timestamp_ms, FrameConfig& frame_config,
+             int* const height, int timestamp_ms,
+             const FrameConfig& frame_config, WebPPicture& pic,
              uint32_t* const bit_pos) {
   if (enc == nullptr || width == nullptr || height == nullptr) {
     fprintf(stderr, "NULL parameters.\n");
@@ -60,9 +69,6 @@ int AddFrame(WebPAnimEncoder** const enc,
     std::abort();
   }
 
-  // Init the source picture.
-  WebPPicture& pic = frame_config.pic_cpp.ref();
-
   // Crop and scale.
   if (*enc == nullptr) {  // First frame will set canvas width and height.
     if (!fuzz_utils::CropOrScale(&pic, frame_config.crop_or_scale_params)) {
@@ -123,33 +129,34 @@ int AddFrame(WebPAnimEncoder** const enc,
   return 1;
 }
 
-void AnimEncoderTest(bool minimize_size, std::pair<int, int> kmin_kmax,
-                     bool allow_mixed, std::vector<FrameConfig> frame_configs,
-                     int optimization_index) {
+// Encodes the frames into 'webp_data'. The frames whose config enables
+// multi-threading use 'num_threads' and 'thread_pool', and their candidates
+// are encoded serially if 'serial' is true. Returns false in case of tolerated
+// failure.
+bool EncodeAnimation(const WebPAnimEncoderOptions& anim_config,
+                     const std::vector<FrameConfig>& frame_configs,
+                     int num_threads, WebPThreadPool* const thread_pool,
+                     bool serial, WebPData* const webp_data) {
   WebPAnimEncoder* enc = nullptr;
   int width = 0, height = 0, timestamp_ms = 0;
   uint32_t bit_pos = 0;
 
-  fuzz_utils::SetOptimization(default_VP8GetCPUInfo, optimization_index);
-
-  // Extract a configuration from the packed bits.
-  WebPAnimEncoderOptions anim_config;
-  if (!WebPAnimEncoderOptionsInit(&anim_config)) {
-    fprintf(stderr, "WebPAnimEncoderOptionsInit failed.\n");
-    std::abort();
-  }
-  anim_config.minimize_size = minimize_size;
-  anim_config.kmin = kmin_kmax.first;
-  anim_config.kmax = kmin_kmax.second;
-  anim_config.allow_mixed = allow_mixed;
-  anim_config.verbose = 0;
-
   // For each frame.
-  for (FrameConfig& frame_config : frame_configs) {
-    if (!AddFrame(&enc, anim_config, &width, &height, timestamp_ms,
-                  frame_config, &bit_pos)) {
-      return;
+  for (const FrameConfig& frame_config : frame_configs) {
+    // Work on a copy of the source picture, which is modified.
+    WebPPicture pic;
+    if (!WebPPictureInit(&pic)) std::abort();
+    if (!WebPPictureCopy(&frame_config.pic_cpp.ref(), &pic)) {
+      WebPAnimEncoderDelete(enc);
+      return false;
     }
+    pic.num_threads = num_threads;
+    pic.thread_pool = thread_pool;
+    if (serial) pic.progress_hook = ProgressHook;
+    const int ok = AddFrame(&enc, anim_config, &width, &height, timestamp_ms,
+                            frame_config, pic, &bit_pos);
+    WebPPictureFree(&pic);
+    if (!ok) return false;
 
     timestamp_ms += frame_config.timestamp;
   }
@@ -161,20 +168,67 @@ void AnimEncoderTest(bool minimize_size, std::pair<int, int> kmin_kmax,
     WebPAnimEncoderDelete(enc);
     std::abort();
   }
-  WebPData webp_data;
-  WebPDataInit(&webp_data);
+  WebPDataInit(webp_data);
   // Tolerate failures when running under the nallocfuzz engine as allocations
   // during assembly may fail.
-  if (!WebPAnimEncoderAssemble(enc, &webp_data) &&
-      getenv("NALLOC_FUZZ_VERSION") == nullptr) {
-    fprintf(stderr, "WebPAnimEncoderAssemble failed: %s.\n",
-            WebPAnimEncoderGetError(enc));
+  if (!WebPAnimEncoderAssemble(enc, webp_data)) {
+    if (getenv("NALLOC_FUZZ_VERSION") == nullptr) {
+      fprintf(stderr, "WebPAnimEncoderAssemble failed: %s.\n",
+              WebPAnimEncoderGetError(enc));
+      WebPAnimEncoderDelete(enc);
+      WebPDataClear(webp_data);
+      std::abort();
+    }
     WebPAnimEncoderDelete(enc);
-    WebPDataClear(&webp_data);
-    std::abort();
+    WebPDataClear(webp_data);
+    return false;
   }
 
   WebPAnimEncoderDelete(enc);
+  return true;
+}
+
+void AnimEncoderTest(bool minimize_size, std::pair<int, int> kmin_kmax,
+                     bool allow_mixed, std::vector<FrameConfig> frame_configs,
+                     int optimization_index, int num_threads,
+                     int num_pool_threads) {
+  fuzz_utils::SetOptimization(default_VP8GetCPUInfo, optimization_index);
+
+  // Extract a configuration from the packed bits.
+  WebPAnimEncoderOptions anim_config;
+  if (!WebPAnimEncoderOptionsInit(&anim_config)) {
+    fprintf(stderr, "WebPAnimEncoderOptionsInit failed.\n");
+    std::abort();
+  }
+  anim_config.minimize_size = minimize_size;
+  anim_config.kmin = kmin_kmax.first;
+  anim_config.kmax = kmin_kmax.second;
+  anim_config.allow_mixed = allow_mixed;
+  anim_config.verbose = 0;
+
+  WebPThreadPool* const thread_pool =
+      (num_pool_threads > 0) ? WebPThreadPoolNew(num_pool_threads) : nullptr;
+  WebPData webp_data;
+  const bool ok = EncodeAnimation(anim_config, frame_configs, num_threads,
+                                  thread_pool, /*serial=*/false, &webp_data);
+  WebPThreadPoolDelete(thread_pool);
+  if (!ok) return;
+
+  // The frame candidates encoded concurrently must give the serial output.
+  WebPData serial_data;
+  if (EncodeAnimation(anim_config, frame_configs, num_threads,
+                      /*thread_pool=*/nullptr, /*serial=*/true,
+                      &serial_data)) {
+    const bool same = (serial_data.size == webp_data.size &&
+                       memcmp(serial_data.bytes, webp_data.bytes,
+                              webp_data.size) == 0);
+    WebPDataClear(&serial_data);
+    if (!same) {
+      fprintf(stderr, "The threaded output differs from the serial one.\n");
+      WebPDataClear(&webp_data);
+      std::abort();
+    }
+  }
   WebPDataClear(&webp_data);
 }
 
@@ -193,7 +247,9 @@ FUZZ_TEST(AnimIndexEncoder, AnimEncoderTest)
             .WithMinSize(1)
             .WithMaxSize(15),
         /*optimization_index=*/
-        fuzztest::InRange<uint32_t>(0, fuzz_utils::kMaxOptimizationIndex));
+        fuzztest::InRange<uint32_t>(0, fuzz_utils::kMaxOptimizationIndex),
+        /*num_threads=*/fuzztest::InRange<int>(0, 3),
+        /*num_pool_threads=*/fuzztest::InRange<int>(0, 2));
 
 FUZZ_TEST(AnimArbitraryEncoder, AnimEncoderTest)
     .WithDomains(
@@ -208,7 +264,9 @@ FUZZ_TEST(AnimArbitraryEncoder, AnimEncoderTest)
             .WithMinSize(1)
             .WithMaxSize(15),
         /*optimization_index=*/
-        fuzztest::InRange<uint32_t>(0, fuzz_utils::kMaxOptimizationIndex));
+        fuzztest::InRange<uint32_t>(0, fuzz_utils::kMaxOptimizationIndex),
+        /*num_threads=*/fuzztest::InRange<int>(0, 3),
+        /*num_pool_threads=*/fuzztest::InRange<int>(0, 2));
 
 TEST(AnimIndexEncoder, Buganizer498967191) {
   auto GetWebPPicture = [](int index,
@@ -242,5 +300,5 @@ TEST(AnimIndexEncoder, Buganizer498967191) {
                               100},
                    fuzz_utils::CropOrScaleParams{true, true, 6, 8, 2, 1},
                    GetWebPPicture(0, true)}},
-      1);
+      1, /*num_threads=*/0, /*num_pool_threads=*/0);
 }
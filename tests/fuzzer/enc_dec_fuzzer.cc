@@ -20,12 +20,15 @@
 #include <cstdlib>
 #include <cstring>
 #include <memory>
+#include <vector>
 
 #include "./fuzz_utils.h"
+#include "gtest/gtest.h"
 #include "src/dsp/cpu.h"
 #include "src/utils/rescaler_utils.h"
 #include "webp/decode.h"
 #include "webp/encode.h"
+#include "webp/types.h"
 
 namespace {
 
@@ -216,6 +219,142 @@ void EncDecTest(bool use_argb, fuzz_utils::WebPPictureCpp pic_cpp,
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Decodes the encoding of 'pic' with and without threads, and checks that the
+// samples are the same. The lossy threads decode the rows of different token
+// partitions concurrently, the lossless ones transform and output the rows of
+// consecutive batches concurrently.
+void EncDecThreadsTest(
+    fuzz_utils::WebPPictureCpp pic_cpp, WebPConfig config,
+    const fuzz_utils::CropOrScaleParams& crop_or_scale_params,
+    const fuzz_utils::WebPDecoderOptionsCpp& decoder_options,
+    int num_pool_threads) {
+  WebPPicture& pic = pic_cpp.ref();
+  WebPMemoryWriter memory_writer;
+  WebPMemoryWriterInit(&memory_writer);
+  std::unique_ptr<WebPMemoryWriter, fuzz_utils::UniquePtrDeleter>
+      memory_writer_owner(&memory_writer);
+
+  Enc(crop_or_scale_params, config, pic, memory_writer);
+  if (memory_writer.size == 0) return;
+  if (static_cast<int64_t>(decoder_options.crop_left) +
+              decoder_options.crop_width >
+          static_cast<int64_t>(pic.width) ||
+      static_cast<int64_t>(decoder_options.crop_top) +
+              decoder_options.crop_height >
+          static_cast<int64_t>(pic.height)) {
+    return;
+  }
+
+  WebPThreadPool* const thread_pool =
+      (num_pool_threads > 0) ? WebPThreadPoolNew(num_pool_threads) : nullptr;
+  WebPDecoderConfig dec_configs[2];
+  VP8StatusCode status[2];
+  for (int i = 0; i < 2; ++i) {
+    WebPDecoderConfig& dec_config = dec_configs[i];
+    if (!WebPInitDecoderConfig(&dec_config)) {
+      fprintf(stderr, "WebPInitDecoderConfig failed.\n");
+      std::abort();
+    }
+    dec_config.output.colorspace = MODE_RGBA;
+    std::memcpy(&dec_config.options, &decoder_options,
+                sizeof(decoder_options));
+    dec_config.options.use_threads = i;
+    if (!WebPDecoderConfigSetThreadPool(&dec_config,
+                                        (i == 1) ? thread_pool : nullptr)) {
+      std::abort();
+    }
+    status[i] = WebPDecode(memory_writer.mem, memory_writer.size, &dec_config);
+  }
+  WebPThreadPoolDelete(thread_pool);
+
+  if (status[0] == VP8_STATUS_OK && status[1] == VP8_STATUS_OK) {
+    const WebPDecBuffer& out0 = dec_configs[0].output;
+    const WebPDecBuffer& out1 = dec_configs[1].output;
+    if (out0.width != out1.width || out0.height != out1.height) {
+      fprintf(stderr, "The threaded decoding has different dimensions.\n");
+      std::abort();
+    }
+    for (int y = 0; y < out0.height; ++y) {
+      if (std::memcmp(out0.u.RGBA.rgba + (size_t)y * out0.u.RGBA.stride,
+                      out1.u.RGBA.rgba + (size_t)y * out1.u.RGBA.stride,
+                      (size_t)out0.width * 4) != 0) {
+        fprintf(stderr, "The threaded decoding differs at row %d.\n", y);
+        std::abort();
+      }
+    }
+  } else if (status[0] != status[1] && status[0] != VP8_STATUS_OUT_OF_MEMORY &&
+             status[1] != VP8_STATUS_OUT_OF_MEMORY) {
+    fprintf(stderr, "WebPDecode statuses differ: %d vs %d.\n", status[0],
+            status[1]);
+    std::abort();
+  }
+  WebPFreeDecBuffer(&dec_configs[0].output);
+  WebPFreeDecBuffer(&dec_configs[1].output);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Lifts the SIMD level limit and restores the CPU detection when going out of
+// scope, however the test exits.
+struct SimdLevelRestorer {
+  ~SimdLevelRestorer() {
+    if (!WebPSetMaxSimdLevel(WEBP_SIMD_AVX512)) std::abort();
+    fuzz_utils::VP8GetCPUInfo = default_VP8GetCPUInfo;
+  }
+};
+
+// Encodes 'pic' and decodes the result with the optimized functions limited to
+// each SIMD level in turn, and checks that the bitstreams and the samples are
+// the same at all levels, e.g. that the AVX-512 functions match the AVX2 and
+// plain C ones.
+void EncDecSimdLevelsTest(
+    fuzz_utils::WebPPictureCpp pic_cpp, WebPConfig config,
+    const fuzz_utils::CropOrScaleParams& crop_or_scale_params) {
+  WebPPicture& pic = pic_cpp.ref();
+  if (!fuzz_utils::CropOrScale(&pic, crop_or_scale_params)) return;
+
+  const SimdLevelRestorer simd_level_restorer;
+  std::vector<uint8_t> expected_bitstream, expected_samples;
+  for (const WebPSimdLevel level :
+       {WEBP_SIMD_NONE, WEBP_SIMD_SSE2, WEBP_SIMD_SSE4_1, WEBP_SIMD_AVX2,
+        WEBP_SIMD_AVX512}) {
+    if (!WebPSetMaxSimdLevel(level)) std::abort();
+
+    WebPPicture pic_copy;
+    if (!WebPPictureInit(&pic_copy)) std::abort();
+    if (!WebPPictureCopy(&pic, &pic_copy)) break;  // out of memory
+    WebPMemoryWriter memory_writer;
+    WebPMemoryWriterInit(&memory_writer);
+    std::unique_ptr<WebPMemoryWriter, fuzz_utils::UniquePtrDeleter>
+        memory_writer_owner(&memory_writer);
+    Enc(/*crop_or_scale_params=*/{}, config, pic_copy, memory_writer);
+    WebPPictureFree(&pic_copy);
+    if (memory_writer.size == 0) break;  // out of memory
+
+    int width, height;
+    uint8_t* const rgba = WebPDecodeRGBA(memory_writer.mem, memory_writer.size,
+                                         &width, &height);
+    if (rgba == nullptr) break;  // out of memory
+    const std::vector<uint8_t> samples(rgba,
+                                       rgba + (size_t)width * height * 4);
+    WebPFree(rgba);
+
+    const std::vector<uint8_t> bitstream(
+        memory_writer.mem, memory_writer.mem + memory_writer.size);
+    if (level == WEBP_SIMD_NONE) {
+      expected_bitstream = bitstream;
+      expected_samples = samples;
+    } else if (bitstream != expected_bitstream ||
+               samples != expected_samples) {
+      fprintf(stderr, "The %s output differs at SIMD level %d.\n",
+              config.lossless ? "lossless" : "lossy", level);
+      std::abort();
+    }
+  }
+}
+
 }  // namespace
 
 FUZZ_TEST(EncIndexDec, EncDecValidTest)
@@ -261,3 +400,71 @@ FUZZ_TEST(EncArbitraryDec, EncDecTest)
                  fuzz_utils::ArbitraryCropOrScaleParams(),
                  /*colorspace=*/fuzztest::Arbitrary<int>(),
                  fuzz_utils::ArbitraryWebPDecoderOptions());
+
+FUZZ_TEST(EncIndexDec, EncDecThreadsTest)
+    .WithDomains(fuzz_utils::ArbitraryWebPPictureFromIndex(),
+                 fuzz_utils::ArbitraryWebPConfig(),
+                 fuzz_utils::ArbitraryCropOrScaleParams(),
+                 fuzz_utils::ArbitraryValidWebPDecoderOptions(),
+                 /*num_pool_threads=*/fuzztest::InRange<int>(0, 3));
+
+FUZZ_TEST(EncIndexDec, EncDecSimdLevelsTest)
+    .WithDomains(fuzz_utils::ArbitraryWebPPictureFromIndex(),
+                 fuzz_utils::ArbitraryWebPConfig(),
+                 fuzz_utils::ArbitraryCropOrScaleParams());
+
+TEST(EncIndexDec, SimdLevels) {
+  for (size_t index = 0; index < fuzz_utils::kNumSourceImages; ++index) {
+    for (int lossless = 0; lossless <= 1; ++lossless) {
+      for (int method = 0; method <= 6; method += 3) {
+        WebPPicture pic =
+            fuzz_utils::GetSourcePicture(index, /*use_argb=*/true);
+        const fuzz_utils::WebPPictureCpp pic_cpp(
+            pic.use_argb, pic.colorspace, pic.width, pic.height, pic.y, pic.u,
+            pic.v, pic.y_stride, pic.uv_stride, pic.a, pic.a_stride, pic.argb,
+            pic.argb_stride, pic.memory_, pic.memory_argb_);
+        WebPConfig config;
+        if (!WebPConfigInit(&config)) std::abort();
+        config.lossless = lossless;
+        config.method = method;
+        EncDecSimdLevelsTest(pic_cpp, config, /*crop_or_scale_params=*/{});
+      }
+    }
+  }
+}
+
+// The lossless decoding only uses threads from a width of 512 pixels.
+TEST(EncIndexDec, LosslessThreads) {
+  for (const int width : {256, 511, 512, 513, 1024}) {
+    const int height = 80;
+    WebPPicture pic = fuzz_utils::GetSourcePicture(/*image_index=*/0,
+                                                   /*use_argb=*/true);
+    if (!WebPPictureRescale(&pic, width, height)) std::abort();
+    const fuzz_utils::WebPPictureCpp pic_cpp(
+        pic.use_argb, pic.colorspace, pic.width, pic.height, pic.y, pic.u,
+        pic.v, pic.y_stride, pic.uv_stride, pic.a, pic.a_stride, pic.argb,
+        pic.argb_stride, pic.memory_, pic.memory_argb_);
+    WebPConfig config;
+    if (!WebPConfigInit(&config)) std::abort();
+    config.lossless = 1;
+    config.method = 0;
+
+    fuzz_utils::WebPDecoderOptionsCpp decoder_options = {};
+    for (const bool use_cropping : {false, true}) {
+      for (const bool use_scaling : {false, true}) {
+        decoder_options.use_cropping = use_cropping;
+        decoder_options.crop_left = 6;
+        decoder_options.crop_top = 10;
+        decoder_options.crop_width = width - 16;
+        decoder_options.crop_height = height - 30;
+        decoder_options.use_scaling = use_scaling;
+        decoder_options.scaled_width = width / 3;
+        decoder_options.scaled_height = height / 2;
+        for (const int num_pool_threads : {0, 2}) {
+          EncDecThreadsTest(pic_cpp, config, /*crop_or_scale_params=*/{},
+                            decoder_options, num_pool_threads);
+        }
+      }
+    }
+  }
+}
@@ -14,16 +14,21 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <vector>
 
 #include "imageio/image_dec.h"
 #include "src/dsp/cpu.h"
+#include "gtest/gtest.h"
 #include "tests/fuzzer/fuzz_utils.h"
 #include "webp/decode.h"
 #include "webp/encode.h"
@@ -52,6 +57,14 @@ void EncTestImpl(WebPPicture& pic, uint32_t optimization_index, bool use_argb,
     config.lossless = 0;
   }
 
+  // Keep a copy of the source for streaming the lossy output.
+  WebPPicture stream_pic;
+  if (!WebPPictureInit(&stream_pic)) std::abort();
+  if (!config.lossless && !WebPPictureCopy(&pic, &stream_pic)) {
+    WebPPictureFree(&pic);
+    return;
+  }
+
   // Encode.
   WebPMemoryWriter memory_writer;
   WebPMemoryWriterInit(&memory_writer);
@@ -60,11 +73,35 @@ void EncTestImpl(WebPPicture& pic, uint32_t optimization_index, bool use_argb,
   if (!WebPEncode(&config, &pic)) {
     const WebPEncodingError error_code = pic.error_code;
     WebPMemoryWriterClear(&memory_writer);
+    WebPPictureFree(&stream_pic);
     if (error_code == VP8_ENC_ERROR_OUT_OF_MEMORY) return;
     std::cerr << "WebPEncode failed. Error code: " << error_code << "\n";
     std::abort();
   }
 
+  // The streamed output must be the same.
+  if (!config.lossless) {
+    WebPMemoryWriter stream_writer;
+    WebPMemoryWriterInit(&stream_writer);
+    stream_pic.writer = WebPMemoryWrite;
+    stream_pic.custom_ptr = &stream_writer;
+    stream_pic.stream_output = 1;
+    if (!WebPEncode(&config, &stream_pic)) {
+      if (stream_pic.error_code != VP8_ENC_ERROR_OUT_OF_MEMORY) {
+        std::cerr << "Streamed WebPEncode failed. Error code: "
+                  << stream_pic.error_code << "\n";
+        std::abort();
+      }
+    } else if (stream_writer.size != memory_writer.size ||
+               memcmp(stream_writer.mem, memory_writer.mem,
+                      memory_writer.size) != 0) {
+      std::cerr << "Streamed output differs.\n";
+      std::abort();
+    }
+    WebPMemoryWriterClear(&stream_writer);
+    WebPPictureFree(&stream_pic);
+  }
+
   // Try decoding the result.
   int w, h;
   const uint8_t* const out_data = memory_writer.mem;
@@ -137,8 +174,275 @@ void EncArbitraryTest(
   EncTestImpl(pic, optimization_index, use_argb, config, crop_or_scale_params);
 }
 
+// Encodes a copy of 'src' with 'context' if not NULL, or with WebPEncode()
+// otherwise. Returns false in case of memory error.
+bool EncodeToMemory(const WebPConfig& config, const WebPPicture& src,
+                    WebPEncoderContext* const context,
+                    std::vector<uint8_t>* const output) {
+  WebPPicture pic;
+  if (!WebPPictureInit(&pic)) std::abort();
+  if (!WebPPictureCopy(&src, &pic)) return false;
+  WebPMemoryWriter memory_writer;
+  WebPMemoryWriterInit(&memory_writer);
+  pic.writer = WebPMemoryWrite;
+  pic.custom_ptr = &memory_writer;
+  const int ok = (context != nullptr)
+                     ? WebPEncodeWithContext(context, &config, &pic)
+                     : WebPEncode(&config, &pic);
+  const WebPEncodingError error_code = pic.error_code;
+  WebPPictureFree(&pic);
+  if (!ok) {
+    WebPMemoryWriterClear(&memory_writer);
+    if (error_code == VP8_ENC_ERROR_OUT_OF_MEMORY) return false;
+    std::cerr << "Encoding failed. Error code: " << error_code << "\n";
+    std::abort();
+  }
+  output->assign(memory_writer.mem, memory_writer.mem + memory_writer.size);
+  WebPMemoryWriterClear(&memory_writer);
+  return true;
+}
+
+// Encodes a sequence of pictures of various sizes, lossy or lossless, with
+// the same context and checks that the output is the one of WebPEncode().
+// Each picture is given as its source index, whether it is lossless, its
+// width, height and method.
+void EncContextTest(
+    const std::vector<std::tuple<int, bool, int, int, int>>& pictures,
+    size_t max_retained_memory) {
+  WebPEncoderContext* const context =
+      WebPEncoderContextNew(max_retained_memory);
+  if (context == nullptr) std::abort();
+  for (const auto& [index, lossless, width, height, method] : pictures) {
+    WebPPicture pic = fuzz_utils::GetSourcePicture(index, /*use_argb=*/true);
+    WebPConfig config;
+    if (!WebPConfigInit(&config)) std::abort();
+    config.lossless = lossless;
+    config.method = method;
+    std::vector<uint8_t> expected, actual;
+    if (!WebPPictureCrop(&pic, 0, 0, std::min(width, pic.width),
+                         std::min(height, pic.height)) ||
+        !EncodeToMemory(config, pic, /*context=*/nullptr, &expected) ||
+        !EncodeToMemory(config, pic, context, &actual)) {
+      WebPPictureFree(&pic);
+      continue;  // out of memory
+    }
+    WebPPictureFree(&pic);
+    if (actual != expected) {
+      std::cerr << "WebPEncodeWithContext() and WebPEncode() differ.\n";
+      std::abort();
+    }
+  }
+  WebPEncoderContextDelete(context);
+}
+
+// Packs the samples of the ARGB picture 'pic' in 'format' (0: RGB, 1: RGBX,
+// 2: BGR, 3: BGRX), with the alpha as 'X' byte.
+std::vector<uint8_t> GetRGBSamples(const WebPPicture& pic, int format) {
+  const int step = (format & 1) ? 4 : 3;
+  const bool swap_rb = (format >= 2);
+  std::vector<uint8_t> rgb((size_t)pic.width * pic.height * step);
+  uint8_t* dst = rgb.data();
+  for (int y = 0; y < pic.height; ++y) {
+    for (int x = 0; x < pic.width; ++x, dst += step) {
+      const uint32_t argb = pic.argb[y * pic.argb_stride + x];
+      dst[swap_rb ? 2 : 0] = (argb >> 16) & 0xff;
+      dst[1] = (argb >> 8) & 0xff;
+      dst[swap_rb ? 0 : 2] = (argb >> 0) & 0xff;
+      if (step == 4) dst[3] = argb >> 24;
+    }
+  }
+  return rgb;
+}
+
+// Encodes 'rgb' samples in 'format' (see GetRGBSamples()) with WebPRowEncoder,
+// appending the rows by chunks of the sizes in 'num_rows', used in turn.
+// Returns false in case of memory error.
+bool RowEncodeToMemory(const WebPConfig& config, const uint8_t* const rgb,
+                       int format, int width, int height,
+                       const std::vector<int>& num_rows, int num_threads,
+                       WebPThreadPool* const thread_pool,
+                       std::vector<uint8_t>* const output) {
+  const int stride = width * ((format & 1) ? 4 : 3);
+  WebPPicture pic;
+  if (!WebPPictureInit(&pic)) std::abort();
+  pic.width = width;
+  pic.height = height;
+  pic.num_threads = num_threads;
+  pic.thread_pool = thread_pool;
+  WebPMemoryWriter memory_writer;
+  WebPMemoryWriterInit(&memory_writer);
+  pic.writer = WebPMemoryWrite;
+  pic.custom_ptr = &memory_writer;
+  WebPRowEncoder* const enc = WebPRowEncoderNew(&config, &pic);
+  int ok = (enc != nullptr);
+  for (int y = 0, i = 0; ok && y < height; ++i) {
+    const int n = std::min(num_rows[i % num_rows.size()], height - y);
+    const uint8_t* const rows = rgb + (size_t)y * stride;
+    switch (format) {
+      case 0: ok = WebPRowEncoderAppendRGB(enc, rows, stride, n); break;
+      case 1: ok = WebPRowEncoderAppendRGBX(enc, rows, stride, n); break;
+      case 2: ok = WebPRowEncoderAppendBGR(enc, rows, stride, n); break;
+      default: ok = WebPRowEncoderAppendBGRX(enc, rows, stride, n); break;
+    }
+    y += n;
+  }
+  ok = ok && WebPRowEncoderFinish(enc);
+  WebPRowEncoderDelete(enc);
+  if (!ok) {
+    WebPMemoryWriterClear(&memory_writer);
+    if (pic.error_code == VP8_ENC_ERROR_OUT_OF_MEMORY) return false;
+    std::cerr << "WebPRowEncoder failed. Error code: " << pic.error_code
+              << "\n";
+    std::abort();
+  }
+  output->assign(memory_writer.mem, memory_writer.mem + memory_writer.size);
+  WebPMemoryWriterClear(&memory_writer);
+  return true;
+}
+
+// Encodes the top-left 'width' x 'height' area of the source picture 'index'
+// with WebPRowEncoder and checks that the output is the one of WebPEncode()
+// with the single coding pass and RGB conversion of the row encoder. The
+// pictures are small enough to fit in one band of the row encoder.
+void RowEncoderTest(int index, int width, int height, WebPConfig config,
+                    int num_threads, int format,
+                    const std::vector<int>& num_rows, int num_pool_threads) {
+  WebPPicture src = fuzz_utils::GetSourcePicture(index, /*use_argb=*/true);
+  if (!WebPPictureCrop(&src, 0, 0, std::min(width, src.width),
+                       std::min(height, src.height))) {
+    WebPPictureFree(&src);
+    return;
+  }
+  width = src.width;
+  height = src.height;
+  const std::vector<uint8_t> rgb = GetRGBSamples(src, format);
+  WebPPictureFree(&src);
+
+  config.lossless = 0;
+  config.thread_level = (num_threads > 0);
+  WebPThreadPool* const thread_pool =
+      (num_pool_threads > 0) ? WebPThreadPoolNew(num_pool_threads) : nullptr;
+  std::vector<uint8_t> actual;
+  const bool ok = RowEncodeToMemory(config, rgb.data(), format, width, height,
+                                    num_rows, num_threads, thread_pool,
+                                    &actual);
+  WebPThreadPoolDelete(thread_pool);
+  if (!ok) return;
+
+  WebPConfig ref_config = config;
+  ref_config.low_memory = 1;
+  ref_config.target_size = 0;
+  ref_config.target_PSNR = 0.f;
+  ref_config.show_compressed = 0;
+  ref_config.use_sharp_yuv = 0;
+  ref_config.preprocessing &= 1;  // no sharp-YUV nor dithering
+  WebPPicture ref;
+  if (!WebPPictureInit(&ref)) std::abort();
+  ref.width = width;
+  ref.height = height;
+  const int stride = width * ((format & 1) ? 4 : 3);
+  const int imported =
+      (format == 0)   ? WebPPictureImportRGB(&ref, rgb.data(), stride)
+      : (format == 1) ? WebPPictureImportRGBX(&ref, rgb.data(), stride)
+      : (format == 2) ? WebPPictureImportBGR(&ref, rgb.data(), stride)
+                      : WebPPictureImportBGRX(&ref, rgb.data(), stride);
+  std::vector<uint8_t> expected;
+  if (!imported || !EncodeToMemory(ref_config, ref, nullptr, &expected)) {
+    WebPPictureFree(&ref);
+    return;
+  }
+  WebPPictureFree(&ref);
+  if (actual != expected) {
+    std::cerr << "WebPRowEncoder and WebPEncode() differ.\n";
+    std::abort();
+  }
+}
+
 }  // namespace
 
+FUZZ_TEST(Enc, RowEncoderTest)
+    .WithDomains(
+        /*index=*/fuzztest::InRange<int>(0, fuzz_utils::kNumSourceImages - 1),
+        /*width=*/fuzztest::InRange<int>(1, 128),
+        /*height=*/fuzztest::InRange<int>(1, 128),
+        fuzz_utils::ArbitraryWebPConfig(),
+        /*num_threads=*/fuzztest::InRange<int>(0, 3),
+        /*format=*/fuzztest::InRange<int>(0, 3),
+        /*num_rows=*/
+        fuzztest::VectorOf(fuzztest::InRange<int>(1, 40))
+            .WithMinSize(1)
+            .WithMaxSize(8),
+        /*num_pool_threads=*/fuzztest::InRange<int>(0, 2));
+
+// Pictures larger than a band of the row encoder can't be compared to
+// WebPEncode(), but their output must not depend on how the rows are appended
+// nor on the threads.
+TEST(Enc, RowEncoderBands) {
+  const int width = 1100, height = 1000;
+  WebPPicture pic;
+  ASSERT_TRUE(WebPPictureInit(&pic));
+  pic.use_argb = 1;
+  pic.width = width;
+  pic.height = height;
+  ASSERT_TRUE(WebPPictureAlloc(&pic));
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      pic.argb[y * pic.argb_stride + x] =
+          0xff000000u | ((uint32_t)((x * y) >> 4) & 0xff) << 16 |
+          ((uint32_t)(x ^ y) & 0xff) << 8 | ((3 * x + y) & 0xff);
+    }
+  }
+  const std::vector<uint8_t> rgb = GetRGBSamples(pic, /*format=*/0);
+  WebPPictureFree(&pic);
+  WebPThreadPool* const thread_pool = WebPThreadPoolNew(3);
+  ASSERT_NE(thread_pool, nullptr);
+  for (const int num_threads : {0, 2}) {
+    WebPConfig config;
+    ASSERT_TRUE(WebPConfigInit(&config));
+    config.thread_level = 1;
+    std::vector<uint8_t> expected;
+    ASSERT_TRUE(RowEncodeToMemory(config, rgb.data(), /*format=*/0, width,
+                                  height, {height}, num_threads, nullptr,
+                                  &expected));
+    for (const std::vector<int>& num_rows :
+         std::vector<std::vector<int>>{{1}, {16}, {7, 300, 2}}) {
+      std::vector<uint8_t> actual;
+      ASSERT_TRUE(RowEncodeToMemory(config, rgb.data(), /*format=*/0, width,
+                                    height, num_rows, num_threads, thread_pool,
+                                    &actual));
+      EXPECT_EQ(actual, expected);
+    }
+  }
+  WebPThreadPoolDelete(thread_pool);
+}
+
+FUZZ_TEST(Enc, EncContextTest)
+    .WithDomains(
+        fuzztest::VectorOf(
+            fuzztest::TupleOf(
+                /*index=*/fuzztest::InRange<int>(
+                    0, fuzz_utils::kNumSourceImages - 1),
+                /*lossless=*/fuzztest::Arbitrary<bool>(),
+                /*width=*/fuzztest::InRange<int>(1, 128),
+                /*height=*/fuzztest::InRange<int>(1, 128),
+                /*method=*/fuzztest::InRange<int>(0, 6)))
+            .WithMaxSize(8),
+        /*max_retained_memory=*/fuzztest::ElementOf<size_t>(
+            {0, 1 << 14, SIZE_MAX}));
+
+TEST(Enc, ContextMixedPictures) {
+  // Shrinking and growing sizes, alternating lossy and lossless.
+  const std::vector<std::tuple<int, bool, int, int, int>> pictures = {
+      {2, false, 128, 128, 4}, {0, false, 16, 8, 2},  {2, true, 128, 128, 4},
+      {1, true, 3, 16, 0},     {2, false, 100, 37, 6}, {0, true, 32, 32, 5},
+      {2, true, 128, 128, 6},  {1, false, 16, 16, 0}, {2, false, 128, 128, 3},
+  };
+  for (const size_t max_retained_memory : {size_t{0}, size_t{1} << 14,
+                                           SIZE_MAX}) {
+    EncContextTest(pictures, max_retained_memory);
+  }
+}
+
 FUZZ_TEST(Enc, EncArbitraryTest)
     .WithDomains(fuzz_utils::ArbitraryWebPPicture(),
                  /*optimization_index=*/
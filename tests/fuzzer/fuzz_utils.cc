@@ -89,7 +89,12 @@ static WEBP_INLINE int GetCPUInfoNoSSE41(CPUFeature feature) {
 }
 
 static WEBP_INLINE int GetCPUInfoNoAVX(CPUFeature feature) {
-  if (feature == kAVX) return 0;
+  if (feature == kAVX || feature == kAVX2 || feature == kAVX512) return 0;
+  return GetCPUInfo(feature);
+}
+
+static WEBP_INLINE int GetCPUInfoNoAVX512(CPUFeature feature) {
+  if (feature == kAVX512) return 0;
   return GetCPUInfo(feature);
 }
 
@@ -110,7 +115,7 @@ void SetOptimization(VP8CPUInfo default_VP8GetCPUInfo, uint32_t index) {
   GetCPUInfo = default_VP8GetCPUInfo;
   const VP8CPUInfo kVP8CPUInfos[kMaxOptimizationIndex + 1] = {
       GetCPUInfoOnlyC, GetCPUInfoForceSlowSSSE3, GetCPUInfoNoSSE41,
-      GetCPUInfoNoAVX, GetCPUInfo};
+      GetCPUInfoNoAVX, GetCPUInfoNoAVX512, GetCPUInfo};
   VP8GetCPUInfo = kVP8CPUInfos[index];
 }
 
@@ -287,6 +287,8 @@ struct WebPDecoderOptionsCpp {
 
   std::array<uint32_t, 5> pad;
 };
+static_assert(sizeof(WebPDecoderOptionsCpp) == sizeof(WebPDecoderOptions),
+              "WebPDecoderOptionsCpp must mirror WebPDecoderOptions");
 
 static inline auto ArbitraryValidWebPDecoderOptions() {
   return fuzztest::Map(
@@ -295,7 +297,7 @@ static inline auto ArbitraryValidWebPDecoderOptions() {
          int use_scaling, int scaled_width, int scaled_height, int use_threads,
          int dithering_strength, int flip,
          int alpha_dithering_strength) -> WebPDecoderOptionsCpp {
-        WebPDecoderOptions options;
+        WebPDecoderOptions options = {};
         options.bypass_filtering = bypass_filtering;
         options.no_fancy_upsampling = no_fancy_upsampling;
         options.use_cropping = use_cropping;
@@ -341,7 +343,7 @@ static inline auto ArbitraryWebPDecoderOptions() {
          int use_scaling, int scaled_width, int scaled_height, int use_threads,
          int dithering_strength, int flip,
          int alpha_dithering_strength) -> WebPDecoderOptionsCpp {
-        WebPDecoderOptions options;
+        WebPDecoderOptions options = {};
         options.bypass_filtering = bypass_filtering;
         options.no_fancy_upsampling = no_fancy_upsampling;
         options.use_cropping = use_cropping;
@@ -413,8 +415,8 @@ static inline auto ArbitraryCropOrScaleParams() {
 int CropOrScale(WebPPicture* pic, const CropOrScaleParams& params);
 
 // Imposes a level of optimization among one of the kMaxOptimizationIndex+1
-// possible values: OnlyC, ForceSlowSSSE3, NoSSE41, NoAVX, default.
-static constexpr uint32_t kMaxOptimizationIndex = 4;
+// possible values: OnlyC, ForceSlowSSSE3, NoSSE41, NoAVX, NoAVX512, default.
+static constexpr uint32_t kMaxOptimizationIndex = 5;
 void SetOptimization(VP8CPUInfo default_VP8GetCPUInfo, uint32_t index);
 
 //------------------------------------------------------------------------------
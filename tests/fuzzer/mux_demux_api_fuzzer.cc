@@ -14,20 +14,59 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 #include "./fuzz_utils.h"
+#include "gtest/gtest.h"
+#include "webp/decode.h"
 #include "webp/demux.h"
+#include "webp/encode.h"
 #include "webp/mux.h"
 #include "webp/mux_types.h"
 
 namespace {
 
+// Decodes the top-left area of a tiled image, if 'webp_data' is one.
+void TileDecoderApiTest(const WebPData& webp_data) {
+  WebPTileDecoder* const dec = WebPTileDecoderNew(&webp_data, nullptr);
+  if (dec == nullptr) return;
+  WebPTileInfo info;
+  if (!WebPTileDecoderGetInfo(dec, &info)) std::abort();
+  // Check the size of each tile, as in animation_api_fuzzer.
+  const WebPDemuxer* const demux = WebPTileDecoderGetDemuxer(dec);
+  WebPIterator iter;
+  bool small_tiles = (WebPDemuxGetFrame(demux, 1, &iter) != 0);
+  if (small_tiles) {
+    do {
+      int w, h;
+      if (WebPGetInfo(iter.fragment.bytes, iter.fragment.size, &w, &h) &&
+          (size_t)w * h > fuzz_utils::kFuzzPxLimit) {
+        small_tiles = false;
+      }
+    } while (small_tiles && WebPDemuxNextFrame(&iter));
+  }
+  WebPDemuxReleaseIterator(&iter);
+  if (small_tiles) {
+    const int width = (int)std::min(info.canvas_width, 64u);
+    const int height = (int)std::min(info.canvas_height, 64u);
+    std::vector<uint8_t> output((size_t)width * height * 4);
+    (void)WebPTileDecoderDecodeRegion(dec, 0, 0, width, height, output.data(),
+                                      width * 4);
+  }
+  WebPTileDecoderDelete(dec);
+}
+
 void MuxDemuxApiTest(std::string_view data_in, bool use_mux_api,
-                     const std::array<int, 10>& chunk_flags) {
+                     const std::array<int, 11>& chunk_flags) {
   const size_t size = data_in.size();
   WebPData webp_data;
   WebPDataInit(&webp_data);
@@ -35,7 +74,8 @@ void MuxDemuxApiTest(std::string_view data_in, bool use_mux_api,
   webp_data.bytes = reinterpret_cast<const uint8_t*>(data_in.data());
 
   // Extracted chunks and frames are not processed or decoded,
-  // which is already covered extensively by the other fuzz targets.
+  // which is already covered extensively by the other fuzz targets, except
+  // for a corner of tiled images to exercise the parsing of the "TILE" chunk.
 
   if (use_mux_api) {
     // Mux API
@@ -45,6 +85,7 @@ void MuxDemuxApiTest(std::string_view data_in, bool use_mux_api,
     WebPData chunk;
     (void)WebPMuxGetChunk(mux, "EXIF", &chunk);
     (void)WebPMuxGetChunk(mux, "ICCP", &chunk);
+    (void)WebPMuxGetChunk(mux, "TILE", &chunk);
     (void)WebPMuxGetChunk(mux, "FUZZ", &chunk);  // unknown
 
     uint32_t flags;
@@ -73,8 +114,9 @@ void MuxDemuxApiTest(std::string_view data_in, bool use_mux_api,
       custom_chunk.bytes = reinterpret_cast<const uint8_t*>(data_in.data()) + 4;
       custom_chunk.size = size - 4;
       int chunk_idx = 0;
-      for (std::string_view fourcc : {"VP8X", "ICCP", "ANIM", "EXIF", "XMP ",
-                                      "ANMF", "ALPH", "VP8 ", "VP8L", "FUZZ"}) {
+      for (std::string_view fourcc :
+           {"VP8X", "ICCP", "ANIM", "EXIF", "XMP ", "TILE", "ANMF", "ALPH",
+            "VP8 ", "VP8L", "FUZZ"}) {
         // The last five image chunks should return WEBP_MUX_INVALID_ARGUMENT.
         for (int i = 0; i < chunk_flags[chunk_idx]; i++) {
           (void)WebPMuxSetChunk(mux, fourcc.data(), &custom_chunk, 0);
@@ -83,10 +125,12 @@ void MuxDemuxApiTest(std::string_view data_in, bool use_mux_api,
       }
     }
 
-    // Try assembling the mux
+    // Try assembling the mux, and reading it as a tiled image.
     WebPData assembled;
     WebPDataInit(&assembled);
-    (void)WebPMuxAssemble(mux, &assembled);
+    if (WebPMuxAssemble(mux, &assembled) == WEBP_MUX_OK) {
+      TileDecoderApiTest(assembled);
+    }
     WebPDataClear(&assembled);
 
     // Get number of chunks of various types
@@ -133,13 +177,245 @@ void MuxDemuxApiTest(std::string_view data_in, bool use_mux_api,
 
     WebPDemuxReleaseIterator(&iter);
     WebPDemuxDelete(demux);
+
+    TileDecoderApiTest(webp_data);
+  }
+}
+
+// Encodes 'pic' as a grid of tiles of 'tile_width' x 'tile_height' into
+// 'webp_data'. Returns false in case of memory error.
+bool EncodeTiles(const WebPPicture& pic, const WebPConfig& config,
+                 int tile_width, int tile_height, WebPData* const webp_data) {
+  const int width = pic.width, height = pic.height;
+  WebPTileEncoder* const enc =
+      WebPTileEncoderNew(width, height, tile_width, tile_height);
+  if (enc == nullptr) {
+    fprintf(stderr, "WebPTileEncoderNew failed.\n");
+    std::abort();
+  }
+  for (int y = 0; y < height; y += tile_height) {
+    for (int x = 0; x < width; x += tile_width) {
+      WebPPicture tile;
+      if (!WebPPictureView(&pic, x, y, std::min(tile_width, width - x),
+                           std::min(tile_height, height - y), &tile)) {
+        std::abort();
+      }
+      const int ok = WebPTileEncoderAdd(enc, x / tile_width, y / tile_height,
+                                        &tile, &config);
+      WebPPictureFree(&tile);
+      if (!ok) {
+        WebPTileEncoderDelete(enc);
+        if (tile.error_code == VP8_ENC_ERROR_OUT_OF_MEMORY) return false;
+        fprintf(stderr, "WebPTileEncoderAdd failed. Error code: %d\n",
+                tile.error_code);
+        std::abort();
+      }
+    }
+  }
+  WebPDataInit(webp_data);
+  const WebPMuxError err = WebPTileEncoderAssemble(enc, webp_data);
+  WebPTileEncoderDelete(enc);
+  if (err == WEBP_MUX_MEMORY_ERROR) return false;
+  if (err != WEBP_MUX_OK) {
+    fprintf(stderr, "WebPTileEncoderAssemble failed: %d.\n", err);
+    std::abort();
+  }
+  return true;
+}
+
+// Encodes 'pic' as a grid of tiles of 'tile_width' x 'tile_height' and checks
+// that decoding each of the 'regions' (left, top, width and height ratios in
+// [0..255]) gives the samples of the full canvas.
+void TileDecoderRegionTest(const WebPPicture& pic, const WebPConfig& config,
+                           int tile_width, int tile_height,
+                           WEBP_CSP_MODE color_mode,
+                           const std::vector<std::array<uint8_t, 4>>& regions) {
+  const int width = pic.width, height = pic.height;
+  WebPData webp_data;
+  if (!EncodeTiles(pic, config, tile_width, tile_height, &webp_data)) return;
+
+  WebPTileDecoderOptions dec_options;
+  if (!WebPTileDecoderOptionsInit(&dec_options)) std::abort();
+  dec_options.color_mode = color_mode;
+  WebPTileDecoder* const dec = WebPTileDecoderNew(&webp_data, &dec_options);
+  if (dec == nullptr) {
+    fprintf(stderr, "WebPTileDecoderNew failed.\n");
+    std::abort();
+  }
+  const int bpp = (color_mode == MODE_RGB || color_mode == MODE_BGR) ? 3
+                  : (color_mode == MODE_RGBA_4444 ||
+                     color_mode == MODE_rgbA_4444 || color_mode == MODE_RGB_565)
+                      ? 2
+                      : 4;
+  std::vector<uint8_t> canvas((size_t)width * height * bpp);
+  std::vector<uint8_t> region(canvas.size());
+  if (!WebPTileDecoderDecodeRegion(dec, 0, 0, width, height, canvas.data(),
+                                   width * bpp)) {
+    fprintf(stderr, "Decoding the full canvas failed.\n");
+    std::abort();
+  }
+  for (const std::array<uint8_t, 4>& ratios : regions) {
+    const int left = ratios[0] * (width - 1) / 255;
+    const int top = ratios[1] * (height - 1) / 255;
+    const int w = 1 + ratios[2] * (width - left - 1) / 255;
+    const int h = 1 + ratios[3] * (height - top - 1) / 255;
+    if (!WebPTileDecoderDecodeRegion(dec, left, top, w, h, region.data(),
+                                     w * bpp)) {
+      fprintf(stderr, "Decoding the region %d,%d %dx%d failed.\n", left, top,
+              w, h);
+      std::abort();
+    }
+    for (int j = 0; j < h; ++j) {
+      if (std::memcmp(&region[(size_t)j * w * bpp],
+                      &canvas[((size_t)(top + j) * width + left) * bpp],
+                      (size_t)w * bpp) != 0) {
+        fprintf(stderr, "Region %d,%d %dx%d differs from the canvas.\n", left,
+                top, w, h);
+        std::abort();
+      }
+    }
   }
+  WebPTileDecoderDelete(dec);
+  WebPDataClear(&webp_data);
+}
+
+void TileDecoderRegionArbitraryTest(
+    fuzz_utils::WebPPictureCpp pic_cpp, WebPConfig config,
+    std::pair<int, int> tile_size, WEBP_CSP_MODE color_mode,
+    const std::vector<std::array<uint8_t, 4>>& regions) {
+  // Skip the slowest settings, which are not relevant to the tiling.
+  config.method = std::min(config.method, 4);
+  // The tile dimensions must be even.
+  TileDecoderRegionTest(pic_cpp.ref(), config, 2 * tile_size.first,
+                        2 * tile_size.second, color_mode, regions);
+}
+
+// Replaces the "TILE" chunk of a tiled image of the source picture 'index' by
+// 'tile_chunk' and checks that the image decodes either as the original one
+// or not at all.
+void TileChunkTest(int index, std::pair<int, int> tile_size,
+                   const std::vector<uint8_t>& tile_chunk) {
+  WebPPicture pic = fuzz_utils::GetSourcePicture(index, /*use_argb=*/true);
+  WebPConfig config;
+  if (!WebPConfigInit(&config)) std::abort();
+  config.lossless = 1;
+  WebPData webp_data;
+  const bool encoded = EncodeTiles(pic, config, 2 * tile_size.first,
+                                   2 * tile_size.second, &webp_data);
+  const int width = pic.width, height = pic.height;
+  WebPPictureFree(&pic);
+  if (!encoded) return;
+
+  std::vector<uint8_t> expected((size_t)width * height * 4);
+  WebPTileDecoder* dec = WebPTileDecoderNew(&webp_data, nullptr);
+  if (dec == nullptr ||
+      !WebPTileDecoderDecodeRegion(dec, 0, 0, width, height, expected.data(),
+                                   width * 4)) {
+    fprintf(stderr, "Decoding the tiled image failed.\n");
+    std::abort();
+  }
+  WebPTileDecoderDelete(dec);
+
+  WebPMux* const mux = WebPMuxCreate(&webp_data, /*copy_data=*/1);
+  WebPDataClear(&webp_data);
+  if (mux == nullptr) return;
+  const WebPData chunk = {tile_chunk.data(), tile_chunk.size()};
+  WebPDataInit(&webp_data);
+  const bool assembled =
+      WebPMuxSetChunk(mux, "TILE", &chunk, /*copy_data=*/1) == WEBP_MUX_OK &&
+      WebPMuxAssemble(mux, &webp_data) == WEBP_MUX_OK;
+  WebPMuxDelete(mux);
+  if (!assembled) {
+    WebPDataClear(&webp_data);
+    return;
+  }
+
+  dec = WebPTileDecoderNew(&webp_data, nullptr);
+  if (dec != nullptr) {
+    WebPTileInfo info;
+    if (!WebPTileDecoderGetInfo(dec, &info) ||
+        info.canvas_width != (uint32_t)width ||
+        info.canvas_height != (uint32_t)height) {
+      std::abort();
+    }
+    std::vector<uint8_t> output(expected.size());
+    if (WebPTileDecoderDecodeRegion(dec, 0, 0, width, height, output.data(),
+                                    width * 4) &&
+        output != expected) {
+      fprintf(stderr, "The tiles decoded with a modified grid differ.\n");
+      std::abort();
+    }
+    WebPTileDecoderDelete(dec);
+  }
+  WebPDataClear(&webp_data);
 }
 
 }  // namespace
 
+FUZZ_TEST(TileDecoder, TileChunkTest)
+    .WithDomains(
+        /*index=*/fuzztest::InRange<int>(0, fuzz_utils::kNumSourceImages - 1),
+        /*tile_size=*/
+        fuzztest::PairOf(fuzztest::InRange(1, 64), fuzztest::InRange(1, 64)),
+        /*tile_chunk=*/
+        fuzztest::VectorOf(fuzztest::Arbitrary<uint8_t>()).WithMaxSize(8));
+
+FUZZ_TEST(TileDecoder, TileDecoderRegionArbitraryTest)
+    .WithDomains(fuzz_utils::ArbitraryWebPPicture(),
+                 fuzz_utils::ArbitraryWebPConfig(),
+                 /*tile_size=*/
+                 fuzztest::PairOf(fuzztest::InRange(1, 64),
+                                  fuzztest::InRange(1, 64)),
+                 fuzztest::ElementOf<WEBP_CSP_MODE>(
+                     {MODE_RGB, MODE_RGBA, MODE_BGR, MODE_BGRA, MODE_ARGB,
+                      MODE_RGBA_4444, MODE_RGB_565, MODE_rgbA, MODE_bgrA,
+                      MODE_Argb, MODE_rgbA_4444}),
+                 /*regions=*/
+                 fuzztest::VectorOf(fuzztest::ArrayOf<4>(
+                                        fuzztest::Arbitrary<uint8_t>()))
+                     .WithMinSize(1)
+                     .WithMaxSize(8));
+
+// The alpha plane of lossy tiles decoded partially, from a row other than the
+// first one, used to differ from the full decoding.
+TEST(TileDecoder, LossyAlphaRegions) {
+  WebPPicture pic;
+  ASSERT_TRUE(WebPPictureInit(&pic));
+  pic.use_argb = 1;
+  pic.width = 300;
+  pic.height = 200;
+  ASSERT_TRUE(WebPPictureAlloc(&pic));
+  for (int y = 0; y < pic.height; ++y) {
+    for (int x = 0; x < pic.width; ++x) {
+      pic.argb[y * pic.argb_stride + x] =
+          ((uint32_t)((3 * x + 5 * y) & 0xff) << 24) |
+          ((uint32_t)((7 * x) ^ (3 * y)) & 0xff) << 8 | ((x * y) & 0xff);
+    }
+  }
+  std::vector<std::array<uint8_t, 4>> regions;
+  uint32_t seed = 1;
+  for (int i = 0; i < 64; ++i) {
+    std::array<uint8_t, 4> ratios;
+    for (uint8_t& ratio : ratios) {
+      seed = seed * 1103515245u + 12345u;
+      ratio = (uint8_t)(seed >> 16);
+    }
+    regions.push_back(ratios);
+  }
+  for (int alpha_filtering = 0; alpha_filtering <= 2; ++alpha_filtering) {
+    WebPConfig config;
+    ASSERT_TRUE(WebPConfigInit(&config));
+    config.alpha_filtering = alpha_filtering;
+    TileDecoderRegionTest(pic, config, 128, 64, MODE_RGBA, regions);
+    TileDecoderRegionTest(pic, config, 128, 64, MODE_rgbA, regions);
+    // A single tile, cropped to the canvas.
+    TileDecoderRegionTest(pic, config, 512, 512, MODE_RGBA, regions);
+  }
+  WebPPictureFree(&pic);
+}
+
 FUZZ_TEST(MuxDemuxApi, MuxDemuxApiTest)
     .WithDomains(
         fuzztest::String().WithMaxSize(fuzz_utils::kMaxWebPFileSize + 1),
         /*mux=*/fuzztest::Arbitrary<bool>(),
-        /*chunk_flags=*/fuzztest::ArrayOf<10>(fuzztest::InRange(0, 2)));
+        /*chunk_flags=*/fuzztest::ArrayOf<11>(fuzztest::InRange(0, 2)));